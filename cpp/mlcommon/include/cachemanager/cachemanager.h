@@ -18,6 +18,7 @@
 #define CACHEMANAGER_H
 
 #include <QString>
+#include <QStringList>
 #include <QVariant>
 
 class CacheManagerPrivate;
@@ -43,6 +44,10 @@ public:
     QString makeExpiringFile(QString file_name, qint64 duration_sec);
     void removeExpiredFiles();
 
+    //persistent caches: files that are kept between sessions and removed least recently used first, by size
+    QString makeCacheFile(const QString& cache_name, const QString& file_name);
+    void limitCacheSize(const QString& cache_name, double max_gb, const QStringList& keep_paths = QStringList()); //keep_paths are never removed
+
     void cleanUp();
 
     static CacheManager* globalInstance();
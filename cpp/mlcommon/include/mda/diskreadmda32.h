@@ -25,6 +25,9 @@ class DiskReadMda32Private;
  * \class DiskReadMda32
  * @brief Read-only access to a .mda file, especially useful for huge arrays that cannot be practically loaded into memory.
  *
+ * The const methods may be called concurrently from several threads. Local files are memory-mapped
+ * (see MdaFileMap) and small reads go through the process-wide MdaBlockCache.
+ *
  * See also Mda32
  */
 class DiskReadMda32 {
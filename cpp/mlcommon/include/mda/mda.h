@@ -20,12 +20,14 @@
 #include <QString>
 #include <QDebug>
 #include <QSharedDataPointer>
+#include <QSharedPointer>
 
 #include "mlcommon.h"
 
 extern void* allocate(bigint nbytes);
 
 class MdaDataDouble;
+class MdaFileMap;
 /** \class Mda - a multi-dimensional array corresponding to the .mda file format
  * @brief The Mda class
  *
@@ -161,6 +163,11 @@ public:
 
     void detach();
 
+    ///Make this array a read-only view of external memory (e.g. a memory-mapped file) without copying. The data is copied on the first non-const access.
+    void setExternalData(const QSharedPointer<MdaFileMap>& keepalive, const double* ptr, bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1);
+    ///True if the array is still a read-only view created by setExternalData()
+    bool isExternal() const;
+
 private:
     QSharedDataPointer<MdaDataDouble> d;
 };
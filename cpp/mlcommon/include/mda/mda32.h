@@ -22,6 +22,7 @@
 #include <QDebug>
 #endif
 
+#include <QSharedPointer>
 #include "mlcommon.h"
 
 typedef float dtype32;
@@ -29,6 +30,7 @@ typedef float dtype32;
 extern void* allocate(const bigint nbytes);
 
 class MdaDataFloat;
+class MdaFileMap;
 
 /** \class Mda32 - a multi-dimensional array corresponding to the .mda file format
  * @brief The Mda32 class
@@ -160,6 +162,11 @@ public:
 
     bool reshape(bigint N1b, bigint N2b, bigint N3b = 1, bigint N4b = 1, bigint N5b = 1, bigint N6b = 1);
 
+    ///Make this array a read-only view of external memory (e.g. a memory-mapped file) without copying. The data is copied on the first non-const access.
+    void setExternalData(const QSharedPointer<MdaFileMap>& keepalive, const dtype32* ptr, bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1);
+    ///True if the array is still a read-only view created by setExternalData()
+    bool isExternal() const;
+
 private:
     QSharedDataPointer<MdaDataFloat> d;
 };
@@ -17,6 +17,7 @@
 #define MDA_P_H
 
 #include <QSharedData>
+#include <QSharedPointer>
 #include "icounter.h"
 #include <objectregistry.h>
 #include <cstring>
@@ -24,6 +25,8 @@
 
 #define MDA_MAX_DIMS 6
 
+class MdaFileMap;
+
 template <typename T>
 class MdaData : public QSharedData {
 public:
@@ -55,6 +58,12 @@ public:
         , bytesReadCounter(other.bytesReadCounter)
         , bytesWrittenCounter(other.bytesWrittenCounter)
     {
+        if (other.m_external) {
+            //still a read-only view -- the copy happens in data() if anyone writes
+            m_data = other.m_data;
+            m_external = other.m_external;
+            return;
+        }
         allocate(total_size);
         std::copy(other.m_data, other.m_data + other.totalSize(), m_data);
     }
@@ -86,6 +95,17 @@ public:
         return true;
     }
 
+    ///Point at read-only external memory (kept alive by keepalive) instead of owning a buffer
+    void setExternalData(const QSharedPointer<MdaFileMap>& keepalive, const T* ptr, bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1)
+    {
+        deallocate();
+        setDims(N1, N2, N3, N4, N5, N6);
+        setTotalSize(N1 * N2 * N3 * N4 * N5 * N6);
+        m_data = const_cast<pointer>(ptr);
+        m_external = keepalive;
+    }
+    inline bool isExternal() const { return !m_external.isNull(); }
+
     inline bigint dim(bigint idx) const { return m_dims.at(idx); }
     inline bigint N1() const { return dim(0); }
     inline bigint N2() const { return dim(1); }
@@ -100,6 +120,11 @@ public:
     }
     void deallocate()
     {
+        if (m_external) {
+            m_external.clear();
+            m_data = 0;
+            return;
+        }
         if (!m_data)
             return;
         free(m_data);
@@ -108,11 +133,16 @@ public:
     }
     inline bigint totalSize() const { return total_size; }
     inline void setTotalSize(bigint ts) { total_size = ts; }
-    inline T* data() { return m_data; }
+    inline T* data()
+    {
+        if (m_external)
+            detach_external();
+        return m_data;
+    }
     inline const T* constData() const { return m_data; }
     inline T at(bigint idx) const { return *(constData() + idx); }
     inline T at(bigint i1, bigint i2) const { return at(i1 + dim(0) * i2); }
-    inline void set(T val, bigint idx) { m_data[idx] = val; }
+    inline void set(T val, bigint idx) { data()[idx] = val; }
     inline void set(T val, bigint i1, bigint i2) { set(val, i1 + dim(0) * i2); }
 
     inline bigint dims(bigint idx) const
@@ -257,7 +287,18 @@ public:
     }
 
 private:
+    void detach_external()
+    {
+        const T* src = m_data;
+        m_data = 0;
+        allocate(totalSize());
+        if (m_data)
+            std::copy(src, src + totalSize(), m_data);
+        m_external.clear();
+    }
+
     pointer m_data;
+    QSharedPointer<MdaFileMap> m_external;
     std::vector<bigint> m_dims;
     bigint total_size;
     mutable IIntCounter* allocatedCounter = nullptr;
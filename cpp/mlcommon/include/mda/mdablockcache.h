@@ -0,0 +1,59 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MDABLOCKCACHE_H
+#define MDABLOCKCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include "mlcommon.h"
+
+class MdaBlockCachePrivate;
+/**
+ * \class MdaBlockCache
+ * @brief Process-wide LRU cache of decoded .mda blocks, shared by all DiskReadMda/DiskReadMda32 instances.
+ *
+ * Blocks are keyed by (file, entry size, block index) and hold blockSize() consecutive entries of the
+ * vectorized array, already converted to the reader's value type. The cache is split into independently
+ * locked shards so that concurrent readers (e.g. OpenMP workers) rarely contend. Hits, misses and
+ * evictions are reported to the mda_cache_hits, mda_cache_misses and mda_cache_evictions counters.
+ */
+class MdaBlockCache {
+public:
+    friend class MdaBlockCachePrivate;
+    MdaBlockCache();
+    virtual ~MdaBlockCache();
+
+    ///Return the cached block, or a null QByteArray if it is not in the cache
+    QByteArray block(const QString& file_key, int entry_size, bigint block_index);
+    ///Insert (or replace) a block, evicting the least recently used blocks as needed
+    void insertBlock(const QString& file_key, int entry_size, bigint block_index, const QByteArray& data);
+    ///Drop all blocks of a file, e.g. after it has been rewritten
+    void removeFile(const QString& file_key);
+    void clear();
+
+    void setMaxBytes(bigint num_bytes);
+    bigint maxBytes() const;
+    bigint numBytes() const;
+
+    ///Number of entries per block
+    static bigint blockSize();
+    static MdaBlockCache* globalInstance();
+
+private:
+    MdaBlockCachePrivate* d;
+};
+
+#endif // MDABLOCKCACHE_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MDAFILEMAP_H
+#define MDAFILEMAP_H
+
+#include <QSharedPointer>
+#include <QString>
+#include "mdaio.h"
+
+class MdaFileMapPrivate;
+/**
+ * \class MdaFileMap
+ * @brief A read-only memory mapping of an entire .mda file, shared by every DiskReadMda/DiskReadMda32 that reads the same path.
+ *
+ * The mapping stays valid for as long as any QSharedPointer to it (including Mda/Mda32 views created from it) is alive.
+ */
+class MdaFileMap {
+public:
+    friend class MdaFileMapPrivate;
+    virtual ~MdaFileMap();
+
+    ///Return the (shared) mapping of the .mda file at path, or a null pointer if mapping is disabled or fails
+    static QSharedPointer<MdaFileMap> map(const QString& path);
+    ///Globally enable or disable memory mapping (enabled by default). Readers fall back to stdio when disabled.
+    static void setEnabled(bool val);
+    static bool enabled();
+
+    QString path() const;
+    ///The header as read from the file
+    MDAIO_HEADER header() const;
+    ///Pointer to the first byte of the file (not of the array data -- add header().header_size)
+    const unsigned char* constDataPtr() const;
+    ///The size of the mapped file in bytes
+    bigint size() const;
+
+private:
+    MdaFileMap();
+    MdaFileMapPrivate* d;
+};
+
+#endif // MDAFILEMAP_H
@@ -91,6 +91,10 @@ bigint mda_read_uint16(uint16_t* data, struct MDAIO_HEADER* H, bigint n, FILE* i
 bigint mda_read_float64(double* data, struct MDAIO_HEADER* H, bigint n, FILE* input_file);
 bigint mda_read_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, FILE* input_file);
 
+//convert n entries stored in memory using the header data type (e.g. from a memory-mapped file)
+bigint mda_convert_float32(float* data, const struct MDAIO_HEADER* H, bigint n, const void* src);
+bigint mda_convert_float64(double* data, const struct MDAIO_HEADER* H, bigint n, const void* src);
+
 //the following can be used no matter what the underlying data type is
 bigint mda_write_byte(unsigned char* data, struct MDAIO_HEADER* H, bigint n, FILE* output_file);
 bigint mda_write_float32(const float* data, struct MDAIO_HEADER* H, bigint n, FILE* output_file);
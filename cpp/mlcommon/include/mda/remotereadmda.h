@@ -40,16 +40,17 @@ public:
     void setPath(const QString& path);
     QString makePath() const; //not capturing the reshaping
 
-    bool reshape(int N1b, int N2b, int N3b);
+    bool reshape(bigint N1b, bigint N2b, bigint N3b);
 
-    int N1() const;
-    int N2() const;
-    int N3() const;
+    bigint N1() const;
+    bigint N2() const;
+    bigint N3() const;
     QDateTime fileLastModified() const;
 
-    ///Retrieve a chunk of the vectorized data of size 1xN starting at position i
-    bool readChunk(Mda& X, int i, int size) const;
-    bool readChunk32(Mda32& X, int i, int size) const;
+    ///Retrieve a chunk of the vectorized data of size 1xN starting at position i. The chunks of the remote array that
+    ///are needed are downloaded in parallel and kept in a persistent cache (see CacheManager::makeCacheFile)
+    bool readChunk(Mda& X, bigint i, bigint size) const;
+    bool readChunk32(Mda32& X, bigint i, bigint size) const;
 
 private:
     RemoteReadMdaPrivate* d;
@@ -354,6 +354,47 @@ void CacheManager::removeExpiredFiles()
     */
 }
 
+QString CacheManager::makeCacheFile(const QString& cache_name, const QString& file_name)
+{
+    QString dirname = localTempPath() + "/tmp_long_term/" + cache_name;
+    if (!QDir(dirname).exists())
+        QDir(localTempPath() + "/tmp_long_term").mkdir(cache_name);
+    return dirname + "/" + file_name;
+}
+
+void CacheManager::limitCacheSize(const QString& cache_name, double max_gb, const QStringList& keep_paths)
+{
+    QString dirname = localTempPath() + "/tmp_long_term/" + cache_name;
+    if (!QDir(dirname).exists())
+        return;
+    QList<CMFileRec> records = get_file_records(dirname);
+    double total_size_gb = 0;
+    for (int i = 0; i < records.count(); i++) {
+        //a file that has been read since it was written counts as recently used
+        QDateTime last_read = QFileInfo(records[i].path).lastRead();
+        if (last_read.isValid())
+            records[i].elapsed_sec = qMin(records[i].elapsed_sec, (int)last_read.secsTo(QDateTime::currentDateTime()));
+        total_size_gb += records[i].size_gb;
+    }
+    if (total_size_gb <= max_gb)
+        return;
+    double amount_to_remove = total_size_gb - 0.75 * max_gb; //as in cleanUp, get it down to 75% of the max allowed
+    double amount_removed = 0;
+    int num_files_removed = 0;
+    sort_by_elapsed(records);
+    for (int i = 0; (i < records.count()) && (amount_removed < amount_to_remove); i++) {
+        if (keep_paths.contains(records[i].path))
+            continue;
+        if (!QFile::remove(records[i].path)) {
+            qCWarning(CM) << "Unable to remove file while limiting cache size: " + records[i].path;
+            continue;
+        }
+        amount_removed += records[i].size_gb;
+        num_files_removed++;
+    }
+    qCInfo(CM) << QString("CacheManager removed %1 GB and %2 files from %3").arg(amount_removed).arg(num_files_removed).arg(cache_name);
+}
+
 void CacheManager::cleanUp()
 {
     double max_gb = MLUtil::configValue("general", "max_cache_size_gb").toDouble();
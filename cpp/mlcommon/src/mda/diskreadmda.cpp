@@ -27,9 +27,13 @@
 #include <QJsonArray>
 #include <icounter.h>
 #include <objectregistry.h>
+#include "mdafilemap.h"
+#include "mdablockcache.h"
+#include <QMutex>
+#include <QDateTime>
 
 #define MAX_PATH_LEN 10000
-#define DEFAULT_CHUNK_SIZE 1e5
+#define MAX_CACHED_READ_NUM_BLOCKS 4
 
 /// TODO (LOW) make tmp directory with different name on server, so we can really test if it is doing the computation in the right place
 
@@ -37,13 +41,17 @@ class DiskReadMdaPrivate {
 public:
     DiskReadMda* q;
     FILE* m_file;
+    QSharedPointer<MdaFileMap> m_map; //shared with all copies of this object
     bool m_file_open_failed;
     bool m_header_read;
     MDAIO_HEADER m_header;
     bool m_reshaped;
     bigint m_mda_header_total_size;
-    Mda m_internal_chunk;
-    int m_current_internal_chunk_index;
+    QString m_cache_key; //identifies the file (and its version) in the shared block cache
+    QByteArray m_current_block; //most recent block used by value(), also held by the block cache
+    bigint m_current_block_index;
+    QMutex m_file_mutex { QMutex::Recursive }; //guards opening and stdio reads, so that const methods are reentrant
+    QMutex m_block_mutex;
     Mda m_memory_mda;
     bool m_use_memory_mda = false;
     bool m_use_concat = false;
@@ -61,6 +69,10 @@ public:
     void construct_and_clear();
     bool read_header_if_needed();
     bool open_file_if_needed();
+    bool make_view(Mda& X, bigint i, bigint size1, bigint size2, bigint size3);
+    bigint read_entries(double* data, bigint i, bigint n);
+    bigint read_entries_cached(double* data, bigint i, bigint n);
+    QByteArray get_block(bigint block_index);
     void copy_from(const DiskReadMda& other);
     bigint total_size();
     static QStringList find_all_mda_files_in_directory(QString dir_path, bool recursive);
@@ -578,13 +590,14 @@ bool DiskReadMda::readChunk(Mda& X, bigint i, bigint size) const
     }
     if (!d->open_file_if_needed())
         return false;
+    if (d->make_view(X, i, size, 1, 1))
+        return true;
     X.allocate(size, 1);
     bigint jA = qMax(i, (bigint)0);
     bigint jB = qMin(i + size - 1, d->total_size() - 1);
     bigint size_to_read = jB - jA + 1;
     if (size_to_read > 0) {
-        fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (jA), SEEK_SET);
-        bigint bytes_read = mda_read_float64(&X.dataPtr()[jA - i], &d->m_header, size_to_read, d->m_file);
+        bigint bytes_read = d->read_entries_cached(&X.dataPtr()[jA - i], jA, size_to_read);
         if (d->bytesReadCounter)
             d->bytesReadCounter->add(bytes_read);
         if (bytes_read != size_to_read) {
@@ -613,13 +626,14 @@ bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint size1, bigint s
         return false;
     if ((size1 == N1()) && (i1 == 0)) {
         //easy case
+        if (d->make_view(X, i1 + N1() * i2, size1, size2, 1))
+            return true;
         X.allocate(size1, size2);
         bigint jA = qMax(i2, (bigint)0);
         bigint jB = qMin(i2 + size2 - 1, N2() - 1);
         bigint size2_to_read = jB - jA + 1;
         if (size2_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i2) * size1], &d->m_header, size1 * size2_to_read, d->m_file);
+            bigint bytes_read = d->read_entries_cached(&X.dataPtr()[(jA - i2) * size1], i1 + N1() * jA, size1 * size2_to_read);
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
             if (bytes_read != size1 * size2_to_read) {
@@ -658,13 +672,14 @@ bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint i3, bigint size
         return false;
     if ((size1 == N1()) && (size2 == N2())) {
         //easy case
+        if (d->make_view(X, i1 + N1() * i2 + N1() * N2() * i3, size1, size2, size3))
+            return true;
         X.allocate(size1, size2, size3);
         bigint jA = qMax(i3, (bigint)0);
         bigint jB = qMin(i3 + size3 - 1, N3() - 1);
         bigint size3_to_read = jB - jA + 1;
         if (size3_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * i2 + N1() * N2() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i3) * size1 * size2], &d->m_header, size1 * size2 * size3_to_read, d->m_file);
+            bigint bytes_read = d->read_entries_cached(&X.dataPtr()[(jA - i3) * size1 * size2], i1 + N1() * i2 + N1() * N2() * jA, size1 * size2 * size3_to_read);
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
             if (bytes_read != size1 * size2 * size3_to_read) {
@@ -686,18 +701,20 @@ double DiskReadMda::value(bigint i) const
         return d->m_memory_mda.value(i);
     if ((i < 0) || (i >= d->total_size()))
         return 0;
-    bigint chunk_index = i / DEFAULT_CHUNK_SIZE;
-    bigint offset = i - DEFAULT_CHUNK_SIZE * chunk_index;
-    if (d->m_current_internal_chunk_index != chunk_index) {
-        bigint size_to_read = DEFAULT_CHUNK_SIZE;
-        if (chunk_index * DEFAULT_CHUNK_SIZE + size_to_read > d->total_size())
-            size_to_read = d->total_size() - chunk_index * DEFAULT_CHUNK_SIZE;
-        if (size_to_read) {
-            this->readChunk(d->m_internal_chunk, chunk_index * DEFAULT_CHUNK_SIZE, size_to_read);
-        }
-        d->m_current_internal_chunk_index = chunk_index;
+    bigint block_index = i / MdaBlockCache::blockSize();
+    bigint offset = i - MdaBlockCache::blockSize() * block_index;
+    QMutexLocker locker(&d->m_block_mutex);
+    if (d->m_current_block_index != block_index) {
+        //don't hold the lock while loading, other threads may be using the current block
+        locker.unlock();
+        QByteArray block = d->get_block(block_index);
+        locker.relock();
+        d->m_current_block = block;
+        d->m_current_block_index = block_index;
     }
-    return d->m_internal_chunk.value(offset);
+    if ((offset + 1) * (bigint)sizeof(double) > d->m_current_block.size())
+        return 0;
+    return ((const double*)d->m_current_block.constData())[offset];
 }
 
 double DiskReadMda::value(bigint i1, bigint i2) const
@@ -728,12 +745,14 @@ void DiskReadMdaPrivate::construct_and_clear()
 {
     m_file_open_failed = false;
     m_file = 0;
-    m_current_internal_chunk_index = -1;
+    m_map.clear();
+    m_cache_key.clear();
+    m_current_block.clear();
+    m_current_block_index = -1;
     m_use_memory_mda = false;
     m_use_concat = false;
     m_header_read = false;
     m_reshaped = false;
-    this->m_internal_chunk = Mda();
     this->m_mda_header_total_size = 0;
     this->m_memory_mda = Mda();
     this->m_path = "";
@@ -743,6 +762,7 @@ bool DiskReadMdaPrivate::read_header_if_needed()
 {
     if (m_header_read)
         return true;
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda) {
         m_header_read = true;
         return true;
@@ -779,6 +799,8 @@ bool DiskReadMdaPrivate::read_header_if_needed()
     bool file_was_open = (m_file != 0); //so we can restore to previous state (we don't want too many files open unnecessarily)
     if (!open_file_if_needed()) //if successful, it will read the header
         return false;
+    if (m_map)
+        return true; //the mapping is shared, so there is no reason to release it
     if (!m_file)
         return false; //should never happen
     if (!file_was_open) {
@@ -790,18 +812,33 @@ bool DiskReadMdaPrivate::read_header_if_needed()
 
 bool DiskReadMdaPrivate::open_file_if_needed()
 {
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda)
         return true;
     if (m_use_concat) {
         read_header_if_needed();
         return true;
     }
-    if (m_file)
+    if ((m_file) || (m_map))
         return true;
     if (m_file_open_failed)
         return false;
     if (m_path.isEmpty())
         return false;
+    QFileInfo info(m_path);
+    m_cache_key = QString("%1:%2:%3").arg(info.canonicalFilePath()).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+    m_map = MdaFileMap::map(m_path);
+    if (m_map) {
+        if (!m_header_read) {
+            //important not to read it again in case we have reshaped the array
+            m_header = m_map->header();
+            m_mda_header_total_size = 1;
+            for (int i = 0; i < MDAIO_MAX_DIMS; i++)
+                m_mda_header_total_size *= m_header.dims[i];
+            m_header_read = true;
+        }
+        return true;
+    }
     m_file = fopen(m_path.toUtf8().data(), "rb");
     if (m_file) {
         if (!m_header_read) {
@@ -827,6 +864,81 @@ bool DiskReadMdaPrivate::open_file_if_needed()
     return true;
 }
 
+bool DiskReadMdaPrivate::make_view(Mda& X, bigint i, bigint size1, bigint size2, bigint size3)
+{
+    //zero-copy only when the stored type matches and the whole range is inside the array
+    if ((!m_map) || (m_header.data_type != MDAIO_TYPE_FLOAT64))
+        return false;
+    bigint size = size1 * size2 * size3;
+    if ((i < 0) || (size <= 0) || (i + size > total_size()))
+        return false;
+    const unsigned char* ptr = m_map->constDataPtr() + m_header.header_size + m_header.num_bytes_per_entry * i;
+    if ((uintptr_t)ptr % sizeof(double) != 0)
+        return false;
+    X.setExternalData(m_map, (const double*)ptr, size1, size2, size3);
+    if (bytesReadCounter)
+        bytesReadCounter->add(size);
+    return true;
+}
+
+bigint DiskReadMdaPrivate::read_entries(double* data, bigint i, bigint n)
+{
+    if (m_map) {
+        const unsigned char* ptr = m_map->constDataPtr() + m_header.header_size + m_header.num_bytes_per_entry * i;
+        return mda_convert_float64(data, &m_header, n, ptr);
+    }
+    QMutexLocker locker(&m_file_mutex);
+    fseeko(m_file, m_header.header_size + m_header.num_bytes_per_entry * i, SEEK_SET);
+    return mda_read_float64(data, &m_header, n, m_file);
+}
+
+bigint DiskReadMdaPrivate::read_entries_cached(double* data, bigint i, bigint n)
+{
+    //large reads would only flush the shared cache, so they go straight to the file
+    bigint block_size = MdaBlockCache::blockSize();
+    if ((m_cache_key.isEmpty()) || (n > MAX_CACHED_READ_NUM_BLOCKS * block_size))
+        return read_entries(data, i, n);
+    bigint num_read = 0;
+    for (bigint block_index = i / block_size; block_index * block_size < i + n; block_index++) {
+        QByteArray block = get_block(block_index);
+        const double* ptr = (const double*)block.constData();
+        bigint j1 = qMax(i, block_index * block_size);
+        bigint j2 = qMin(i + n, block_index * block_size + block.size() / (bigint)sizeof(double));
+        if (j2 <= j1)
+            break;
+        std::copy(ptr + j1 - block_index * block_size, ptr + j2 - block_index * block_size, data + j1 - i);
+        num_read += j2 - j1;
+    }
+    return num_read;
+}
+
+QByteArray DiskReadMdaPrivate::get_block(bigint block_index)
+{
+    bigint block_size = MdaBlockCache::blockSize();
+    bigint i0 = block_index * block_size;
+    bigint n = qMin(block_size, total_size() - i0);
+    if (n <= 0)
+        return QByteArray();
+    if ((m_use_concat) || (m_cache_key.isEmpty())) {
+        //the concatenated arrays do their own caching
+        Mda X;
+        if (!q->readChunk(X, i0, n))
+            return QByteArray();
+        return QByteArray((const char*)X.constDataPtr(), n * sizeof(double));
+    }
+    MdaBlockCache* cache = MdaBlockCache::globalInstance();
+    QByteArray ret = cache->block(m_cache_key, sizeof(double), block_index);
+    if (!ret.isNull())
+        return ret;
+    if (!open_file_if_needed())
+        return QByteArray();
+    ret.resize(n * sizeof(double));
+    if (read_entries((double*)ret.data(), i0, n) != n)
+        return QByteArray();
+    cache->insertBlock(m_cache_key, sizeof(double), block_index, ret);
+    return ret;
+}
+
 void DiskReadMdaPrivate::copy_from(const DiskReadMda& other)
 {
     /// TODO (LOW) think about copying over additional information such as internal chunks
@@ -840,7 +952,8 @@ void DiskReadMdaPrivate::copy_from(const DiskReadMda& other)
     this->bytesReadCounter = other.d->bytesReadCounter;
     this->bytesWrittenCounter = other.d->bytesWrittenCounter;
     this->construct_and_clear();
-    this->m_current_internal_chunk_index = -1;
+    this->m_map = other.d->m_map;
+    this->m_cache_key = other.d->m_cache_key;
     this->m_file_open_failed = other.d->m_file_open_failed;
     this->m_header = other.d->m_header;
     this->m_header_read = other.d->m_header_read;
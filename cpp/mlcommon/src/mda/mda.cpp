@@ -817,6 +817,16 @@ void Mda::detach()
     d.detach();
 }
 
+void Mda::setExternalData(const QSharedPointer<MdaFileMap>& keepalive, const double* ptr, bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
+{
+    d->setExternalData(keepalive, ptr, N1, N2, N3, N4, N5, N6);
+}
+
+bool Mda::isExternal() const
+{
+    return d->isExternal();
+}
+
 void Mda::set(double val, bigint i)
 {
     d->set(val, i);
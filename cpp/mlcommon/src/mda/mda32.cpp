@@ -719,3 +719,13 @@ void Mda32::set(dtype32 val, bigint i1, bigint i2, bigint i3, bigint i4, bigint
 
     d->set(val, i1 + d->dims(0) * i2 + d01 * i3 + d02 * i4 + d03 * i5 + d04 * i6);
 }
+
+void Mda32::setExternalData(const QSharedPointer<MdaFileMap>& keepalive, const dtype32* ptr, bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
+{
+    d->setExternalData(keepalive, ptr, N1, N2, N3, N4, N5, N6);
+}
+
+bool Mda32::isExternal() const
+{
+    return d->isExternal();
+}
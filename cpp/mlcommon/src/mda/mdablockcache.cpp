@@ -0,0 +1,222 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mdablockcache.h"
+#include <QHash>
+#include <QMutex>
+#include <list>
+#include <icounter.h>
+#include <objectregistry.h>
+
+#define MDA_BLOCK_CACHE_NUM_SHARDS 16
+#define MDA_BLOCK_CACHE_BLOCK_SIZE 65536
+#define MDA_BLOCK_CACHE_DEFAULT_MAX_BYTES 512e6
+
+struct MdaBlockKey {
+    QString file_key;
+    int entry_size;
+    bigint block_index;
+    bool operator==(const MdaBlockKey& other) const
+    {
+        return ((block_index == other.block_index) && (entry_size == other.entry_size) && (file_key == other.file_key));
+    }
+};
+
+inline uint qHash(const MdaBlockKey& key, uint seed = 0)
+{
+    return qHash(key.file_key, seed) ^ qHash(key.block_index, seed) ^ (uint)key.entry_size;
+}
+
+struct MdaBlockCacheShard {
+    struct Entry {
+        QByteArray data;
+        std::list<MdaBlockKey>::iterator lru_position;
+    };
+    QMutex mutex;
+    QHash<MdaBlockKey, Entry> entries;
+    std::list<MdaBlockKey> lru; //most recently used at the front
+    bigint num_bytes = 0;
+};
+
+class MdaBlockCachePrivate {
+public:
+    MdaBlockCache* q;
+    MdaBlockCacheShard m_shards[MDA_BLOCK_CACHE_NUM_SHARDS];
+    QAtomicInteger<qint64> m_max_bytes;
+
+    IIntCounter* hitsCounter = nullptr;
+    IIntCounter* missesCounter = nullptr;
+    IIntCounter* evictionsCounter = nullptr;
+
+    MdaBlockCacheShard& shard_for(const MdaBlockKey& key);
+    bigint max_bytes_per_shard() const;
+    void evict_if_needed(MdaBlockCacheShard& shard, bigint max_bytes);
+};
+
+MdaBlockCache::MdaBlockCache()
+{
+    d = new MdaBlockCachePrivate;
+    d->q = this;
+    d->m_max_bytes = (qint64)MDA_BLOCK_CACHE_DEFAULT_MAX_BYTES;
+    ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
+    if (manager) {
+        d->hitsCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_hits"));
+        d->missesCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_misses"));
+        d->evictionsCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_evictions"));
+    }
+}
+
+MdaBlockCache::~MdaBlockCache()
+{
+    delete d;
+}
+
+QByteArray MdaBlockCache::block(const QString& file_key, int entry_size, bigint block_index)
+{
+    MdaBlockKey key = { file_key, entry_size, block_index };
+    MdaBlockCacheShard& shard = d->shard_for(key);
+    QByteArray ret;
+    {
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->lru_position);
+            ret = it->data;
+        }
+    }
+    //counters are updated outside the shard lock since they emit signals
+    if (ret.isNull()) {
+        if (d->missesCounter)
+            d->missesCounter->add(1);
+    }
+    else {
+        if (d->hitsCounter)
+            d->hitsCounter->add(1);
+    }
+    return ret;
+}
+
+void MdaBlockCache::insertBlock(const QString& file_key, int entry_size, bigint block_index, const QByteArray& data)
+{
+    MdaBlockKey key = { file_key, entry_size, block_index };
+    MdaBlockCacheShard& shard = d->shard_for(key);
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        //another thread loaded the same block concurrently -- keep the newer copy
+        shard.num_bytes -= it->data.size();
+        shard.lru.erase(it->lru_position);
+        shard.entries.erase(it);
+    }
+    shard.lru.push_front(key);
+    MdaBlockCacheShard::Entry entry;
+    entry.data = data;
+    entry.lru_position = shard.lru.begin();
+    shard.entries.insert(key, entry);
+    shard.num_bytes += data.size();
+    d->evict_if_needed(shard, d->max_bytes_per_shard());
+}
+
+void MdaBlockCache::removeFile(const QString& file_key)
+{
+    for (int i = 0; i < MDA_BLOCK_CACHE_NUM_SHARDS; i++) {
+        MdaBlockCacheShard& shard = d->m_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.lru.begin();
+        while (it != shard.lru.end()) {
+            if (it->file_key == file_key) {
+                shard.num_bytes -= shard.entries.value(*it).data.size();
+                shard.entries.remove(*it);
+                it = shard.lru.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+}
+
+void MdaBlockCache::clear()
+{
+    for (int i = 0; i < MDA_BLOCK_CACHE_NUM_SHARDS; i++) {
+        MdaBlockCacheShard& shard = d->m_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        shard.entries.clear();
+        shard.lru.clear();
+        shard.num_bytes = 0;
+    }
+}
+
+void MdaBlockCache::setMaxBytes(bigint num_bytes)
+{
+    d->m_max_bytes = num_bytes;
+    for (int i = 0; i < MDA_BLOCK_CACHE_NUM_SHARDS; i++) {
+        MdaBlockCacheShard& shard = d->m_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        d->evict_if_needed(shard, d->max_bytes_per_shard());
+    }
+}
+
+bigint MdaBlockCache::maxBytes() const
+{
+    return d->m_max_bytes;
+}
+
+bigint MdaBlockCache::numBytes() const
+{
+    bigint ret = 0;
+    for (int i = 0; i < MDA_BLOCK_CACHE_NUM_SHARDS; i++) {
+        MdaBlockCacheShard& shard = d->m_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        ret += shard.num_bytes;
+    }
+    return ret;
+}
+
+bigint MdaBlockCache::blockSize()
+{
+    return MDA_BLOCK_CACHE_BLOCK_SIZE;
+}
+
+Q_GLOBAL_STATIC(MdaBlockCache, theMdaBlockCache)
+MdaBlockCache* MdaBlockCache::globalInstance()
+{
+    return theMdaBlockCache;
+}
+
+MdaBlockCacheShard& MdaBlockCachePrivate::shard_for(const MdaBlockKey& key)
+{
+    //consecutive blocks of one file land in different shards
+    return m_shards[qHash(key) % MDA_BLOCK_CACHE_NUM_SHARDS];
+}
+
+bigint MdaBlockCachePrivate::max_bytes_per_shard() const
+{
+    return m_max_bytes / MDA_BLOCK_CACHE_NUM_SHARDS;
+}
+
+void MdaBlockCachePrivate::evict_if_needed(MdaBlockCacheShard& shard, bigint max_bytes)
+{
+    //always keep the most recently inserted block, even if it alone exceeds the budget
+    int num_evicted = 0;
+    while ((shard.num_bytes > max_bytes) && (shard.lru.size() > 1)) {
+        MdaBlockKey key = shard.lru.back();
+        shard.num_bytes -= shard.entries.value(key).data.size();
+        shard.entries.remove(key);
+        shard.lru.pop_back();
+        num_evicted++;
+    }
+    if ((num_evicted) && (evictionsCounter))
+        evictionsCounter->add(num_evicted);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mdafilemap.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QWeakPointer>
+
+class MdaFileMapPrivate {
+public:
+    MdaFileMap* q;
+    QString m_path;
+    QFile m_file;
+    uchar* m_data = 0;
+    bigint m_size = 0;
+    QDateTime m_last_modified;
+    MDAIO_HEADER m_header;
+
+    bool open(const QString& path);
+    bool is_stale() const;
+
+    static QMutex s_mutex;
+    static QHash<QString, QWeakPointer<MdaFileMap> > s_maps;
+    static bool s_enabled;
+};
+
+QMutex MdaFileMapPrivate::s_mutex;
+QHash<QString, QWeakPointer<MdaFileMap> > MdaFileMapPrivate::s_maps;
+bool MdaFileMapPrivate::s_enabled = true;
+
+MdaFileMap::MdaFileMap()
+{
+    d = new MdaFileMapPrivate;
+    d->q = this;
+}
+
+MdaFileMap::~MdaFileMap()
+{
+    if (d->m_data)
+        d->m_file.unmap(d->m_data);
+    d->m_file.close();
+    delete d;
+}
+
+QSharedPointer<MdaFileMap> MdaFileMap::map(const QString& path)
+{
+    if (!MdaFileMapPrivate::s_enabled)
+        return QSharedPointer<MdaFileMap>();
+    QString key = QFileInfo(path).canonicalFilePath();
+    if (key.isEmpty())
+        return QSharedPointer<MdaFileMap>();
+
+    QMutexLocker locker(&MdaFileMapPrivate::s_mutex);
+    QSharedPointer<MdaFileMap> ret = MdaFileMapPrivate::s_maps.value(key).toStrongRef();
+    if ((ret) && (!ret->d->is_stale()))
+        return ret;
+    ret = QSharedPointer<MdaFileMap>(new MdaFileMap);
+    if (!ret->d->open(key)) {
+        MdaFileMapPrivate::s_maps.remove(key);
+        return QSharedPointer<MdaFileMap>();
+    }
+    MdaFileMapPrivate::s_maps[key] = ret;
+    return ret;
+}
+
+void MdaFileMap::setEnabled(bool val)
+{
+    QMutexLocker locker(&MdaFileMapPrivate::s_mutex);
+    MdaFileMapPrivate::s_enabled = val;
+}
+
+bool MdaFileMap::enabled()
+{
+    QMutexLocker locker(&MdaFileMapPrivate::s_mutex);
+    return MdaFileMapPrivate::s_enabled;
+}
+
+QString MdaFileMap::path() const
+{
+    return d->m_path;
+}
+
+MDAIO_HEADER MdaFileMap::header() const
+{
+    return d->m_header;
+}
+
+const unsigned char* MdaFileMap::constDataPtr() const
+{
+    return d->m_data;
+}
+
+bigint MdaFileMap::size() const
+{
+    return d->m_size;
+}
+
+bool MdaFileMapPrivate::open(const QString& path)
+{
+    m_path = path;
+    FILE* f = fopen(path.toUtf8().data(), "rb");
+    if (!f)
+        return false;
+    bool header_ok = mda_read_header(&m_header, f);
+    fclose(f);
+    if (!header_ok)
+        return false;
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_size = m_file.size();
+    bigint expected_size = m_header.header_size;
+    bigint total_size = 1;
+    for (int i = 0; i < MDAIO_MAX_DIMS; i++)
+        total_size *= m_header.dims[i];
+    expected_size += total_size * m_header.num_bytes_per_entry;
+    if (m_size < expected_size) {
+        qWarning() << "Not memory-mapping truncated mda file" << path << m_size << expected_size;
+        m_file.close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        //e.g. address space exhausted on 32-bit systems -- the caller falls back to stdio
+        m_file.close();
+        return false;
+    }
+    m_last_modified = QFileInfo(path).lastModified();
+    return true;
+}
+
+bool MdaFileMapPrivate::is_stale() const
+{
+    QFileInfo info(m_path);
+    return ((info.size() != m_size) || (info.lastModified() != m_last_modified));
+}
@@ -19,6 +19,7 @@
 #include <QStringList>
 #include <QDir>
 #include <QDateTime>
+#include <QCoreApplication>
 #include <mlnetwork.h>
 #include <mda32.h>
 #include <diskreadmda32.h>
@@ -26,6 +27,10 @@
 #include "mlcommon.h"
 
 #define REMOTE_READ_MDA_CHUNK_SIZE 5e5
+#define REMOTE_READ_MDA_MAX_PARALLEL_DOWNLOADS 6
+#define REMOTE_READ_MDA_READ_AHEAD_CHUNKS 2
+#define REMOTE_READ_MDA_CACHE_NAME "remote_chunks"
+#define REMOTE_READ_MDA_DEFAULT_MAX_CACHE_GB 2
 
 struct RemoteReadMdaInfo {
     RemoteReadMdaInfo()
@@ -33,11 +38,31 @@ struct RemoteReadMdaInfo {
         N1 = N2 = N3 = 0;
     }
 
-    int N1, N2, N3;
+    bigint N1, N2, N3;
     QString checksum;
     QDateTime file_last_modified;
 };
 
+//a chunk being downloaded: the server is first asked to prepare the chunk (it returns a url), then the binary is downloaded
+struct RemoteChunkDownload {
+    enum Stage {
+        NotStarted,
+        RequestingChunk,
+        DownloadingChunk,
+        DownloadingDynamicRange, //float32_q8 only
+        Finished
+    };
+
+    bigint chunk_index = 0;
+    bigint size = 0;
+    bool required = true; //false for chunks that are only read ahead
+    Stage stage = NotStarted;
+    bool success = false;
+    QString binary_url;
+    QString tmp_mda_fname;
+    MLNetwork::Downloader* downloader = 0;
+};
+
 class RemoteReadMdaPrivate {
 public:
     RemoteReadMda* q;
@@ -49,11 +74,16 @@ public:
     QString m_remote_datatype;
     int m_download_chunk_size;
     bool m_download_failed; //don't make excessive calls. Once we failed, that's it.
+    bigint m_last_chunk_index; //for reading ahead in the direction of access
 
     void construct_and_clear();
     void copy_from(const RemoteReadMda& other);
     void download_info_if_needed();
-    QString download_chunk_at_index(int ii);
+    bigint total_size();
+    QString chunk_path(bigint ii);
+    bool download_chunks(bigint jj1, bigint jj2, bool read_ahead = true);
+    void start_downloader(RemoteChunkDownload& D, const QString& url);
+    void advance_download(RemoteChunkDownload& D);
 };
 
 RemoteReadMda::RemoteReadMda(const QString& path)
@@ -66,8 +96,6 @@ RemoteReadMda::RemoteReadMda(const QString& path)
 
 RemoteReadMda::RemoteReadMda(const RemoteReadMda& other)
 {
-    d = new RemoteReadMdaPrivate;
-    d->q = this;
     d = new RemoteReadMdaPrivate;
     d->q = this;
     d->copy_from(other);
@@ -110,7 +138,7 @@ QString RemoteReadMda::makePath() const
     return d->m_path;
 }
 
-bool RemoteReadMda::reshape(int N1b, int N2b, int N3b)
+bool RemoteReadMda::reshape(bigint N1b, bigint N2b, bigint N3b)
 {
     if (this->N1() * this->N2() * this->N3() != N1b * N2b * N3b)
         return false;
@@ -122,19 +150,19 @@ bool RemoteReadMda::reshape(int N1b, int N2b, int N3b)
     return true;
 }
 
-int RemoteReadMda::N1() const
+bigint RemoteReadMda::N1() const
 {
     d->download_info_if_needed();
     return d->m_info.N1;
 }
 
-int RemoteReadMda::N2() const
+bigint RemoteReadMda::N2() const
 {
     d->download_info_if_needed();
     return d->m_info.N2;
 }
 
-int RemoteReadMda::N3() const
+bigint RemoteReadMda::N3() const
 {
     d->download_info_if_needed();
     return d->m_info.N3;
@@ -157,17 +185,12 @@ QString format_num(double num_entries)
     return QString("%1G").arg(num_entries / 1e9, 0, 'f', 2);
 }
 
-bool RemoteReadMda::readChunk(Mda& X, int i, int size) const
+bool RemoteReadMda::readChunk(Mda& X, bigint i, bigint size) const
 {
     if (d->m_download_failed) {
         //don't make excessive calls... once we fail, that's it.
         return false;
     }
-    //double size_mb = size * datatype_size * 1.0 / 1e6;
-    //TaskProgress task(TaskProgress::Download, "Downloading array chunk");
-    //if (size_mb > 0.5) {
-    //    task.setLabel(QString("Downloading array chunk: %1 MB").arg(size_mb));
-    //}
     //read a chunk of the remote array considered as a 1D array
 
     TaskProgress task(TaskProgress::Download, QString("Downloading %1 numbers - %2 (%3x%4x%5)").arg(format_num(size)).arg(d->m_remote_datatype).arg(N1()).arg(N2()).arg(N3()));
@@ -175,109 +198,38 @@ bool RemoteReadMda::readChunk(Mda& X, int i, int size) const
 
     X.allocate(size, 1); //allocate the output array
     double* Xptr = X.dataPtr(); //pointer to the output data
-    int ii1 = i; //start index of the remote array
-    int ii2 = i + size - 1; //end index of the remote array
-    int jj1 = ii1 / d->m_download_chunk_size; //start chunk index of the remote array
-    int jj2 = ii2 / d->m_download_chunk_size; //end chunk index of the remote array
-    if (jj1 == jj2) { //in this case there is only one chunk we need to worry about
-        task.setProgress(0.2);
-        QString fname = d->download_chunk_at_index(jj1); //download the single chunk
-        if (fname.isEmpty()) {
-            //task.error("fname is empty");
-            if (!MLUtil::threadInterruptRequested()) {
-                TaskProgress errtask("Download chunk at index");
-                errtask.log() << QString("m_remote_data_type = %1, download chunk size = %2").arg(d->m_remote_datatype).arg(d->m_download_chunk_size);
-                errtask.log() << d->m_path;
-                errtask.error() << QString("Failed to download chunk at index %1 *").arg(jj1);
-                d->m_download_failed = true;
-            }
-            return false;
-        }
-        DiskReadMda A(fname);
-        A.readChunk(X, ii1 - jj1 * d->m_download_chunk_size, size); //starting reading at the offset of ii1 relative to the start index of the chunk
-        return true;
-    }
-    else {
-        for (int jj = jj1; jj <= jj2; jj++) { //otherwise we need to step through the chunks
-            task.setProgress((jj - jj1 + 0.5) / (jj2 - jj1 + 1));
-            if (MLUtil::threadInterruptRequested()) {
-                //X = Mda(); //maybe it's better to return the right size.
-                //task.error("Halted");
-                return false;
-            }
-            QString fname = d->download_chunk_at_index(jj); //download the chunk at index jj
-            if (fname.isEmpty()) {
-                //task.error("fname is empty *");
+    bigint chunk_size = d->m_download_chunk_size;
+    bigint ii1 = i; //start index of the remote array
+    bigint ii2 = i + size - 1; //end index of the remote array
+    bigint jj1 = ii1 / chunk_size; //start chunk index of the remote array
+    bigint jj2 = ii2 / chunk_size; //end chunk index of the remote array
+    task.setProgress(0.2);
+    if (!d->download_chunks(jj1, jj2)) //all at once, in parallel
+        return false;
+    for (bigint jj = jj1; jj <= jj2; jj++) {
+        //the part of [ii1,ii2] that lies in this chunk
+        bigint a1 = qMax(ii1, jj * chunk_size);
+        bigint a2 = qMin(ii2, (jj + 1) * chunk_size - 1);
+        Mda tmp;
+        if (!DiskReadMda(d->chunk_path(jj)).readChunk(tmp, a1 - jj * chunk_size, a2 - a1 + 1)) {
+            //another reader may have evicted it from the cache in the meantime, so download it once more
+            QFile::remove(d->chunk_path(jj));
+            if ((!d->download_chunks(jj, jj, false)) || (!DiskReadMda(d->chunk_path(jj)).readChunk(tmp, a1 - jj * chunk_size, a2 - a1 + 1))) {
+                task.error() << "Unable to read downloaded chunk:" << d->chunk_path(jj);
                 return false;
             }
-            DiskReadMda A(fname);
-            if (jj == jj1) { //case 1/3, this is the first chunk
-                Mda tmp;
-                int size0 = (jj1 + 1) * d->m_download_chunk_size - ii1; //the size is going to be the difference between ii1 and the start index of the next chunk
-                A.readChunk(tmp, ii1 - jj1 * d->m_download_chunk_size, size0); //again we start reading at the offset of ii1 relative to the start index of the chunk
-                double* tmp_ptr = tmp.dataPtr(); //copy the data directly from tmp_ptr to Xptr
-                const int b = 0;
-                std::copy(tmp_ptr, tmp_ptr + size0, Xptr + b);
-                //                for (int a = 0; a < size0; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
-            else if (jj == jj2) { //case 2/3, this is the last chunk
-                Mda tmp;
-                int size0 = ii2 + 1 - jj2 * d->m_download_chunk_size; //the size is going to be the difference between the start index of the last chunk and ii2+1
-                A.readChunk(tmp, 0, size0); //we start reading at position zero
-                double* tmp_ptr = tmp.dataPtr();
-                //copy the data to the last part of X
-                const int b = size - size0;
-                std::copy(tmp_ptr, tmp_ptr + size0, Xptr + b);
-                //                for (int a = 0; a < size0; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
-
-            /*
-             ///this was the old code, which was wrong!!!!!!!!! -- fixed on 5/16/2016
-            else if (jj == jj2) {
-                Mda tmp;
-                int size0 = ii2 + 1 - jj2 * d->m_download_chunk_size;
-                A.readChunk(tmp, d->m_download_chunk_size - size0, size0);
-                double* tmp_ptr = tmp.dataPtr();
-                int b = jj2 * d->m_download_chunk_size - ii1;
-                for (int a = 0; a < size0; a++) {
-                    Xptr[b] = tmp_ptr[a];
-                    b++;
-                }
-            }
-            */
-            else { //case 3/3, this is a middle chunk
-                Mda tmp;
-                A.readChunk(tmp, 0, d->m_download_chunk_size); //read the entire chunk, because we'll use it all
-                double* tmp_ptr = tmp.dataPtr();
-                int b = jj * d->m_download_chunk_size - ii1; //we start writing at the offset between the start index of the chunk and the start index
-                std::copy(tmp_ptr, tmp_ptr + d->m_download_chunk_size, Xptr + b);
-                //                for (int a = 0; a < d->m_download_chunk_size; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
         }
-        return true;
+        std::copy(tmp.dataPtr(), tmp.dataPtr() + (a2 - a1 + 1), Xptr + (a1 - ii1));
     }
+    return true;
 }
 
-bool RemoteReadMda::readChunk32(Mda32& X, int i, int size) const
+bool RemoteReadMda::readChunk32(Mda32& X, bigint i, bigint size) const
 {
     if (d->m_download_failed) {
         //don't make excessive calls... once we fail, that's it.
         return false;
     }
-    //double size_mb = size * datatype_size * 1.0 / 1e6;
-    //TaskProgress task(TaskProgress::Download, "Downloading array chunk");
-    //if (size_mb > 0.5) {
-    //    task.setLabel(QString("Downloading array chunk: %1 MB").arg(size_mb));
-    //}
     //read a chunk of the remote array considered as a 1D array
 
     TaskProgress task(TaskProgress::Download, QString("Downloading %1 numbers -- %2 (%3x%4x%5)").arg(format_num(size)).arg(d->m_remote_datatype).arg(N1()).arg(N2()).arg(N3()));
@@ -285,96 +237,30 @@ bool RemoteReadMda::readChunk32(Mda32& X, int i, int size) const
 
     X.allocate(size, 1); //allocate the output array
     dtype32* Xptr = X.dataPtr(); //pointer to the output data
-    int ii1 = i; //start index of the remote array
-    int ii2 = i + size - 1; //end index of the remote array
-    int jj1 = ii1 / d->m_download_chunk_size; //start chunk index of the remote array
-    int jj2 = ii2 / d->m_download_chunk_size; //end chunk index of the remote array
-    if (jj1 == jj2) { //in this case there is only one chunk we need to worry about
-        task.setProgress(0.2);
-        QString fname = d->download_chunk_at_index(jj1); //download the single chunk
-        if (fname.isEmpty()) {
-            //task.error("fname is empty");
-            if (!MLUtil::threadInterruptRequested()) {
-                TaskProgress errtask("Download chunk at index");
-                errtask.log(QString("m_remote_data_type = %1, download chunk size = %2").arg(d->m_remote_datatype).arg(d->m_download_chunk_size));
-                errtask.log(d->m_path);
-                errtask.error(QString("Failed to download chunk at index %1 -").arg(jj1));
-                d->m_download_failed = true;
-            }
-            return false;
-        }
-        DiskReadMda32 A(fname);
-        A.readChunk(X, ii1 - jj1 * d->m_download_chunk_size, size); //starting reading at the offset of ii1 relative to the start index of the chunk
-        return true;
-    }
-    else {
-        for (int jj = jj1; jj <= jj2; jj++) { //otherwise we need to step through the chunks
-            task.setProgress((jj - jj1 + 0.5) / (jj2 - jj1 + 1));
-            if (MLUtil::threadInterruptRequested()) {
-                //X = Mda32(); //maybe it's better to return the right size.
-                //task.error("Halted");
-                return false;
-            }
-            QString fname = d->download_chunk_at_index(jj); //download the chunk at index jj
-            if (fname.isEmpty()) {
-                //task.error("fname is empty *");
+    bigint chunk_size = d->m_download_chunk_size;
+    bigint ii1 = i; //start index of the remote array
+    bigint ii2 = i + size - 1; //end index of the remote array
+    bigint jj1 = ii1 / chunk_size; //start chunk index of the remote array
+    bigint jj2 = ii2 / chunk_size; //end chunk index of the remote array
+    task.setProgress(0.2);
+    if (!d->download_chunks(jj1, jj2)) //all at once, in parallel
+        return false;
+    for (bigint jj = jj1; jj <= jj2; jj++) {
+        //the part of [ii1,ii2] that lies in this chunk
+        bigint a1 = qMax(ii1, jj * chunk_size);
+        bigint a2 = qMin(ii2, (jj + 1) * chunk_size - 1);
+        Mda32 tmp;
+        if (!DiskReadMda32(d->chunk_path(jj)).readChunk(tmp, a1 - jj * chunk_size, a2 - a1 + 1)) {
+            //another reader may have evicted it from the cache in the meantime, so download it once more
+            QFile::remove(d->chunk_path(jj));
+            if ((!d->download_chunks(jj, jj, false)) || (!DiskReadMda32(d->chunk_path(jj)).readChunk(tmp, a1 - jj * chunk_size, a2 - a1 + 1))) {
+                task.error(QString("Unable to read downloaded chunk: %1").arg(d->chunk_path(jj)));
                 return false;
             }
-            DiskReadMda32 A(fname);
-            if (jj == jj1) { //case 1/3, this is the first chunk
-                Mda32 tmp;
-                int size0 = (jj1 + 1) * d->m_download_chunk_size - ii1; //the size is going to be the difference between ii1 and the start index of the next chunk
-                A.readChunk(tmp, ii1 - jj1 * d->m_download_chunk_size, size0); //again we start reading at the offset of ii1 relative to the start index of the chunk
-                dtype32* tmp_ptr = tmp.dataPtr(); //copy the data directly from tmp_ptr to Xptr
-                std::copy(tmp_ptr, tmp_ptr + size0, Xptr);
-                //                int b = 0;
-                //                for (int a = 0; a < size0; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
-            else if (jj == jj2) { //case 2/3, this is the last chunk
-                Mda32 tmp;
-                int size0 = ii2 + 1 - jj2 * d->m_download_chunk_size; //the size is going to be the difference between the start index of the last chunk and ii2+1
-                A.readChunk(tmp, 0, size0); //we start reading at position zero
-                dtype32* tmp_ptr = tmp.dataPtr();
-                //copy the data to the last part of X
-                int b = size - size0;
-                std::copy(tmp_ptr, tmp_ptr + size0, Xptr + b);
-                //                for (int a = 0; a < size0; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
-
-            /*
-             ///this was the old code, which was wrong!!!!!!!!! -- fixed on 5/16/2016
-            else if (jj == jj2) {
-                Mda32 tmp;
-                int size0 = ii2 + 1 - jj2 * d->m_download_chunk_size;
-                A.readChunk(tmp, d->m_download_chunk_size - size0, size0);
-                dtype32* tmp_ptr = tmp.dataPtr();
-                int b = jj2 * d->m_download_chunk_size - ii1;
-                for (int a = 0; a < size0; a++) {
-                    Xptr[b] = tmp_ptr[a];
-                    b++;
-                }
-            }
-            */
-            else { //case 3/3, this is a middle chunk
-                Mda32 tmp;
-                A.readChunk(tmp, 0, d->m_download_chunk_size); //read the entire chunk, because we'll use it all
-                dtype32* tmp_ptr = tmp.dataPtr();
-                //const int b = jj * d->m_download_chunk_size - ii1; //we start writing at the offset between the start index of the chunk and the start index
-                std::copy(tmp_ptr, tmp_ptr + d->m_download_chunk_size, Xptr);
-                //                for (int a = 0; a < d->m_download_chunk_size; a++) {
-                //                    Xptr[b] = tmp_ptr[a];
-                //                    b++;
-                //                }
-            }
         }
-        return true;
+        std::copy(tmp.dataPtr(), tmp.dataPtr() + (a2 - a1 + 1), Xptr + (a1 - ii1));
     }
+    return true;
 }
 
 void RemoteReadMdaPrivate::construct_and_clear()
@@ -387,6 +273,7 @@ void RemoteReadMdaPrivate::construct_and_clear()
     /// TODO (LOW) use enum instead of string "float64", "float32", etc
     this->m_remote_datatype = "float64";
     this->m_reshaped = false;
+    this->m_last_chunk_index = -1;
 }
 
 void RemoteReadMdaPrivate::copy_from(const RemoteReadMda& other)
@@ -398,6 +285,7 @@ void RemoteReadMdaPrivate::copy_from(const RemoteReadMda& other)
     this->m_path = other.d->m_path;
     this->m_remote_datatype = other.d->m_remote_datatype;
     this->m_reshaped = other.d->m_reshaped;
+    this->m_last_chunk_index = other.d->m_last_chunk_index;
 }
 
 void RemoteReadMdaPrivate::download_info_if_needed()
@@ -415,91 +303,257 @@ void RemoteReadMdaPrivate::download_info_if_needed()
     QString txt = MLNetwork::httpGetTextSync(url2);
     QStringList lines = txt.split("\n");
     QStringList sizes = lines.value(0).split(",");
-    m_info.N1 = sizes.value(0).toLong();
-    m_info.N2 = sizes.value(1).toLong();
-    m_info.N3 = sizes.value(2).toLong();
+    m_info.N1 = sizes.value(0).toLongLong();
+    m_info.N2 = sizes.value(1).toLongLong();
+    m_info.N3 = sizes.value(2).toLongLong();
     m_info.checksum = lines.value(1);
-    m_info.file_last_modified = QDateTime::fromMSecsSinceEpoch(lines.value(2).toLong());
+    m_info.file_last_modified = QDateTime::fromMSecsSinceEpoch(lines.value(2).toLongLong());
 }
 
-void unquantize8(Mda& X, double minval, double maxval);
-QString RemoteReadMdaPrivate::download_chunk_at_index(int ii)
+bigint RemoteReadMdaPrivate::total_size()
 {
-    TaskProgress task(QString("Download chunk at index %1 ---").arg(ii));
     download_info_if_needed();
-    int Ntot = m_info.N1 * m_info.N2 * m_info.N3;
-    int size = m_download_chunk_size;
-    if (ii * m_download_chunk_size + size > Ntot) {
-        size = Ntot - ii * m_download_chunk_size;
-    }
-    if (size <= 0) {
-        task.log() << m_info.N1 << m_info.N2 << m_info.N3 << Ntot << m_download_chunk_size << ii;
-        task.error() << "Size is:" << size;
-        return "";
-    }
+    return m_info.N1 * m_info.N2 * m_info.N3;
+}
+
+QString RemoteReadMdaPrivate::chunk_path(bigint ii)
+{
+    //content addressed: the same array (by checksum) read with the same datatype and chunk size gives the same file, across sessions
+    QString file_name = QString("%1-%2-%3-%4.mda").arg(m_info.checksum).arg(m_remote_datatype).arg(m_download_chunk_size).arg(ii);
+    return CacheManager::globalInstance()->makeCacheFile(REMOTE_READ_MDA_CACHE_NAME, file_name);
+}
+
+bool RemoteReadMdaPrivate::download_chunks(bigint jj1, bigint jj2, bool read_ahead)
+{
+    TaskProgress task(QString("Download chunks %1-%2").arg(jj1).arg(jj2));
+    download_info_if_needed();
     if (m_info.checksum.isEmpty()) {
         task.error() << "Info checksum is empty";
-        return "";
+        return false;
     }
-    QString file_name = m_info.checksum + "-" + QString("%1-%2").arg(m_download_chunk_size).arg(ii);
-    QString fname = CacheManager::globalInstance()->makeLocalFile(file_name, CacheManager::ShortTerm);
-    if (QFile::exists(fname))
-        return fname;
-    QString url = m_path;
-    QString url0 = url + QString("?a=readChunk&output=text&index=%1&size=%2&datatype=%3").arg((int)(ii * m_download_chunk_size)).arg(size).arg(m_remote_datatype);
-    QString binary_url = MLNetwork::httpGetTextSync(url0).trimmed();
-    if (binary_url.isEmpty())
-        return "";
-
-    //the following is ugly
-    int ind = m_path.indexOf("/mdaserver");
-    if (ind > 0) {
-        binary_url = m_path.mid(0, ind) + "/mdaserver/" + binary_url;
+    bigint Ntot = total_size();
+    bigint num_chunks = (Ntot + m_download_chunk_size - 1) / m_download_chunk_size;
+    if ((jj1 < 0) || (jj2 >= num_chunks) || (jj1 > jj2)) {
+        task.log() << m_info.N1 << m_info.N2 << m_info.N3 << Ntot << m_download_chunk_size << jj1 << jj2;
+        task.error() << "Chunk index out of range";
+        return false;
+    }
+
+    QList<RemoteChunkDownload> downloads;
+    QStringList required_paths;
+    for (bigint jj = jj1; jj <= jj2; jj++) {
+        required_paths << chunk_path(jj);
+        if (QFile::exists(chunk_path(jj)))
+            continue;
+        RemoteChunkDownload D;
+        D.chunk_index = jj;
+        D.size = qMin((bigint)m_download_chunk_size, Ntot - jj * m_download_chunk_size);
+        downloads << D;
+    }
+
+    //when the access is moving through the array, also fetch the next chunks in that direction. Only when we are
+    //downloading anyway, and only in the slots the required chunks leave free, so that they all start in the same
+    //round and the caller never waits for a read-ahead chunk to get a slot
+    if (read_ahead) {
+        bigint direction = 0;
+        if ((m_last_chunk_index >= 0) && (jj1 > m_last_chunk_index))
+            direction = 1;
+        else if ((m_last_chunk_index >= 0) && (jj2 < m_last_chunk_index))
+            direction = -1;
+        m_last_chunk_index = (jj1 + jj2) / 2;
+        int num_required = downloads.count();
+        for (bigint aa = 1; (num_required) && (direction) && (aa <= REMOTE_READ_MDA_READ_AHEAD_CHUNKS) && (downloads.count() < REMOTE_READ_MDA_MAX_PARALLEL_DOWNLOADS); aa++) {
+            bigint jj = (direction > 0) ? jj2 + aa : jj1 - aa;
+            if ((jj < 0) || (jj >= num_chunks))
+                break;
+            if (QFile::exists(chunk_path(jj)))
+                continue;
+            RemoteChunkDownload D;
+            D.chunk_index = jj;
+            D.size = qMin((bigint)m_download_chunk_size, Ntot - jj * m_download_chunk_size);
+            D.required = false;
+            downloads << D;
+        }
+    }
+    if (downloads.isEmpty())
+        return true;
+    task.log() << QString("Downloading %1 chunks").arg(downloads.count());
+
+    //make room before downloading. This walks the cache directory, so it is only done when something is missing, and
+    //the chunks of this request that are already cached are kept
+    double max_cache_gb = MLUtil::configValue("general", "max_remote_chunk_cache_gb").toDouble();
+    if (!max_cache_gb)
+        max_cache_gb = REMOTE_READ_MDA_DEFAULT_MAX_CACHE_GB;
+    CacheManager::globalInstance()->limitCacheSize(REMOTE_READ_MDA_CACHE_NAME, max_cache_gb, required_paths);
+
+    //at most REMOTE_READ_MDA_MAX_PARALLEL_DOWNLOADS requests in flight. The downloaders are asynchronous and all
+    //belong to this thread, so we drive them by processing events, as MLNetwork::Runner::waitForFinished does
+    bool ok = true;
+    bool interrupted = false;
+    while (true) {
+        int num_active = 0;
+        bool all_finished = true;
+        for (int i = 0; i < downloads.count(); i++) {
+            if (downloads[i].stage != RemoteChunkDownload::Finished)
+                all_finished = false;
+            if ((downloads[i].stage != RemoteChunkDownload::NotStarted) && (downloads[i].stage != RemoteChunkDownload::Finished))
+                num_active++;
+        }
+        if (all_finished)
+            break;
+        if ((ok) && (MLUtil::threadInterruptRequested())) {
+            interrupted = true;
+            ok = false;
+        }
+        if ((!ok) && (!num_active))
+            break;
+        for (int i = 0; (i < downloads.count()) && (ok) && (num_active < REMOTE_READ_MDA_MAX_PARALLEL_DOWNLOADS); i++) {
+            RemoteChunkDownload& D = downloads[i];
+            if (D.stage == RemoteChunkDownload::NotStarted) {
+                D.stage = RemoteChunkDownload::RequestingChunk;
+                QString url = m_path + QString("?a=readChunk&output=text&index=%1&size=%2&datatype=%3").arg(D.chunk_index * m_download_chunk_size).arg(D.size).arg(m_remote_datatype);
+                start_downloader(D, url);
+                num_active++;
+            }
+        }
+        QCoreApplication::processEvents();
+        for (int i = 0; i < downloads.count(); i++) {
+            RemoteChunkDownload& D = downloads[i];
+            if ((D.downloader) && (D.downloader->isFinished())) {
+                if (ok)
+                    advance_download(D);
+                else {
+                    //stopping: let what is in flight finish, but start nothing new
+                    QFile::remove(D.downloader->destination_file_name);
+                    delete D.downloader;
+                    D.downloader = 0;
+                    D.stage = RemoteChunkDownload::Finished;
+                }
+                if ((D.stage == RemoteChunkDownload::Finished) && (!D.success) && (D.required)) {
+                    task.error() << QString("Failed to download chunk at index %1").arg(D.chunk_index);
+                    ok = false;
+                }
+            }
+        }
+        if (!ok) {
+            //nothing that was not started will be
+            for (int i = 0; i < downloads.count(); i++) {
+                if (downloads[i].stage == RemoteChunkDownload::NotStarted)
+                    downloads[i].stage = RemoteChunkDownload::Finished;
+            }
+        }
+    }
+    for (int i = 0; i < downloads.count(); i++) {
+        if (!downloads[i].tmp_mda_fname.isEmpty())
+            QFile::remove(downloads[i].tmp_mda_fname);
     }
 
-    task.log() << "binary_url:" << binary_url;
-    QString tmp_mda_fname = MLNetwork::httpGetBinaryFileSync(binary_url);
-    if (tmp_mda_fname.isEmpty())
-        return "";
-    DiskReadMda tmp(tmp_mda_fname);
-    if (tmp.totalSize() != size) {
-        task.error() << "Unexpected total size problem: " << tmp.totalSize() << size;
-        qWarning() << "Unexpected total size problem: " << tmp.totalSize() << size;
-        QFile::remove(tmp_mda_fname);
-        return "";
+    if ((!ok) && (!interrupted) && (!MLUtil::threadInterruptRequested())) {
+        TaskProgress errtask("Download chunk at index");
+        errtask.log() << QString("m_remote_data_type = %1, download chunk size = %2").arg(m_remote_datatype).arg(m_download_chunk_size);
+        errtask.log() << m_path;
+        errtask.error() << QString("Failed to download chunks %1-%2").arg(jj1).arg(jj2);
+        m_download_failed = true;
     }
-    if (m_remote_datatype == "float32_q8") {
-        QString dynamic_range_fname = MLNetwork::httpGetBinaryFileSync(binary_url + ".q8");
-        if (dynamic_range_fname.isEmpty()) {
-            qWarning() << "problem downloading .q8 file: " + binary_url + ".q8";
-            task.error() << "problem downloading .q8 file: " + binary_url + ".q8";
-            return "";
+    return ok;
+}
+
+void RemoteReadMdaPrivate::start_downloader(RemoteChunkDownload& D, const QString& url)
+{
+    D.downloader = new MLNetwork::Downloader;
+    D.downloader->source_url = url;
+    D.downloader->destination_file_name = CacheManager::globalInstance()->makeLocalFile() + ".RemoteReadMda";
+    D.downloader->start();
+}
+
+void unquantize8(Mda& X, double minval, double maxval);
+void RemoteReadMdaPrivate::advance_download(RemoteChunkDownload& D)
+{
+    MLNetwork::Downloader* downloader = D.downloader;
+    D.downloader = 0;
+    bool success = downloader->success;
+    QString downloaded_fname = downloader->destination_file_name;
+    QString url = downloader->source_url;
+    delete downloader;
+    if (!success) {
+        QFile::remove(downloaded_fname);
+        qWarning() << "Problem downloading" << url;
+        D.stage = RemoteChunkDownload::Finished;
+        return;
+    }
+
+    QString fname = chunk_path(D.chunk_index);
+    //write under a temporary name and rename, so that an interrupted write never leaves a partial chunk in the cache
+    QString fname_tmp = fname + ".tmp." + MLUtil::makeRandomId(5);
+    if (D.stage == RemoteChunkDownload::RequestingChunk) {
+        QString binary_url = TextFile::read(downloaded_fname).trimmed();
+        QFile::remove(downloaded_fname);
+        if (binary_url.isEmpty()) {
+            D.stage = RemoteChunkDownload::Finished;
+            return;
+        }
+        //the following is ugly
+        int ind = m_path.indexOf("/mdaserver");
+        if (ind > 0) {
+            binary_url = m_path.mid(0, ind) + "/mdaserver/" + binary_url;
+        }
+        D.binary_url = binary_url;
+        D.stage = RemoteChunkDownload::DownloadingChunk;
+        start_downloader(D, binary_url);
+    }
+    else if (D.stage == RemoteChunkDownload::DownloadingChunk) {
+        D.tmp_mda_fname = downloaded_fname;
+        DiskReadMda tmp(D.tmp_mda_fname);
+        if (tmp.totalSize() != D.size) {
+            qWarning() << "Unexpected total size problem: " << tmp.totalSize() << D.size;
+            D.stage = RemoteChunkDownload::Finished;
+            return;
         }
-        Mda dynamic_range(dynamic_range_fname);
+        if (m_remote_datatype == "float32_q8") {
+            D.stage = RemoteChunkDownload::DownloadingDynamicRange;
+            start_downloader(D, D.binary_url + ".q8");
+            return;
+        }
+        if (!QFile::rename(D.tmp_mda_fname, fname_tmp)) {
+            qWarning() << "Unable to rename file: " << D.tmp_mda_fname << fname_tmp;
+            D.stage = RemoteChunkDownload::Finished;
+            return;
+        }
+        D.tmp_mda_fname = "";
+        //another reader may have stored the same chunk in the meantime, which is fine since the content is the same
+        if ((!QFile::rename(fname_tmp, fname)) && (!QFile::exists(fname))) {
+            QFile::remove(fname_tmp);
+            qWarning() << "Unable to rename file: " << fname_tmp << fname;
+            D.stage = RemoteChunkDownload::Finished;
+            return;
+        }
+        QFile::remove(fname_tmp);
+        D.success = true;
+        D.stage = RemoteChunkDownload::Finished;
+    }
+    else if (D.stage == RemoteChunkDownload::DownloadingDynamicRange) {
+        D.stage = RemoteChunkDownload::Finished;
+        Mda dynamic_range(downloaded_fname);
+        QFile::remove(downloaded_fname);
         if (dynamic_range.totalSize() != 2) {
-            qWarning() << QString("Problem in .q8 file. Unexpected size %1: ").arg(dynamic_range.totalSize()) + binary_url + ".q8";
-            task.error() << QString("Problem in .q8 file. Unexpected size %1: ").arg(dynamic_range.totalSize()) + binary_url + ".q8";
-            return "";
+            qWarning() << QString("Problem in .q8 file. Unexpected size %1: ").arg(dynamic_range.totalSize()) + D.binary_url + ".q8";
+            return;
         }
-        Mda chunk(tmp_mda_fname);
+        Mda chunk(D.tmp_mda_fname);
         unquantize8(chunk, dynamic_range.value(0), dynamic_range.value(1));
-        if (!chunk.write32(fname)) {
-            QFile::remove(tmp_mda_fname);
-            qWarning() << "Unable to write file: " + fname;
-            task.error() << "Unable to write file: " + fname;
-            return "";
+        if (!chunk.write32(fname_tmp)) {
+            QFile::remove(fname_tmp);
+            qWarning() << "Unable to write file: " + fname_tmp;
+            return;
         }
-        QFile::remove(tmp_mda_fname);
-    }
-    else {
-        if (!QFile::rename(tmp_mda_fname, fname)) {
-            QFile::remove(tmp_mda_fname);
-            qWarning() << "Unable to rename file: " << tmp_mda_fname << fname;
-            task.error() << "Unable to rename file: " << tmp_mda_fname << fname;
-            return "";
+        if ((!QFile::rename(fname_tmp, fname)) && (!QFile::exists(fname))) {
+            QFile::remove(fname_tmp);
+            qWarning() << "Unable to rename file: " << fname_tmp << fname;
+            return;
         }
+        QFile::remove(fname_tmp);
+        D.success = true;
     }
-    return fname;
 }
 
 void unit_test_remote_read_mda()
@@ -531,9 +585,9 @@ void unit_test_remote_read_mda_2(const QString& path)
 
 void unquantize8(Mda& X, double minval, double maxval)
 {
-    int N = X.totalSize();
+    bigint N = X.totalSize();
     double* Xptr = X.dataPtr();
-    for (int i = 0; i < N; i++) {
+    for (bigint i = 0; i < N; i++) {
         Xptr[i] = minval + (Xptr[i] / 255) * (maxval - minval);
     }
 }
@@ -264,13 +264,14 @@ void MLUtil::mkdirIfNeeded(const QString& path)
 QString MLUtil::computeSha1SumOfFile(const QString& path)
 {
     //printf("Looking up sha1: %s\n",path.toUtf8().data());
+    //a side-car .sha1 file is used when there is one, but the checksum index (sumit) does not need one, and works on read-only storage
     if (QFile::exists(path + ".sha1")) {
         QString txt = TextFile::read(path + ".sha1").trimmed();
         if (txt.count() == 40) {
             return txt;
         }
     }
-    return sumit(path, 0, MLUtil::tempPath());
+    return sumit(path, 0, CacheManager::globalInstance()->localTempPath());
     /*
     QFile file(path);
     if (!file.open(QIODevice::ReadOnly))
@@ -284,12 +285,12 @@ QString MLUtil::computeSha1SumOfFile(const QString& path)
 }
 QString MLUtil::computeSha1SumOfFileHead(const QString& path, bigint num_bytes)
 {
-    return sumit(path, num_bytes, MLUtil::tempPath());
+    return sumit(path, num_bytes, CacheManager::globalInstance()->localTempPath());
 }
 
 QString MLUtil::computeSha1SumOfDirectory(const QString& path)
 {
-    return sumit_dir(path, MLUtil::tempPath());
+    return sumit_dir(path, CacheManager::globalInstance()->localTempPath());
 }
 
 static QString s_temp_path = "";
@@ -53,8 +53,8 @@ SOURCES += \
 INCLUDEPATH += ../include/mda
 VPATH += ../include/mda
 VPATH += mda
-HEADERS += diskreadmda.h diskwritemda.h mda.h mdaio.h remotereadmda.h usagetracking.h
-SOURCES += diskreadmda.cpp diskwritemda.cpp mda.cpp mdaio.cpp remotereadmda.cpp usagetracking.cpp
+HEADERS += diskreadmda.h diskwritemda.h mda.h mdaio.h mdablockcache.h mdafilemap.h remotereadmda.h usagetracking.h
+SOURCES += diskreadmda.cpp diskwritemda.cpp mda.cpp mdaio.cpp mdablockcache.cpp mdafilemap.cpp remotereadmda.cpp usagetracking.cpp
 
 INCLUDEPATH += ../include/cachemanager
 VPATH += ../include/cachemanager
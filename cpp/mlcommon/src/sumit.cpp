@@ -24,11 +24,121 @@
 #include <QStringList>
 #include <QTime>
 #include <QDataStream>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QLockFile>
+#include <QCoreApplication>
+#include <QSharedPointer>
+#include <QMap>
 #include <sys/stat.h>
+#include "taskprogress.h"
+
+#define SUMIT_BLOCK_SIZE (4 * 1024 * 1024)
+#define SUMIT_NUM_BUFFERED_BLOCKS 4
+#define SUMIT_PROGRESS_MIN_FILE_SIZE (100 * 1024 * 1024)
+
+//reads the file ahead of the hashing, so that the disk and the sha1 computation are busy at the same time
+class SumitBlockReader : public QThread {
+public:
+    QString path;
+    bool ok = true;
+
+    bool nextBlock(QByteArray& block); //false at the end of the file
+    void requestStop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_block_available;
+    QWaitCondition m_space_available;
+    QList<QByteArray> m_blocks;
+    bool m_finished = false;
+    bool m_stop_requested = false;
+};
+
+void SumitBlockReader::run()
+{
+    QFile FF(path);
+    if (!FF.open(QFile::ReadOnly)) {
+        QMutexLocker locker(&m_mutex);
+        ok = false;
+        m_finished = true;
+        m_block_available.wakeAll();
+        return;
+    }
+    while (!FF.atEnd()) {
+        QByteArray block = FF.read(SUMIT_BLOCK_SIZE);
+        if (block.isEmpty())
+            break;
+        QMutexLocker locker(&m_mutex);
+        while ((m_blocks.count() >= SUMIT_NUM_BUFFERED_BLOCKS) && (!m_stop_requested))
+            m_space_available.wait(&m_mutex);
+        if (m_stop_requested)
+            break;
+        m_blocks << block;
+        m_block_available.wakeAll();
+    }
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_block_available.wakeAll();
+}
+
+bool SumitBlockReader::nextBlock(QByteArray& block)
+{
+    QMutexLocker locker(&m_mutex);
+    while ((m_blocks.isEmpty()) && (!m_finished))
+        m_block_available.wait(&m_mutex);
+    if (m_blocks.isEmpty())
+        return false;
+    block = m_blocks.takeFirst();
+    m_space_available.wakeAll();
+    return true;
+}
+
+void SumitBlockReader::requestStop()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stop_requested = true;
+    m_space_available.wakeAll();
+}
+
+QString compute_the_whole_file_hash(const QString& path)
+{
+    // Do not printf here!
+    qint64 total_size = QFileInfo(path).size();
+    QSharedPointer<TaskProgress> task;
+    if (total_size >= SUMIT_PROGRESS_MIN_FILE_SIZE)
+        task.reset(new TaskProgress(TaskProgress::Calculate, "Computing checksum: " + path));
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    SumitBlockReader reader;
+    reader.path = path;
+    reader.start();
+    QByteArray block;
+    qint64 num_bytes_processed = 0;
+    while (reader.nextBlock(block)) {
+        hash.addData(block);
+        num_bytes_processed += block.count();
+        if ((task) && (total_size))
+            task->setProgress(num_bytes_processed * 1.0 / total_size);
+    }
+    reader.requestStop();
+    reader.wait();
+    if (!reader.ok)
+        return "";
+
+    QString ret = QString(hash.result().toHex());
+    return ret;
+}
 
 QString compute_the_file_hash(const QString& path, int num_bytes)
 {
     // Do not printf here!
+    if (num_bytes == 0)
+        return compute_the_whole_file_hash(path);
     QCryptographicHash hash(QCryptographicHash::Sha1);
     QFile FF(path);
     if (!FF.open(QFile::ReadOnly))
@@ -87,42 +197,66 @@ inline void write_text_file(const QString& path, const QString& txt)
     out << txt;
 }
 
-void create_hash_file(const QString& path, const QString& hash_path)
+QString sumit_file_id(const QString& path)
 {
-    QString the_hash = compute_the_file_hash(path, 0);
-    write_text_file(hash_path, the_hash);
+    //the file id is a hashed function of device, inode, size, and modification time (in milliseconds)
+    //note that it is not dependent on the file name
+    struct stat SS;
+    if (stat(QFile::encodeName(path).data(), &SS) != 0)
+        return "";
+    QFileInfo info(path);
+    QString id_string = QString("%1:%2:%3:%4").arg((qulonglong)SS.st_dev).arg((qulonglong)SS.st_ino).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+    return compute_the_string_hash(id_string);
 }
 
+//the checksums already looked up by this process, by file id
+static QMutex s_checksums_mutex;
+static QMap<QString, QString> s_checksums;
+
 QString sumit(const QString& path, int num_bytes, const QString& temporary_path)
 {
     if (num_bytes != 0) {
         return compute_the_file_hash(path, num_bytes);
     }
-    //the file id is a hashed function of device,inode,size, and modification time (in seconds)
-    //note that it is not dependent on the file name
-    struct stat SS;
-    stat(path.toLatin1().data(), &SS);
-
-    //didn't compile on mac so using the following which only depends on size and modification date
-
-    QFileInfo info(path);
-    QString id_string = QString("%1:%2:%3:%4").arg(path).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch()).arg(info.size());
-
-    //QString id_string = QString("%1:%2:%3:%4").arg(SS.st_dev).arg(SS.st_ino).arg(SS.st_size).arg(SS.st_mtim.tv_sec);
-    QString file_id = compute_the_string_hash(id_string);
+    QString file_id = sumit_file_id(path);
+    if (file_id.isEmpty())
+        return "";
+    {
+        QMutexLocker locker(&s_checksums_mutex);
+        if (s_checksums.contains(file_id))
+            return s_checksums[file_id];
+    }
 
     QString dirname = QString(temporary_path + "/sumit/sha1/%1").arg(file_id.mid(0, 4));
     create_directory_if_doesnt_exist(dirname);
     QString hash_path = QString("%1/%2").arg(dirname).arg(file_id);
 
-    QString hash_sum = read_text_file(hash_path);
-    if (hash_sum.isEmpty()) {
-        create_hash_file(path, hash_path);
-        hash_sum = read_text_file(hash_path);
-    }
+    QString hash_sum = read_text_file(hash_path).trimmed();
     if (hash_sum.count() != 40) {
-        create_hash_file(path, hash_path);
-        hash_sum = read_text_file(hash_path);
+        //the index is shared between processes: one of them computes the checksum while the others wait for it.
+        //The lock is never considered stale while its owner is alive, however long the hashing takes
+        QLockFile lock(hash_path + ".lock");
+        lock.setStaleLockTime(0);
+        bool locked = lock.lock();
+        hash_sum = read_text_file(hash_path).trimmed();
+        if (hash_sum.count() != 40) {
+            hash_sum = compute_the_file_hash(path, 0);
+            //only record it if the file did not change while we were reading it
+            if ((hash_sum.count() == 40) && (sumit_file_id(path) == file_id)) {
+                //written under a temporary name and renamed, so that readers never see a partial entry
+                QString tmp_path = hash_path + QString(".tmp.%1").arg(QCoreApplication::applicationPid());
+                write_text_file(tmp_path, hash_sum);
+                QFile::remove(hash_path);
+                if (!QFile::rename(tmp_path, hash_path))
+                    QFile::remove(tmp_path);
+            }
+        }
+        if (locked)
+            lock.unlock();
+    }
+    if (hash_sum.count() == 40) {
+        QMutexLocker locker(&s_checksums_mutex);
+        s_checksums[file_id] = hash_sum;
     }
     return hash_sum;
 }
@@ -84,13 +84,6 @@ MVPrefsControl::MVPrefsControl(MVAbstractContext* context, MVMainWindow* mw)
         glayout->addWidget(X, row, 1);
         row++;
     }
-    {
-        QWidget* X = this->createDoubleControl("cc_max_est_data_size");
-        context->onOptionChanged("cc_max_est_data_size", this, SLOT(updateControls()));
-        glayout->addWidget(new QLabel("CC max est data size:"), row, 0);
-        glayout->addWidget(X, row, 1);
-        row++;
-    }
     {
         QWidget* X = this->createDoubleControl("amp_thresh_display");
         context->onOptionChanged("amp_thresh_display", this, SLOT(updateControls()));
@@ -140,7 +133,6 @@ void MVPrefsControl::updateContext()
     c->setOption("cc_max_dt_msec", this->controlValue("cc_max_dt_msec").toDouble());
     c->setOption("cc_log_time_constant_msec", this->controlValue("cc_log_time_constant_msec").toDouble());
     c->setOption("cc_bin_size_msec", this->controlValue("cc_bin_size_msec").toDouble());
-    c->setOption("cc_max_est_data_size", this->controlValue("cc_max_est_data_size").toDouble());
     c->setOption("amp_thresh_display", this->controlValue("amp_thresh_display").toDouble());
     //c->setOption("discrim_hist_method", this->controlValue("discrim_hist_method").toString());
 }
@@ -158,7 +150,6 @@ void MVPrefsControl::updateControls()
     this->setControlValue("cc_max_dt_msec", c->option("cc_max_dt_msec").toDouble());
     this->setControlValue("cc_log_time_constant_msec", c->option("cc_log_time_constant_msec").toDouble());
     this->setControlValue("cc_bin_size_msec", c->option("cc_bin_size_msec").toDouble());
-    this->setControlValue("cc_max_est_data_size", c->option("cc_max_est_data_size").toDouble());
     this->setControlValue("amp_thresh_display", c->option("amp_thresh_display").toDouble());
     //this->setControlValue("discrim_hist_method", c->option("discrim_hist_method"));
 }
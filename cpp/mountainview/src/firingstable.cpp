@@ -0,0 +1,250 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "firingstable.h"
+#include <QDebug>
+#include <QMutex>
+
+#define FIRINGS_TABLE_READ_CHUNK_SIZE 1e6 //number of events per readChunk
+
+class FiringsTablePrivate {
+public:
+    DiskReadMda m_firings;
+    QMutex m_mutex;
+    bool m_loaded = false;
+    bool m_load_failed = false;
+
+    QVector<double> m_times;
+    QVector<int> m_labels;
+    QVector<double> m_amplitudes;
+    QVector<int> m_channels;
+    int m_K = 0;
+
+    //events sorted by label: the indices for label k are m_label_indices[m_label_offsets[k] .. m_label_offsets[k+1]-1]
+    QVector<bigint> m_label_offsets;
+    QVector<bigint> m_label_indices;
+
+    bool load();
+    void build_label_index();
+};
+
+FiringsTable::FiringsTable()
+    : d(new FiringsTablePrivate)
+{
+    d->build_label_index();
+    d->m_loaded = true; //empty
+}
+
+FiringsTable::FiringsTable(const DiskReadMda& firings)
+    : d(new FiringsTablePrivate)
+{
+    d->m_firings = firings;
+}
+
+FiringsTable::FiringsTable(const FiringsTable& other)
+{
+    d = other.d;
+}
+
+FiringsTable::~FiringsTable()
+{
+}
+
+void FiringsTable::operator=(const FiringsTable& other)
+{
+    d = other.d;
+}
+
+DiskReadMda FiringsTable::firings() const
+{
+    return d->m_firings;
+}
+
+bool FiringsTable::load() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->load();
+}
+
+bool FiringsTable::isLoaded() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_loaded;
+}
+
+bigint FiringsTable::count() const
+{
+    load();
+    return d->m_times.count();
+}
+
+int FiringsTable::K() const
+{
+    load();
+    return d->m_K;
+}
+
+bool FiringsTable::hasAmplitudes() const
+{
+    load();
+    return (!d->m_amplitudes.isEmpty());
+}
+
+const QVector<double>& FiringsTable::times() const
+{
+    load();
+    return d->m_times;
+}
+
+const QVector<int>& FiringsTable::labels() const
+{
+    load();
+    return d->m_labels;
+}
+
+const QVector<double>& FiringsTable::amplitudes() const
+{
+    load();
+    return d->m_amplitudes;
+}
+
+const QVector<int>& FiringsTable::channels() const
+{
+    load();
+    return d->m_channels;
+}
+
+bigint FiringsTable::labelCount(int k) const
+{
+    load();
+    if ((k < 0) || (k > d->m_K))
+        return 0;
+    return d->m_label_offsets[k + 1] - d->m_label_offsets[k];
+}
+
+QVector<bigint> FiringsTable::eventIndicesForLabel(int k) const
+{
+    load();
+    if ((k < 0) || (k > d->m_K))
+        return QVector<bigint>();
+    bigint i1 = d->m_label_offsets[k];
+    bigint i2 = d->m_label_offsets[k + 1];
+    return d->m_label_indices.mid(i1, i2 - i1);
+}
+
+QVector<double> FiringsTable::timesForLabel(int k) const
+{
+    QVector<bigint> inds = eventIndicesForLabel(k);
+    QVector<double> ret(inds.count());
+    for (bigint i = 0; i < inds.count(); i++) {
+        ret[i] = d->m_times[inds[i]];
+    }
+    return ret;
+}
+
+QVector<double> FiringsTable::amplitudesForLabel(int k) const
+{
+    if (!hasAmplitudes())
+        return QVector<double>();
+    QVector<bigint> inds = eventIndicesForLabel(k);
+    QVector<double> ret(inds.count());
+    for (bigint i = 0; i < inds.count(); i++) {
+        ret[i] = d->m_amplitudes[inds[i]];
+    }
+    return ret;
+}
+
+bool FiringsTablePrivate::load()
+{
+    if (m_loaded)
+        return true;
+    if (m_load_failed)
+        return false;
+
+    bigint R = m_firings.N1();
+    bigint L = m_firings.N2();
+    if ((L > 0) && (R < 3)) {
+        qWarning() << "Unexpected number of rows in firings array" << R;
+        build_label_index();
+        m_load_failed = true;
+        return false;
+    }
+    bool has_amplitudes = (R >= 4);
+
+    m_times.resize(L);
+    m_labels.resize(L);
+    m_channels.resize(L);
+    if (has_amplitudes)
+        m_amplitudes.resize(L);
+
+    //read the first (up to) four rows in large chunks, and scatter them into the columns
+    int R0 = qMin(R, (bigint)4);
+    bigint chunk_size = FIRINGS_TABLE_READ_CHUNK_SIZE;
+    for (bigint i = 0; i < L; i += chunk_size) {
+        bigint size = qMin(chunk_size, L - i);
+        Mda X;
+        if (!m_firings.readChunk(X, 0, i, R0, size)) {
+            qWarning() << "Problem reading chunk of firings array" << m_firings.makePath();
+            m_times.clear();
+            m_labels.clear();
+            m_channels.clear();
+            m_amplitudes.clear();
+            build_label_index();
+            m_load_failed = true;
+            return false;
+        }
+        const double* ptr = X.constDataPtr();
+        for (bigint j = 0; j < size; j++) {
+            const double* col = &ptr[R0 * j];
+            m_channels[i + j] = (int)col[0];
+            m_times[i + j] = col[1];
+            m_labels[i + j] = (int)col[2];
+            if (has_amplitudes)
+                m_amplitudes[i + j] = col[3];
+        }
+    }
+
+    build_label_index();
+    m_loaded = true;
+    return true;
+}
+
+void FiringsTablePrivate::build_label_index()
+{
+    m_K = 0;
+    bigint L = m_labels.count();
+    for (bigint i = 0; i < L; i++) {
+        if (m_labels[i] > m_K)
+            m_K = m_labels[i];
+    }
+
+    //counting sort by label (labels outside 0..K are left out of the index)
+    m_label_offsets.fill(0, m_K + 2);
+    for (bigint i = 0; i < L; i++) {
+        int k = m_labels[i];
+        if (k >= 0)
+            m_label_offsets[k + 1]++;
+    }
+    for (int k = 0; k <= m_K; k++) {
+        m_label_offsets[k + 1] += m_label_offsets[k];
+    }
+    m_label_indices.resize(m_label_offsets[m_K + 1]);
+    QVector<bigint> positions = m_label_offsets;
+    for (bigint i = 0; i < L; i++) {
+        int k = m_labels[i];
+        if (k >= 0)
+            m_label_indices[positions[k]++] = i;
+    }
+}
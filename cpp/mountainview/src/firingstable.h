@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FIRINGSTABLE_H
+#define FIRINGSTABLE_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include "diskreadmda.h"
+
+class FiringsTablePrivate;
+/**
+ * \class FiringsTable
+ * @brief Columnar, in-memory view of a firings array (times, labels, amplitudes, channels) with a per-label index.
+ *
+ * The firings are read in one bulk readChunk the first time any column is accessed, rather than
+ * one value() call per element. Copies share the loaded columns, so an MVContext can hand the same
+ * table to every view computer and the file is parsed only once. All methods are const and may be
+ * called from several threads; the first caller does the loading.
+ *
+ * Rows follow the firings convention: 0 = primary channel, 1 = time, 2 = label, 3 = amplitude (optional).
+ */
+class FiringsTable {
+public:
+    FiringsTable();
+    FiringsTable(const DiskReadMda& firings);
+    FiringsTable(const FiringsTable& other);
+    virtual ~FiringsTable();
+    void operator=(const FiringsTable& other);
+
+    DiskReadMda firings() const;
+    ///Load the columns if not already done. Returns false if the firings could not be read
+    bool load() const;
+    bool isLoaded() const;
+
+    bigint count() const;
+    ///The maximum label
+    int K() const;
+    bool hasAmplitudes() const;
+
+    const QVector<double>& times() const;
+    const QVector<int>& labels() const;
+    const QVector<double>& amplitudes() const; //empty if hasAmplitudes() is false
+    const QVector<int>& channels() const;
+
+    ///Number of events with label k
+    bigint labelCount(int k) const;
+    ///Indices (into the columns) of the events with label k, in increasing order
+    QVector<bigint> eventIndicesForLabel(int k) const;
+    QVector<double> timesForLabel(int k) const;
+    QVector<double> amplitudesForLabel(int k) const;
+
+private:
+    QSharedPointer<FiringsTablePrivate> d;
+};
+
+#endif // FIRINGSTABLE_H
@@ -87,8 +87,8 @@ SOURCES += mountainviewmain.cpp \
     views/mvtemplatesview2panel.cpp \
 
 
-HEADERS += mvcontext.h
-SOURCES += mvcontext.cpp
+HEADERS += mvcontext.h firingstable.h
+SOURCES += mvcontext.cpp firingstable.cpp
 
 INCLUDEPATH += multiscaletimeseries
 VPATH += multiscaletimeseries
@@ -122,7 +122,7 @@ correlationmatrixview.h histogramview.h mvamphistview2.h mvamphistview3.h histog
 mvclipswidget.h \
 mvclusterview.h mvclusterwidget.h mvcrosscorrelogramswidget3.h \
 mvdiscrimhistview.h mvfiringeventview2.h mvhistogramgrid.h \
-mvspikesprayview.h mvtimeseriesrendermanager.h mvtimeseriesview2.h \
+mvspikesprayview.h mvtimeseriesrendermanager.h mvenveloperasterizer.h mvtimeseriesview2.h \
 mvtimeseriesviewbase.h spikespywidget.h \
 #mvdiscrimhistview_guide.h \
 mvclusterlegend.h
@@ -131,7 +131,7 @@ correlationmatrixview.cpp histogramview.cpp mvamphistview2.cpp mvamphistview3.cp
 mvclipswidget.cpp \
 mvclusterview.cpp mvclusterwidget.cpp mvcrosscorrelogramswidget3.cpp \
 mvdiscrimhistview.cpp mvfiringeventview2.cpp mvhistogramgrid.cpp \
-mvspikesprayview.cpp mvtimeseriesrendermanager.cpp mvtimeseriesview2.cpp \
+mvspikesprayview.cpp mvtimeseriesrendermanager.cpp mvenveloperasterizer.cpp mvtimeseriesview2.cpp \
 mvtimeseriesviewbase.cpp spikespywidget.cpp \
 #mvdiscrimhistview_guide.cpp \
 mvclusterlegend.cpp
@@ -177,6 +177,10 @@ HEADERS += compute_templates_0.h
 SOURCES += compute_templates_0.cpp
 HEADERS += extract_clips.h
 SOURCES += extract_clips.cpp
+HEADERS += pca.h
+SOURCES += pca.cpp
+HEADERS += localprocessors.h
+SOURCES += localprocessors.cpp
 
 
 #-std=c++11   # AHB removed since not in GNU gcc 4.6.3
@@ -60,6 +60,8 @@
 #include "closemehandler.h"
 #include "clusterdetailplugin.h"
 #include "histogramview.h"
+#include "localprocessorregistry.h"
+#include "localprocessors.h"
 #include "mda.h"
 #include "mvclusterwidget.h"
 #include "mvmainwindow.h"
@@ -205,6 +207,10 @@ int main(int argc, char* argv[])
     //The process manager
     QProcessManager* processManager = new QProcessManager;
     registry.addAutoReleasedObject(processManager);
+
+    //processors that the views can run without spawning ml-run-process
+    register_local_processors(LocalProcessorRegistry::globalInstance());
+
     signal(SIGINT, sig_handler);
     signal(SIGKILL, sig_handler);
     signal(SIGTERM, sig_handler);
@@ -216,6 +222,12 @@ int main(int argc, char* argv[])
     ObjectRegistry::addAutoReleasedObject(new IIntCounter("bytes_downloaded"));
     ObjectRegistry::addAutoReleasedObject(new IIntCounter("bytes_read"));
     ObjectRegistry::addAutoReleasedObject(new IIntCounter("bytes_written"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("mda_cache_hits"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("mda_cache_misses"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("mda_cache_evictions"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("process_result_hits"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("timeseries_prefetch_hits"));
+    ObjectRegistry::addAutoReleasedObject(new IIntCounter("timeseries_prefetch_misses"));
 
     QList<ICounterBase*> counters = ObjectRegistry::getObjects<ICounterBase>();
     counterManager->setCounters(counters);
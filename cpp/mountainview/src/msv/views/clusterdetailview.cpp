@@ -75,8 +75,9 @@ public:
     //input
     //QString mscmdserver_url;
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     DiskReadMda32 timeseries;
-    DiskReadMda firings;
+    FiringsTable firings;
     bool using_static_data;
     DiskReadMda32 static_templates;
     DiskReadMda32 static_template_stdevs;
@@ -298,8 +299,9 @@ void ClusterDetailView::prepareCalculation()
         d->compute_total_time();
     //}
     d->m_calculator.mlproxy_url = c->mlProxyUrl();
+    d->m_calculator.result_store = c->resultStore();
     d->m_calculator.timeseries = c->currentTimeseries();
-    d->m_calculator.firings = c->firings();
+    d->m_calculator.firings = c->firingsTable();
     d->m_calculator.using_static_data = d->m_using_static_data;
     d->m_calculator.static_templates = d->m_static_templates;
     d->m_calculator.static_template_stdevs = d->m_static_template_stdevs;
@@ -1457,7 +1459,7 @@ QColor ClusterView::get_firing_rate_text_color(double rate)
     return QColor(50, 0, 0);
 }
 
-DiskReadMda mp_compute_templates(const QString& mlproxy_url, const QString& timeseries, const QString& firings, int clip_size)
+DiskReadMda mp_compute_templates(const QString& mlproxy_url, ProcessResultStore* result_store, const QString& timeseries, const QString& firings, int clip_size)
 {
     TaskProgress task(TaskProgress::Calculate, "mp_compute_templates");
     task.log("mlproxy_url: " + mlproxy_url);
@@ -1471,6 +1473,7 @@ DiskReadMda mp_compute_templates(const QString& mlproxy_url, const QString& time
     params["clip_size"] = clip_size;
     X.setInputParameters(params);
     X.setMLProxyUrl(mlproxy_url);
+    X.setResultStore(result_store);
 
     QString templates_fname = X.makeOutputFilePath("templates_out");
 
@@ -1483,7 +1486,7 @@ DiskReadMda mp_compute_templates(const QString& mlproxy_url, const QString& time
     return ret;
 }
 
-void mp_compute_templates_stdevs(DiskReadMda32& templates_out, DiskReadMda32& stdevs_out, const QString& mlproxy_url, const QString& timeseries, const QString& firings, int clip_size)
+void mp_compute_templates_stdevs(DiskReadMda32& templates_out, DiskReadMda32& stdevs_out, const QString& mlproxy_url, ProcessResultStore* result_store, const QString& timeseries, const QString& firings, int clip_size)
 {
     TaskProgress task(TaskProgress::Calculate, "compute templates stdevs");
     task.log("mlproxy_url: " + mlproxy_url);
@@ -1497,6 +1500,7 @@ void mp_compute_templates_stdevs(DiskReadMda32& templates_out, DiskReadMda32& st
     params["clip_size"] = clip_size;
     X.setInputParameters(params);
     X.setMLProxyUrl(mlproxy_url);
+    X.setResultStore(result_store);
 
     QString templates_fname = X.makeOutputFilePath("templates_out");
     QString stdevs_fname = X.makeOutputFilePath("stdevs_out");
@@ -1525,23 +1529,12 @@ void ClusterDetailViewCalculator::compute()
 
 
     //int N = timeseries.N2();
-    int L = firings.N2();
-
-    QVector<double> times;
-    QVector<int> channels, labels;
-    QVector<double> peaks;
+    int L = firings.count();
 
     if (using_static_data)
         task.log(QString("Using static data (templates: %1 x %2 x %3)").arg(static_templates.N1()).arg(static_templates.N2()).arg(static_templates.N3()));
 
-    task.log("Setting up times/channels/labels/peaks");
     task.setProgress(0.2);
-    for (int i = 0; i < L; i++) {
-        times << firings.value(1, i) - 1; //convert to 0-based indexing
-        channels << (int)firings.value(0, i) - 1; //convert to 0-based indexing
-        labels << (int)firings.value(2, i);
-        peaks << firings.value(3, i);
-    }
 
     if (MLUtil::threadInterruptRequested()) {
         task.error("Halted *");
@@ -1554,7 +1547,7 @@ void ClusterDetailViewCalculator::compute()
     task.setProgress(0.4);
 
     QString timeseries_path = timeseries.makePath();
-    QString firings_path = firings.makePath();
+    QString firings_path = firings.firings().makePath();
     /*
     this->setStatus("", "mscmd_compute_templates: "+mscmdserver_url+" timeseries_path="+timeseries_path+" firings_path="+firings_path, 0.6);
     DiskReadMda templates0 = mscmd_compute_templates(mscmdserver_url, timeseries_path, firings_path, T);
@@ -1562,7 +1555,7 @@ void ClusterDetailViewCalculator::compute()
 
     task.log("mp_compute_templates_stdevs: " + mlproxy_url + " timeseries_path=" + timeseries_path + " firings_path=" + firings_path);
     task.setProgress(0.6);
-    //DiskReadMda templates0 = mp_compute_templates(mlproxy_url, timeseries_path, firings_path, T);
+    //DiskReadMda templates0 = mp_compute_templates(mlproxy_url, result_store.data(), timeseries_path, firings_path, T);
     DiskReadMda32 templates0, stdevs0;
     int M,T,K;
     if (using_static_data) {
@@ -1575,11 +1568,8 @@ void ClusterDetailViewCalculator::compute()
     else {
         M = timeseries.N1();
         T = clip_size;
-        K = 0;
-        for (int i = 0; i < L; i++)
-            if (labels[i] > K)
-                K = labels[i];
-        mp_compute_templates_stdevs(templates0, stdevs0, mlproxy_url, timeseries_path, firings_path, T);
+        K = firings.K();
+        mp_compute_templates_stdevs(templates0, stdevs0, mlproxy_url, result_store.data(), timeseries_path, firings_path, T);
     }
     if (MLUtil::threadInterruptRequested()) {
         task.error("Halted **");
@@ -1607,11 +1597,7 @@ void ClusterDetailViewCalculator::compute()
         ClusterData CD;
         CD.k = k;
         CD.channel = 0;
-        for (int i = 0; i < L; i++) {
-            if (labels[i] == k) {
-                CD.num_events++;
-            }
-        }
+        CD.num_events = firings.labelCount(k);
         if (MLUtil::threadInterruptRequested()) {
             task.error("Halted ****");
             return;
@@ -28,19 +28,31 @@
 #include <math.h>
 #include "mountainprocessrunner.h"
 #include "mlcommon.h"
+#include <QSharedPointer>
+
+#define MAX_RAW_READ_ENTRIES 4e6 //largest raw read used to serve getData before the pyramid is ready
+#define NUM_ESTIMATE_TIMEPOINTS 30000 //used for minimum()/maximum() before the pyramid is ready
+
+//shared by all copies, so the render threads see the pyramid as soon as initialize() completes
+struct MultiScaleTimeSeriesPyramid {
+    QMutex mutex;
+    DiskReadMda32 multiscale_data;
+    bool initialized = false;
+};
 
 class MultiScaleTimeSeriesPrivate {
 public:
     MultiScaleTimeSeries* q;
 
     DiskReadMda32 m_data;
-    DiskReadMda32 m_multiscale_data;
-    bool m_initialized;
+    QSharedPointer<MultiScaleTimeSeriesPyramid> m_pyramid;
     QString m_remote_data_type;
     QString m_mlproxy_url;
 
     QString get_multiscale_fname();
     bool get_data(Mda32& min, Mda32& max, int t1, int t2, int ds_factor);
+    bool get_data_from_raw(Mda32& min, Mda32& max, int t1, int t2, int ds_factor);
+    bool is_initialized(DiskReadMda32* multiscale_data = 0);
 
     static bool is_power_of_3(int N);
 };
@@ -49,7 +61,7 @@ MultiScaleTimeSeries::MultiScaleTimeSeries()
 {
     d = new MultiScaleTimeSeriesPrivate;
     d->q = this;
-    d->m_initialized = false;
+    d->m_pyramid.reset(new MultiScaleTimeSeriesPyramid);
     d->m_remote_data_type = "float32";
 }
 
@@ -59,8 +71,7 @@ MultiScaleTimeSeries::MultiScaleTimeSeries(const MultiScaleTimeSeries& other)
     d->q = this;
 
     d->m_data = other.d->m_data;
-    d->m_multiscale_data = other.d->m_multiscale_data;
-    d->m_initialized = other.d->m_initialized;
+    d->m_pyramid = other.d->m_pyramid;
     d->m_mlproxy_url = other.d->m_mlproxy_url;
     d->m_remote_data_type = other.d->m_remote_data_type;
 }
@@ -73,8 +84,7 @@ MultiScaleTimeSeries::~MultiScaleTimeSeries()
 void MultiScaleTimeSeries::operator=(const MultiScaleTimeSeries& other)
 {
     d->m_data = other.d->m_data;
-    d->m_multiscale_data = other.d->m_multiscale_data;
-    d->m_initialized = other.d->m_initialized;
+    d->m_pyramid = other.d->m_pyramid;
     d->m_mlproxy_url = other.d->m_mlproxy_url;
     d->m_remote_data_type = other.d->m_remote_data_type;
 }
@@ -82,8 +92,7 @@ void MultiScaleTimeSeries::operator=(const MultiScaleTimeSeries& other)
 void MultiScaleTimeSeries::setData(const DiskReadMda32& X)
 {
     d->m_data = X;
-    d->m_multiscale_data = DiskReadMda32();
-    d->m_initialized = false;
+    d->m_pyramid.reset(new MultiScaleTimeSeriesPyramid);
 }
 
 void MultiScaleTimeSeries::setMLProxyUrl(const QString& url)
@@ -93,14 +102,18 @@ void MultiScaleTimeSeries::setMLProxyUrl(const QString& url)
 
 void MultiScaleTimeSeries::initialize()
 {
+    if (isInitialized())
+        return;
     TaskProgress task("Initializing multiscaletimeseries");
+    QSharedPointer<MultiScaleTimeSeriesPyramid> pyramid = d->m_pyramid;
     QString path;
     {
         path = d->m_data.makePath();
         if (path.isEmpty()) {
             qWarning() << "Unable to initialize multiscaletimeseries.... path is empty.";
             task.error() << "Unable to initialize multiscaletimeseries.... path is empty.";
-            d->m_initialized = true;
+            QMutexLocker locker(&pyramid->mutex);
+            pyramid->initialized = true;
             return;
         }
     }
@@ -122,14 +135,28 @@ void MultiScaleTimeSeries::initialize()
         return;
     }
     {
-        d->m_multiscale_data.setPath(path_out);
+        DiskReadMda32 multiscale_data(path_out);
         task.log(d->m_data.makePath());
-        task.log(d->m_multiscale_data.makePath());
-        task.log(QString("%1x%2 -- %3x%4").arg(d->m_multiscale_data.N1()).arg(d->m_multiscale_data.N2()).arg(d->m_data.N1()).arg(d->m_data.N2()));
-        d->m_initialized = true;
+        task.log(multiscale_data.makePath());
+        task.log(QString("%1x%2 -- %3x%4").arg(multiscale_data.N1()).arg(multiscale_data.N2()).arg(d->m_data.N1()).arg(d->m_data.N2()));
+        QMutexLocker locker(&pyramid->mutex);
+        pyramid->multiscale_data = multiscale_data;
+        pyramid->initialized = true;
     }
 }
 
+bool MultiScaleTimeSeries::isInitialized()
+{
+    return d->is_initialized();
+}
+
+bool MultiScaleTimeSeries::canGetData(int t1, int t2, int ds_factor)
+{
+    if ((ds_factor == 1) || (d->is_initialized()))
+        return true;
+    return ((t2 - t1 + 1) * 1.0 * ds_factor * d->m_data.N1() <= MAX_RAW_READ_ENTRIES);
+}
+
 int MultiScaleTimeSeries::N1()
 {
     return d->m_data.N1();
@@ -147,17 +174,27 @@ bool MultiScaleTimeSeries::getData(Mda32& min, Mda32& max, int t1, int t2, int d
 
 double MultiScaleTimeSeries::minimum()
 {
-    int ds_factor = MultiScaleTimeSeries::smallest_power_of_3_larger_than(this->N2() / 3);
     Mda32 min, max;
-    this->getData(min, max, 0, 0, ds_factor);
+    if (isInitialized()) {
+        int ds_factor = MultiScaleTimeSeries::smallest_power_of_3_larger_than(this->N2() / 3);
+        this->getData(min, max, 0, 0, ds_factor);
+    }
+    else {
+        this->getData(min, max, 0, qMin(this->N2(), NUM_ESTIMATE_TIMEPOINTS) - 1, 1);
+    }
     return min.minimum();
 }
 
 double MultiScaleTimeSeries::maximum()
 {
-    int ds_factor = MultiScaleTimeSeries::smallest_power_of_3_larger_than(this->N2() / 3);
     Mda32 min, max;
-    this->getData(min, max, 0, 0, ds_factor);
+    if (isInitialized()) {
+        int ds_factor = MultiScaleTimeSeries::smallest_power_of_3_larger_than(this->N2() / 3);
+        this->getData(min, max, 0, 0, ds_factor);
+    }
+    else {
+        this->getData(min, max, 0, qMin(this->N2(), NUM_ESTIMATE_TIMEPOINTS) - 1, 1);
+    }
     return max.maximum();
 }
 
@@ -174,10 +211,6 @@ bool MultiScaleTimeSeriesPrivate::get_data(Mda32& min, Mda32& max, int t1, int t
 {
     int M, N, N2;
     {
-        if (!m_initialized) {
-            qWarning() << "Cannot get_data. Multiscale timeseries is not initialized!";
-            return false;
-        }
         M = m_data.N1();
         N2 = m_data.N2();
         N = MultiScaleTimeSeries::smallest_power_of_3_larger_than(N2);
@@ -229,7 +262,14 @@ bool MultiScaleTimeSeriesPrivate::get_data(Mda32& min, Mda32& max, int t1, int t
             return false;
         }
 
-        //m_multiscale_data.setRemoteDataType(m_remote_data_type);
+        DiskReadMda32 multiscale_data;
+        if (!is_initialized(&multiscale_data)) {
+            if (!q->canGetData(t1, t2, ds_factor))
+                return false; //wait for the pyramid
+            return get_data_from_raw(min, max, t1, t2, ds_factor);
+        }
+
+        //multiscale_data.setRemoteDataType(m_remote_data_type);
 
         int t_offset_min = 0;
         int ds_factor_0 = 3;
@@ -239,11 +279,11 @@ bool MultiScaleTimeSeriesPrivate::get_data(Mda32& min, Mda32& max, int t1, int t
         }
         int t_offset_max = t_offset_min + N / ds_factor;
 
-        if (!m_multiscale_data.readChunk(min, 0, t1 + t_offset_min, M, t2 - t1 + 1)) {
+        if (!multiscale_data.readChunk(min, 0, t1 + t_offset_min, M, t2 - t1 + 1)) {
             qWarning() << "Unable to read chunk of data in multi-scale timeseries (2)";
             return false;
         }
-        if (!m_multiscale_data.readChunk(max, 0, t1 + t_offset_max, M, t2 - t1 + 1)) {
+        if (!multiscale_data.readChunk(max, 0, t1 + t_offset_max, M, t2 - t1 + 1)) {
             qWarning() << "Unable to read chunk of data in multi-scale timeseries (3)";
             return false;
         }
@@ -256,6 +296,49 @@ bool MultiScaleTimeSeriesPrivate::get_data(Mda32& min, Mda32& max, int t1, int t
     return true;
 }
 
+bool MultiScaleTimeSeriesPrivate::get_data_from_raw(Mda32& min, Mda32& max, int t1, int t2, int ds_factor)
+{
+    //same reduction as mv.create_multiscale_timeseries, over raw timepoints [t*ds_factor, (t+1)*ds_factor)
+    int M = m_data.N1();
+    int num = t2 - t1 + 1;
+    Mda32 X;
+    if (!m_data.readChunk(X, 0, t1 * ds_factor, M, num * ds_factor)) {
+        qWarning() << "Unable to read chunk of data in multi-scale timeseries (4)";
+        return false;
+    }
+    if (MLUtil::threadInterruptRequested()) {
+        return false;
+    }
+    min.allocate(M, num);
+    max.allocate(M, num);
+    const float* Xptr = X.constDataPtr();
+    float* min_ptr = min.dataPtr();
+    float* max_ptr = max.dataPtr();
+    for (int t = 0; t < num; t++) {
+        const float* col = &Xptr[M * t * ds_factor];
+        for (int m = 0; m < M; m++) {
+            min_ptr[m + M * t] = col[m];
+            max_ptr[m + M * t] = col[m];
+        }
+        for (int i = 1; i < ds_factor; i++) {
+            col += M;
+            for (int m = 0; m < M; m++) {
+                min_ptr[m + M * t] = qMin(min_ptr[m + M * t], col[m]);
+                max_ptr[m + M * t] = qMax(max_ptr[m + M * t], col[m]);
+            }
+        }
+    }
+    return true;
+}
+
+bool MultiScaleTimeSeriesPrivate::is_initialized(DiskReadMda32* multiscale_data)
+{
+    QMutexLocker locker(&m_pyramid->mutex);
+    if ((multiscale_data) && (m_pyramid->initialized))
+        *multiscale_data = m_pyramid->multiscale_data;
+    return m_pyramid->initialized;
+}
+
 bool MultiScaleTimeSeriesPrivate::is_power_of_3(int N)
 {
     double val = N;
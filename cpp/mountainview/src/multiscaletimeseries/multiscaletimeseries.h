@@ -29,13 +29,17 @@ public:
     void operator=(const MultiScaleTimeSeries& other);
     void setData(const DiskReadMda32& X);
     void setMLProxyUrl(const QString& url);
-    void initialize();
+    void initialize(); //builds the multi-scale pyramid; copies of this object pick it up once it is complete
+    bool isInitialized();
+
+    ///Whether getData can be served now. Until initialized, only small windows are served by reducing the raw data directly
+    bool canGetData(int t1, int t2, int ds_factor);
 
     int N1();
     int N2();
     bool getData(Mda32& min, Mda32& max, int t1, int t2, int ds_factor); //returns values at timepoints i1*ds_factor:ds_factor:i2*ds_factor
-    double minimum(); //return the global minimum value
-    double maximum(); //return the global maximum value
+    double minimum(); //return the global minimum value (estimated from the start of the data until initialized)
+    double maximum(); //return the global maximum value (estimated from the start of the data until initialized)
 
     static int smallest_power_of_3_larger_than(int N);
 
@@ -48,10 +48,12 @@ public:
     QMap<QString, TimeseriesStruct> m_timeseries;
     QString m_current_timeseries_name;
     DiskReadMda m_firings;
-    int m_K = 0;
+    FiringsTable m_firings_table;
     DiskReadMda m_firings_subset;
+    FiringsTable m_firings_subset_table;
     double m_sample_rate = 0;
     QString m_mlproxy_url; //this is to disappear
+    QSharedPointer<ProcessResultStore> m_result_store;
     QMap<QString, QColor> m_colors;
     ClusterVisibilityRule m_visibility_rule;
     QJsonObject m_original_object;
@@ -84,6 +86,10 @@ MVContext::MVContext()
 
     d->set_default_options();
 
+    d->m_result_store = QSharedPointer<ProcessResultStore>(new ProcessResultStore);
+    QObject::connect(this, SIGNAL(firingsChanged()), this, SLOT(slot_remove_stale_results()));
+    QObject::connect(this, SIGNAL(clusterMergeChanged()), this, SLOT(slot_remove_stale_results()));
+
     // default colors
     d->m_colors["background"] = QColor(240, 240, 240);
     d->m_colors["frame1"] = QColor(245, 245, 245);
@@ -111,6 +117,9 @@ void MVContext::clear()
     d->m_cluster_pair_attributes.clear();
     d->m_timeseries.clear();
     d->m_firings = DiskReadMda();
+    d->m_firings_table = FiringsTable();
+    d->m_firings_subset = DiskReadMda();
+    d->m_firings_subset_table = FiringsTable();
     clearOptions();
     d->set_default_options();
 }
@@ -505,6 +514,15 @@ DiskReadMda MVContext::firings()
     }
 }
 
+FiringsTable MVContext::firingsTable()
+{
+    if (d->m_clusters_subset.isEmpty())
+        return d->m_firings_table;
+    else {
+        return d->m_firings_subset_table;
+    }
+}
+
 double MVContext::sampleRate() const
 {
     return d->m_sample_rate;
@@ -521,20 +539,13 @@ void MVContext::setCurrentTimeseriesName(QString name)
 void MVContext::setFirings(const DiskReadMda& F)
 {
     d->m_firings = F;
-    d->m_K = 0; //trigger recompute
+    d->m_firings_table = FiringsTable(F); //loaded on first use
     emit firingsChanged();
 }
 
 int MVContext::K()
 {
-    if (!d->m_K) {
-        for (bigint i = 0; i < d->m_firings.N2(); i++) {
-            int label = d->m_firings.value(2, i);
-            if (label > d->m_K)
-                d->m_K = label;
-        }
-    }
-    return d->m_K;
+    return d->m_firings_table.K();
 }
 
 void MVContext::setSampleRate(double sample_rate)
@@ -555,6 +566,11 @@ QString MVContext::mlProxyUrl() const
     return d->m_mlproxy_url;
 }
 
+QSharedPointer<ProcessResultStore> MVContext::resultStore() const
+{
+    return d->m_result_store;
+}
+
 void MVContext::setMLProxyUrl(QString url)
 {
     d->m_mlproxy_url = url;
@@ -942,6 +958,7 @@ class FiringsSubsetCalculator : public QThread {
 public:
     //input
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     QString firings_path;
     QSet<int> clusters_subset;
 
@@ -953,6 +970,7 @@ public:
         TaskProgress task(TaskProgress::Calculate, "Firings subset");
         MountainProcessRunner PR;
         PR.setMLProxyUrl(mlproxy_url);
+        PR.setResultStore(result_store.data());
         PR.setProcessorName("firings_subset");
         QMap<QString, QVariant> params;
         params["firings"] = firings_path;
@@ -980,6 +998,7 @@ void MVContext::setClustersSubset(const QSet<int>& clusters_subset)
         FiringsSubsetCalculator* CC = new FiringsSubsetCalculator;
         QObject::connect(CC, SIGNAL(finished()), this, SLOT(slot_firings_subset_calculator_finished()));
         CC->mlproxy_url = d->m_mlproxy_url;
+        CC->result_store = d->m_result_store;
         CC->firings_path = d->m_firings.makePath();
         CC->clusters_subset = d->m_clusters_subset;
         CC->start();
@@ -1104,10 +1123,18 @@ void MVContext::slot_firings_subset_calculator_finished()
     if (!CC)
         return;
     d->m_firings_subset.setPath(CC->firings_out_path);
+    d->m_firings_subset_table = FiringsTable(d->m_firings_subset);
     CC->deleteLater();
     emit this->firingsChanged();
 }
 
+void MVContext::slot_remove_stale_results()
+{
+    //results computed from firings files that have since been rewritten are dropped; results for the new
+    //firings get new keys anyway, since a request is keyed by the signatures of its input files
+    d->m_result_store->removeStaleResults();
+}
+
 void MVContext::clickCluster(int k, Qt::KeyboardModifiers modifiers)
 {
     if (modifiers & Qt::ControlModifier) {
@@ -1465,7 +1492,6 @@ void MVContextPrivate::set_default_options()
     q->setOption("cc_max_dt_msec", 100);
     q->setOption("cc_log_time_constant_msec", 1);
     q->setOption("cc_bin_size_msec", 0.5);
-    q->setOption("cc_max_est_data_size", "1e4");
     q->setOption("amp_thresh_display", 3);
     //q->setOption("discrim_hist_method", "centroid");
 }
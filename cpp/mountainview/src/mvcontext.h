@@ -25,6 +25,9 @@
 #include <diskreadmda32.h>
 #include "mvutils.h"
 #include "diskreadmda.h"
+#include "firingstable.h"
+#include "processresultstore.h"
+#include <QSharedPointer>
 
 class MVContext;
 
@@ -193,6 +196,7 @@ public:
 
     /////////////////////////////////////////////////
     DiskReadMda firings();
+    FiringsTable firingsTable(); //columnar view of firings(), loaded once and shared by all views
     void setFirings(const DiskReadMda& F);
     int K();
 
@@ -203,6 +207,10 @@ public:
     QString mlProxyUrl() const;
     void setMLProxyUrl(QString url);
 
+    /////////////////////////////////////////////////
+    // processor results shared by all of the views (pass to MountainProcessRunner::setResultStore)
+    QSharedPointer<ProcessResultStore> resultStore() const;
+
     /////////////////////////////////////////////////
     void copySettingsFrom(MVContext* other);
 
@@ -232,6 +240,7 @@ signals:
 
 private slots:
     void slot_firings_subset_calculator_finished();
+    void slot_remove_stale_results();
 
 private:
     MVContextPrivate* d;
@@ -19,8 +19,12 @@
 #include "mlcommon.h"
 #include <math.h>
 #include "get_sort_indices.h"
+#include <algorithm>
+#include <QDebug>
 //#include "omp.h" //removed by jfm on 5/18/18
 
+#define TEMPLATES_CHUNK_SIZE 1e5
+
 Mda compute_templates_0(const DiskReadMda& X, Mda& firings, int clip_size)
 {
     QVector<double> times;
@@ -86,74 +90,110 @@ Mda compute_templates_0(const DiskReadMda& X, const QVector<double>& times, cons
     return templates;
 }
 
-void get_sums_and_counts_for_templates(Mda& sums, Mda& counts, const Mda32& X, bigint t_offset, const QVector<double>& times, const QVector<int>& labels, int clip_size, int K)
+Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
 {
-    int M = X.N1();
-    bigint N = X.N2();
-    int T = clip_size;
-    int Tmid = (int)((T + 1) / 2) - 1;
-    sums.allocate(M, T, K);
-    counts.allocate(1, K);
-    for (bigint i = 0; i < times.count(); i++) {
-        bigint t = times[i] - t_offset;
-        if ((t >= clip_size) && (t < N - clip_size)) {
-            int k = labels[i];
-            if ((k >= 1) && (k <= K)) {
-                Mda32 clip;
-                X.getChunk(clip, 0, t - Tmid, M, T);
-                for (int t = 0; t < T; t++) {
-                    for (int m = 0; m < M; m++) {
-                        sums.setValue(sums.value(m, t, k - 1) + clip.value(m, t), m, t, k - 1);
-                    }
-                }
-                counts.set(counts.get(k - 1) + 1, k - 1);
-            }
-        }
+    Mda32 templates;
+    if (!compute_templates_in_parallel(templates, 0, X, times, labels, clip_size)) {
+        qWarning() << "Problem computing templates in parallel";
     }
+    return templates;
 }
 
-Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
+bool compute_templates_in_parallel(Mda32& templates, Mda32* stdevs, const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
 {
-    int M = X.N1();
+    bigint M = X.N1();
     bigint N = X.N2();
-    int T = clip_size;
+    bigint T = clip_size;
+    bigint Tmid = (bigint)((T + 1) / 2) - 1;
     int K = MLCompute::max<int>(labels);
+    bigint MT = M * T;
 
-    Mda sums(M, T, K);
-    Mda counts(1, K);
+    templates.allocate(M, T, K);
+    if (stdevs)
+        stdevs->allocate(M, T, K);
+    if ((!MT) || (K <= 0))
+        return true;
+
+    //sort the events by time once, so that each chunk only visits its own range of events
+    QVector<bigint> event_times;
+    QVector<int> event_labels;
+    {
+        QVector<double> times0;
+        QVector<int> labels0;
+        for (bigint i = 0; i < times.count(); i++) {
+            int k = labels.value(i);
+            if (k >= 1) {
+                times0 << times[i];
+                labels0 << k;
+            }
+        }
+        QList<bigint> inds = get_sort_indices_bigint(times0);
+        event_times.resize(inds.count());
+        event_labels.resize(inds.count());
+        for (bigint j = 0; j < inds.count(); j++) {
+            event_times[j] = (bigint)(times0[inds[j]] + 0.5);
+            event_labels[j] = labels0[inds[j]];
+        }
+    }
+    bigint L = event_times.count();
+
+    //contiguous sums (and sums of squares) per label, so the inner loops run over M*T consecutive values
+    QVector<double> sums(K * MT, 0);
+    QVector<double> sumsqrs(stdevs ? K * MT : 0, 0);
+    QVector<bigint> counts(K, 0);
 
-    bigint chunk_size = 1e5;
-//#pragma omp parallel for
-    for (bigint t = 0; t < N; t += chunk_size) {
+    //chunk c handles the events with times in [c*chunk_size,(c+1)*chunk_size) and reads only the span
+    //their clips cover. Events outside of the timeseries go to the first and last chunks
+    bigint chunk_size = TEMPLATES_CHUNK_SIZE;
+    bigint num_chunks = qMax((bigint)1, (N + chunk_size - 1) / chunk_size);
+    bigint i1 = 0;
+    for (bigint c = 0; c < num_chunks; c++) {
+        bigint i2 = (c + 1 < num_chunks) ? std::lower_bound(event_times.begin() + i1, event_times.end(), (c + 1) * chunk_size) - event_times.begin() : L;
+        if (i1 >= i2)
+            continue;
+        if (MLUtil::threadInterruptRequested())
+            return false;
+        bigint t1 = event_times[i1] - Tmid;
+        bigint t2 = event_times[i2 - 1] - Tmid + T - 1;
         Mda32 chunk;
-//#pragma omp critical(compute_templates_in_parallel1)
-        {
-            X.readChunk(chunk, 0, t - clip_size, M, chunk_size + 2 * clip_size);
+        if (!X.readChunk(chunk, 0, t1, M, t2 - t1 + 1)) {
+            qWarning() << "Problem reading chunk in compute_templates_in_parallel" << t1 << t2;
+            return false;
         }
-        Mda sums0;
-        Mda counts0;
-        get_sums_and_counts_for_templates(sums0, counts0, chunk, t - clip_size, times, labels, clip_size, K);
-//#pragma omp critical(compute_templates_in_parallel2)
-        {
-            for (bigint i = 0; i < M * T * K; i++) {
-                sums.set(sums.get(i) + sums0.get(i), i);
+        const dtype32* Xptr = chunk.constDataPtr();
+        for (bigint i = i1; i < i2; i++) {
+            int k = event_labels[i];
+            const dtype32* clip = &Xptr[(event_times[i] - Tmid - t1) * M];
+            double* s = &sums.data()[(k - 1) * MT];
+            for (bigint aa = 0; aa < MT; aa++) {
+                s[aa] += clip[aa];
             }
-            for (int i = 0; i < K; i++) {
-                counts.set(counts.get(i) + counts0.get(i), i);
+            if (stdevs) {
+                double* ss = &sumsqrs.data()[(k - 1) * MT];
+                for (bigint aa = 0; aa < MT; aa++) {
+                    ss[aa] += clip[aa] * (double)clip[aa];
+                }
             }
+            counts[k - 1]++;
         }
+        i1 = i2;
     }
-    Mda32 ret(M, T, K);
+
+    dtype32* templates_ptr = templates.dataPtr();
+    dtype32* stdevs_ptr = stdevs ? stdevs->dataPtr() : 0;
     for (int k = 0; k < K; k++) {
-        if (counts.get(k)) {
-            for (int t = 0; t < T; t++) {
-                for (int m = 0; m < M; m++) {
-                    ret.setValue(sums.value(m, t, k) / counts.get(k), m, t, k);
+        bigint count = counts[k];
+        for (bigint aa = k * MT; aa < (k + 1) * MT; aa++) {
+            if (count) {
+                double mean0 = sums[aa] / count;
+                templates_ptr[aa] = mean0;
+                if ((stdevs_ptr) && (count >= 2)) {
+                    stdevs_ptr[aa] = sqrt(qMax(0.0, sumsqrs[aa] / count - mean0 * mean0));
                 }
             }
         }
     }
-    return ret;
+    return true;
 }
 
 Mda32 compute_templates_0(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
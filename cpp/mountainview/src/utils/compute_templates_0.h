@@ -28,5 +28,9 @@ Mda32 compute_templates_0(const DiskReadMda32& X, Mda& firings, int clip_size);
 Mda32 compute_templates_0(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
 
 Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
+//One pass over X: the templates are the means of the clips of each label (1..K), and the stdevs (if not null)
+//are computed along with them, for labels with at least two events. Returns false if X could not be read
+//or the calling thread was interrupted
+bool compute_templates_in_parallel(Mda32& templates, Mda32* stdevs, const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
 
 #endif // COMPUTE_TEMPLATES_0_H
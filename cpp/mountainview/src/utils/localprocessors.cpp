@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "localprocessors.h"
+#include "localprocessorregistry.h"
+#include "compute_templates_0.h"
+#include "extract_clips.h"
+#include "pca.h"
+#include "mlcommon.h"
+
+#include <QDebug>
+
+namespace LocalProcessors {
+
+QList<int> int_list_parameter(const QVariant& val)
+{
+    //either "1,2,3" (as on the command line) or a list
+    QStringList strs;
+    foreach (QString str, MLUtil::toStringList(val)) {
+        strs << str.split(",", QString::SkipEmptyParts);
+    }
+    return MLUtil::stringListToIntList(strs);
+}
+
+bool read_firings(Mda& firings, const QString& path)
+{
+    DiskReadMda F(path);
+    if (!F.readChunk(firings, 0, 0, F.N1(), F.N2())) {
+        qWarning() << "Unable to read firings: " + path;
+        return false;
+    }
+    return true;
+}
+
+//same selection as mv.mv_subfirings: the events of the given labels, thinned to max_per_label events per label
+//(evenly distributed in time) when max_per_label is nonzero
+bool subfirings(const QMap<QString, QVariant>& params)
+{
+    Mda firings;
+    if (!read_firings(firings, params["firings"].toString()))
+        return false;
+    QList<int> labels = int_list_parameter(params["labels"]);
+    bigint max_per_label = params.value("max_per_label", 0).toDouble();
+
+    QMap<int, QList<bigint> > inds_by_label;
+    foreach (int label, labels) {
+        inds_by_label[label] = QList<bigint>();
+    }
+    for (bigint j = 0; j < firings.N2(); j++) {
+        int label = (int)firings.value(2, j);
+        if (inds_by_label.contains(label))
+            inds_by_label[label] << j;
+    }
+
+    QVector<bool> to_use(firings.N2(), false);
+    bigint num_to_use = 0;
+    QList<int> keys = inds_by_label.keys();
+    foreach (int label, keys) {
+        const QList<bigint>& inds = inds_by_label[label];
+        if ((max_per_label) && (inds.count() > max_per_label)) {
+            double stride = inds.count() * 1.0 / max_per_label;
+            double jj = 0;
+            for (bigint i = 0; i < max_per_label; i++) {
+                to_use[inds[(bigint)jj]] = true;
+                jj += stride;
+            }
+            num_to_use += max_per_label;
+        }
+        else {
+            foreach (bigint j, inds) {
+                to_use[j] = true;
+            }
+            num_to_use += inds.count();
+        }
+    }
+
+    bigint R = firings.N1();
+    Mda out(R, num_to_use);
+    bigint jj = 0;
+    for (bigint j = 0; j < firings.N2(); j++) {
+        if (to_use[j]) {
+            for (bigint r = 0; r < R; r++) {
+                out.setValue(firings.value(r, j), r, jj);
+            }
+            jj++;
+        }
+    }
+    return out.write64(params["firings_out"].toString());
+}
+
+bool extract_clips_features(const QMap<QString, QVariant>& params)
+{
+    DiskReadMda32 X(params["timeseries"].toString());
+    Mda firings;
+    if (!read_firings(firings, params["firings"].toString()))
+        return false;
+    int clip_size = params["clip_size"].toInt();
+    int num_features = params["num_features"].toInt();
+    bool subtract_mean = (params["subtract_mean"].toInt() != 0);
+
+    QVector<double> times(firings.N2());
+    for (bigint i = 0; i < firings.N2(); i++) {
+        times[i] = firings.value(1, i);
+    }
+    Mda32 clips = extract_clips(X, times, clip_size);
+    if (MLUtil::threadInterruptRequested())
+        return false;
+    //the pca is done in double precision, as in the mv.mv_extract_clips_features processor
+    Mda clips_reshaped(clips.N1() * clips.N2(), clips.N3());
+    const dtype32* clips_ptr = clips.constDataPtr();
+    double* clips_reshaped_ptr = clips_reshaped.dataPtr();
+    bigint NNN = clips.totalSize();
+    for (bigint iii = 0; iii < NNN; iii++) {
+        clips_reshaped_ptr[iii] = clips_ptr[iii];
+    }
+    Mda CC, FF, sigma;
+    pca(CC, FF, sigma, clips_reshaped, num_features, subtract_mean);
+    return FF.write32(params["features_out"].toString());
+}
+
+bool compute_templates(const QMap<QString, QVariant>& params)
+{
+    DiskReadMda32 X(params["timeseries"].toString());
+    if (X.N2() <= 1)
+        return false;
+    Mda firings;
+    if (!read_firings(firings, params["firings"].toString()))
+        return false;
+    int clip_size = params["clip_size"].toInt();
+
+    QVector<double> times(firings.N2());
+    QVector<int> labels(firings.N2());
+    for (bigint i = 0; i < firings.N2(); i++) {
+        times[i] = firings.value(1, i);
+        labels[i] = (int)firings.value(2, i);
+    }
+    Mda32 templates, stdevs;
+    if (!compute_templates_in_parallel(templates, &stdevs, X, times, labels, clip_size))
+        return false;
+    if (!templates.write32(params["templates_out"].toString()))
+        return false;
+    if (params.contains("stdevs_out")) {
+        if (!stdevs.write32(params["stdevs_out"].toString()))
+            return false;
+    }
+    return true;
+}
+}
+
+void register_local_processors(LocalProcessorRegistry* registry)
+{
+    registry->registerProcessor("mv.mv_subfirings", LocalProcessors::subfirings);
+    registry->registerProcessor("firings_subset", LocalProcessors::subfirings);
+    registry->registerProcessor("mv.mv_extract_clips_features", LocalProcessors::extract_clips_features);
+    registry->registerProcessor("mv.mv_compute_templates", LocalProcessors::compute_templates);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCALPROCESSORS_H
+#define LOCALPROCESSORS_H
+
+class LocalProcessorRegistry;
+
+// Registers in-process versions of the mv processors that the views run on every recompute
+// (mv.mv_subfirings, firings_subset, mv.mv_extract_clips_features, mv.mv_compute_templates).
+// They take the same parameters and write the same outputs as the ml-run-process versions
+void register_local_processors(LocalProcessorRegistry* registry);
+
+#endif // LOCALPROCESSORS_H
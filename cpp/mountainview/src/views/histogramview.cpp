@@ -38,6 +38,8 @@ public:
     QVector<double> m_second_data;
     QVector<int> m_second_bin_counts;
     QVector<double> m_second_bin_densities;
+    QVector<int> m_preset_bin_counts;
+    bool m_use_preset_bin_counts = false;
 
     BinInfo m_bin_info;
     double m_max_bin_density = 0;
@@ -64,7 +66,8 @@ public:
     void update_bin_counts();
     QPointF coord2pix(QPointF pt, int W = 0, int H = 0);
     QPointF pix2coord(QPointF pt, int W = 0, int H = 0);
-    int get_bin_index_at(QPointF pt);
+    int get_bin_index_at(QPointF pt, int W = 0, int H = 0);
+    void request_repaint();
     void export_image();
     void do_paint(QPainter& painter, int W, int H);
 
@@ -93,6 +96,7 @@ HistogramView::~HistogramView()
 void HistogramView::setData(const QVector<double>& values)
 {
     d->m_data = values;
+    d->m_use_preset_bin_counts = false;
     d->m_update_required = true;
 }
 
@@ -102,6 +106,15 @@ void HistogramView::setSecondData(const QVector<double>& values)
     d->m_update_required = true;
 }
 
+void HistogramView::setBinCounts(const QVector<int>& counts)
+{
+    d->m_data.clear();
+    d->m_preset_bin_counts = counts;
+    d->m_use_preset_bin_counts = true;
+    d->m_update_required = true;
+    d->request_repaint();
+}
+
 void HistogramView::setBinInfo(double bin_min, double bin_max, int num_bins)
 {
     d->m_bin_info.bin_min = bin_min;
@@ -110,6 +123,11 @@ void HistogramView::setBinInfo(double bin_min, double bin_max, int num_bins)
     d->set_bins();
 }
 
+struct SharedBinEdges {
+    QVector<double> lefts;
+    QVector<double> rights;
+};
+
 void HistogramViewPrivate::set_bins()
 {
     double bin_min = m_bin_info.bin_min;
@@ -118,54 +136,75 @@ void HistogramViewPrivate::set_bins()
 
     int N = num_bins;
 
-    m_bin_lefts = QVector<double>(N);
-    m_bin_rights = QVector<double>(N);
-    m_bin_counts = QVector<int>(N);
-    m_bin_densities = QVector<double>(N);
-
-    m_second_bin_counts = QVector<int>(N);
-    m_second_bin_densities = QVector<double>(N);
+    //the counts are allocated when they are first needed, which is when the histogram is first drawn
+    m_bin_counts.clear();
+    m_bin_densities.clear();
+    m_second_bin_counts.clear();
+    m_second_bin_densities.clear();
 
-    if (N <= 2)
+    if (N <= 2) {
+        m_bin_lefts = QVector<double>(N);
+        m_bin_rights = QVector<double>(N);
         return;
-    double spacing = (transform1(bin_max) - transform1(bin_min)) / N;
-    for (int i = 0; i < N; i++) {
-        m_bin_lefts[i] = transform2(transform1(bin_min) + i * spacing);
-        m_bin_rights[i] = transform2(transform1(bin_min) + (i + 1) * spacing);
     }
 
+    //grids hold many histograms with the same bins, so the edges are computed once and shared (widgets live in the gui thread)
+    static QMap<QString, SharedBinEdges> shared_edges;
+    QString key = QString("%1:%2:%3:%4:%5").arg(bin_min, 0, 'g', 17).arg(bin_max, 0, 'g', 17).arg(N).arg((int)m_time_scale_mode).arg(m_time_constant, 0, 'g', 17);
+    if (!shared_edges.contains(key)) {
+        SharedBinEdges E;
+        E.lefts = QVector<double>(N);
+        E.rights = QVector<double>(N);
+        double spacing = (transform1(bin_max) - transform1(bin_min)) / N;
+        for (int i = 0; i < N; i++) {
+            E.lefts[i] = transform2(transform1(bin_min) + i * spacing);
+            E.rights[i] = transform2(transform1(bin_min) + (i + 1) * spacing);
+        }
+        if (shared_edges.count() > 100)
+            shared_edges.clear();
+        shared_edges[key] = E;
+    }
+    m_bin_lefts = shared_edges[key].lefts;
+    m_bin_rights = shared_edges[key].rights;
+
     m_update_required = true;
+    request_repaint();
+}
+
+void HistogramViewPrivate::request_repaint()
+{
     q->update();
+    emit q->repaintNeeded();
 }
 
 void HistogramView::setFillColor(const QColor& col)
 {
     d->m_fill_color = col;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setLineColor(const QColor& col)
 {
     d->m_line_color = col;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setTitle(const QString& title)
 {
     d->m_title = title;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setCaption(const QString& caption)
 {
     d->m_caption = caption;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setColors(const QMap<QString, QColor>& colors)
 {
     d->m_colors = colors;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setTimeScaleMode(HistogramView::TimeScaleMode mode)
@@ -196,7 +235,7 @@ void HistogramView::setXRange(MVRange range)
     if (range == d->m_xrange)
         return;
     d->m_xrange = range;
-    update();
+    d->request_repaint();
 }
 
 #include "mlcommon.h"
@@ -214,34 +253,65 @@ void HistogramView::setDrawVerticalAxisAtZero(bool val)
     if (d->m_draw_vertical_axis_at_zero == val)
         return;
     d->m_draw_vertical_axis_at_zero = val;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setVerticalLines(const QList<double>& vals)
 {
     d->m_vertical_lines = vals;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setTickMarks(const QList<double>& vals)
 {
     d->m_tick_marks = vals;
-    update();
+    d->request_repaint();
 }
 
 void HistogramView::setCurrent(bool val)
 {
     if (d->m_current != val) {
         d->m_current = val;
-        this->update();
+        d->request_repaint();
     }
 }
 void HistogramView::setSelected(bool val)
 {
     if (d->m_selected != val) {
         d->m_selected = val;
-        this->update();
+        d->request_repaint();
+    }
+}
+
+void HistogramView::paint(QPainter& painter, int W, int H)
+{
+    d->do_paint(painter, W, H);
+}
+
+void HistogramView::setHovered(bool val)
+{
+    if (d->m_hovered == val)
+        return;
+    d->m_hovered = val;
+    update();
+}
+
+void HistogramView::setHoveredBinIndex(int index)
+{
+    if (d->m_hovered_bin_index == index)
+        return;
+    d->m_hovered_bin_index = index;
+    update();
+}
+
+int HistogramView::binIndexAt(const QPointF& pos, int W, int H)
+{
+    if (d->m_update_required) {
+        //the vertical scale depends on the counts
+        d->update_bin_counts();
+        d->m_update_required = false;
     }
+    return d->get_bin_index_at(pos, W, H);
 }
 
 QImage HistogramView::renderImage(int W, int H)
@@ -371,15 +441,29 @@ void HistogramView::slot_context_menu(const QPoint& pos)
 void HistogramViewPrivate::update_bin_counts()
 {
     int num_bins = m_bin_lefts.count();
+    m_bin_counts.resize(num_bins);
+    m_second_bin_counts.resize(num_bins);
+    m_bin_densities.resize(num_bins);
+    m_second_bin_densities.resize(num_bins);
     for (int i = 0; i < num_bins; i++) {
         m_bin_counts[i] = 0;
         m_second_bin_counts[i] = 0;
         m_bin_densities[i] = 0;
         m_second_bin_densities[i] = 0;
     }
+    if (m_use_preset_bin_counts) {
+        if (m_preset_bin_counts.count() == num_bins) {
+            m_bin_counts = m_preset_bin_counts;
+        }
+        else {
+            qWarning() << "Unexpected number of preset bin counts in HistogramView" << m_preset_bin_counts.count() << num_bins;
+        }
+    }
     for (int pass = 1; pass <= 2; pass++) {
         QVector<double> list;
         if (pass == 1) {
+            if (m_use_preset_bin_counts)
+                continue;
             list = m_data;
         }
         else {
@@ -511,13 +595,13 @@ QPointF HistogramViewPrivate::pix2coord(QPointF pt, int W, int H)
     return QPointF(x0, y0);
 }
 
-int HistogramViewPrivate::get_bin_index_at(QPointF pt_pix)
+int HistogramViewPrivate::get_bin_index_at(QPointF pt_pix, int W, int H)
 {
     int num_bins = m_bin_lefts.count();
     if (num_bins < 2) {
         return -1;
     }
-    QPointF pt = pix2coord(pt_pix);
+    QPointF pt = pix2coord(pt_pix, W, H);
     for (int i = 0; i < num_bins; i++) {
         if ((pt.x() >= m_bin_lefts[i]) && (pt.x() <= m_bin_rights[i])) {
             //if ((0<=pt.y())&&(pt.y()<=m_bin_counts[i])) {
@@ -619,6 +703,30 @@ void HistogramViewPrivate::do_paint(QPainter& painter, int W, int H)
             line_color = modify_color_for_second_histogram2(m_line_color);
         }
 
+        if (num_bins > W - m_margin_left - m_margin_right) {
+            //more bins than pixels (a small cell of a big grid): one line per pixel column, at the tallest bin
+            int num_columns = qMax(0, W - m_margin_left - m_margin_right);
+            QVector<double> column_densities(num_columns, 0);
+            QVector<bool> column_used(num_columns, false);
+            for (int i = 0; i < num_bins; i++) {
+                double x0 = coord2pix(QPointF((m_bin_lefts[i] + m_bin_rights[i]) / 2, 0), W, H).x();
+                int column = (int)(x0 - m_margin_left);
+                if ((column >= 0) && (column < num_columns)) {
+                    column_densities[column] = qMax(column_densities[column], bin_densities[i]);
+                    column_used[column] = true;
+                }
+            }
+            painter.setPen(col);
+            double y0 = coord2pix(QPointF(0, 0), W, H).y();
+            for (int column = 0; column < num_columns; column++) {
+                if (column_used[column]) {
+                    double y1 = coord2pix(QPointF(0, column_densities[column]), W, H).y();
+                    painter.drawLine(QPointF(m_margin_left + column + 0.5, y0), QPointF(m_margin_left + column + 0.5, y1));
+                }
+            }
+            continue;
+        }
+
         for (int i = 0; i < num_bins; i++) {
             QPointF pt1 = coord2pix(QPointF(m_bin_lefts[i], 0), W, H);
             QPointF pt2 = coord2pix(QPointF(m_bin_rights[i], bin_densities[i]), W, H);
@@ -633,8 +741,8 @@ void HistogramViewPrivate::do_paint(QPainter& painter, int W, int H)
     }
 
     if (m_draw_vertical_axis_at_zero) {
-        QPointF pt0 = coord2pix(QPointF(0, 0));
-        QPointF pt1 = coord2pix(QPointF(0, m_max_bin_density));
+        QPointF pt0 = coord2pix(QPointF(0, 0), W, H);
+        QPointF pt1 = coord2pix(QPointF(0, m_max_bin_density), W, H);
         QPen pen = painter.pen();
         pen.setColor(Qt::black);
         pen.setStyle(Qt::SolidLine);
@@ -643,8 +751,8 @@ void HistogramViewPrivate::do_paint(QPainter& painter, int W, int H)
     }
 
     foreach (double val, m_vertical_lines) {
-        QPointF pt0 = coord2pix(QPointF(val, 0));
-        QPointF pt1 = coord2pix(QPointF(val, m_max_bin_density));
+        QPointF pt0 = coord2pix(QPointF(val, 0), W, H);
+        QPointF pt1 = coord2pix(QPointF(val, m_max_bin_density), W, H);
         QPen pen = painter.pen();
         pen.setColor(Qt::gray);
         pen.setStyle(Qt::DashLine);
@@ -653,7 +761,7 @@ void HistogramViewPrivate::do_paint(QPainter& painter, int W, int H)
     }
 
     foreach (double val, m_tick_marks) {
-        QPointF pt0 = coord2pix(QPointF(val, 0));
+        QPointF pt0 = coord2pix(QPointF(val, 0), W, H);
         QPointF pt1 = pt0;
         pt1.setY(pt1.y() + 5);
         QPen pen = painter.pen();
@@ -41,6 +41,7 @@ public:
 
     void setData(const QVector<double>& values); // The data to view
     void setSecondData(const QVector<double>& values);
+    void setBinCounts(const QVector<int>& counts); // Already-binned data, one count per bin of setBinInfo (use instead of setData)
     void setBinInfo(double bin_min, double bin_max, int num_bins); //Set evenly spaced bins
     void setFillColor(const QColor& col); // The color for filling the histogram bars
     void setLineColor(const QColor& col); // The edge color for the bars
@@ -60,6 +61,12 @@ public:
     void setCurrent(bool val); // Set this as the current histogram (affects highlighting)
     void setSelected(bool val); // Set this as among the selected histograms (affects highlighting)
 
+    // For a grid that draws the histogram itself rather than showing the widget
+    void paint(QPainter& painter, int W, int H);
+    void setHovered(bool val);
+    void setHoveredBinIndex(int index);
+    int binIndexAt(const QPointF& pos, int W, int H); // -1 if none
+
     QImage renderImage(int W, int H) Q_DECL_OVERRIDE;
 
 protected:
@@ -75,6 +82,7 @@ signals:
     void activated(const QPoint&);
 
     void signalExportHistogramMatrixImage();
+    void repaintNeeded(); // something that affects the appearance has changed
 
 private slots:
     void slot_context_menu(const QPoint& pos);
@@ -37,7 +37,8 @@ class MVAmpHistView3Computer {
 public:
     //input
     QString mlproxy_url;
-    QString firings;
+    QSharedPointer<ProcessResultStore> result_store;
+    FiringsTable firings;
     QString timeseries;
     MVAmpHistView3::AmplitudeMode amplitude_mode;
 
@@ -133,7 +134,8 @@ void MVAmpHistView3::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_computer.mlproxy_url = c->mlProxyUrl();
-    d->m_computer.firings = c->firings().makePath();
+    d->m_computer.result_store = c->resultStore();
+    d->m_computer.firings = c->firingsTable();
     d->m_computer.timeseries = c->currentTimeseries().makePath();
     d->m_computer.amplitude_mode = d->m_amplitude_mode;
 }
@@ -269,7 +271,7 @@ void MVAmpHistView3::slot_current_cluster_changed()
     }
 }
 
-DiskReadMda compute_amplitudes(QString timeseries, QString firings, QString mlproxy_url)
+DiskReadMda compute_amplitudes(QString timeseries, QString firings, QString mlproxy_url, ProcessResultStore* result_store)
 {
     MountainProcessRunner X;
     QString processor_name = "mv.mv_compute_amplitudes";
@@ -280,6 +282,7 @@ DiskReadMda compute_amplitudes(QString timeseries, QString firings, QString mlpr
     params["firings"] = firings;
     X.setInputParameters(params);
     X.setMLProxyUrl(mlproxy_url);
+    X.setResultStore(result_store);
 
     QString firings_out_fname = X.makeOutputFilePath("firings_out");
 
@@ -294,41 +297,28 @@ void MVAmpHistView3Computer::compute()
 
     histograms.clear();
 
-    DiskReadMda firings2;
+    FiringsTable firings2;
     if (amplitude_mode == MVAmpHistView3::ComputeAmplitudes) {
-        firings2 = compute_amplitudes(timeseries, firings, mlproxy_url);
+        firings2 = FiringsTable(compute_amplitudes(timeseries, firings.firings().makePath(), mlproxy_url, result_store.data()));
     }
     else {
-        firings2 = DiskReadMda(firings);
+        firings2 = firings;
     }
 
-    QVector<int> labels;
-    //QVector<double> amplitudes;
-    int L = firings2.N2();
-
     task.setProgress(0.2);
-    for (int n = 0; n < L; n++) {
-        labels << (int)firings2.value(2, n);
-    }
-
-    int K = MLCompute::max<int>(labels);
+    int K = firings2.K();
 
     //assemble the histograms index 0 <--> k=1
     for (int k = 1; k <= K; k++) {
         AmpHistogram3 HH;
         HH.k = k;
+        if (firings2.hasAmplitudes())
+            HH.data = firings2.amplitudesForLabel(k);
+        else
+            HH.data = QVector<double>(firings2.labelCount(k), 0);
         this->histograms << HH;
     }
 
-    int row = 3; //for amplitudes
-    for (int n = 0; n < L; n++) {
-        int label0 = (int)firings2.value(2, n);
-        double amp0 = firings2.value(row, n);
-        if ((label0 >= 1) && (label0 <= K)) {
-            this->histograms[label0 - 1].data << amp0;
-        }
-    }
-
     for (int i = 0; i < histograms.count(); i++) {
         if (histograms[i].data.count() == 0) {
             histograms.removeAt(i);
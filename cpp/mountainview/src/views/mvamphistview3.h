@@ -67,6 +67,7 @@ public:
 private slots:
 };
 
-DiskReadMda compute_amplitudes(QString timeseries, QString firings, QString mlproxy_url);
+class ProcessResultStore;
+DiskReadMda compute_amplitudes(QString timeseries, QString firings, QString mlproxy_url, ProcessResultStore* result_store = 0);
 
 #endif // MVAMPHISTVIEW3_H
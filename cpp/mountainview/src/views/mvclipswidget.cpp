@@ -37,6 +37,7 @@ public:
     DiskReadMda firings;
     DiskReadMda32 timeseries;
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     int clip_size;
     QList<int> labels_to_use;
 
@@ -102,6 +103,7 @@ void MVClipsWidget::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_computer.mlproxy_url = c->mlProxyUrl();
+    d->m_computer.result_store = c->resultStore();
     d->m_computer.firings = c->firings();
     d->m_computer.timeseries = c->currentTimeseries();
     d->m_computer.labels_to_use = d->m_labels_to_use;
@@ -174,6 +176,7 @@ void MVClipsWidgetComputer::compute()
         MT.setInputParameters(params);
         //MT.setMscmdServerUrl(mscmdserver_url);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         firings_out_path = MT.makeOutputFilePath("firings_out");
 
@@ -197,6 +200,7 @@ void MVClipsWidgetComputer::compute()
         MT.setInputParameters(params);
         //MT.setMscmdServerUrl(mscmdserver_url);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         clips_path = MT.makeOutputFilePath("clips_out");
 
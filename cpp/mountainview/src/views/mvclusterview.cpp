@@ -28,16 +28,28 @@
 #include "mlcommon.h"
 #include "mvcontext.h"
 #include <QMenu>
+#include <QThread>
+#include <QtConcurrentRun>
+
+#define MVCV_INTERACTIVE_MAX_POINTS 50000 //while the view is being dragged, only a subsample of this many points is drawn
+#define MVCV_REFINE_DELAY_MSEC 150 //once the view has been still for this long, all the points are drawn again
+#define MVCV_BANDS_PER_THREAD 2
 
 class MVClusterViewPrivate : public QObject {
     Q_OBJECT
 public:
     MVClusterView* q;
     Mda m_data;
-    Mda m_data_proj;
+    //the first three features, one array per coordinate, stored in the order given by m_order
+    QVector<float> m_proj_x, m_proj_y, m_proj_z;
+    QVector<int> m_order; //position -> event index. The first positions form an evenly spread subsample
+    double m_max_abs_val;
     bool m_data_proj_needed;
-    Mda m_data_trans;
+    QVector<float> m_trans_x, m_trans_y, m_trans_z; //same order as m_proj_x etc
+    int m_num_trans; //number of positions that have been transformed
     bool m_data_trans_needed;
+    bool m_interacting;
+    QTimer m_refine_timer;
     int m_current_event_index;
     int m_mode;
     //FilterInfo m_filter_info;
@@ -71,8 +83,11 @@ public:
     AffineTransformation m_transformation; //3x4
 
     void compute_data_proj();
-    void compute_data_trans();
+    void compute_data_trans(int num_points);
+    void ensure_data_trans();
+    void start_interaction();
     void update_grid();
+    void splat_points(int row1, int row2, const QVector<int>& cells, const QVector<float>& zs, const QVector<int>& inds);
     void coord2gridindex(double x0, double y0, double& i1, double& i2);
     QPointF gridindex2coord(double& x0, double& y0, double i1, double i2);
     QPointF pixel2coord(QPointF pix);
@@ -85,6 +100,7 @@ public:
     void export_image();
 public slots:
     void slot_emit_transformation_changed();
+    void slot_refine();
 };
 #include "mvclusterview.moc"
 
@@ -112,6 +128,12 @@ MVClusterView::MVClusterView(MVAbstractContext* context, QWidget* parent)
     d->m_emit_transformation_changed_scheduled = false;
     d->m_max_time = 1;
     d->m_max_amplitude = 1;
+    d->m_max_abs_val = 0;
+    d->m_num_trans = 0;
+    d->m_interacting = false;
+    d->m_refine_timer.setSingleShot(true);
+    d->m_refine_timer.setInterval(MVCV_REFINE_DELAY_MSEC);
+    connect(&d->m_refine_timer, SIGNAL(timeout()), d, SLOT(slot_refine()));
     this->setMouseTracking(true);
 
     d->m_legend.setClusterColors(c->clusterColors());
@@ -336,6 +358,7 @@ void MVClusterView::mouseMoveEvent(QMouseEvent* evt)
                 d->m_transformation.rotateY(deg_x * M_PI / 180);
                 d->m_transformation.rotateX(deg_y * M_PI / 180);
                 d->schedule_emit_transformation_changed();
+                d->start_interaction();
                 d->m_data_trans_needed = true;
                 d->m_grid_update_needed = true;
                 update();
@@ -349,6 +372,7 @@ void MVClusterView::mouseMoveEvent(QMouseEvent* evt)
                 d->m_transformation = d->m_anchor_transformation;
                 d->m_transformation.translate(xx, yy, 0, true);
                 d->schedule_emit_transformation_changed();
+                d->start_interaction();
                 d->m_data_trans_needed = true;
                 d->m_grid_update_needed = true;
                 update();
@@ -435,6 +459,7 @@ void MVClusterView::scaleView(double factor)
     d->m_data_trans_needed = true;
     d->m_grid_update_needed = true;
     d->schedule_emit_transformation_changed();
+    d->start_interaction();
     update();
 }
 
@@ -450,34 +475,100 @@ void MVClusterViewPrivate::slot_emit_transformation_changed()
     emit q->transformationChanged();
 }
 
+void MVClusterViewPrivate::slot_refine()
+{
+    m_interacting = false;
+    if (m_num_trans < m_order.count()) {
+        m_grid_update_needed = true;
+        q->update();
+    }
+}
+
+void MVClusterViewPrivate::start_interaction()
+{
+    m_interacting = true;
+    m_refine_timer.start();
+}
+
 void MVClusterViewPrivate::compute_data_proj()
 {
-    if (m_data.N2() <= 1)
+    m_proj_x.clear();
+    m_proj_y.clear();
+    m_proj_z.clear();
+    m_order.clear();
+    m_max_abs_val = 0;
+    if ((m_data.N2() <= 1) || (m_data.N1() < 3))
         return;
-    m_data_proj.allocate(3, m_data.N2());
-    for (int i = 0; i < m_data.N2(); i++) {
-        m_data_proj.setValue(m_data.value(0, i), 0, i);
-        m_data_proj.setValue(m_data.value(1, i), 1, i);
-        m_data_proj.setValue(m_data.value(2, i), 2, i);
+    int N = m_data.N2();
+    int M = m_data.N1();
+
+    //the evenly spread subsample goes first, so that drawing only the first positions gives a faithful preview
+    m_order.reserve(N);
+    int stride = qMax(1, (N + MVCV_INTERACTIVE_MAX_POINTS - 1) / MVCV_INTERACTIVE_MAX_POINTS);
+    for (int i = 0; i < N; i += stride) {
+        m_order << i;
+    }
+    if (stride > 1) {
+        for (int i = 0; i < N; i++) {
+            if (i % stride)
+                m_order << i;
+        }
+    }
+
+    m_proj_x.resize(N);
+    m_proj_y.resize(N);
+    m_proj_z.resize(N);
+    const double* ptr = m_data.constDataPtr();
+    for (int p = 0; p < N; p++) {
+        const double* col = &ptr[M * m_order[p]];
+        m_proj_x[p] = col[0];
+        m_proj_y[p] = col[1];
+        m_proj_z[p] = col[2];
+    }
+    bigint NN = m_data.totalSize();
+    for (bigint i = 0; i < NN; i++) {
+        m_max_abs_val = qMax(m_max_abs_val, fabs(ptr[i]));
     }
 }
 
-void MVClusterViewPrivate::compute_data_trans()
+void MVClusterViewPrivate::compute_data_trans(int num_points)
 {
-    int N2 = m_data_proj.N2();
-    m_data_trans.allocate(3, N2);
-    if (m_data_proj.N1() != 3)
-        return; //prevents a crash when data hasn't been set, which is always a good thing
-    double* AA = m_data_proj.dataPtr();
-    double* BB = m_data_trans.dataPtr();
+    int N = m_order.count();
+    m_trans_x.resize(N);
+    m_trans_y.resize(N);
+    m_trans_z.resize(N);
+    m_num_trans = qMin(num_points, N);
+
     double MM[16];
     m_transformation.getMatrixData(MM);
-    int aaa = 0;
-    for (int i = 0; i < N2; i++) {
-        BB[aaa + 0] = AA[aaa + 0] * MM[0] + AA[aaa + 1] * MM[1] + AA[aaa + 2] * MM[2] + MM[3];
-        BB[aaa + 1] = AA[aaa + 0] * MM[4] + AA[aaa + 1] * MM[5] + AA[aaa + 2] * MM[6] + MM[7];
-        BB[aaa + 2] = AA[aaa + 0] * MM[8] + AA[aaa + 1] * MM[9] + AA[aaa + 2] * MM[10] + MM[11];
-        aaa += 3;
+    float M0 = MM[0], M1 = MM[1], M2 = MM[2], M3 = MM[3];
+    float M4 = MM[4], M5 = MM[5], M6 = MM[6], M7 = MM[7];
+    float M8 = MM[8], M9 = MM[9], M10 = MM[10], M11 = MM[11];
+    //one array per coordinate, so the compiler can vectorize this
+    const float* AX = m_proj_x.constData();
+    const float* AY = m_proj_y.constData();
+    const float* AZ = m_proj_z.constData();
+    float* BX = m_trans_x.data();
+    float* BY = m_trans_y.data();
+    float* BZ = m_trans_z.data();
+    int num = m_num_trans;
+    for (int p = 0; p < num; p++) {
+        BX[p] = AX[p] * M0 + AY[p] * M1 + AZ[p] * M2 + M3;
+        BY[p] = AX[p] * M4 + AY[p] * M5 + AZ[p] * M6 + M7;
+        BZ[p] = AX[p] * M8 + AY[p] * M9 + AZ[p] * M10 + M11;
+    }
+}
+
+void MVClusterViewPrivate::ensure_data_trans()
+{
+    if (m_data_proj_needed) {
+        compute_data_proj();
+        m_data_proj_needed = false;
+        m_data_trans_needed = true;
+    }
+    if ((m_data_trans_needed) || (m_num_trans < m_order.count())) {
+        compute_data_trans(m_order.count());
+        m_data_trans_needed = false;
     }
 }
 
@@ -506,79 +597,78 @@ void MVClusterViewPrivate::update_grid()
     if (m_data_proj_needed) {
         compute_data_proj();
         m_data_proj_needed = false;
+        m_data_trans_needed = true;
     }
-    if (m_data_trans_needed) {
-        compute_data_trans();
+    //while dragging, only the leading subsample is transformed and drawn
+    int num_points = m_order.count();
+    if (m_interacting)
+        num_points = qMin(num_points, MVCV_INTERACTIVE_MAX_POINTS);
+    if ((m_data_trans_needed) || (m_num_trans < num_points)) {
+        compute_data_trans(num_points);
         m_data_trans_needed = false;
     }
     int kernel_rad = 10;
-    double kernel_tau = 3;
-    double kernel[(kernel_rad * 2 + 1) * (kernel_rad * 2 + 1)];
-    {
-        int aa = 0;
-        for (int dy = -kernel_rad; dy <= kernel_rad; dy++) {
-            for (int dx = -kernel_rad; dx <= kernel_rad; dx++) {
-                kernel[aa] = exp(-0.5 * (dx * dx + dy * dy) / (kernel_tau * kernel_tau));
-                aa++;
-            }
-        }
-    }
     int N1 = m_grid_N1, N2 = m_grid_N2;
 
     m_point_grid.allocate(N1, N2);
     for (int i = 0; i < N1 * N2; i++)
         m_point_grid.set(-1, i);
-    double* m_point_grid_ptr = m_point_grid.dataPtr();
 
     if (m_mode == MVCV_MODE_TIME_COLORS) {
         m_time_grid.allocate(N1, N2);
         for (int i = 0; i < N1 * N2; i++)
             m_time_grid.set(-1, i);
     }
-    double* m_time_grid_ptr = m_time_grid.dataPtr();
 
     if (m_mode == MVCV_MODE_AMPLITUDE_COLORS) {
         m_amplitude_grid.allocate(N1, N2);
         for (int i = 0; i < N1 * N2; i++)
             m_amplitude_grid.set(0, i);
     }
-    double* m_amplitude_grid_ptr = m_amplitude_grid.dataPtr();
 
     if (m_mode == MVCV_MODE_HEAT_DENSITY) {
         m_heat_map_grid.allocate(N1, N2);
     }
-    double* m_heat_map_grid_ptr = m_heat_map_grid.dataPtr();
 
-    Mda z_grid;
-    if (m_mode != MVCV_MODE_HEAT_DENSITY) {
-        z_grid.allocate(N1, N2);
-    }
-    double* z_grid_ptr = z_grid.dataPtr();
-
-    double max_abs_val = 0;
-    int NN = m_data.totalSize();
-    for (int i = 0; i < NN; i++) {
-        const double cur_abs_val = fabs(m_data.get(i));
-        if (cur_abs_val > max_abs_val)
-            max_abs_val = cur_abs_val;
-    }
-
-    QVector<double> x0s, y0s, z0s;
-    QVector<int> label0s;
-    QVector<double> time0s;
-    QVector<double> amp0s;
-    for (int j = 0; j < m_data_trans.N2(); j++) {
-        int label0 = m_labels.value(j);
-        if (active_cluster_numbers.contains(label0)) {
-            double x0 = m_data_trans.value(0, j);
-            double y0 = m_data_trans.value(1, j);
-            double z0 = m_data_trans.value(2, j);
-            x0s << x0;
-            y0s << y0;
-            z0s << z0;
-            label0s << m_labels.value(j);
-            time0s << m_times.value(j);
-            amp0s << m_amplitudes.value(j);
+    double max_abs_val = m_max_abs_val;
+
+    int max_label = 0;
+    foreach (int k, active_cluster_numbers) {
+        max_label = qMax(max_label, k);
+    }
+    QVector<bool> is_active(max_label + 1, false);
+    foreach (int k, active_cluster_numbers) {
+        if (k >= 0)
+            is_active[k] = true;
+    }
+
+    //grid cell, depth and event index (-1 for the axes) of every point whose kernel fits in the grid
+    QVector<int> cells, inds;
+    QVector<float> zs;
+    cells.reserve(num_points);
+    inds.reserve(num_points);
+    zs.reserve(num_points);
+    {
+        int N1mid = (N1 + 1) / 2 - 1;
+        int N2mid = (N2 + 1) / 2 - 1;
+        float delta1 = 2.0 / N1;
+        float delta2 = 2.0 / N2;
+        const float* X = m_trans_x.constData();
+        const float* Y = m_trans_y.constData();
+        const float* Z = m_trans_z.constData();
+        for (int p = 0; p < num_points; p++) {
+            int ind = m_order[p];
+            int label0 = m_labels.value(ind);
+            bool active = ((label0 >= 0) && (label0 <= max_label)) ? is_active[label0] : active_cluster_numbers.contains(label0);
+            if (!active)
+                continue;
+            int ii1 = (int)(N1mid + X[p] / delta1 + 0.5);
+            int ii2 = (int)(N2mid + Y[p] / delta2 + 0.5);
+            if ((ii1 - kernel_rad >= 0) && (ii1 + kernel_rad < N1) && (ii2 - kernel_rad >= 0) && (ii2 + kernel_rad < N2)) {
+                cells << ii1 + N1 * ii2;
+                zs << Z[p];
+                inds << ind;
+            }
         }
     }
 
@@ -587,105 +677,36 @@ void MVClusterViewPrivate::update_grid()
         double factor = 1.2;
         if (max_abs_val) {
             for (double aa = -max_abs_val * factor; aa <= max_abs_val * factor; aa += max_abs_val * factor / 50) {
-                {
-                    Point3D pt1 = Point3D(aa, 0, 0);
+                for (int pass = 1; pass <= 3; pass++) {
+                    Point3D pt1 = Point3D((pass == 1) ? aa : 0, (pass == 2) ? aa : 0, (pass == 3) ? aa : 0);
                     Point3D pt2 = m_transformation.map(pt1);
-                    x0s << pt2.x;
-                    y0s << pt2.y;
-                    z0s << pt2.z;
-                    label0s << -2;
-                    time0s << -1;
-                    amp0s << 0;
-                }
-                {
-                    Point3D pt1 = Point3D(0, aa, 0);
-                    Point3D pt2 = m_transformation.map(pt1);
-                    x0s << pt2.x;
-                    y0s << pt2.y;
-                    z0s << pt2.z;
-                    label0s << -2;
-                    time0s << -1;
-                    amp0s << 0;
-                }
-                {
-                    Point3D pt1 = Point3D(0, 0, aa);
-                    Point3D pt2 = m_transformation.map(pt1);
-                    x0s << pt2.x;
-                    y0s << pt2.y;
-                    z0s << pt2.z;
-                    label0s << -2;
-                    time0s << -1;
-                    amp0s << 0;
+                    double i1, i2;
+                    coord2gridindex(pt2.x, pt2.y, i1, i2);
+                    int ii1 = (int)(i1 + 0.5);
+                    int ii2 = (int)(i2 + 0.5);
+                    if ((ii1 - kernel_rad >= 0) && (ii1 + kernel_rad < N1) && (ii2 - kernel_rad >= 0) && (ii2 + kernel_rad < N2)) {
+                        cells << ii1 + N1 * ii2;
+                        zs << pt2.z;
+                        inds << -1;
+                    }
                 }
             }
         }
     }
-    for (int i = 0; i < x0s.count(); i++) {
-        double x0 = x0s[i], y0 = y0s[i], z0 = z0s[i];
-        int label0 = label0s[i];
-        double time0 = time0s[i];
-        double amp0 = amp0s[i];
-        double factor = 1;
-        //if (m_data_trans.value(2,j)>0) {
-        //factor=0.2;
-        //}
-        double i1, i2;
-        coord2gridindex(x0, y0, i1, i2);
-        int ii1 = (int)(i1 + 0.5);
-        int ii2 = (int)(i2 + 0.5);
-        if ((ii1 - kernel_rad >= 0) && (ii1 + kernel_rad < N1) && (ii2 - kernel_rad >= 0) && (ii2 + kernel_rad < N2)) {
-            int iiii = ii1 + N1 * ii2;
-            if (m_mode != MVCV_MODE_HEAT_DENSITY) {
-                if ((m_point_grid_ptr[iiii] == -1) || (z_grid_ptr[iiii] > z0)) {
-                    /*
-                    if (m_filter_info.use_filter) {
-                        if (exclude_based_on_filter(i)) {
-                            m_point_grid_ptr[iiii] = -3; //means we are excluding due to filter
-                        }
-                        else {
-                            m_point_grid_ptr[iiii] = label0;
-                        }
-                    }
-                    else {
-                        m_point_grid_ptr[iiii] = label0;
-                    }
-                    */
-
-                    m_point_grid_ptr[iiii] = label0;
-
-                    if (m_mode == MVCV_MODE_TIME_COLORS) {
-                        m_time_grid_ptr[iiii] = time0;
-                    }
-                    if (m_mode == MVCV_MODE_AMPLITUDE_COLORS) {
-                        m_amplitude_grid_ptr[iiii] = amp0;
-                    }
-                    z_grid_ptr[iiii] = z0;
-                }
-            }
-            else {
-                m_point_grid_ptr[iiii] = 1;
-                /*
-                if (m_mode == MVCV_MODE_TIME_COLORS) {
-                    m_time_grid_ptr[iiii] = time0;
-                }
-                if (m_mode == MVCV_MODE_AMPLITUDE_COLORS) {
-                    m_amplitude_grid_ptr[iiii] = amp0;
-                }
-                */
-            }
 
-            if (m_mode == MVCV_MODE_HEAT_DENSITY) {
-                int aa = 0;
-                for (int dy = -kernel_rad; dy <= kernel_rad; dy++) {
-                    int ii2b = ii2 + dy;
-                    for (int dx = -kernel_rad; dx <= kernel_rad; dx++) {
-                        int ii1b = ii1 + dx;
-                        m_heat_map_grid_ptr[ii1b + N1 * ii2b] += kernel[aa] * factor;
-                        aa++;
-                    }
-                }
-            }
-        }
+    //Each band of rows is splatted by its own thread. Every band visits the points in the same order,
+    //so the result does not depend on the number of threads
+    int num_bands = qMax(1, MVCV_BANDS_PER_THREAD * QThread::idealThreadCount());
+    int band_height = qMax(1, (N2 + num_bands - 1) / num_bands);
+    QList<QFuture<void> > futures;
+    for (int row1 = 0; row1 < N2; row1 += band_height) {
+        int row2 = qMin(N2, row1 + band_height);
+        futures << QtConcurrent::run([this, row1, row2, &cells, &zs, &inds]() {
+            splat_points(row1, row2, cells, zs, inds);
+        });
+    }
+    for (int b = 0; b < futures.count(); b++) {
+        futures[b].waitForFinished();
     }
 
     m_grid_image = QImage(N1, N2, QImage::Format_ARGB32);
@@ -806,6 +827,74 @@ void MVClusterViewPrivate::coord2gridindex(double x0, double y0, double& i1, dou
     i2 = N2mid + y0 / delta2;
 }
 
+/*!
+ * \brief MVClusterViewPrivate::splat_points draws the points into the grid rows row1..row2-1
+ *
+ * In the heat density mode, a point contributes its kernel to every row of the band within reach.
+ * Otherwise the nearest point (smallest z) of each cell wins, the earlier one in case of a tie.
+ */
+void MVClusterViewPrivate::splat_points(int row1, int row2, const QVector<int>& cells, const QVector<float>& zs, const QVector<int>& inds)
+{
+    int kernel_rad = 10;
+    double kernel_tau = 3;
+    double kernel[(kernel_rad * 2 + 1) * (kernel_rad * 2 + 1)];
+    {
+        int aa = 0;
+        for (int dy = -kernel_rad; dy <= kernel_rad; dy++) {
+            for (int dx = -kernel_rad; dx <= kernel_rad; dx++) {
+                kernel[aa] = exp(-0.5 * (dx * dx + dy * dy) / (kernel_tau * kernel_tau));
+                aa++;
+            }
+        }
+    }
+    int N1 = m_grid_N1;
+    double* m_point_grid_ptr = m_point_grid.dataPtr();
+    double* m_time_grid_ptr = m_time_grid.dataPtr();
+    double* m_amplitude_grid_ptr = m_amplitude_grid.dataPtr();
+    double* m_heat_map_grid_ptr = m_heat_map_grid.dataPtr();
+
+    if (m_mode == MVCV_MODE_HEAT_DENSITY) {
+        for (int i = 0; i < cells.count(); i++) {
+            int ii1 = cells[i] % N1;
+            int ii2 = cells[i] / N1;
+            if ((ii2 + kernel_rad < row1) || (ii2 - kernel_rad >= row2))
+                continue;
+            if ((ii2 >= row1) && (ii2 < row2))
+                m_point_grid_ptr[cells[i]] = 1;
+            int dy1 = qMax(-kernel_rad, row1 - ii2);
+            int dy2 = qMin(kernel_rad, row2 - 1 - ii2);
+            for (int dy = dy1; dy <= dy2; dy++) {
+                const double* kernel_row = &kernel[(dy + kernel_rad) * (kernel_rad * 2 + 1) + kernel_rad];
+                double* grid_row = &m_heat_map_grid_ptr[ii1 + N1 * (ii2 + dy)];
+                for (int dx = -kernel_rad; dx <= kernel_rad; dx++) {
+                    grid_row[dx] += kernel_row[dx];
+                }
+            }
+        }
+        return;
+    }
+
+    QVector<float> z_grid(N1 * (row2 - row1));
+    int offset = N1 * row1;
+    for (int i = 0; i < cells.count(); i++) {
+        int iiii = cells[i];
+        if ((iiii < offset) || (iiii >= N1 * row2))
+            continue;
+        float z0 = zs[i];
+        if ((m_point_grid_ptr[iiii] == -1) || (z_grid[iiii - offset] > z0)) {
+            int ind = inds[i];
+            m_point_grid_ptr[iiii] = (ind >= 0) ? m_labels.value(ind) : -2;
+            if (m_mode == MVCV_MODE_TIME_COLORS) {
+                m_time_grid_ptr[iiii] = (ind >= 0) ? m_times.value(ind) : -1;
+            }
+            if (m_mode == MVCV_MODE_AMPLITUDE_COLORS) {
+                m_amplitude_grid_ptr[iiii] = (ind >= 0) ? m_amplitudes.value(ind) : 0;
+            }
+            z_grid[iiii - offset] = z0;
+        }
+    }
+}
+
 QPointF MVClusterViewPrivate::gridindex2coord(double& x0, double& y0, double i1, double i2)
 {
     int N1 = m_grid_N1;
@@ -870,16 +959,20 @@ QColor MVClusterViewPrivate::get_time_color(double pct)
 
 int MVClusterViewPrivate::find_closest_event_index(double x, double y, const QSet<int>& inds_to_exclude)
 {
+    ensure_data_trans();
     double best_distsqr = 0;
     int best_ind = 0;
-    for (int i = 0; i < m_data_trans.N2(); i++) {
+    bool found = false;
+    for (int p = 0; p < m_order.count(); p++) {
+        int i = m_order[p];
         if (!inds_to_exclude.contains(i)) {
-            double distx = m_data_trans.value(0, i) - x;
-            double disty = m_data_trans.value(1, i) - y;
+            double distx = m_trans_x[p] - x;
+            double disty = m_trans_y[p] - y;
             double distsqr = distx * distx + disty * disty;
-            if ((distsqr < best_distsqr) || (i == 0)) {
+            if ((distsqr < best_distsqr) || ((distsqr == best_distsqr) && (i < best_ind)) || (!found)) {
                 best_distsqr = distsqr;
                 best_ind = i;
+                found = true;
             }
         }
     }
@@ -920,10 +1013,11 @@ void MVClusterViewPrivate::do_paint(QPainter& painter, int W, int H)
     //painter.setPen(pen);
     //painter.drawRect(target);
 
-    if (m_current_event_index >= 0) {
-        double x = m_data_trans.value(0, m_current_event_index);
-        double y = m_data_trans.value(1, m_current_event_index);
-        QPointF pix = coord2pixel(QPointF(x, y));
+    if ((m_current_event_index >= 0) && (m_current_event_index < m_data.N2()) && (m_data.N1() >= 3)) {
+        //mapped directly, since only a subsample may have been transformed while dragging
+        Point3D pt = Point3D(m_data.value(0, m_current_event_index), m_data.value(1, m_current_event_index), m_data.value(2, m_current_event_index));
+        Point3D pt2 = m_transformation.map(pt);
+        QPointF pix = coord2pixel(QPointF(pt2.x, pt2.y));
         painter.setBrush(QBrush(Qt::darkGreen));
         painter.drawEllipse(pix, 6, 6);
     }
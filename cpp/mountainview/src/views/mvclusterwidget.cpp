@@ -39,6 +39,7 @@ class MVClusterWidgetComputer {
 public:
     //input
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     DiskReadMda32 timeseries;
     DiskReadMda firings;
     int clip_size;
@@ -245,6 +246,7 @@ void MVClusterWidget::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_computer.mlproxy_url = c->mlProxyUrl();
+    d->m_computer.result_store = c->resultStore();
     d->m_computer.timeseries = c->currentTimeseries();
     d->m_computer.firings = c->firings();
     d->m_computer.clip_size = c->option("clip_size").toInt();
@@ -522,6 +524,7 @@ void MVClusterWidgetComputer::compute()
         MT.setInputParameters(params);
         //MT.setMscmdServerUrl(mscmdserver_url);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         firings_out_path = MT.makeOutputFilePath("firings_out");
 
@@ -547,6 +550,7 @@ void MVClusterWidgetComputer::compute()
         MT.setInputParameters(params);
         //MT.setMscmdServerUrl(mscmdserver_url);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         features_path = MT.makeOutputFilePath("features_out");
 
@@ -572,6 +576,7 @@ void MVClusterWidgetComputer::compute()
         params["channels"] = channels_strlist.join(",");
         MT.setInputParameters(params);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         features_path = MT.makeOutputFilePath("values");
 
@@ -586,16 +591,14 @@ void MVClusterWidgetComputer::compute()
         err.error("Unrecognized features mode: " + features_mode);
         return;
     }
-    DiskReadMda F(firings_out_path);
+    FiringsTable F(DiskReadMda(firings_out_path));
 
-    times.clear();
-    labels.clear();
-    amplitudes.clear();
-    for (int j = 0; j < F.N2(); j++) {
-        times << F.value(1, j);
-        labels << (int)F.value(2, j);
-        amplitudes << F.value(3, j);
-    }
+    times = F.times();
+    labels = F.labels();
+    if (F.hasAmplitudes())
+        amplitudes = F.amplitudes();
+    else
+        amplitudes.fill(0, F.count());
 
     if (MLUtil::threadInterruptRequested()) {
         return;
@@ -33,31 +33,64 @@
 #include "mvmisc.h"
 #include <QFileDialog>
 #include <QJsonDocument>
+#include <QMutex>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#define CC_PROGRESS_INTERVAL_MSEC 300
+
+//The bins of the correlograms, in timepoints. In log mode the bins are evenly spaced in the same
+//pseudo-log time scale as HistogramView::Log, so that the counts line up with the displayed bars
+struct CorrelogramBinning {
+    double bin_min = 0, bin_max = 0;
+    int num_bins = 0;
+    bool log_time_scale = false;
+    double time_constant = 30;
+
+    double transform(double t) const;
+    int binIndex(double dt) const; //-1 if outside of the bins
+    QJsonObject toJsonObject() const;
+    void fromJsonObject(const QJsonObject& X);
+};
 
 struct Correlogram3 {
     int k1 = 0, k2 = 0;
-    QVector<double> data;
+    QVector<int> counts;
+    bigint total_count = 0;
+    QVector<double> legacy_data; //raw time differences from static views saved by older versions
 };
 
-QVector<double> compute_cc_data3(const QVector<double>& times1_in, const QVector<double>& times2_in, int max_dt, bool exclude_matches, double max_est_data_size);
+//times1 and times2 must be sorted, and counts must hold binning.num_bins zeros
+void compute_cc_counts3(int* counts, bigint& total_count, const QVector<double>& times1, const QVector<double>& times2, int max_dt, bool exclude_matches, const CorrelogramBinning& binning);
 
 class MVCrossCorrelogramsWidget3Computer {
 public:
     //input
     QString mlproxy_url;
-    DiskReadMda firings;
+    FiringsTable firings;
     CrossCorrelogramOptions3 options;
     int max_dt;
     ClusterMerge cluster_merge;
     int pair_mode = false;
-    double max_est_data_size = 0;
+    CorrelogramBinning binning;
 
     //output
     QList<Correlogram3> correlograms;
 
     void compute();
 
+    //progressive output, polled by the gui thread while compute() is running.
+    //progress_correlograms is set once the pairs are assembled, and the counts of
+    //each are filled in as they finish
+    QMutex progress_mutex;
+    QList<Correlogram3> progress_correlograms;
+    QList<int> progress_finished_indices; //not yet taken by the gui thread
+    bool progress_pairs_taken = false;
+
     bool loaded_from_static_output = false;
+    CorrelogramBinning static_binning; //the binning of the loaded static output
+    bool static_output_needs_binning = false;
     QJsonObject exportStaticOutput();
     void loadStaticOutput(const QJsonObject& X);
 };
@@ -73,6 +106,10 @@ public:
     CrossCorrelogramOptions3 m_options;
     HistogramView::TimeScaleMode m_time_scale_mode = HistogramView::Uniform;
 
+    QTimer m_progress_timer;
+    QMap<int, HistogramView*> m_progress_views; //by index into the correlograms of the computer
+
+    QList<HistogramView*> create_histogram_views(const QList<Correlogram3>& correlograms, QList<int>* indices = 0);
     void update_scale_stuff();
 };
 
@@ -92,7 +129,10 @@ MVCrossCorrelogramsWidget3::MVCrossCorrelogramsWidget3(MVAbstractContext* contex
     this->recalculateOnOptionChanged("cc_max_dt_msec");
     this->recalculateOnOptionChanged("cc_log_time_constant_msec");
     this->recalculateOnOptionChanged("cc_bin_size_msec");
-    this->recalculateOnOptionChanged("cc_max_est_data_size");
+
+    //while computing, the correlograms that are done are shown as they come in
+    d->m_progress_timer.setInterval(CC_PROGRESS_INTERVAL_MSEC);
+    QObject::connect(&d->m_progress_timer, SIGNAL(timeout()), this, SLOT(slot_show_progress()));
 
     {
         QAction* A = new QAction("Log", this);
@@ -132,7 +172,7 @@ void MVCrossCorrelogramsWidget3::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_computer.mlproxy_url = c->mlProxyUrl();
-    d->m_computer.firings = c->firings();
+    d->m_computer.firings = c->firingsTable();
     d->m_computer.options = d->m_options;
     d->m_computer.max_dt = c->option("cc_max_dt_msec", 100).toDouble() / 1000 * c->sampleRate();
     d->m_computer.cluster_merge.clear();
@@ -140,7 +180,27 @@ void MVCrossCorrelogramsWidget3::prepareCalculation()
         d->m_computer.cluster_merge = c->clusterMerge();
     }
     d->m_computer.pair_mode = this->pairMode();
-    d->m_computer.max_est_data_size = c->option("cc_max_est_data_size", 10000).toDouble();
+
+    //the bins are fixed up front, so the correlograms can be accumulated directly into counts
+    double sample_freq = c->sampleRate();
+    double bin_size = c->option("cc_bin_size_msec", 0.5).toDouble() / 1000 * sample_freq;
+    CorrelogramBinning binning;
+    binning.bin_max = d->m_computer.max_dt;
+    binning.bin_min = -binning.bin_max;
+    binning.num_bins = 0;
+    if (bin_size > 0)
+        binning.num_bins = (binning.bin_max - binning.bin_min) / bin_size;
+    if (binning.num_bins > 2000)
+        binning.num_bins = 2000;
+    binning.log_time_scale = (d->m_time_scale_mode == HistogramView::Log);
+    binning.time_constant = c->option("cc_log_time_constant_msec", 1).toDouble() / 1000 * sample_freq;
+    d->m_computer.binning = binning;
+
+    d->m_computer.progress_correlograms.clear();
+    d->m_computer.progress_finished_indices.clear();
+    d->m_computer.progress_pairs_taken = false;
+    d->m_progress_views.clear();
+    d->m_progress_timer.start();
 }
 
 void MVCrossCorrelogramsWidget3::runCalculation()
@@ -148,63 +208,53 @@ void MVCrossCorrelogramsWidget3::runCalculation()
     d->m_computer.compute();
 }
 
-double max2(const QList<Correlogram3>& data0)
-{
-    double ret = 0;
-    for (int i = 0; i < data0.count(); i++) {
-        QVector<double> tmp = data0[i].data;
-        for (int j = 0; j < tmp.count(); j++) {
-            if (tmp[j] > ret)
-                ret = tmp[j];
-        }
-    }
-    return ret;
-}
-
 void MVCrossCorrelogramsWidget3::onCalculationFinished()
 {
     MVContext* c = qobject_cast<MVContext*>(mvContext());
     Q_ASSERT(c);
 
-    d->m_correlograms = d->m_computer.correlograms;
-
-    double bin_max = max2(d->m_correlograms);
-    double bin_min = -bin_max;
-    //int num_bins=100;
-    double sample_freq = c->sampleRate();
-    int bin_size = c->option("cc_bin_size_msec").toDouble() / 1000 * sample_freq;
-    int num_bins = (bin_max - bin_min) / bin_size;
-    //if (num_bins < 100)
-    //    num_bins = 100;
-    if (num_bins > 2000)
-        num_bins = 2000;
+    d->m_progress_timer.stop();
+    d->m_progress_views.clear();
 
-    double time_width = (bin_max - bin_min) / sample_freq * 1000;
-    HorizontalScaleAxisData X;
-    X.use_it = true;
-    X.label = QString("%1 ms").arg((int)(time_width / 2));
-    this->setHorizontalScaleAxis(X);
+    d->m_correlograms = d->m_computer.correlograms;
 
-    QList<HistogramView*> histogram_views;
-    for (int ii = 0; ii < d->m_correlograms.count(); ii++) {
-        int k1 = d->m_correlograms[ii].k1;
-        int k2 = d->m_correlograms[ii].k2;
-        if ((c->clusterIsVisible(k1)) && (c->clusterIsVisible(k2))) {
-            HistogramView* HV = new HistogramView;
-            HV->setData(d->m_correlograms[ii].data);
-            HV->setColors(c->colors());
-            HV->setBinInfo(bin_min, bin_max, num_bins);
-            QString title0;
-            QString caption0;
-            HV->setProperty("k", d->m_correlograms[ii].k1);
-            HV->setProperty("k1", d->m_correlograms[ii].k1);
-            HV->setProperty("k2", d->m_correlograms[ii].k2);
+    this->setHistogramViews(d->create_histogram_views(d->m_correlograms));
+    d->update_scale_stuff();
+}
 
-            histogram_views << HV;
+void MVCrossCorrelogramsWidget3::slot_show_progress()
+{
+    if (!this->isCalculating())
+        return;
+    QList<Correlogram3> new_pairs;
+    QMap<int, Correlogram3> finished;
+    {
+        QMutexLocker locker(&d->m_computer.progress_mutex);
+        if ((!d->m_computer.progress_pairs_taken) && (!d->m_computer.progress_correlograms.isEmpty())) {
+            new_pairs = d->m_computer.progress_correlograms;
+            d->m_computer.progress_pairs_taken = true;
+        }
+        foreach (int ind, d->m_computer.progress_finished_indices) {
+            finished[ind] = d->m_computer.progress_correlograms.value(ind);
         }
+        d->m_computer.progress_finished_indices.clear();
+    }
+    if (!new_pairs.isEmpty()) {
+        //lay out the whole grid right away, and fill it in as the correlograms finish
+        QList<int> indices;
+        QList<HistogramView*> views = d->create_histogram_views(new_pairs, &indices);
+        for (int i = 0; i < views.count(); i++) {
+            d->m_progress_views[indices[i]] = views[i];
+        }
+        this->setHistogramViews(views);
+        d->update_scale_stuff();
+    }
+    QList<int> inds = finished.keys();
+    foreach (int ind, inds) {
+        HistogramView* HV = d->m_progress_views.value(ind);
+        if (HV)
+            HV->setBinCounts(finished[ind].counts);
     }
-    this->setHistogramViews(histogram_views);
-    d->update_scale_stuff();
 }
 
 void MVCrossCorrelogramsWidget3::setOptions(CrossCorrelogramOptions3 opts)
@@ -230,7 +280,8 @@ void MVCrossCorrelogramsWidget3::setTimeScaleMode(HistogramView::TimeScaleMode m
     if (d->m_time_scale_mode == mode)
         return;
     d->m_time_scale_mode = mode;
-    d->update_scale_stuff();
+    //the bins depend on the time scale
+    this->recalculate();
 }
 
 HistogramView::TimeScaleMode MVCrossCorrelogramsWidget3::timeScaleMode() const
@@ -315,61 +366,68 @@ void MVCrossCorrelogramsWidget3::slot_export_static_view()
     }
 }
 
-double pseudorandomnumber(double i)
+double CorrelogramBinning::transform(double t) const
 {
-    double ret = sin(i + cos(i));
-    ret = (ret + 5) - (int)(ret + 5);
-    return ret;
+    //same as the Log mode of HistogramView
+    if (!log_time_scale)
+        return t;
+    if (t < 0)
+        return -transform(-t);
+    if (t < time_constant)
+        return t;
+    return (1 + log(t / time_constant)) * time_constant;
 }
 
-QVector<double> pseudorandomsample(const QVector<double>& X, double dsfactor)
+int CorrelogramBinning::binIndex(double dt) const
 {
-    QVector<double> ret;
-    for (int i = 0; i < X.count(); i++) {
-        double randnum = pseudorandomnumber(i);
-        if (randnum <= 1 / dsfactor)
-            ret << X[i];
-    }
+    if ((num_bins <= 0) || (dt < bin_min) || (dt > bin_max))
+        return -1;
+    double x1 = transform(bin_min);
+    double x2 = transform(bin_max);
+    if (x2 <= x1)
+        return -1;
+    int ret = (int)((transform(dt) - x1) / (x2 - x1) * num_bins);
+    if (ret >= num_bins)
+        ret = num_bins - 1; //dt==bin_max
+    if (ret < 0)
+        ret = 0;
     return ret;
 }
 
-double estimate_cc_data_size(const QVector<double>& times1, const QVector<double>& times2, int max_dt, bool exclude_matches)
+QJsonObject CorrelogramBinning::toJsonObject() const
 {
-    double dsfactor = 10;
-    QVector<double> times1b = pseudorandomsample(times1, dsfactor);
-    QVector<double> times2b = pseudorandomsample(times2, dsfactor);
-    QVector<double> datab = compute_cc_data3(times1b, times2b, max_dt, exclude_matches, 0);
-    return datab.count() * dsfactor * dsfactor;
+    QJsonObject ret;
+    ret["bin_min"] = bin_min;
+    ret["bin_max"] = bin_max;
+    ret["num_bins"] = num_bins;
+    ret["log_time_scale"] = log_time_scale;
+    ret["time_constant"] = time_constant;
+    return ret;
 }
 
-bool write_mda(QString fname, const QVector<double>& X)
+void CorrelogramBinning::fromJsonObject(const QJsonObject& X)
 {
-    Mda A(1, X.count());
-    for (bigint i = 0; i < X.count(); i++) {
-        A.set(X[i], i);
-    }
-    return A.write64(fname);
+    bin_min = X["bin_min"].toDouble();
+    bin_max = X["bin_max"].toDouble();
+    num_bins = X["num_bins"].toInt();
+    log_time_scale = X["log_time_scale"].toBool();
+    time_constant = X["time_constant"].toDouble(30);
 }
 
-QVector<double> compute_cc_data3(const QVector<double>& times1_in, const QVector<double>& times2_in, int max_dt, bool exclude_matches, double max_est_data_size)
+void compute_cc_counts3(int* counts, bigint& total_count, const QVector<double>& times1, const QVector<double>& times2, int max_dt, bool exclude_matches, const CorrelogramBinning& binning)
 {
-    QVector<double> ret;
-    QVector<double> times1 = times1_in;
-    QVector<double> times2 = times2_in;
-    qSort(times1);
-    qSort(times2);
+    //The time differences are binned as they are generated, so the memory is O(num_bins)
+    //no matter how many pairs of events fall within max_dt
+    total_count = 0;
 
     if ((times1.isEmpty()) || (times2.isEmpty()))
-        return ret;
-
-    if (max_est_data_size) {
-        double estimated_data_size = estimate_cc_data_size(times1, times2, max_dt, exclude_matches);
-        if (estimated_data_size > max_est_data_size) {
-            double dsfactor = sqrt(estimated_data_size / max_est_data_size);
-            times1 = pseudorandomsample(times1, dsfactor);
-            times2 = pseudorandomsample(times2, dsfactor);
-        }
-    }
+        return;
+
+    //in the uniform case the bin index is a single multiply, which matters for bursty units
+    double x1 = binning.bin_min;
+    double inv_spacing = 0;
+    if (binning.bin_max > binning.bin_min)
+        inv_spacing = binning.num_bins / (binning.bin_max - binning.bin_min);
 
     int i1 = 0;
     for (int i2 = 0; i2 < times2.count(); i2++) {
@@ -381,12 +439,25 @@ QVector<double> compute_cc_data3(const QVector<double>& times1_in, const QVector
             if ((exclude_matches) && (j1 == i2) && (times1[j1] == times2[i2]))
                 ok = false;
             if (ok) {
-                ret << times1[j1] - times2[i2];
+                double dt = times1[j1] - times2[i2];
+                int b;
+                if (binning.log_time_scale) {
+                    b = binning.binIndex(dt);
+                }
+                else if ((dt < binning.bin_min) || (dt > binning.bin_max)) {
+                    b = -1;
+                }
+                else {
+                    b = qMin(binning.num_bins - 1, (int)((dt - x1) * inv_spacing));
+                }
+                if (b >= 0) {
+                    counts[b]++;
+                    total_count++;
+                }
             }
             j1++;
         }
     }
-    return ret;
 }
 
 typedef QVector<double> DoubleList;
@@ -396,29 +467,44 @@ void MVCrossCorrelogramsWidget3Computer::compute()
     TaskProgress task(TaskProgress::Calculate, QString("Cross Correlograms (%1)").arg(options.mode));
     if (loaded_from_static_output) {
         task.log("Loaded from static output");
+        //older static views stored the raw time differences, which we bin once here
+        if (static_output_needs_binning) {
+            static_binning = binning;
+            static_output_needs_binning = false;
+        }
+        for (int j = 0; j < correlograms.count(); j++) {
+            if (!correlograms[j].legacy_data.isEmpty()) {
+                QVector<int>& counts = correlograms[j].counts;
+                counts = QVector<int>(qMax(0, binning.num_bins), 0);
+                correlograms[j].total_count = 0;
+                foreach (double dt, correlograms[j].legacy_data) {
+                    int b = binning.binIndex(dt);
+                    if (b >= 0) {
+                        counts[b]++;
+                        correlograms[j].total_count++;
+                    }
+                }
+                correlograms[j].legacy_data.clear();
+            }
+        }
+        binning = static_binning;
         return;
     }
 
     correlograms.clear();
 
-    QVector<double> times;
-    QVector<int> labels;
-    bigint L = firings.N2();
-
-    //assemble the times and labels arrays
+    //the times and labels arrays (shared with the other views, loaded once)
     task.setProgress(0.2);
-    for (bigint n = 0; n < L; n++) {
-        times << firings.value(1, n);
-        //times << debug.value(1,n);
-        labels << (int)firings.value(2, n);
-    }
+    QVector<double> times = firings.times();
+    QVector<int> labels = firings.labels();
+    bigint L = times.count();
 
     //compute K (the maximum label)
-    int K = MLCompute::max(labels);
+    int K = firings.K();
 
     //handle the merge
     QMap<int, int> label_map = cluster_merge.labelMap(K);
-    for (int n = 0; n < L; n++) {
+    for (bigint n = 0; n < L; n++) {
         labels[n] = label_map[labels[n]];
     }
 
@@ -480,19 +566,65 @@ void MVCrossCorrelogramsWidget3Computer::compute()
         }
     }
 
-    //compute the cross-correlograms
-    task.setProgress(0.7);
-    for (int j = 0; j < correlograms.count(); j++) {
-        if (MLUtil::threadInterruptRequested()) {
-            return;
-        }
-        int k1 = correlograms[j].k1;
-        int k2 = correlograms[j].k2;
-        correlograms[j].data = compute_cc_data3(the_times.value(k1), the_times.value(k2), max_dt, (k1 == k2), max_est_data_size);
-        if (correlograms[j].data.count() > max_est_data_size) {
-            qWarning() << QString("%1>%2").arg(correlograms[j].data.count()).arg(max_est_data_size);
+    //each spike train is sorted once here, rather than once per pair
+    for (int k = 0; k <= K; k++) {
+        qSort(the_times[k]);
+    }
+
+    {
+        QMutexLocker locker(&progress_mutex);
+        progress_correlograms = correlograms;
+    }
+
+    //compute the cross-correlograms. The pairs are handed out in order to a pool of workers, each
+    //accumulating into its own histogram buffer, so that the first rows finish first
+    task.setProgress(0.5);
+    QThread* calculation_thread = QThread::currentThread();
+    int num_pairs = correlograms.count();
+    int num_bins = qMax(0, binning.num_bins);
+    QAtomicInt next_pair_index(0);
+    QAtomicInt num_pairs_finished(0);
+    const QList<Correlogram3>& pairs = correlograms; //only read by the workers
+    auto worker = [&]() {
+        QVector<int> buffer(num_bins);
+        while (true) {
+            if (calculation_thread->isInterruptionRequested())
+                return;
+            int j = next_pair_index.fetchAndAddOrdered(1);
+            if (j >= num_pairs)
+                return;
+            int k1 = pairs.at(j).k1;
+            int k2 = pairs.at(j).k2;
+            buffer.fill(0);
+            bigint total_count = 0;
+            compute_cc_counts3(buffer.data(), total_count, the_times.value(k1), the_times.value(k2), max_dt, (k1 == k2), binning);
+            {
+                QMutexLocker locker(&progress_mutex);
+                progress_correlograms[j].counts = buffer;
+                progress_correlograms[j].total_count = total_count;
+                progress_finished_indices << j;
+            }
+            num_pairs_finished.fetchAndAddOrdered(1);
         }
-        if ((correlograms[j].data.isEmpty()) && (!pair_mode)) {
+    };
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, qMin(QThread::idealThreadCount(), num_pairs)));
+    for (int i = 0; i < pool.maxThreadCount(); i++) {
+        QtConcurrent::run(&pool, worker);
+    }
+    while (!pool.waitForDone(100)) {
+        task.setProgress(0.5 + 0.5 * num_pairs_finished.load() / qMax(1, num_pairs));
+    }
+    if (MLUtil::threadInterruptRequested()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&progress_mutex);
+        correlograms = progress_correlograms;
+    }
+    for (int j = 0; j < correlograms.count(); j++) {
+        if ((!correlograms[j].total_count) && (!pair_mode)) {
             correlograms.removeAt(j);
             j--;
         }
@@ -502,11 +634,12 @@ void MVCrossCorrelogramsWidget3Computer::compute()
 QJsonObject MVCrossCorrelogramsWidget3Computer::exportStaticOutput()
 {
     QJsonObject ret;
-    ret["version"] = "MVCrossCorrelogramsWidget3Computer-0.1";
+    ret["version"] = "MVCrossCorrelogramsWidget3Computer-0.2";
+    ret["binning"] = binning.toJsonObject();
     QJsonArray cc;
     for (int i = 0; i < correlograms.count(); i++) {
         QJsonObject oo;
-        oo["data"] = MLUtil::toJsonValue(correlograms[i].data);
+        oo["counts"] = MLUtil::toJsonValue(correlograms[i].counts);
         oo["k1"] = correlograms[i].k1;
         oo["k2"] = correlograms[i].k2;
         cc.append(oo);
@@ -518,11 +651,20 @@ QJsonObject MVCrossCorrelogramsWidget3Computer::exportStaticOutput()
 void MVCrossCorrelogramsWidget3Computer::loadStaticOutput(const QJsonObject& X)
 {
     QJsonArray cc = X["correlograms"].toArray();
+    static_binning.fromJsonObject(X["binning"].toObject());
+    static_output_needs_binning = !X.contains("binning");
     correlograms.clear();
     for (int ii = 0; ii < cc.count(); ii++) {
         QJsonObject oo = cc[ii].toObject();
         Correlogram3 CC;
-        MLUtil::fromJsonValue(CC.data, oo["data"]);
+        if (oo.contains("counts")) {
+            MLUtil::fromJsonValue(CC.counts, oo["counts"]);
+            for (int b = 0; b < CC.counts.count(); b++)
+                CC.total_count += CC.counts[b];
+        }
+        else {
+            MLUtil::fromJsonValue(CC.legacy_data, oo["data"]);
+        }
         CC.k1 = oo["k1"].toInt();
         CC.k2 = oo["k2"].toInt();
         correlograms << CC;
@@ -836,20 +978,61 @@ QList<QAction*> MVSelectedCrossCorrelogramsFactory::actions(const QMimeData& md)
 }
 */
 
-void MVCrossCorrelogramsWidget3Private::update_scale_stuff()
+QList<HistogramView*> MVCrossCorrelogramsWidget3Private::create_histogram_views(const QList<Correlogram3>& correlograms, QList<int>* indices)
 {
     MVContext* c = qobject_cast<MVContext*>(q->mvContext());
     Q_ASSERT(c);
 
+    CorrelogramBinning binning = m_computer.binning;
+    double bin_max = binning.bin_max;
+    double bin_min = binning.bin_min;
+    int num_bins = binning.num_bins;
+    double sample_freq = c->sampleRate();
+
+    double time_width = (bin_max - bin_min) / sample_freq * 1000;
+    HorizontalScaleAxisData X;
+    X.use_it = true;
+    X.label = QString("%1 ms").arg((int)(time_width / 2));
+    q->setHorizontalScaleAxis(X);
+
+    QList<HistogramView*> histogram_views;
+    for (int ii = 0; ii < correlograms.count(); ii++) {
+        int k1 = correlograms[ii].k1;
+        int k2 = correlograms[ii].k2;
+        if ((c->clusterIsVisible(k1)) && (c->clusterIsVisible(k2))) {
+            HistogramView* HV = new HistogramView;
+            //the time scale must be set before the bins, which are spaced according to it
+            HV->setTimeScaleMode(binning.log_time_scale ? HistogramView::Log : HistogramView::Uniform);
+            HV->setTimeConstant(binning.time_constant);
+            HV->setColors(c->colors());
+            HV->setBinInfo(bin_min, bin_max, num_bins);
+            HV->setBinCounts(correlograms[ii].counts);
+            HV->setProperty("k", correlograms[ii].k1);
+            HV->setProperty("k1", correlograms[ii].k1);
+            HV->setProperty("k2", correlograms[ii].k2);
+
+            histogram_views << HV;
+            if (indices)
+                (*indices) << ii;
+        }
+    }
+    return histogram_views;
+}
+
+void MVCrossCorrelogramsWidget3Private::update_scale_stuff()
+{
+    //the counts were binned in the time scale of the computer, so the views must use that one
+    const CorrelogramBinning& binning = m_computer.binning;
+    HistogramView::TimeScaleMode mode = binning.log_time_scale ? HistogramView::Log : HistogramView::Uniform;
+
     QList<HistogramView*> views = q->histogramViews();
     foreach (HistogramView* HV, views) {
-        HV->setTimeScaleMode(m_time_scale_mode);
-        double time_constant_sec = c->option("cc_log_time_constant_msec", 1).toDouble() / 1000;
-        HV->setTimeConstant(c->sampleRate() * time_constant_sec);
+        HV->setTimeScaleMode(mode);
+        HV->setTimeConstant(binning.time_constant);
         QList<double> tickvals;
-        if (m_time_scale_mode == HistogramView::Uniform) {
+        if (mode == HistogramView::Uniform) {
         }
-        else if (m_time_scale_mode == HistogramView::Log) {
+        else if (mode == HistogramView::Log) {
             for (int sign = -1; sign <= 1; sign += 2) {
                 tickvals << 30 * sign << 300 * sign << 3000 * sign << 30000 * sign;
             }
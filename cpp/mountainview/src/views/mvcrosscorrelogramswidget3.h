@@ -64,6 +64,7 @@ private slots:
     void slot_log_time_scale();
     void slot_warning();
     void slot_export_static_view();
+    void slot_show_progress();
 
 private:
     MVCrossCorrelogramsWidget3Private* d;
@@ -33,6 +33,7 @@ class MVDiscrimHistViewComputer {
 public:
     //input
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     DiskReadMda32 timeseries;
     DiskReadMda firings;
     QList<int> cluster_numbers;
@@ -98,6 +99,7 @@ void MVDiscrimHistView::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_computer.mlproxy_url = c->mlProxyUrl();
+    d->m_computer.result_store = c->resultStore();
     d->m_computer.timeseries = c->currentTimeseries();
     d->m_computer.firings = c->firings();
     d->m_computer.cluster_numbers = d->m_cluster_numbers;
@@ -161,6 +163,7 @@ void MVDiscrimHistViewComputer::compute()
 
     MountainProcessRunner MPR;
     MPR.setMLProxyUrl(mlproxy_url);
+    MPR.setResultStore(result_store.data());
     MPR.setProcessorName("mv.mv_discrimhist");
 
     QStringList clusters_strlist;
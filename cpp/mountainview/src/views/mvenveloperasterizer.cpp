@@ -0,0 +1,143 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mvenveloperasterizer.h"
+#include <QDebug>
+#include <math.h>
+#include <limits>
+
+MVEnvelopeRasterizer::MVEnvelopeRasterizer(int num_channels, int width, double t1, double t2)
+{
+    m_M = qMax(0, num_channels);
+    m_W = qMax(0, width);
+    m_t1 = t1;
+    m_t2 = t2;
+    m_lo.fill(std::numeric_limits<float>::max(), m_M * m_W);
+    m_hi.fill(-std::numeric_limits<float>::max(), m_M * m_W);
+}
+
+void MVEnvelopeRasterizer::addData(const Mda32& min, const Mda32& max, double t0, int ds_factor, double clip_t1, double clip_t2)
+{
+    if ((!m_M) || (!m_W) || (m_t2 <= m_t1))
+        return;
+    if ((min.N1() != m_M) || (max.N1() != m_M) || (min.N2() != max.N2())) {
+        qWarning() << "Unexpected dimensions in MVEnvelopeRasterizer::addData" << min.N1() << min.N2() << max.N1() << max.N2() << m_M;
+        return;
+    }
+    int M = m_M;
+    bigint N = min.N2();
+    double scale = m_W / (m_t2 - m_t1);
+    const float* pmin = min.constDataPtr();
+    const float* pmax = max.constDataPtr();
+    float* lo0 = m_lo.data();
+    float* hi0 = m_hi.data();
+    int xmin = qMax(0, (int)floor((clip_t1 - m_t1) * scale));
+    int xmax = qMin(m_W - 1, (int)floor((clip_t2 - m_t1) * scale));
+
+    if (N == 1) {
+        int x1 = qMax(xmin, (int)floor((t0 - m_t1) * scale));
+        int x2 = qMin(xmax, (int)floor((t0 + ds_factor - m_t1) * scale));
+        for (int x = x1; x <= x2; x++) {
+            float* lo = &lo0[x * M];
+            float* hi = &hi0[x * M];
+            for (int m = 0; m < M; m++) {
+                lo[m] = qMin(lo[m], pmin[m]);
+                hi[m] = qMax(hi[m], pmax[m]);
+            }
+        }
+        return;
+    }
+
+    //the traces are linear between the sample centers. For each segment, every column it touches
+    //receives the values at the two ends of the part of the segment inside that column
+    for (bigint j = 0; j + 1 < N; j++) {
+        double ca = (t0 + (j + 0.5) * ds_factor - m_t1) * scale;
+        double cb = ca + ds_factor * scale;
+        if ((cb < xmin) || (ca >= xmax + 1))
+            continue;
+        int x1 = qMax(xmin, (int)floor(ca));
+        int x2 = qMin(xmax, (int)floor(cb));
+        const float* amin = &pmin[j * M];
+        const float* bmin = &pmin[(j + 1) * M];
+        const float* amax = &pmax[j * M];
+        const float* bmax = &pmax[(j + 1) * M];
+        for (int x = x1; x <= x2; x++) {
+            float fa = (float)((qMax(1.0 * x, ca) - ca) / (cb - ca));
+            float fb = (float)((qMin(x + 1.0, cb) - ca) / (cb - ca));
+            float* lo = &lo0[x * M];
+            float* hi = &hi0[x * M];
+            for (int m = 0; m < M; m++) {
+                float v1 = amin[m] + (bmin[m] - amin[m]) * fa;
+                float v2 = amin[m] + (bmin[m] - amin[m]) * fb;
+                float u1 = amax[m] + (bmax[m] - amax[m]) * fa;
+                float u2 = amax[m] + (bmax[m] - amax[m]) * fb;
+                lo[m] = qMin(lo[m], qMin(v1, v2));
+                hi[m] = qMax(hi[m], qMax(u1, u2));
+            }
+        }
+    }
+}
+
+void MVEnvelopeRasterizer::render(QImage& image, double amp_factor, const QList<QColor>& channel_colors, int min_span_height) const
+{
+    if ((!m_M) || (!m_W))
+        return;
+    if (image.width() != m_W) {
+        qWarning() << "Unexpected image width in MVEnvelopeRasterizer::render" << image.width() << m_W;
+        return;
+    }
+    if ((image.format() != QImage::Format_ARGB32) && (image.format() != QImage::Format_ARGB32_Premultiplied) && (image.format() != QImage::Format_RGB32)) {
+        qWarning() << "Unsupported image format in MVEnvelopeRasterizer::render" << image.format();
+        return;
+    }
+    int H = image.height();
+    if (!H)
+        return;
+    int M = m_M;
+    double band_height = H * 1.0 / M;
+
+    QVector<QRgb> colors(M);
+    for (int m = 0; m < M; m++) {
+        QRgb col = channel_colors.isEmpty() ? qRgb(0, 0, 0) : channel_colors[m % channel_colors.count()].rgba();
+        if (image.format() == QImage::Format_ARGB32_Premultiplied)
+            col = qPremultiply(col);
+        colors[m] = col;
+    }
+
+    QRgb* bits = (QRgb*)image.bits();
+    int stride = image.bytesPerLine() / 4;
+    for (int x = 0; x < m_W; x++) {
+        const float* lo = &m_lo[x * M];
+        const float* hi = &m_hi[x * M];
+        for (int m = 0; m < M; m++) {
+            if (lo[m] > hi[m])
+                continue; //no data in this column
+            double band_top = m * band_height;
+            int y1 = (int)floor(band_top + (1 - (hi[m] * amp_factor + 1) / 2) * band_height);
+            int y2 = (int)floor(band_top + (1 - (lo[m] * amp_factor + 1) / 2) * band_height);
+            if (y2 - y1 + 1 < min_span_height) {
+                int mid = (y1 + y2) / 2;
+                y1 = mid - (min_span_height - 1) / 2;
+                y2 = y1 + min_span_height - 1;
+            }
+            y1 = qMax(0, y1);
+            y2 = qMin(H - 1, y2);
+            QRgb col = colors[m];
+            for (int y = y1; y <= y2; y++) {
+                bits[y * stride + x] = col;
+            }
+        }
+    }
+}
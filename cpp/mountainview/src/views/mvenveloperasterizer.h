@@ -0,0 +1,53 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MVENVELOPERASTERIZER_H
+#define MVENVELOPERASTERIZER_H
+
+#include <QColor>
+#include <QImage>
+#include <QList>
+#include <QVector>
+#include "mda32.h"
+
+/**
+ * \class MVEnvelopeRasterizer
+ * @brief Rasterizes multi-channel min/max envelopes directly at the output resolution
+ *
+ * The visible time range [t1,t2] is mapped onto W pixel columns. addData() accumulates, for every
+ * column and channel, the range covered by the piecewise-linear min and max traces. render() then
+ * fills one vertical span per column in each channel's horizontal band. The cost depends on W and
+ * the number of channels, and not on how many blocks of data were added.
+ *
+ * The accumulators are laid out column by column with the channels contiguous, which matches the
+ * column-major layout of Mda32, so the inner loops run over channels with unit stride.
+ */
+class MVEnvelopeRasterizer {
+public:
+    MVEnvelopeRasterizer(int num_channels, int width, double t1, double t2);
+
+    ///Column j of min/max (M x N) covers the timepoints [t0 + j*ds_factor, t0 + (j+1)*ds_factor).
+    ///Only the pixel columns within [clip_t1,clip_t2] are affected
+    void addData(const Mda32& min, const Mda32& max, double t0, int ds_factor, double clip_t1, double clip_t2);
+    ///Fills the spans into image (Format_ARGB32 with the same width), one band of height H/M per channel
+    void render(QImage& image, double amp_factor, const QList<QColor>& channel_colors, int min_span_height = 1) const;
+
+private:
+    int m_M, m_W;
+    double m_t1, m_t2;
+    QVector<float> m_lo, m_hi; //m_W x m_M
+};
+
+#endif // MVENVELOPERASTERIZER_H
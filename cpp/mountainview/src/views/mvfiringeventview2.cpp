@@ -36,6 +36,7 @@ public:
     QString timeseries;
     QString firings;
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     QSet<int> labels_to_use;
 
     //output
@@ -156,6 +157,7 @@ void MVFiringEventView2::prepareCalculation()
 
     d->m_calculator.labels_to_use = d->m_labels_to_use;
     d->m_calculator.mlproxy_url = c->mlProxyUrl();
+    d->m_calculator.result_store = c->resultStore();
     d->m_calculator.timeseries = c->currentTimeseries().makePath();
     d->m_calculator.firings = c->firings().makePath();
 }
@@ -331,26 +333,31 @@ void MVFiringEventViewCalculator::compute()
 {
     TaskProgress task("Computing firing events");
 
-    DiskReadMda firings2 = compute_amplitudes(timeseries, firings, mlproxy_url);
-
-    int L = firings2.N2();
-    times.clear();
-    labels.clear();
-    amplitudes.clear();
-    for (int i = 0; i < L; i++) {
-        if (i % 100 == 0) {
-            if (MLUtil::threadInterruptRequested()) {
-                task.error("Halted");
-                return;
-            }
-        }
-        int label0 = (int)firings2.value(2, i);
-        if (labels_to_use.contains(label0)) {
-            task.setProgress(i * 1.0 / L);
-            times << firings2.value(1, i);
-            labels << label0;
-            amplitudes << firings2.value(3, i);
-        }
+    FiringsTable firings2(compute_amplitudes(timeseries, firings, mlproxy_url, result_store.data()));
+    if (MLUtil::threadInterruptRequested()) {
+        task.error("Halted");
+        return;
+    }
+
+    //use the per-label index, keeping the events in their original order
+    QVector<bigint> inds;
+    foreach (int k, labels_to_use) {
+        inds << firings2.eventIndicesForLabel(k);
+    }
+    qSort(inds);
+
+    const QVector<double>& times0 = firings2.times();
+    const QVector<int>& labels0 = firings2.labels();
+    const QVector<double>& amplitudes0 = firings2.amplitudes();
+    bigint num = inds.count();
+    times.resize(num);
+    labels.resize(num);
+    amplitudes.fill(0, num);
+    for (bigint i = 0; i < num; i++) {
+        times[i] = times0[inds[i]];
+        labels[i] = labels0[inds[i]];
+        if (!amplitudes0.isEmpty())
+            amplitudes[i] = amplitudes0[inds[i]];
     }
     task.log(QString("Found %1 events, using %2 clusters").arg(times.count()).arg(labels_to_use.count()));
 }
@@ -19,10 +19,14 @@
 #include "mvutils.h"
 
 #include <QHBoxLayout>
+#include <QMouseEvent>
+#include <QPaintEvent>
 #include <QScrollArea>
 #include "actionfactory.h"
 #include <QScrollBar>
 
+#define GRID_VIEW_HORIZONTAL_SPACING 12
+
 class ViewWrap : public QWidget {
 public:
     ViewWrap(MVGridView* GV, QWidget* W, int index)
@@ -46,14 +50,34 @@ private:
     int m_index;
 };
 
+class MVGridViewPrivate;
+class GridCanvas : public QWidget {
+public:
+    GridCanvas(MVGridViewPrivate* grid_view_private);
+
+protected:
+    void paintEvent(QPaintEvent* evt) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent* evt) Q_DECL_OVERRIDE;
+    void mouseDoubleClickEvent(QMouseEvent* evt) Q_DECL_OVERRIDE;
+    void mouseMoveEvent(QMouseEvent* evt) Q_DECL_OVERRIDE;
+    void leaveEvent(QEvent* evt) Q_DECL_OVERRIDE;
+
+private:
+    MVGridViewPrivate* d;
+};
+
 class MVGridViewPrivate {
 public:
     MVGridView* q;
     QList<RenderableWidget*> m_views;
-    QList<ViewWrap*> m_view_wraps;
+    QList<ViewWrap*> m_view_wraps; //wrap i holds view i, once it has been laid out
     QScrollArea* m_scroll_area;
     QWidget* m_grid_widget;
     QGridLayout* m_grid_layout;
+    bool m_virtual_layout = false;
+    GridCanvas* m_canvas = 0;
+    int m_num_cols = 1;
+    int m_hovered_view_index = -1;
     double m_preferred_width = 0; //zero means zoomed all the way out
     bool m_force_square_matrix = false;
     double m_preferred_aspect_ratio = 1.618; //golden mean
@@ -64,6 +88,12 @@ public:
     void on_resize();
     void setup_grid(int num_cols);
     void get_num_rows_cols_and_height_for_preferred_width(int& num_rows, int& num_cols, int& height, double preferred_width);
+
+    //virtual layout
+    QRect view_rect(int index);
+    int view_index_at(const QPoint& pos);
+    void paint_canvas(QPainter& painter, const QRect& exposed);
+    void hover_canvas(const QPoint& pos);
 };
 
 MVGridView::MVGridView(MVAbstractContext* context)
@@ -89,7 +119,7 @@ MVGridView::MVGridView(MVAbstractContext* context)
     d->m_grid_layout = GL;
     d->m_grid_widget = GW;
 
-    GL->setHorizontalSpacing(12);
+    GL->setHorizontalSpacing(GRID_VIEW_HORIZONTAL_SPACING);
     GL->setVerticalSpacing(0);
     GL->setMargin(0);
 
@@ -123,9 +153,14 @@ MVGridView::~MVGridView()
 
 void MVGridView::clearViews()
 {
+    //the wraps own the views they hold, the other views have no parent
+    for (int i = d->m_view_wraps.count(); i < d->m_views.count(); i++) {
+        delete d->m_views[i];
+    }
     qDeleteAll(d->m_view_wraps);
     d->m_views.clear();
     d->m_view_wraps.clear();
+    d->m_hovered_view_index = -1;
 }
 
 void MVGridView::addView(RenderableWidget* W)
@@ -268,15 +303,29 @@ void MVGridViewPrivate::setup_grid(int num_cols)
 {
     QGridLayout* GL = m_grid_layout;
     for (int i = GL->count() - 1; i >= 0; i--) {
-        GL->takeAt(i);
+        delete GL->takeAt(i);
+    }
+    m_num_cols = num_cols;
+    if (m_virtual_layout) {
+        GL->addWidget(m_canvas, 0, 0);
+        if (m_horizontal_scale_widget) {
+            //under the first column, as in the widget layout
+            QRect R = view_rect(0);
+            m_horizontal_scale_widget->setFixedWidth(qMax(1, R.width()));
+            GL->addWidget(m_horizontal_scale_widget, 1, 0, Qt::AlignLeft);
+        }
+        m_canvas->update();
+        return;
     }
     int num_rows = 0;
     for (int jj = 0; jj < m_views.count(); jj++) {
         QWidget* HV = m_views[jj];
         int row0 = (jj) / num_cols;
         int col0 = (jj) % num_cols;
-        ViewWrap* VW = new ViewWrap(q, HV, jj);
-        m_view_wraps << VW;
+        //the wraps are created once, since a wrap owns its view
+        if (jj >= m_view_wraps.count())
+            m_view_wraps << new ViewWrap(q, HV, jj);
+        ViewWrap* VW = m_view_wraps[jj];
         QFont fnt = HV->font();
         fnt.setPixelSize(m_properties.font_size);
         HV->setFont(fnt);
@@ -373,11 +422,26 @@ void MVGridView::setPreferredHistogramWidth(int width)
 
 void MVGridView::updateViews()
 {
+    if (d->m_virtual_layout) {
+        d->m_canvas->update();
+        return;
+    }
     foreach (QWidget* W, d->m_views) {
         W->update();
     }
 }
 
+void MVGridView::updateView(int index)
+{
+    if ((index < 0) || (index >= d->m_views.count()))
+        return;
+    if (d->m_virtual_layout) {
+        d->m_canvas->update(d->view_rect(index));
+        return;
+    }
+    d->m_views[index]->update();
+}
+
 int MVGridView::currentViewIndex() const
 {
     if (d->m_current_view_index >= d->m_views.count())
@@ -393,17 +457,9 @@ QImage MVGridView::renderImage(int W, int H)
     if (!H) {
         H = 900;
     }
-    int max_row = 0, max_col = 0;
-    for (int i = 0; i < d->m_views.count(); i++) {
-        QWidget* W = d->m_views[i];
-        int row = W->property("row").toInt();
-        int col = W->property("col").toInt();
-        if (row > max_row)
-            max_row = row;
-        if (col > max_col)
-            max_col = col;
-    }
-    int NR = max_row + 1, NC = max_col + 1;
+    int num_cols = qMax(1, d->m_num_cols);
+    int NR = qMax(1, (d->m_views.count() + num_cols - 1) / num_cols);
+    int NC = qMin(num_cols, qMax(1, d->m_views.count()));
     if (d->m_properties.use_fixed_panel_size) {
         W = d->m_properties.fixed_panel_width * NC;
         H = d->m_properties.fixed_panel_height * NR;
@@ -419,8 +475,8 @@ QImage MVGridView::renderImage(int W, int H)
 
     for (int i = 0; i < d->m_views.count(); i++) {
         RenderableWidget* W = d->m_views[i];
-        int row = W->property("row").toInt();
-        int col = W->property("col").toInt();
+        int row = i / num_cols;
+        int col = i % num_cols;
         W->setExportMode(true);
         QImage img = W->renderImage(W0, H0);
         W->setExportMode(false);
@@ -435,3 +491,155 @@ QImage MVGridView::renderImage(int W, int H)
 
     return ret;
 }
+
+void MVGridView::setVirtualLayout(bool val)
+{
+    if (d->m_virtual_layout == val)
+        return;
+    d->m_virtual_layout = val;
+    if ((val) && (!d->m_canvas)) {
+        d->m_canvas = new GridCanvas(d);
+    }
+    d->on_resize();
+}
+
+bool MVGridView::virtualLayout() const
+{
+    return d->m_virtual_layout;
+}
+
+void MVGridView::paintView(QPainter& painter, int index, int W, int H)
+{
+    RenderableWidget* V = d->m_views.value(index);
+    if (V)
+        painter.drawImage(0, 0, V->renderImage(W, H));
+}
+
+void MVGridView::hoverView(int index, const QPoint& pos, int W, int H)
+{
+    Q_UNUSED(index)
+    Q_UNUSED(pos)
+    Q_UNUSED(W)
+    Q_UNUSED(H)
+}
+
+QRect MVGridViewPrivate::view_rect(int index)
+{
+    int num_cols = qMax(1, m_num_cols);
+    int num_rows = qMax(1, (m_views.count() + num_cols - 1) / num_cols);
+    int spacing = GRID_VIEW_HORIZONTAL_SPACING;
+    double col_width = (m_canvas->width() + spacing) * 1.0 / num_cols; //including the spacing
+    double row_height = m_canvas->height() * 1.0 / num_rows;
+    int row = index / num_cols;
+    int col = index % num_cols;
+    int x1 = (int)(col * col_width);
+    int x2 = (int)((col + 1) * col_width) - spacing;
+    int y1 = (int)(row * row_height);
+    int y2 = (int)((row + 1) * row_height);
+    return QRect(x1, y1, qMax(0, x2 - x1), qMax(0, y2 - y1));
+}
+
+int MVGridViewPrivate::view_index_at(const QPoint& pos)
+{
+    int num_cols = qMax(1, m_num_cols);
+    int num_rows = qMax(1, (m_views.count() + num_cols - 1) / num_cols);
+    double col_width = (m_canvas->width() + GRID_VIEW_HORIZONTAL_SPACING) * 1.0 / num_cols;
+    double row_height = m_canvas->height() * 1.0 / num_rows;
+    if ((pos.x() < 0) || (pos.y() < 0) || (col_width <= 0) || (row_height <= 0))
+        return -1;
+    int col = (int)(pos.x() / col_width);
+    int row = (int)(pos.y() / row_height);
+    if ((col >= num_cols) || (row >= num_rows))
+        return -1;
+    int index = row * num_cols + col;
+    if ((index >= m_views.count()) || (!view_rect(index).contains(pos)))
+        return -1; //in the spacing between columns
+    return index;
+}
+
+void MVGridViewPrivate::paint_canvas(QPainter& painter, const QRect& exposed)
+{
+    if (m_views.isEmpty())
+        return;
+    int num_cols = qMax(1, m_num_cols);
+    int num_rows = qMax(1, (m_views.count() + num_cols - 1) / num_cols);
+    double col_width = (m_canvas->width() + GRID_VIEW_HORIZONTAL_SPACING) * 1.0 / num_cols;
+    double row_height = m_canvas->height() * 1.0 / num_rows;
+    if ((col_width <= 0) || (row_height <= 0))
+        return;
+
+    QFont fnt = painter.font();
+    fnt.setPixelSize(m_properties.font_size);
+    painter.setFont(fnt);
+
+    //only the views that intersect the exposed region are drawn
+    int row1 = qMax(0, (int)(exposed.top() / row_height));
+    int row2 = qMin(num_rows - 1, (int)(exposed.bottom() / row_height));
+    int col1 = qMax(0, (int)(exposed.left() / col_width));
+    int col2 = qMin(num_cols - 1, (int)(exposed.right() / col_width));
+    for (int row = row1; row <= row2; row++) {
+        for (int col = col1; col <= col2; col++) {
+            int index = row * num_cols + col;
+            if (index >= m_views.count())
+                break;
+            QRect R = view_rect(index);
+            if ((R.isEmpty()) || (!R.intersects(exposed)))
+                continue;
+            painter.save();
+            painter.setClipRect(R);
+            painter.translate(R.topLeft());
+            q->paintView(painter, index, R.width(), R.height());
+            painter.restore();
+        }
+    }
+}
+
+void MVGridViewPrivate::hover_canvas(const QPoint& pos)
+{
+    int index = view_index_at(pos);
+    if ((index != m_hovered_view_index) && (m_hovered_view_index >= 0)) {
+        q->hoverView(-1, QPoint(-1, -1), 0, 0);
+    }
+    m_hovered_view_index = index;
+    if (index >= 0) {
+        QRect R = view_rect(index);
+        q->hoverView(index, pos - R.topLeft(), R.width(), R.height());
+    }
+}
+
+GridCanvas::GridCanvas(MVGridViewPrivate* grid_view_private)
+{
+    d = grid_view_private;
+    setMouseTracking(true);
+}
+
+void GridCanvas::paintEvent(QPaintEvent* evt)
+{
+    QPainter painter(this);
+    d->paint_canvas(painter, evt->rect());
+}
+
+void GridCanvas::mousePressEvent(QMouseEvent* evt)
+{
+    int index = d->view_index_at(evt->pos());
+    if ((index >= 0) && (evt->button() == Qt::LeftButton))
+        emit d->q->signalViewClicked(index, evt->modifiers());
+}
+
+void GridCanvas::mouseDoubleClickEvent(QMouseEvent* evt)
+{
+    int index = d->view_index_at(evt->pos());
+    if (index >= 0)
+        emit d->q->signalViewActivated(index, d->q->mapFromGlobal(evt->globalPos()));
+}
+
+void GridCanvas::mouseMoveEvent(QMouseEvent* evt)
+{
+    d->hover_canvas(evt->pos());
+}
+
+void GridCanvas::leaveEvent(QEvent* evt)
+{
+    Q_UNUSED(evt)
+    d->hover_canvas(QPoint(-1, -1));
+}
@@ -19,6 +19,7 @@
 #include "renderablewidget.h"
 
 #include <mvabstractview.h>
+#include <QPainter>
 #include <QResizeEvent>
 
 class MVGridViewPrivate;
@@ -35,12 +36,14 @@ public:
     void setForceSquareMatrix(bool val);
     void setPreferredHistogramWidth(int width); //use 0 for zoomed all the way out
     void updateViews();
+    void updateView(int index);
     int currentViewIndex() const;
 
     QImage renderImage(int W = 0, int H = 0);
 
 signals:
     void signalViewClicked(int index, Qt::KeyboardModifiers modifiers);
+    void signalViewActivated(int index, const QPoint& pos); //double-click, pos in the coordinates of this widget
 
 protected:
     void resizeEvent(QResizeEvent* evt);
@@ -50,6 +53,13 @@ protected:
     int viewCount() const;
     RenderableWidget* view(int j) const;
 
+    // In the virtual layout the views are not shown as widgets. Only the visible ones are drawn, on a single surface,
+    // through paintView, and the grid itself handles the mouse. This is what makes grids of many thousands of views usable
+    void setVirtualLayout(bool val);
+    bool virtualLayout() const;
+    virtual void paintView(QPainter& painter, int index, int W, int H);
+    virtual void hoverView(int index, const QPoint& pos, int W, int H); //index -1 when no view is hovered; pos within the view
+
 private slots:
     void slot_zoom_out(double factor = 1.2);
     void slot_zoom_in(double factor = 1.2);
@@ -49,6 +49,7 @@ public:
     HorizontalScaleAxis* m_horizontal_scale_axis;
 
     bool m_pair_mode = true;
+    int m_hovered_index = -1;
 
     void do_highlighting_and_captions();
     int find_view_index_for_k(int k);
@@ -64,6 +65,11 @@ MVHistogramGrid::MVHistogramGrid(MVAbstractContext* context)
 
     d->m_horizontal_scale_axis = new HorizontalScaleAxis;
 
+    //the histogram views are not shown as widgets; only the visible cells are drawn
+    this->setVirtualLayout(true);
+    QObject::connect(this, SIGNAL(signalViewClicked(int, Qt::KeyboardModifiers)), this, SLOT(slot_view_clicked(int, Qt::KeyboardModifiers)));
+    QObject::connect(this, SIGNAL(signalViewActivated(int, QPoint)), this, SLOT(slot_view_activated(int, QPoint)));
+
     MVContext* c = qobject_cast<MVContext*>(context);
     Q_ASSERT(c);
 
@@ -134,20 +140,21 @@ void MVHistogramGrid::setHorizontalScaleAxis(HorizontalScaleAxisData X)
 void MVHistogramGrid::setHistogramViews(const QList<HistogramView*> views)
 {
     MVGridView::clearViews();
+    d->m_hovered_index = -1;
     foreach (HistogramView* V, views) {
         MVGridView::addView(V);
     }
 
     for (int jj = 0; jj < MVGridView::viewCount(); jj++) {
         HistogramView* HV = qobject_cast<HistogramView*>(MVGridView::view(jj));
-        connect(HV, SIGNAL(clicked(Qt::KeyboardModifiers)), this, SLOT(slot_histogram_view_clicked(Qt::KeyboardModifiers)));
-        //connect(HV, SIGNAL(activated()), this, SLOT(slot_histogram_view_activated()));
-        connect(HV, SIGNAL(activated(QPoint)), this, SLOT(slot_context_menu(QPoint)));
+        //clicks and double-clicks come from the grid (signalViewClicked, signalViewActivated)
+        connect(HV, SIGNAL(repaintNeeded()), this, SLOT(slot_histogram_view_repaint_needed()));
         //connect(HV, SIGNAL(signalExportHistogramMatrixImage()), this, SLOT(slot_export_image()));
     }
     d->update_layout();
 
     d->do_highlighting_and_captions();
+    this->updateViews();
 }
 
 QList<HistogramView*> MVHistogramGrid::histogramViews()
@@ -199,18 +206,49 @@ bool MVHistogramGrid::pairMode() const
     return d->m_pair_mode;
 }
 
-void MVHistogramGrid::slot_histogram_view_clicked(Qt::KeyboardModifiers modifiers)
+void MVHistogramGrid::paintView(QPainter& painter, int index, int W, int H)
+{
+    HistogramView* HV = qobject_cast<HistogramView*>(MVGridView::view(index));
+    if (!HV)
+        return;
+    HV->paint(painter, W, H);
+}
+
+void MVHistogramGrid::hoverView(int index, const QPoint& pos, int W, int H)
+{
+    int previous_index = d->m_hovered_index;
+    d->m_hovered_index = index;
+    if ((previous_index != index) && (previous_index >= 0) && (previous_index < viewCount())) {
+        HistogramView* HV = qobject_cast<HistogramView*>(MVGridView::view(previous_index));
+        HV->setHovered(false);
+        HV->setHoveredBinIndex(-1);
+        this->updateView(previous_index);
+    }
+    if (index < 0)
+        return;
+    HistogramView* HV = qobject_cast<HistogramView*>(MVGridView::view(index));
+    if (!HV)
+        return;
+    HV->setHovered(true);
+    HV->setHoveredBinIndex(HV->binIndexAt(pos, W, H));
+    this->updateView(index);
+}
+
+void MVHistogramGrid::slot_view_clicked(int index, Qt::KeyboardModifiers modifiers)
 {
     MVContext* c = qobject_cast<MVContext*>(mvContext());
     Q_ASSERT(c);
 
+    RenderableWidget* V = MVGridView::view(index);
+    if (!V)
+        return;
     if (d->m_pair_mode) {
-        int k1 = sender()->property("k1").toInt();
-        int k2 = sender()->property("k2").toInt();
+        int k1 = V->property("k1").toInt();
+        int k2 = V->property("k2").toInt();
         c->clickClusterPair(ClusterPair(k1, k2), modifiers);
     }
     else {
-        int k = sender()->property("k").toInt();
+        int k = V->property("k").toInt();
         if (modifiers & Qt::ControlModifier) {
             c->clickCluster(k, Qt::ControlModifier);
         }
@@ -243,20 +281,20 @@ void MVHistogramGrid::slot_update_highlighting()
     d->do_highlighting_and_captions();
 }
 
-void MVHistogramGrid::slot_context_menu(const QPoint& pt)
+void MVHistogramGrid::slot_view_activated(int index, const QPoint& pos)
 {
-    // IMO this code doesn't work correctly as the "activated" signal
-    // doesn't "select" the HV thus we're being triggered over a widget
-    // that is different than the selected HV
-
-    HistogramView* HV = qobject_cast<HistogramView*>(sender());
-    if (!HV)
-        return;
+    Q_UNUSED(index)
     // send yourself a context menu request
-    QContextMenuEvent e(QContextMenuEvent::Mouse, mapFromGlobal(HV->mapToGlobal(pt)));
+    QContextMenuEvent e(QContextMenuEvent::Mouse, pos);
     QCoreApplication::sendEvent(this, &e);
 }
 
+void MVHistogramGrid::slot_histogram_view_repaint_needed()
+{
+    //repaints are coalesced by the canvas, so a batch of changes (e.g. highlighting) costs one repaint
+    this->updateViews();
+}
+
 void MVHistogramGridPrivate::do_highlighting_and_captions()
 {
     MVContext* c = qobject_cast<MVContext*>(q->mvContext());
@@ -47,13 +47,16 @@ protected:
     void prepareMimeData(QMimeData& mimeData, const QPoint& pos);
     void setPairMode(bool val);
     bool pairMode() const;
+    void paintView(QPainter& painter, int index, int W, int H) Q_DECL_OVERRIDE;
+    void hoverView(int index, const QPoint& pos, int W, int H) Q_DECL_OVERRIDE;
 
 private slots:
-    void slot_histogram_view_clicked(Qt::KeyboardModifiers modifiers);
+    void slot_view_clicked(int index, Qt::KeyboardModifiers modifiers);
+    void slot_view_activated(int index, const QPoint& pos);
+    void slot_histogram_view_repaint_needed();
     void slot_cluster_attributes_changed(int cluster_number);
     void slot_cluster_pair_attributes_changed(ClusterPair pair);
     void slot_update_highlighting();
-    void slot_context_menu(const QPoint& pt);
 
 private:
     MVHistogramGridPrivate* d;
@@ -22,9 +22,17 @@
 #include <QThread>
 #include <QTime>
 #include <QTimer>
+#include <QtConcurrentRun>
+#include <math.h>
 #include "mda.h"
 #include "mlcommon.h"
 
+#define SPIKE_SPRAY_PROGRESS_INTERVAL_MSEC 300
+#define SPIKE_SPRAY_NUM_BATCHES 50 //the clips are rasterized in batches, between which progress is reported
+#define SPIKE_SPRAY_BANDS_PER_THREAD 2
+#define SPIKE_SPRAY_MAX_ALPHA 0.995 //an opaque clip would have infinite optical depth
+#define SPIKE_SPRAY_DENSITY_MODE_MIN_CLIPS 20000 //with more clips than this, render a density map
+
 /*!
  * \class MVSpikeSprayPanelControl
  * \brief The MVSpikeSprayPanelControl class provides a way to render a spike spray panel
@@ -228,6 +236,14 @@ QColor brighten(QColor col, double factor)
 /*!
  * \brief MVSSRenderer::render starts the rendering operation.
  *
+ * Rather than painting a path per channel per clip, the clips are rasterized into per-pixel
+ * accumulators: each clip adds weight*coverage (and the correspondingly weighted color) to the
+ * pixels its lines cross. In the normal mode the weight is the optical depth -log(1-alpha) of the
+ * clip color, so the composite matches painting the clips over one another, but it does not depend
+ * on their order. This lets horizontal bands of the image be rasterized in parallel, and the image
+ * is composited only when progress is reported. In the density mode every clip has weight one and
+ * the opacity follows the log of the density, which keeps huge clusters readable.
+ *
  * \warning This method can run for a int period of times.
  */
 void MVSSRenderer::render()
@@ -242,8 +258,6 @@ void MVSSRenderer::render()
     image.fill(Qt::transparent); // and make it transparent
     replaceImage(image); // replace the current image
     emit imageUpdated(0); // and report we've just begun
-    QPainter painter(&image);
-    painter.setRenderHint(QPainter::Antialiasing);
     // the algorithm is performing lazy memory allocation. This is the last spot we can
     // do the actual allocation (and copy). Bail out if interruption is requested.
     clips = allocator.allocate([this]() { return isInterruptionRequested(); });
@@ -253,50 +267,185 @@ void MVSSRenderer::render()
         qWarning() << "Unexpected sizes: " << colors.count() << L;
         return;
     }
+
+    m_weights.fill(0, W * H);
+    m_weighted_rgb.fill(0, 3 * W * H);
+    m_clip_weights.resize(L);
+    m_clip_rgb.resize(3 * L);
+    for (int i = 0; i < L; i++) {
+        const QColor& col = colors[i];
+        m_clip_weights[i] = density_mode ? 1 : -log(1 - qMin(SPIKE_SPRAY_MAX_ALPHA, col.alphaF()));
+        m_clip_rgb[3 * i + 0] = col.redF();
+        m_clip_rgb[3 * i + 1] = col.greenF();
+        m_clip_rgb[3 * i + 2] = col.blueF();
+    }
+
+    // each band of rows is owned by one task, so the accumulators need no locking
+    int num_bands = qMax(1, SPIKE_SPRAY_BANDS_PER_THREAD * QThread::idealThreadCount());
+    int band_height = qMax(1, (H + num_bands - 1) / num_bands);
+    int batch_size = qMax(1, L / SPIKE_SPRAY_NUM_BATCHES);
     QTime timer;
     timer.start();
-    for (int i = 0; i < L; i++) {
-        if (timer.elapsed() > 300) { // each 300ms report an intermediate result
-            replaceImage(image);
-            emit imageUpdated(100 * i / L);
-            timer.restart();
-        }
+    for (int i1 = 0; i1 < L; i1 += batch_size) {
         if (isInterruptionRequested()) {
             return;
         }
-        render_clip(&painter, i); // render one step
+        int i2 = qMin(L, i1 + batch_size);
+        QList<QFuture<void> > futures;
+        for (int row1 = 0; row1 < H; row1 += band_height) {
+            int row2 = qMin(H, row1 + band_height);
+            futures << QtConcurrent::run([this, i1, i2, row1, row2]() {
+                rasterize_clips(i1, i2, row1, row2);
+            });
+        }
+        for (int b = 0; b < futures.count(); b++) {
+            futures[b].waitForFinished();
+        }
+        if ((timer.elapsed() > SPIKE_SPRAY_PROGRESS_INTERVAL_MSEC) && (i2 < L)) { // report an intermediate result
+            replaceImage(composite());
+            emit imageUpdated(100 * i2 / L);
+            timer.restart();
+        }
+    }
+    if (isInterruptionRequested()) {
+        return;
     }
-    replaceImage(image); // we're done, expose the result
+    replaceImage(composite()); // we're done, expose the result
     emit imageUpdated(100);
 }
 
 /*!
- * \brief MVSSRenderer::render_clip performs rendering of a single clip
+ * \brief MVSSRenderer::rasterize_clips accumulates clips i1..i2-1 into the rows row1..row2-1
  *
  */
-void MVSSRenderer::render_clip(QPainter* painter, int i) const
+void MVSSRenderer::rasterize_clips(int i1, int i2, int row1, int row2)
 {
-    QColor col = colors[i];
     const int M = clips.N1();
     const int T = clips.N2();
-    const double* ptr = clips.constDataPtr() + (M * T * i);
-    QPen pen = painter->pen();
-    pen.setColor(col); // set proper color
-    painter->setPen(pen);
+    if (T < 2)
+        return;
+    // the geometry of coord2pix, evaluated once: x depends only on t, and y is linear in the value
+    QVector<double> xs(T), y_offsets(M);
+    for (int t = 0; t < T; t++) {
+        xs[t] = coord2pix(0, t, 0).x();
+    }
     for (int m = 0; m < M; m++) {
-        QPainterPath path; // we're setting up a painter path
-        for (int t = 0; t < T; t++) {
-            double val = ptr[m + M * t];
-            QPointF pt = coord2pix(m, t, val);
-            if (t == 0) {
-                path.moveTo(pt);
+        y_offsets[m] = coord2pix(m, 0, 0).y();
+    }
+    double y_scale = coord2pix(0, 0, 1).y() - y_offsets.value(0);
+    for (int i = i1; i < i2; i++) {
+        if (isInterruptionRequested()) {
+            return;
+        }
+        const double* ptr = clips.constDataPtr() + (M * T * i);
+        float weight = m_clip_weights[i];
+        const float* rgb = &m_clip_rgb.constData()[3 * i];
+        for (int m = 0; m < M; m++) {
+            double x_prev = xs[0];
+            double y_prev = y_offsets[m] + y_scale * ptr[m];
+            for (int t = 1; t < T; t++) {
+                double y = y_offsets[m] + y_scale * ptr[m + M * t];
+                add_line(x_prev, y_prev, xs[t], y, weight, rgb, row1, row2);
+                x_prev = xs[t];
+                y_prev = y;
             }
-            else {
-                path.lineTo(pt); // plotting a curve
+        }
+    }
+}
+
+/*!
+ * \brief MVSSRenderer::add_line accumulates an antialiased one-pixel line (Wu's algorithm),
+ *        restricted to the rows row1..row2-1
+ *
+ * Samples are taken at the pixel centers along the major axis, half-open at the end point, so
+ * that consecutive segments of a curve do not cover their common point twice.
+ */
+void MVSSRenderer::add_line(double x0, double y0, double x1, double y1, float weight, const float* rgb, int row1, int row2)
+{
+    if ((qMax(y0, y1) < row1 - 1) || (qMin(y0, y1) > row2 + 1)) {
+        return; // entirely outside of the band
+    }
+    bool steep = (qAbs(y1 - y0) > qAbs(x1 - x0));
+    if (steep) {
+        qSwap(x0, y0);
+        qSwap(x1, y1);
+    }
+    if (x0 > x1) {
+        qSwap(x0, x1);
+        qSwap(y0, y1);
+    }
+    double gradient = (x1 > x0) ? (y1 - y0) / (x1 - x0) : 0;
+    // j runs along the major axis (rows if steep, columns otherwise), k along the minor one
+    int j1 = (int)ceil(x0 - 0.5);
+    int j2 = (int)ceil(x1 - 0.5);
+    int num_minor;
+    if (steep) {
+        j1 = qMax(j1, row1);
+        j2 = qMin(j2, row2);
+        num_minor = W;
+    }
+    else {
+        j1 = qMax(j1, 0);
+        j2 = qMin(j2, W);
+        num_minor = H;
+    }
+    float* weights = m_weights.data();
+    float* weighted_rgb = m_weighted_rgb.data();
+    for (int j = j1; j < j2; j++) {
+        double yy = y0 + gradient * (j + 0.5 - x0) - 0.5;
+        int k = (int)floor(yy);
+        float frac = yy - k;
+        for (int kk = k; kk <= k + 1; kk++) {
+            if ((kk < 0) || (kk >= num_minor))
+                continue;
+            int row = steep ? j : kk;
+            int col = steep ? kk : j;
+            if ((row < row1) || (row >= row2))
+                continue;
+            float w = weight * ((kk == k) ? (1 - frac) : frac);
+            int idx = row * W + col;
+            weights[idx] += w;
+            weighted_rgb[3 * idx + 0] += w * rgb[0];
+            weighted_rgb[3 * idx + 1] += w * rgb[1];
+            weighted_rgb[3 * idx + 2] += w * rgb[2];
+        }
+    }
+}
+
+/*!
+ * \brief MVSSRenderer::composite converts the accumulators into an image
+ *
+ */
+QImage MVSSRenderer::composite() const
+{
+    QImage ret(W, H, QImage::Format_ARGB32);
+    const float* weights = m_weights.constData();
+    const float* weighted_rgb = m_weighted_rgb.constData();
+    double log_max_weight = 0;
+    if (density_mode) {
+        float max_weight = 0;
+        for (int idx = 0; idx < W * H; idx++) {
+            max_weight = qMax(max_weight, weights[idx]);
+        }
+        log_max_weight = log(1 + max_weight);
+    }
+    for (int y = 0; y < H; y++) {
+        QRgb* line = (QRgb*)ret.scanLine(y);
+        for (int x = 0; x < W; x++) {
+            int idx = y * W + x;
+            float w = weights[idx];
+            if (w <= 0) {
+                line[x] = qRgba(0, 0, 0, 0);
+                continue;
             }
+            double alpha = density_mode ? log(1 + w) / log_max_weight : 1 - exp(-w);
+            int r = qBound(0, (int)(255 * weighted_rgb[3 * idx + 0] / w), 255);
+            int g = qBound(0, (int)(255 * weighted_rgb[3 * idx + 1] / w), 255);
+            int b = qBound(0, (int)(255 * weighted_rgb[3 * idx + 2] / w), 255);
+            line[x] = qRgba(r, g, b, qBound(0, (int)(255 * alpha), 255));
         }
-        painter->drawPath(path); // render the complete painter path
     }
+    return ret;
 }
 
 QPointF MVSSRenderer::coord2pix(int m, double t, double val) const
@@ -619,6 +768,7 @@ void MVSpikeSprayPanelControl::rerender()
     }
 
     d->renderer->amplitude_factor = amplitude();
+    d->renderer->density_mode = (inds.count() > SPIKE_SPRAY_DENSITY_MODE_MIN_CLIPS);
     d->renderer->W = T * 4;
     d->renderer->H = 1500;
     connect(d->renderer, SIGNAL(imageUpdated(int)), this, SLOT(update(int)));
@@ -115,8 +115,8 @@ public:
     double amplitude_factor;
     int W;
     int H;
+    bool density_mode = false; //color by (log) event density instead of per-clip alpha; for huge clusters
     QPointF coord2pix(int m, double t, double val) const;
-    void render_clip(QPainter* painter, int i) const;
 
     class ClipsAllocator {
     public:
@@ -145,6 +145,16 @@ signals:
     void allocateProgress(int progress);
 
 private:
+    void rasterize_clips(int i1, int i2, int row1, int row2);
+    void add_line(double x0, double y0, double x1, double y1, float weight, const float* rgb, int row1, int row2);
+    QImage composite() const;
+
+    //per-pixel accumulators: total weight, and weighted red, green, blue
+    QVector<float> m_weights;
+    QVector<float> m_weighted_rgb;
+    QVector<float> m_clip_weights;
+    QVector<float> m_clip_rgb;
+
     QImage image_in_progress;
     mutable QMutex image_in_progress_mutex;
     QAtomicInteger<bool> m_int = 0;
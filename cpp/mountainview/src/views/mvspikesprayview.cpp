@@ -44,6 +44,7 @@ public:
     DiskReadMda32 timeseries;
     DiskReadMda firings;
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     QSet<int> labels_to_use;
     int clip_size;
     int max_per_label;
@@ -242,6 +243,7 @@ void MVSpikeSprayView::prepareCalculation()
     this->setCalculatingMessage(QString("Calculating using %1...").arg(timeseries_name));
     d->m_labels_to_render.clear();
     d->m_computer.mlproxy_url = d->m_context->mlProxyUrl();
+    d->m_computer.result_store = d->m_context->resultStore();
     d->m_computer.timeseries = d->m_context->timeseries(timeseries_name);
     d->m_computer.firings = d->m_context->firings();
     d->m_computer.labels_to_use = d->m_labels_to_use;
@@ -494,6 +496,7 @@ void MVSpikeSprayComputer::compute()
         params["max_per_label"] = max_per_label;
         MT.setInputParameters(params);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         firings_out_path = MT.makeOutputFilePath("firings_out");
 
@@ -520,6 +523,7 @@ void MVSpikeSprayComputer::compute()
         params["clip_size"] = clip_size;
         MT.setInputParameters(params);
         MT.setMLProxyUrl(mlproxy_url);
+        MT.setResultStore(result_store.data());
 
         clips_path = MT.makeOutputFilePath("clips_out");
 
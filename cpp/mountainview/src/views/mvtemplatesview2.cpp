@@ -40,8 +40,9 @@ class MVTemplatesView2Calculator {
 public:
     //input
     QString mlproxy_url;
+    QSharedPointer<ProcessResultStore> result_store;
     DiskReadMda32 timeseries;
-    DiskReadMda firings;
+    FiringsTable firings;
     int clip_size;
 
     //output
@@ -52,7 +53,7 @@ public:
     bool loaded_from_static_output = false;
     QJsonObject exportStaticOutput();
     void loadStaticOutput(const QJsonObject& X);
-    static void mv_compute_templates_stdevs(DiskReadMda& templates_out, DiskReadMda& stdevs_out, const QString& mlproxy_url, const QString& timeseries, const QString& firings, int clip_size);
+    static void mv_compute_templates_stdevs(DiskReadMda& templates_out, DiskReadMda& stdevs_out, const QString& mlproxy_url, ProcessResultStore* result_store, const QString& timeseries, const QString& firings, int clip_size);
 };
 
 class MVTemplatesView2Private {
@@ -141,8 +142,9 @@ void MVTemplatesView2::prepareCalculation()
     Q_ASSERT(c);
 
     d->m_calculator.mlproxy_url = c->mlProxyUrl();
+    d->m_calculator.result_store = c->resultStore();
     d->m_calculator.timeseries = c->currentTimeseries();
-    d->m_calculator.firings = c->firings();
+    d->m_calculator.firings = c->firingsTable();
     d->m_calculator.clip_size = c->option("clip_size", 100).toInt();
     update();
 }
@@ -276,7 +278,7 @@ void MVTemplatesView2::slot_set_num_rows(int num_rows)
     d->update_panels();
 }
 
-void MVTemplatesView2Calculator::mv_compute_templates_stdevs(DiskReadMda& templates_out, DiskReadMda& stdevs_out, const QString& mlproxy_url, const QString& timeseries, const QString& firings, int clip_size)
+void MVTemplatesView2Calculator::mv_compute_templates_stdevs(DiskReadMda& templates_out, DiskReadMda& stdevs_out, const QString& mlproxy_url, ProcessResultStore* result_store, const QString& timeseries, const QString& firings, int clip_size)
 {
     TaskProgress task(TaskProgress::Calculate, "mv_compute_templates_stdevs");
     task.log("mlproxy_url: " + mlproxy_url);
@@ -290,6 +292,7 @@ void MVTemplatesView2Calculator::mv_compute_templates_stdevs(DiskReadMda& templa
     params["clip_size"] = clip_size;
     X.setInputParameters(params);
     X.setMLProxyUrl(mlproxy_url);
+    X.setResultStore(result_store);
 
     QString templates_fname = X.makeOutputFilePath("templates_out");
     QString stdevs_fname = X.makeOutputFilePath("stdevs_out");
@@ -318,16 +321,11 @@ void MVTemplatesView2Calculator::compute()
 
     int M = timeseries.N1();
     //int N = timeseries.N2();
-    int L = firings.N2();
     int T = clip_size;
 
-    QVector<int> labels;
-
     task.log("Setting up labels");
     task.setProgress(0.2);
-    for (int i = 0; i < L; i++) {
-        labels << (int)firings.value(2, i);
-    }
+    firings.load();
 
     if (MLUtil::threadInterruptRequested()) {
         task.error("Halted *");
@@ -338,15 +336,15 @@ void MVTemplatesView2Calculator::compute()
 
     task.setLabel("Computing templates");
     task.setProgress(0.4);
-    int K = MLCompute::max(labels);
+    int K = firings.K();
 
     QString timeseries_path = timeseries.makePath();
-    QString firings_path = firings.makePath();
+    QString firings_path = firings.firings().makePath();
 
     task.log("mp_compute_templates_stdevs: " + mlproxy_url + " timeseries_path=" + timeseries_path + " firings_path=" + firings_path);
     task.setProgress(0.6);
     DiskReadMda templates0, stdevs0;
-    mv_compute_templates_stdevs(templates0, stdevs0, mlproxy_url, timeseries_path, firings_path, T);
+    mv_compute_templates_stdevs(templates0, stdevs0, mlproxy_url, result_store.data(), timeseries_path, firings_path, T);
     if (MLUtil::threadInterruptRequested()) {
         task.error("Halted **");
         return;
@@ -362,11 +360,7 @@ void MVTemplatesView2Calculator::compute()
         ClusterData2 CD;
         CD.k = k;
         CD.channel = 0;
-        for (int i = 0; i < L; i++) {
-            if (labels[i] == k) {
-                CD.num_events++;
-            }
-        }
+        CD.num_events = firings.labelCount(k);
         if (MLUtil::threadInterruptRequested()) {
             task.error("Halted ****");
             return;
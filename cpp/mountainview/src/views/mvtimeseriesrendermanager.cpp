@@ -19,79 +19,125 @@
 #include <QImage>
 #include <QPainter>
 #include <QThread>
-#include <QTimer>
-#include <QCoreApplication>
+#include <QThreadPool>
 #include <QImageWriter>
+#include <math.h>
+#include "mvenveloperasterizer.h"
 #include "taskprogress.h"
+#include <icounter.h>
+#include <objectregistry.h>
 
 #define PANEL_NUM_POINTS 1200
-#define PANEL_WIDTH PANEL_NUM_POINTS * 2
-#define PANEL_HEIGHT_PER_CHANNEL 30
-#define MIN_PANEL_HEIGHT 600
-#define MAX_PANEL_HEIGHT 1800
-#define PANEL_HEIGHT(M) (int) qMin(MAX_PANEL_HEIGHT * 1.0, qMax(MIN_PANEL_HEIGHT * 1.0, PANEL_HEIGHT_PER_CHANNEL * M * 1.0))
 
-#define MAX_NUM_IMAGE_PIXELS 50 * 1e6
+#define MAX_NUM_PANEL_ENTRIES 25 * 1e6 //total number of cached min/max values
+#define DEFAULT_PREFETCH_BUDGET_BYTES 80 * 1e6
+#define PREFETCH_LOOKAHEAD_SEC 1.0 //how far ahead of the motion to prefetch
+#define MAX_PREFETCH_PANELS_AHEAD 8
+#define PREFETCH_ZOOM_THRESHOLD 0.2 //zoom velocity (log range ratio per sec) considered as zooming
 
-struct ImagePanel {
+//the min/max envelope of one block of the timeseries at a given downsampling factor.
+//It does not depend on the amplitude factor, which is only applied when rasterizing
+struct EnvelopePanel {
     int ds_factor;
-    int panel_width;
     int panel_num_points;
     int index;
-    double amp_factor;
-    QImage image;
-    Mda32 min_data, max_data;
+    Mda32 min_data, max_data; //M x (panel_num_points+1), the last column overlaps the next panel
     QString make_code();
+    double t1() const { return 1.0 * index * panel_num_points * ds_factor; }
+    double t2() const { return 1.0 * (index + 1) * panel_num_points * ds_factor; }
 };
 
 class MVTimeSeriesRenderManagerPrivate {
 public:
     MVTimeSeriesRenderManager* q;
-    MultiScaleTimeSeries m_ts;
-    QMap<QString, ImagePanel> m_image_panels;
-    QSet<QString> m_queued_or_running_panel_codes;
-    ThreadManager m_thread_manager;
-    double m_total_num_image_pixels;
+    QSharedPointer<MultiScaleTimeSeries> m_ts;
+    QMap<QString, EnvelopePanel> m_panels;
+    QMap<QString, MVTimeSeriesRenderManagerTask*> m_tasks; //queued or running, by panel code
+    QSet<MVTimeSeriesRenderManagerTask*> m_outstanding_tasks; //including cancelled ones that have not finished yet
+    QThreadPool m_thread_pool;
+    double m_total_num_panel_entries;
     QList<QColor> m_channel_colors;
     double m_visible_minimum, m_visible_maximum;
 
-    ImagePanel render_panel(ImagePanel p);
-    void start_compute_panel(ImagePanel p);
+    //the last composed image, if it was complete (no placeholders). It is reused while nothing it depends on
+    //has changed, e.g. when only the cursor moves
+    QImage m_frame;
+    double m_frame_t1 = 0, m_frame_t2 = 0, m_frame_amp_factor = 0;
+    bool m_frame_valid = false;
+
+    double m_pan_velocity = 0, m_zoom_velocity = 0;
+    double m_prefetch_budget_bytes = DEFAULT_PREFETCH_BUDGET_BYTES;
+    QSet<QString> m_prefetched_codes; //started speculatively and not yet seen on screen
+    IIntCounter* m_prefetch_hits_counter = 0;
+    IIntCounter* m_prefetch_misses_counter = 0;
+
+    void get_panel_params(double t1, double t2, double W, int& ds_factor, int& panel_num_points);
+    QList<EnvelopePanel> panels_covering(double t1, double t2, int ds_factor, int panel_num_points);
+    void add_prefetch_panels(QList<EnvelopePanel>& panels, QList<int>& priorities, double t1, double t2, double W);
+    void record_prefetch_outcome(const QString& code);
+    EnvelopePanel* find_panel(EnvelopePanel p, bool& is_placeholder);
+    void start_compute_panel(EnvelopePanel p, int priority);
     void stop_compute_panel(const QString& code);
-    ImagePanel* closest_ancestor_panel(ImagePanel p);
-    void cleanup_images(double t1, double t2, double amp_factor);
+    void stop_all_compute_panels();
+    EnvelopePanel* closest_ancestor_panel(EnvelopePanel p);
+    void cleanup_panels(double t1, double t2, const QSet<QString>& codes_to_keep);
 };
 
 MVTimeSeriesRenderManager::MVTimeSeriesRenderManager()
 {
     d = new MVTimeSeriesRenderManagerPrivate;
     d->q = this;
-    d->m_total_num_image_pixels = 0;
+    d->m_total_num_panel_entries = 0;
     d->m_visible_minimum = d->m_visible_maximum = 0;
+    d->m_ts = QSharedPointer<MultiScaleTimeSeries>(new MultiScaleTimeSeries);
+    d->m_thread_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+
+    ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
+    if (manager) {
+        d->m_prefetch_hits_counter = static_cast<IIntCounter*>(manager->counter("timeseries_prefetch_hits"));
+        d->m_prefetch_misses_counter = static_cast<IIntCounter*>(manager->counter("timeseries_prefetch_misses"));
+    }
 }
 
 MVTimeSeriesRenderManager::~MVTimeSeriesRenderManager()
 {
+    d->stop_all_compute_panels();
+    d->m_thread_pool.waitForDone();
+    qDeleteAll(d->m_outstanding_tasks);
     delete d;
 }
 
 void MVTimeSeriesRenderManager::clear()
 {
-    d->m_image_panels.clear();
-    d->m_total_num_image_pixels = 0;
-    d->m_queued_or_running_panel_codes.clear();
-    d->m_thread_manager.clear();
+    d->m_panels.clear();
+    d->m_total_num_panel_entries = 0;
+    d->m_frame_valid = false;
+    d->m_prefetched_codes.clear();
+    d->stop_all_compute_panels();
 }
 
 void MVTimeSeriesRenderManager::setMultiScaleTimeSeries(MultiScaleTimeSeries ts)
 {
-    d->m_ts = ts;
     this->clear();
+    //a new handle, so that tasks still running on the old one are not affected
+    d->m_ts = QSharedPointer<MultiScaleTimeSeries>(new MultiScaleTimeSeries(ts));
 }
 
 void MVTimeSeriesRenderManager::setChannelColors(const QList<QColor>& colors)
 {
     d->m_channel_colors = colors;
+    d->m_frame_valid = false;
+}
+
+void MVTimeSeriesRenderManager::setMotion(double pan_velocity, double zoom_velocity)
+{
+    d->m_pan_velocity = pan_velocity;
+    d->m_zoom_velocity = zoom_velocity;
+}
+
+void MVTimeSeriesRenderManager::setPrefetchBudget(double num_bytes)
+{
+    d->m_prefetch_budget_bytes = num_bytes;
 }
 
 double MVTimeSeriesRenderManager::visibleMinimum() const
@@ -114,159 +160,197 @@ QImage MVTimeSeriesRenderManager::getImage(double t1, double t2, double amp_fact
         return tmp;
     }
 
+    if ((d->m_frame_valid) && (d->m_frame_t1 == t1) && (d->m_frame_t2 == t2) && (d->m_frame_amp_factor == amp_factor) && (d->m_frame.size() == QSize((int)W, (int)H))) {
+        return d->m_frame;
+    }
+
     QImage ret(W, H, QImage::Format_ARGB32);
     QColor transparent(0, 0, 0, 6);
     ret.fill(transparent);
     QPainter painter(&ret);
 
-    int ds_factor = 1;
-    int panel_width = PANEL_WIDTH;
-    int panel_num_points = PANEL_NUM_POINTS;
-    //points per pixel should be around 1
-    while (((t2 - t1) / ds_factor) / W > 3) {
-        ds_factor *= 3;
-    }
-    double points_per_pixel = ((t2 - t1) / ds_factor) / W;
-    if (points_per_pixel < 1.0 / 3) {
-        panel_num_points /= 3;
-    }
-    if ((t2 - t1 < panel_num_points)) {
-        panel_num_points /= 3;
-    }
+    int ds_factor, panel_num_points;
+    d->get_panel_params(t1, t2, W, ds_factor, panel_num_points);
+
+    //the envelopes of all visible panels are rasterized together at the final resolution
+    MVEnvelopeRasterizer rasterizer(d->m_ts->N1(), ret.width(), t1, t2);
 
     QSet<QString> panel_codes_needed;
-    QList<ImagePanel> panels_to_start;
+    QList<EnvelopePanel> panels_to_start;
+    QList<int> priorities;
 
     d->m_visible_minimum = d->m_visible_maximum = 0;
+    bool complete = true;
 
     int ind1 = (int)(t1 / (ds_factor * panel_num_points));
     int ind2 = (int)(t2 / (ds_factor * panel_num_points));
     for (int iii = ind1; iii <= ind2; iii++) {
-        ImagePanel p;
-        p.amp_factor = amp_factor;
+        EnvelopePanel p;
         p.ds_factor = ds_factor;
-        p.panel_width = panel_width;
         p.panel_num_points = panel_num_points;
         p.index = iii;
         panel_codes_needed.insert(p.make_code());
-        if (!d->m_image_panels.contains(p.make_code())) {
-            if (!d->m_queued_or_running_panel_codes.contains(p.make_code())) {
-                panels_to_start << p;
-            }
+        d->record_prefetch_outcome(p.make_code());
+        if (!d->m_panels.contains(p.make_code())) {
+            panels_to_start << p;
+            priorities << MVTimeSeriesRenderManagerTask::VisiblePriority;
         }
 
-        p = d->render_panel(p);
-        d->m_visible_minimum = qMin(d->m_visible_minimum, 1.0 * p.min_data.minimum());
-        d->m_visible_maximum = qMax(d->m_visible_maximum, 1.0 * p.max_data.maximum());
-        if (p.image.width()) {
-            double a1 = (iii * panel_num_points * ds_factor - t1) * 1.0 / (t2 - t1) * W;
-            double a2 = ((iii + 1) * panel_num_points * ds_factor - t1) * 1.0 / (t2 - t1) * W;
-            if (a2 - a1 < 4000) { //we avoid running out of memory
-                painter.drawImage(a1, 0, p.image.scaled(a2 - a1, H, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+        double a1 = (p.t1() - t1) / (t2 - t1) * W;
+        double a2 = (p.t2() - t1) / (t2 - t1) * W;
+        bool is_placeholder;
+        EnvelopePanel* P = d->find_panel(p, is_placeholder);
+        if (P) {
+            rasterizer.addData(P->min_data, P->max_data, P->t1(), P->ds_factor, p.t1(), p.t2());
+            d->m_visible_minimum = qMin(d->m_visible_minimum, 1.0 * P->min_data.minimum());
+            d->m_visible_maximum = qMax(d->m_visible_maximum, 1.0 * P->max_data.maximum());
+            if (is_placeholder) {
+                //a coarser level stands in until this panel is ready
+                painter.fillRect(QRectF(a1, 0, a2 - a1, H), QColor(255, 0, 0, 6));
+                complete = false;
             }
-            else {
-                QRectF rect(0, 0, ret.width(), ret.height());
-                painter.fillRect(rect, Qt::lightGray);
-                QString txt = "Image stretched too far.";
-                painter.setPen(Qt::black);
-                painter.drawText(rect, Qt::AlignCenter | Qt::AlignVCenter, txt);
+        }
+        else {
+            painter.fillRect(QRectF(a1, 0, a2 - a1, H), QColor(0, 0, 0, 10));
+            complete = false;
+        }
+    }
+    painter.end();
+    rasterizer.render(ret, amp_factor, d->m_channel_colors, (ds_factor == 1) ? 2 : 1);
+
+    //speculatively load what is likely to be needed next, within the prefetch budget
+    {
+        QList<EnvelopePanel> prefetch;
+        QList<int> prefetch_priorities;
+        d->add_prefetch_panels(prefetch, prefetch_priorities, t1, t2, W);
+        for (int i = 0; i < prefetch.count(); i++) {
+            QString code = prefetch[i].make_code();
+            if (panel_codes_needed.contains(code))
+                continue;
+            panel_codes_needed.insert(code);
+            if (!d->m_panels.contains(code)) {
+                panels_to_start << prefetch[i];
+                priorities << prefetch_priorities[i];
             }
         }
     }
 
-    //stop the threads that aren't needed
-    foreach (QString code, d->m_queued_or_running_panel_codes) {
+    //stop the tasks that aren't needed
+    foreach (QString code, d->m_tasks.keys()) {
         if (!panel_codes_needed.contains(code)) {
             d->stop_compute_panel(code);
         }
     }
 
     for (int i = 0; i < panels_to_start.count(); i++) {
-        d->start_compute_panel(panels_to_start[i]);
+        d->start_compute_panel(panels_to_start[i], priorities[i]);
+    }
+    foreach (QString code, d->m_prefetched_codes) {
+        if (!panel_codes_needed.contains(code))
+            d->m_prefetched_codes.remove(code); //the prediction did not pan out
     }
 
-    if (d->m_total_num_image_pixels > MAX_NUM_IMAGE_PIXELS) {
-        d->cleanup_images(t1, t2, amp_factor);
+    if (d->m_total_num_panel_entries > MAX_NUM_PANEL_ENTRIES) {
+        d->cleanup_panels(t1, t2, panel_codes_needed);
     }
 
+    d->m_frame = ret;
+    d->m_frame_t1 = t1;
+    d->m_frame_t2 = t2;
+    d->m_frame_amp_factor = amp_factor;
+    d->m_frame_valid = complete;
+
     return ret;
 }
 
-void MVTimeSeriesRenderManager::slot_thread_finished()
+void MVTimeSeriesRenderManager::slot_task_finished()
 {
-    MVTimeSeriesRenderManagerThread* thread = qobject_cast<MVTimeSeriesRenderManagerThread*>(sender());
-    if (!thread)
+    MVTimeSeriesRenderManagerTask* task = qobject_cast<MVTimeSeriesRenderManagerTask*>(sender());
+    if (!task)
         return;
-    ImagePanel p;
-    p.amp_factor = thread->amp_factor;
-    p.ds_factor = thread->ds_factor;
-    p.panel_width = thread->panel_width;
-    p.panel_num_points = thread->panel_num_points;
-    p.index = thread->index;
+    d->m_outstanding_tasks.remove(task);
+    task->deleteLater();
+    EnvelopePanel p;
+    p.ds_factor = task->ds_factor;
+    p.panel_num_points = task->panel_num_points;
+    p.index = task->index;
     QString code = p.make_code();
-    d->m_queued_or_running_panel_codes.remove(code);
-
-    if (thread->image.width()) {
-        d->m_image_panels[code] = p;
-        d->m_image_panels[code].image = thread->image;
-        d->m_image_panels[code].min_data = thread->min_data;
-        d->m_image_panels[code].max_data = thread->max_data;
-        d->m_total_num_image_pixels += thread->image.width() * thread->image.height();
+    if (d->m_tasks.value(code) != task)
+        return; //cancelled
+    d->m_tasks.remove(code);
+
+    if ((!task->isCancelled()) && (task->min_data.N2())) {
+        p.min_data = task->min_data;
+        p.max_data = task->max_data;
+        d->m_panels[code] = p;
+        d->m_total_num_panel_entries += p.min_data.totalSize() + p.max_data.totalSize();
+        d->m_frame_valid = false;
         emit updated();
     }
-    else {
-    }
-
-    thread->deleteLater();
 }
 
-QString ImagePanel::make_code()
+QString EnvelopePanel::make_code()
 {
-    return QString("amp=%1.ds=%2.pw=%3.pnp=%4.ind=%5").arg(this->amp_factor).arg(this->ds_factor).arg(this->panel_width).arg(this->panel_num_points).arg(this->index);
+    return QString("ds=%1.pnp=%2.ind=%3").arg(this->ds_factor).arg(this->panel_num_points).arg(this->index);
 }
 
-void MVTimeSeriesRenderManagerPrivate::start_compute_panel(ImagePanel p)
+void MVTimeSeriesRenderManagerPrivate::start_compute_panel(EnvelopePanel p, int priority)
 {
-    if (m_queued_or_running_panel_codes.contains(p.make_code()))
+    QString code = p.make_code();
+    if (m_tasks.contains(code))
+        return;
+    //until the multi-scale pyramid is ready, only panels that can be computed from raw reads are started
+    if (!m_ts->canGetData(p.index * p.panel_num_points, (p.index + 1) * p.panel_num_points, p.ds_factor))
         return;
-    MVTimeSeriesRenderManagerThread* thread = new MVTimeSeriesRenderManagerThread;
-    QObject::connect(thread, SIGNAL(finished()), q, SLOT(slot_thread_finished()));
-    thread->amp_factor = p.amp_factor;
-    thread->ds_factor = p.ds_factor;
-    thread->panel_width = p.panel_width;
-    thread->panel_num_points = p.panel_num_points;
-    thread->index = p.index;
-    thread->ts = m_ts;
-    thread->channel_colors = m_channel_colors;
-    m_queued_or_running_panel_codes.insert(p.make_code());
-    m_thread_manager.start(p.make_code(), thread);
+    MVTimeSeriesRenderManagerTask* task = new MVTimeSeriesRenderManagerTask;
+    task->ds_factor = p.ds_factor;
+    task->panel_num_points = p.panel_num_points;
+    task->index = p.index;
+    task->ts = m_ts;
+    QObject::connect(task, SIGNAL(finished()), q, SLOT(slot_task_finished()), Qt::QueuedConnection);
+    if (priority == MVTimeSeriesRenderManagerTask::VisiblePriority) {
+        if (m_prefetch_misses_counter)
+            m_prefetch_misses_counter->add(1);
+    }
+    else {
+        m_prefetched_codes.insert(code);
+    }
+    m_tasks[code] = task;
+    m_outstanding_tasks.insert(task);
+    m_thread_pool.start(task, priority);
 }
 
 void MVTimeSeriesRenderManagerPrivate::stop_compute_panel(const QString& code)
 {
-    m_queued_or_running_panel_codes.remove(code);
-    m_thread_manager.stop(code);
+    MVTimeSeriesRenderManagerTask* task = m_tasks.value(code);
+    if (!task)
+        return;
+    //the task is deleted in slot_task_finished once it has returned
+    task->cancel();
+    m_tasks.remove(code);
 }
 
-ImagePanel* MVTimeSeriesRenderManagerPrivate::closest_ancestor_panel(ImagePanel p)
+void MVTimeSeriesRenderManagerPrivate::stop_all_compute_panels()
 {
-    QList<ImagePanel*> candidates;
-    QStringList keys = m_image_panels.keys();
+    foreach (MVTimeSeriesRenderManagerTask* task, m_tasks) {
+        task->cancel();
+    }
+    m_tasks.clear();
+}
+
+EnvelopePanel* MVTimeSeriesRenderManagerPrivate::closest_ancestor_panel(EnvelopePanel p)
+{
+    QList<EnvelopePanel*> candidates;
+    QStringList keys = m_panels.keys();
     foreach (QString key, keys) {
-        ImagePanel* pp = &m_image_panels[key];
-        if (pp->amp_factor == p.amp_factor) {
-            double t1 = p.index * p.ds_factor * p.panel_num_points;
-            double t2 = (p.index + 1) * p.ds_factor * p.panel_num_points;
-            double s1 = pp->index * pp->ds_factor * p.panel_num_points;
-            double s2 = (pp->index + 1) * pp->ds_factor * p.panel_num_points;
-            if ((s1 <= t1) && (t2 <= s2)) {
-                candidates << pp;
-            }
+        EnvelopePanel* pp = &m_panels[key];
+        if ((pp->t1() <= p.t1()) && (p.t2() <= pp->t2())) {
+            candidates << pp;
         }
     }
     if (candidates.isEmpty())
         return 0;
-    ImagePanel* ret = candidates[0];
+    EnvelopePanel* ret = candidates[0];
     int best_ds_factor = ret->ds_factor;
     for (int i = 0; i < candidates.count(); i++) {
         if (candidates[i]->ds_factor < best_ds_factor) {
@@ -277,225 +361,164 @@ ImagePanel* MVTimeSeriesRenderManagerPrivate::closest_ancestor_panel(ImagePanel
     return ret;
 }
 
-void MVTimeSeriesRenderManagerPrivate::cleanup_images(double t1, double t2, double amp_factor)
+void MVTimeSeriesRenderManagerPrivate::cleanup_panels(double t1, double t2, const QSet<QString>& codes_to_keep)
 {
-    QStringList keys = m_image_panels.keys();
+    QStringList keys = m_panels.keys();
     foreach (QString key, keys) {
-        ImagePanel* P = &m_image_panels[key];
-        double s1 = P->index * P->ds_factor * P->panel_num_points;
-        double s2 = (P->index + 1) * P->ds_factor * P->panel_num_points;
-        if (((s2 < t1) || (s1 > t2)) || (P->amp_factor != amp_factor)) {
-            //does not intersect or different amplitude
-            m_total_num_image_pixels -= P->image.width() * P->image.height();
-            m_image_panels.remove(key);
+        if (codes_to_keep.contains(key))
+            continue; //visible or prefetched
+        EnvelopePanel* P = &m_panels[key];
+        if ((P->t2() < t1) || (P->t1() > t2)) {
+            //does not intersect
+            m_total_num_panel_entries -= P->min_data.totalSize() + P->max_data.totalSize();
+            m_panels.remove(key);
         }
-        if (m_total_num_image_pixels < MAX_NUM_IMAGE_PIXELS * 0.5)
+        if (m_total_num_panel_entries < MAX_NUM_PANEL_ENTRIES * 0.5)
             return;
     }
 }
 
-QColor MVTimeSeriesRenderManagerThread::get_channel_color(int m)
+void MVTimeSeriesRenderManagerPrivate::get_panel_params(double t1, double t2, double W, int& ds_factor, int& panel_num_points)
 {
-    if (channel_colors.isEmpty())
-        return Qt::black;
-    return channel_colors[m % channel_colors.count()];
+    ds_factor = 1;
+    panel_num_points = PANEL_NUM_POINTS;
+    //points per pixel should be around 1
+    while (((t2 - t1) / ds_factor) / W > 3) {
+        ds_factor *= 3;
+    }
+    double points_per_pixel = ((t2 - t1) / ds_factor) / W;
+    if (points_per_pixel < 1.0 / 3) {
+        panel_num_points /= 3;
+    }
+    if ((t2 - t1 < panel_num_points)) {
+        panel_num_points /= 3;
+    }
 }
 
-void MVTimeSeriesRenderManagerThread::run()
+QList<EnvelopePanel> MVTimeSeriesRenderManagerPrivate::panels_covering(double t1, double t2, int ds_factor, int panel_num_points)
 {
-    int M = ts.N1();
-    if (!M)
-        return;
-
-    if (MLUtil::threadInterruptRequested())
-        return;
-
-    QImage image0 = QImage(panel_width, PANEL_HEIGHT(M), QImage::Format_ARGB32);
-    QColor transparent(0, 0, 0, 0);
-    image0.fill(transparent);
-
-    if (MLUtil::threadInterruptRequested())
-        return;
-
-    QPainter painter(&image0);
-    painter.setRenderHint(QPainter::Antialiasing);
-
-    int t1 = index * panel_num_points;
-    int t2 = (index + 1) * panel_num_points;
-
-    Mda32 Xmin, Xmax;
-    ts.getData(Xmin, Xmax, t1, t2, ds_factor);
+    QList<EnvelopePanel> ret;
+    int ind1 = (int)(qMax(0.0, t1) / (ds_factor * panel_num_points));
+    int ind2 = (int)(qMin(m_ts->N2() - 1.0, t2) / (ds_factor * panel_num_points));
+    for (int iii = ind1; iii <= ind2; iii++) {
+        EnvelopePanel p;
+        p.ds_factor = ds_factor;
+        p.panel_num_points = panel_num_points;
+        p.index = iii;
+        ret << p;
+    }
+    return ret;
+}
 
-    if (MLUtil::threadInterruptRequested())
+void MVTimeSeriesRenderManagerPrivate::add_prefetch_panels(QList<EnvelopePanel>& panels, QList<int>& priorities, double t1, double t2, double W)
+{
+    int M = m_ts->N1();
+    double bytes_per_panel = 2.0 * M * (PANEL_NUM_POINTS + 1) * sizeof(dtype32);
+    int max_num_panels = (int)(m_prefetch_budget_bytes / bytes_per_panel);
+    if (max_num_panels <= 0)
         return;
 
-    double space = 0;
-    double channel_height = (PANEL_HEIGHT(M) - (M - 1) * space) / M;
-    int y0 = 0;
-    QPen pen = painter.pen();
-    for (int m = 0; m < M; m++) {
-        if (MLUtil::threadInterruptRequested())
-            return;
-        pen.setColor(get_channel_color(m));
-        if (ds_factor == 1)
-            pen.setWidth(3);
-        painter.setPen(pen);
-        QRectF geom(0, y0, panel_width, channel_height);
-        /*
-        QPainterPath path;
-        for (int ii = t1; ii <= t2; ii++) {
-            double val_min = Xmin.value(m, ii - t1);
-            double val_max = Xmax.value(m, ii - t1);
-            double pctx = (ii - t1) * 1.0 / (t2 - t1);
-            double pcty_min = 1 - (val_min * amp_factor + 1) / 2;
-            double pcty_max = 1 - (val_max * amp_factor + 1) / 2;
-            QPointF pt_min = QPointF(geom.x() + pctx * geom.width(), geom.y() + pcty_min * geom.height());
-            QPointF pt_max = QPointF(geom.x() + pctx * geom.width(), geom.y() + pcty_max * geom.height());
-            if (ii == t1)
-                path.moveTo(pt_min);
-            else
-                path.lineTo(pt_min);
-            path.lineTo(pt_max);
-        }
-        painter.drawPath(path);
-        */
-        QPainterPath path;
-        QPointF first;
-        for (int ii = t1; ii <= t2; ii++) {
-            double val_min = Xmin.value(m, ii - t1);
-            double pctx = (ii - t1) * 1.0 / (t2 - t1);
-            double pcty_min = 1 - (val_min * amp_factor + 1) / 2;
-            QPointF pt_min = QPointF(geom.x() + pctx * geom.width(), geom.y() + pcty_min * geom.height());
-            if (ii == t1) {
-                first = pt_min;
-                path.moveTo(pt_min);
-            }
-            else
-                path.lineTo(pt_min);
-        }
-        if (ds_factor > 1) {
-            for (int ii = t2; ii >= t1; ii--) {
-                double val_max = Xmax.value(m, ii - t1);
-                double pctx = (ii - t1) * 1.0 / (t2 - t1);
-                double pcty_max = 1 - (val_max * amp_factor + 1) / 2;
-                QPointF pt_max = QPointF(geom.x() + pctx * geom.width(), geom.y() + pcty_max * geom.height());
-                path.lineTo(pt_max);
-            }
-            path.lineTo(first);
-            painter.fillPath(path, painter.pen().color());
-        }
-        else {
-            painter.drawPath(path);
+    int ds_factor, panel_num_points;
+    get_panel_params(t1, t2, W, ds_factor, panel_num_points);
+    double panel_span = 1.0 * ds_factor * panel_num_points;
+
+    QList<EnvelopePanel> candidates;
+    QList<int> candidate_priorities;
+
+    //panels in the direction of motion, as far as we expect to travel within the lookahead time
+    //(one on each side when at rest)
+    int num_ahead = (int)ceil(fabs(m_pan_velocity) * PREFETCH_LOOKAHEAD_SEC / panel_span);
+    num_ahead = qMax(1, qMin(MAX_PREFETCH_PANELS_AHEAD, num_ahead));
+    if (m_pan_velocity >= 0) {
+        candidates.append(panels_covering(t2 + 1, t2 + num_ahead * panel_span, ds_factor, panel_num_points));
+        if (m_pan_velocity == 0)
+            candidates.append(panels_covering(t1 - panel_span, t1 - 1, ds_factor, panel_num_points));
+    }
+    else {
+        candidates.append(panels_covering(t1 - num_ahead * panel_span, t1 - 1, ds_factor, panel_num_points));
+    }
+    while (candidate_priorities.count() < candidates.count())
+        candidate_priorities << MVTimeSeriesRenderManagerTask::NeighborPriority;
+
+    //the neighboring zoom levels, favoring the direction we are zooming in
+    double tmid = (t1 + t2) / 2, span = t2 - t1;
+    bool zooming_in = (m_zoom_velocity < -PREFETCH_ZOOM_THRESHOLD);
+    bool zooming_out = (m_zoom_velocity > PREFETCH_ZOOM_THRESHOLD);
+    {
+        int ds0, np0;
+        get_panel_params(tmid - span * 3 / 2, tmid + span * 3 / 2, W, ds0, np0);
+        QList<EnvelopePanel> coarser = panels_covering(t1, t2, ds0, np0); //also used as placeholders
+        candidates.append(coarser);
+        for (int i = 0; i < coarser.count(); i++)
+            candidate_priorities << (zooming_out ? MVTimeSeriesRenderManagerTask::NeighborPriority : MVTimeSeriesRenderManagerTask::LowerZoomLevelPriority);
+    }
+    if (!zooming_out) {
+        int ds0, np0;
+        get_panel_params(tmid - span / 6, tmid + span / 6, W, ds0, np0);
+        if ((ds0 != ds_factor) || (np0 != panel_num_points)) {
+            QList<EnvelopePanel> finer = panels_covering(tmid - span / 6, tmid + span / 6, ds0, np0);
+            candidates.append(finer);
+            for (int i = 0; i < finer.count(); i++)
+                candidate_priorities << (zooming_in ? MVTimeSeriesRenderManagerTask::NeighborPriority : MVTimeSeriesRenderManagerTask::LowerZoomLevelPriority);
         }
-
-        if (MLUtil::threadInterruptRequested())
-            return;
-
-        painter.drawPath(path);
-
-        y0 += channel_height + space;
     }
 
-    if (MLUtil::threadInterruptRequested())
-        return;
-    min_data = Xmin;
-    max_data = Xmax;
-    image = image0; //only copy on successful exit
-}
-
-ThreadManager::ThreadManager()
-{
-    QTimer::singleShot(100, this, SLOT(slot_timer()));
+    for (int i = 0; (i < candidates.count()) && (panels.count() < max_num_panels); i++) {
+        panels << candidates[i];
+        priorities << candidate_priorities[i];
+    }
 }
 
-ThreadManager::~ThreadManager()
+void MVTimeSeriesRenderManagerPrivate::record_prefetch_outcome(const QString& code)
 {
-    m_queued_threads.clear();
-    QStringList keys = m_running_threads.keys();
-    foreach (QString key, keys) {
-        this->stop(key);
+    //called for each visible panel: a speculative panel that is already rendered when it comes into view is a hit
+    if (!m_prefetched_codes.contains(code))
+        return;
+    m_prefetched_codes.remove(code);
+    if (m_panels.contains(code)) {
+        if (m_prefetch_hits_counter)
+            m_prefetch_hits_counter->add(1);
     }
-    while (!m_running_threads.isEmpty()) {
-        qApp->processEvents();
+    else {
+        if (m_prefetch_misses_counter)
+            m_prefetch_misses_counter->add(1);
     }
 }
 
-void ThreadManager::start(QString id, QThread* thread)
+MVTimeSeriesRenderManagerTask::MVTimeSeriesRenderManagerTask()
 {
-    if (m_queued_threads.contains(id))
-        return;
-    m_queued_threads[id] = thread;
-    thread->setProperty("threadmanager_id", id);
-    QObject::connect(thread, SIGNAL(finished()), this, SLOT(slot_thread_finished()));
+    setAutoDelete(false); //deleted by the render manager
 }
 
-void ThreadManager::stop(QString id)
+void MVTimeSeriesRenderManagerTask::cancel()
 {
-    if (m_queued_threads.contains(id))
-        m_queued_threads.remove(id);
-    if (m_running_threads.contains(id)) {
-        m_running_threads[id]->requestInterruption();
-    }
+    m_cancelled.storeRelease(1);
 }
 
-void ThreadManager::clear()
+bool MVTimeSeriesRenderManagerTask::isCancelled() const
 {
-    QStringList keys = m_running_threads.keys();
-    foreach (QString key, keys) {
-        this->stop(key);
-    }
-    m_running_threads.clear();
-    m_queued_threads.clear();
+    return m_cancelled.loadAcquire();
 }
 
-void ThreadManager::slot_timer()
+void MVTimeSeriesRenderManagerTask::run()
 {
-    while ((m_running_threads.count() < 4) && (!m_queued_threads.isEmpty())) {
-        QString key = m_queued_threads.keys().value(0);
-        QThread* T = m_queued_threads[key];
-        m_queued_threads.remove(key);
-        m_running_threads[key] = T;
-        T->start();
+    if (!isCancelled()) {
+        Mda32 Xmin, Xmax;
+        if (ts->getData(Xmin, Xmax, index * panel_num_points, (index + 1) * panel_num_points, ds_factor)) {
+            min_data = Xmin;
+            max_data = Xmax;
+        }
     }
-    QTimer::singleShot(100, this, SLOT(slot_timer()));
+    emit finished();
 }
 
-void ThreadManager::slot_thread_finished()
-{
-    QThread* thread = qobject_cast<QThread*>(sender());
-    if (!thread)
-        return;
-    m_running_threads.remove(thread->property("threadmanager_id").toString());
-}
-
-ImagePanel MVTimeSeriesRenderManagerPrivate::render_panel(ImagePanel p)
+EnvelopePanel* MVTimeSeriesRenderManagerPrivate::find_panel(EnvelopePanel p, bool& is_placeholder)
 {
     QString code = p.make_code();
-    if (m_image_panels.contains(code)) {
-        return m_image_panels[code];
-    }
-    else {
-        ImagePanel* p2 = closest_ancestor_panel(p);
-        if (p2) {
-            double s1 = p2->ds_factor * p2->index * p2->panel_num_points;
-            double s2 = p2->ds_factor * (p2->index + 1) * p2->panel_num_points;
-            double t1 = p.ds_factor * p.index * p.panel_num_points;
-            double t2 = p.ds_factor * (p.index + 1) * p.panel_num_points;
-            double a1 = (t1 - s1) / (s2 - s1) * p2->image.width();
-            double a2 = (t2 - s1) / (s2 - s1) * p2->image.width();
-            p.min_data = p2->min_data;
-            p.max_data = p2->max_data;
-            p.image = p2->image.copy(a1, 0, a2 - a1, p2->image.height());
-            QPainter painter(&p.image);
-            QColor col(255, 0, 0, 6);
-            painter.fillRect(0, 0, p.image.width(), p.image.height(), col);
-            return p;
-        }
-        else {
-            p.image = QImage(100, 100, QImage::Format_ARGB32);
-            QColor col(0, 0, 0, 10);
-            p.image.fill(col);
-            return p;
-        }
+    if (m_panels.contains(code)) {
+        is_placeholder = false;
+        return &m_panels[code];
     }
+    is_placeholder = true;
+    return closest_ancestor_panel(p);
 }
@@ -23,7 +23,7 @@
 #include <QColor>
 #include <QImage>
 #include <QRunnable>
-#include <QThread>
+#include <QSharedPointer>
 
 class MVTimeSeriesRenderManagerPrivate;
 class MVTimeSeriesRenderManager : public QObject {
@@ -36,6 +36,10 @@ public:
     void clear();
     void setMultiScaleTimeSeries(MultiScaleTimeSeries ts);
     void setChannelColors(const QList<QColor>& colors);
+    ///The current pan/zoom velocity of the view (see MVTimeSeriesViewBase::panVelocity()), used to choose the panels to prefetch
+    void setMotion(double pan_velocity, double zoom_velocity);
+    ///Upper bound on the image memory used for speculatively rendered panels
+    void setPrefetchBudget(double num_bytes);
     double visibleMinimum() const;
     double visibleMaximum() const;
 
@@ -45,48 +49,43 @@ signals:
     void updated();
 
 private slots:
-    void slot_thread_finished();
+    void slot_task_finished();
 
 private:
     MVTimeSeriesRenderManagerPrivate* d;
 };
 
-class MVTimeSeriesRenderManagerThread : public QThread {
+/// A panel job (reading the min/max envelope of one panel), run on the render manager's thread pool. Cancelling is cooperative: run() checks the flag between steps
+class MVTimeSeriesRenderManagerTask : public QObject, public QRunnable {
     Q_OBJECT
 public:
+    enum Priority {
+        LowerZoomLevelPriority = 0,
+        NeighborPriority = 1,
+        VisiblePriority = 2
+    };
+
+    MVTimeSeriesRenderManagerTask();
+
     //input
-    double amp_factor;
     int ds_factor;
-    int panel_width;
     int panel_num_points;
     int index;
-    QList<QColor> channel_colors;
-    MultiScaleTimeSeries ts;
-    QColor get_channel_color(int m);
+    QSharedPointer<MultiScaleTimeSeries> ts; //shared by all tasks of a render manager
 
     //output
-    QImage image;
     Mda32 min_data;
     Mda32 max_data;
 
-    void run();
-};
+    void cancel();
+    bool isCancelled() const;
+    void run() Q_DECL_OVERRIDE;
 
-class ThreadManager : public QObject {
-    Q_OBJECT
-public:
-    ThreadManager();
-    virtual ~ThreadManager();
-    void start(QString id, QThread* thread);
-    void stop(QString id);
-    void clear();
-private slots:
-    void slot_timer();
-    void slot_thread_finished();
+signals:
+    void finished();
 
 private:
-    QMap<QString, QThread*> m_queued_threads;
-    QMap<QString, QThread*> m_running_threads;
+    QAtomicInt m_cancelled;
 };
 
 #endif // MVTIMESERIESRENDERMANAGER_H
@@ -24,6 +24,8 @@
 #include <QImageWriter>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QPointer>
+#include <QThread>
 #include <mvcontext.h>
 
 struct mvtsv_channel {
@@ -46,6 +48,15 @@ public:
     void compute();
 };
 
+//builds the multi-scale pyramid after the view is already showing data from raw reads
+class MVTimeSeriesView2PyramidThread : public QThread {
+public:
+    //input
+    MultiScaleTimeSeries msts;
+
+    void run();
+};
+
 class MVTimeSeriesView2Private {
 public:
     MVTimeSeriesView2* q;
@@ -59,8 +70,12 @@ public:
     int m_num_channels;
 
     MVTimeSeriesRenderManager m_render_manager;
+    QPointer<MVTimeSeriesView2PyramidThread> m_pyramid_thread;
+    double m_estimated_amplitude_factor = 0;
 
     QList<mvtsv_channel> make_channel_layout(int M);
+    void start_pyramid_thread();
+    void stop_pyramid_thread();
     void paint_channel_labels(QPainter* painter, double W, double H);
 
     double val2ypix(int m, double val);
@@ -104,6 +119,7 @@ MVTimeSeriesView2::MVTimeSeriesView2(MVAbstractContext* context)
 MVTimeSeriesView2::~MVTimeSeriesView2()
 {
     this->stopCalculation(); //this is needed because of deletion of the multi-scale timeseries
+    d->stop_pyramid_thread(); //the thread has its own copy, so it is left to finish on its own
     delete d;
 }
 
@@ -136,12 +152,15 @@ void MVTimeSeriesView2::onCalculationFinished()
     d->m_render_manager.setMultiScaleTimeSeries(d->m_msts);
     d->m_num_channels = d->m_calculator.num_channels;
 
-    double max_range = qMax(qAbs(d->m_msts.minimum()), qAbs(d->m_msts.maximum()));
+    //estimated from the start of the data, refined in slot_pyramid_ready()
+    double max_range = qMax(qAbs(d->m_calculator.minval), qAbs(d->m_calculator.maxval));
     if (max_range) {
         this->setAmplitudeFactor(1.5 / max_range);
+        d->m_estimated_amplitude_factor = d->m_amplitude_factor;
     }
 
     d->m_layout_needed = true;
+    d->start_pyramid_thread();
 
     MVTimeSeriesViewBase::onCalculationFinished();
 }
@@ -163,6 +182,24 @@ void MVTimeSeriesView2::setAmplitudeFactor(double factor)
     update();
 }
 
+void MVTimeSeriesView2::slot_pyramid_ready()
+{
+    if (sender() != d->m_pyramid_thread)
+        return;
+    d->m_pyramid_thread = 0;
+    if (!d->m_msts.isInitialized())
+        return;
+    //only replace the estimate if the user has not changed the amplitude in the meantime
+    if (d->m_amplitude_factor == d->m_estimated_amplitude_factor) {
+        double max_range = qMax(qAbs(d->m_msts.minimum()), qAbs(d->m_msts.maximum()));
+        if (max_range) {
+            this->setAmplitudeFactor(1.5 / max_range);
+            d->m_estimated_amplitude_factor = d->m_amplitude_factor;
+        }
+    }
+    update(); //start the panels that were waiting for the pyramid
+}
+
 void MVTimeSeriesView2::autoSetAmplitudeFactorWithinTimeRange()
 {
     double min0 = d->m_render_manager.visibleMinimum();
@@ -192,6 +229,7 @@ void MVTimeSeriesView2::paintContent(QPainter* painter)
     double WW = this->contentGeometry().width();
     double HH = this->contentGeometry().height();
     QImage img;
+    d->m_render_manager.setMotion(this->panVelocity(), this->zoomVelocity());
     img = d->m_render_manager.getImage(c->currentTimeRange().min, c->currentTimeRange().max, d->m_amplitude_factor, WW, HH);
     painter->drawImage(this->contentGeometry().left(), this->contentGeometry().top(), img);
 
@@ -291,16 +329,41 @@ double MVTimeSeriesView2Private::ypix2val(int m, double ypix)
         return 0;
 }
 
+void MVTimeSeriesView2Private::start_pyramid_thread()
+{
+    stop_pyramid_thread();
+    MVTimeSeriesView2PyramidThread* thread = new MVTimeSeriesView2PyramidThread;
+    thread->msts = m_msts;
+    QObject::connect(thread, SIGNAL(finished()), q, SLOT(slot_pyramid_ready()));
+    QObject::connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    m_pyramid_thread = thread;
+    thread->start();
+}
+
+void MVTimeSeriesView2Private::stop_pyramid_thread()
+{
+    if (!m_pyramid_thread)
+        return;
+    QObject::disconnect(m_pyramid_thread, SIGNAL(finished()), q, SLOT(slot_pyramid_ready()));
+    m_pyramid_thread->requestInterruption();
+    m_pyramid_thread = 0;
+}
+
 void MVTimeSeriesView2Calculator::compute()
 {
+    //the pyramid is built afterwards (see MVTimeSeriesView2PyramidThread), so minval/maxval are estimates
     msts.setData(timeseries);
     msts.setMLProxyUrl(mlproxy_url);
-    msts.initialize();
     minval = msts.minimum();
     maxval = msts.maximum();
     num_channels = timeseries.N1();
 }
 
+void MVTimeSeriesView2PyramidThread::run()
+{
+    msts.initialize();
+}
+
 MVTimeSeriesDataFactory::MVTimeSeriesDataFactory(MVMainWindow* mw, QObject* parent)
     : MVAbstractViewFactory(mw, parent)
 {
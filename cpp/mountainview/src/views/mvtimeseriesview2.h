@@ -49,6 +49,7 @@ public:
 private slots:
     void slot_vertical_zoom_in();
     void slot_vertical_zoom_out();
+    void slot_pyramid_ready();
 
 private:
     MVTimeSeriesView2Private* d;
@@ -19,12 +19,16 @@
 #include "actionfactory.h"
 #include <math.h>
 
+#include <QElapsedTimer>
 #include <QIcon>
 #include <QImageWriter>
 #include <QMouseEvent>
 #include <QPainter>
 #include <mvcontext.h>
 
+#define MOTION_IDLE_MSEC 400 //after this long without a range change, the view is considered at rest
+#define MOTION_SMOOTHING 0.5 //weight of the newest sample in the velocity estimates
+
 struct TickStruct {
     TickStruct(QString str0, int min_pixel_spacing_between_ticks0, double tick_height0, double timepoint_interval0)
     {
@@ -46,7 +50,7 @@ struct TickStruct {
 class mvtsvb_calculator {
 public:
     //input
-    DiskReadMda firings;
+    FiringsTable firings;
     QSet<int> labels_to_use;
     QList<MVEvent> special_events;
 
@@ -165,6 +169,11 @@ public:
 
     int m_clip_size = 0;
 
+    QElapsedTimer m_motion_timer;
+    MVRange m_motion_last_range;
+    double m_pan_velocity = 0;
+    double m_zoom_velocity = 0;
+
     double time2xpix(double t);
     double xpix2time(double xpix);
     QRectF content_geometry();
@@ -172,6 +181,7 @@ public:
     void zoom_out(double about_time, double frac = 0.8);
     void zoom_in(double about_time, double frac = 0.8);
     void scroll_to_current_timepoint();
+    void update_motion(MVRange range);
 
     QString format_time(double tp);
     void update_cursor();
@@ -201,6 +211,7 @@ MVTimeSeriesViewBase::MVTimeSeriesViewBase(MVAbstractContext* context)
     QObject::connect(context, SIGNAL(currentTimepointChanged()), this, SLOT(update()));
     QObject::connect(context, SIGNAL(currentTimepointChanged()), this, SLOT(slot_scroll_to_current_timepoint()));
     QObject::connect(context, SIGNAL(currentTimeRangeChanged()), this, SLOT(update()));
+    QObject::connect(context, SIGNAL(currentTimeRangeChanged()), this, SLOT(slot_update_motion()));
 
     this->recalculateOn(context, SIGNAL(firingsChanged()), false);
 }
@@ -216,7 +227,7 @@ void MVTimeSeriesViewBase::prepareCalculation()
     MVContext* c = qobject_cast<MVContext*>(mvContext());
     Q_ASSERT(c);
 
-    d->m_calculator.firings = c->firings();
+    d->m_calculator.firings = c->firingsTable();
     d->m_calculator.labels_to_use = d->m_labels_to_view;
     d->m_calculator.special_events = d->m_special_events;
 }
@@ -492,6 +503,28 @@ void MVTimeSeriesViewBase::slot_zoom_out()
     d->zoom_out(c->currentTimepoint());
 }
 
+void MVTimeSeriesViewBase::slot_update_motion()
+{
+    MVContext* c = qobject_cast<MVContext*>(mvContext());
+    Q_ASSERT(c);
+
+    d->update_motion(c->currentTimeRange());
+}
+
+double MVTimeSeriesViewBase::panVelocity() const
+{
+    if ((!d->m_motion_timer.isValid()) || (d->m_motion_timer.elapsed() > MOTION_IDLE_MSEC))
+        return 0;
+    return d->m_pan_velocity;
+}
+
+double MVTimeSeriesViewBase::zoomVelocity() const
+{
+    if ((!d->m_motion_timer.isValid()) || (d->m_motion_timer.elapsed() > MOTION_IDLE_MSEC))
+        return 0;
+    return d->m_zoom_velocity;
+}
+
 struct MarkerRecord {
     double xpix;
     int label;
@@ -710,6 +743,26 @@ void MVTimeSeriesViewBasePrivate::scroll_to_current_timepoint()
     }
 }
 
+void MVTimeSeriesViewBasePrivate::update_motion(MVRange range)
+{
+    if ((!m_motion_timer.isValid()) || (m_motion_last_range.range() <= 0) || (range.range() <= 0)) {
+        m_motion_timer.start();
+        m_motion_last_range = range;
+        return;
+    }
+    qint64 msec = m_motion_timer.restart();
+    if (msec > MOTION_IDLE_MSEC) {
+        //starting a new gesture
+        m_pan_velocity = m_zoom_velocity = 0;
+    }
+    double sec = qMax(msec, (qint64)1) / 1000.0;
+    double pan = ((range.min + range.max) / 2 - (m_motion_last_range.min + m_motion_last_range.max) / 2) / sec;
+    double zoom = log(range.range() / m_motion_last_range.range()) / sec;
+    m_pan_velocity = MOTION_SMOOTHING * pan + (1 - MOTION_SMOOTHING) * m_pan_velocity;
+    m_zoom_velocity = MOTION_SMOOTHING * zoom + (1 - MOTION_SMOOTHING) * m_zoom_velocity;
+    m_motion_last_range = range;
+}
+
 QString MVTimeSeriesViewBasePrivate::format_time(double tp)
 {
     MVContext* c = qobject_cast<MVContext*>(q->mvContext());
@@ -759,13 +812,19 @@ void mvtsvb_calculator::compute()
     if (labels_to_use.isEmpty())
         return;
 
-    bigint L = firings.N2();
-    for (bigint i = 0; i < L; i++) {
-        int label0 = firings.value(2, i);
-        if (labels_to_use.contains(label0)) {
-            times << firings.value(1, i);
-            labels << label0;
-        }
+    //use the per-label index, keeping the events in their original order
+    QVector<bigint> inds;
+    foreach (int k, labels_to_use) {
+        inds << firings.eventIndicesForLabel(k);
+    }
+    qSort(inds);
+    const QVector<double>& times0 = firings.times();
+    const QVector<int>& labels0 = firings.labels();
+    times.reserve(times.count() + inds.count());
+    labels.reserve(labels.count() + inds.count());
+    for (bigint i = 0; i < inds.count(); i++) {
+        times << times0[inds[i]];
+        labels << labels0[inds[i]];
     }
 }
 
@@ -77,6 +77,10 @@ public:
 
     double amplitudeFactor() const;
 
+    //smoothed motion of the visible time range, used for predictive prefetching. Both decay to zero when idle
+    double panVelocity() const; //timepoints per second (positive = scrolling right)
+    double zoomVelocity() const; //log of the range ratio per second (positive = zooming out)
+
 protected:
     void resizeEvent(QResizeEvent* evt);
     void paintEvent(QPaintEvent* evt);
@@ -99,6 +103,7 @@ private slots:
     void slot_scroll_to_current_timepoint();
     void slot_zoom_in();
     void slot_zoom_out();
+    void slot_update_motion();
 
 private:
     MVTimeSeriesViewBasePrivate* d;
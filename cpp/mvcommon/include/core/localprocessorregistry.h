@@ -0,0 +1,60 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCALPROCESSORREGISTRY_H
+#define LOCALPROCESSORREGISTRY_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <functional>
+
+class LocalProcessorRegistryPrivate;
+/**
+ * \class LocalProcessorRegistry
+ * @brief Processors that the viewer can execute in its own process, keyed by processor name.
+ *
+ * When MountainProcessRunner runs locally (no mlproxy url) and the processor has been registered
+ * here, the registered function is called directly in the calculation thread instead of spawning
+ * ml-run-process. It receives the same parameters (inputs, outputs and options) that would otherwise
+ * have been passed on the command line, and returns false on failure. Remote runs and unregistered
+ * processors still go through the external runner.
+ */
+class LocalProcessorRegistry {
+public:
+    typedef std::function<bool(const QMap<QString, QVariant>& parameters)> ProcessorFunction;
+
+    friend class LocalProcessorRegistryPrivate;
+    LocalProcessorRegistry();
+    virtual ~LocalProcessorRegistry();
+
+    void registerProcessor(const QString& processor_name, ProcessorFunction func);
+    bool contains(const QString& processor_name) const;
+    ProcessorFunction processor(const QString& processor_name) const;
+    QStringList processorNames() const;
+
+    ///Set to false to always use the external runner (default true, or false if ML_DISABLE_LOCAL_PROCESSORS is set)
+    void setEnabled(bool val);
+    bool enabled() const;
+
+    static LocalProcessorRegistry* globalInstance();
+
+private:
+    LocalProcessorRegistryPrivate* d;
+};
+
+#endif // LOCALPROCESSORREGISTRY_H
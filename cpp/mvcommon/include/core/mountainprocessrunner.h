@@ -21,6 +21,7 @@
 #include <QMap>
 #include <QVariant>
 
+class ProcessResultStore;
 class MountainProcessRunnerPrivate;
 class MountainProcessRunner {
 public:
@@ -34,6 +35,7 @@ public:
     void setAllowGuiThread(bool val);
     QString makeOutputFilePath(const QString& pname);
     void setDetach(bool val);
+    void setResultStore(ProcessResultStore* store); //optional: identical requests are then run once and shared
     void runProcess();
 
 private:
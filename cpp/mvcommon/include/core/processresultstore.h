@@ -0,0 +1,59 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROCESSRESULTSTORE_H
+#define PROCESSRESULTSTORE_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <functional>
+
+class ProcessResultStorePrivate;
+/**
+ * \class ProcessResultStore
+ * @brief Results of the processors run by the views, shared so that identical requests are computed once.
+ *
+ * A request is identified by the processor name, its parameters, and the size and modification time of
+ * each of its local input files. When a request has already completed (and its output files are unchanged)
+ * nothing is run again, and when the same request is in progress in another thread the caller waits for it
+ * rather than starting a second run. Output files are never rewritten once recorded, so callers can share
+ * them freely.
+ *
+ * The store is owned by the context, which calls removeStaleResults() when the firings or the cluster merge
+ * change, so that exactly the results whose input or output files have changed are dropped.
+ */
+class ProcessResultStore {
+public:
+    typedef std::function<bool()> ComputeFunction;
+
+    friend class ProcessResultStorePrivate;
+    ProcessResultStore();
+    virtual ~ProcessResultStore();
+
+    ///Run compute (which writes the outputs) unless an identical request has completed or is in progress. Returns false if the computation failed or was interrupted
+    bool run(const QString& processor_name, const QMap<QString, QVariant>& parameters, const QStringList& output_parameter_names, ComputeFunction compute);
+
+    void removeStaleResults();
+    void clear();
+    int numResults() const;
+
+private:
+    ProcessResultStorePrivate* d;
+};
+
+#endif // PROCESSRESULTSTORE_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "localprocessorregistry.h"
+
+#include <QMutex>
+
+class LocalProcessorRegistryPrivate {
+public:
+    LocalProcessorRegistry* q;
+
+    //registration happens at startup, lookups happen in the calculation threads
+    mutable QMutex m_mutex;
+    QMap<QString, LocalProcessorRegistry::ProcessorFunction> m_processors;
+    bool m_enabled = true;
+};
+
+LocalProcessorRegistry::LocalProcessorRegistry()
+{
+    d = new LocalProcessorRegistryPrivate;
+    d->q = this;
+    d->m_enabled = qgetenv("ML_DISABLE_LOCAL_PROCESSORS").isEmpty();
+}
+
+LocalProcessorRegistry::~LocalProcessorRegistry()
+{
+    delete d;
+}
+
+void LocalProcessorRegistry::registerProcessor(const QString& processor_name, ProcessorFunction func)
+{
+    QMutexLocker locker(&d->m_mutex);
+    d->m_processors[processor_name] = func;
+}
+
+bool LocalProcessorRegistry::contains(const QString& processor_name) const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return ((d->m_enabled) && (d->m_processors.contains(processor_name)));
+}
+
+LocalProcessorRegistry::ProcessorFunction LocalProcessorRegistry::processor(const QString& processor_name) const
+{
+    QMutexLocker locker(&d->m_mutex);
+    if (!d->m_enabled)
+        return ProcessorFunction();
+    return d->m_processors.value(processor_name);
+}
+
+QStringList LocalProcessorRegistry::processorNames() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_processors.keys();
+}
+
+void LocalProcessorRegistry::setEnabled(bool val)
+{
+    QMutexLocker locker(&d->m_mutex);
+    d->m_enabled = val;
+}
+
+bool LocalProcessorRegistry::enabled() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_enabled;
+}
+
+Q_GLOBAL_STATIC(LocalProcessorRegistry, theLocalProcessorRegistry)
+
+LocalProcessorRegistry* LocalProcessorRegistry::globalInstance()
+{
+    return theLocalProcessorRegistry;
+}
@@ -34,6 +34,8 @@
 //#include <objectregistry.h>
 #include <icounter.h>
 #include "qprocessmanager.h"
+#include "localprocessorregistry.h"
+#include "processresultstore.h"
 
 class MountainProcessRunnerPrivate {
 public:
@@ -44,7 +46,10 @@ public:
     QString m_mlproxy_url;
     bool m_allow_gui_thread = false;
     bool m_detach = false;
+    ProcessResultStore* m_result_store = 0;
+    QStringList m_output_parameter_names;
 
+    bool run_process(TaskProgress& task);
     QString create_temporary_output_file_name(const QString& remote_url, const QString& processor_name, const QMap<QString, QVariant>& params, const QString& parameter_name);
 };
 
@@ -68,6 +73,8 @@ QString MountainProcessRunner::makeOutputFilePath(const QString& pname)
 {
     QString ret = d->create_temporary_output_file_name(d->m_mlproxy_url, d->m_processor_name, d->m_parameters, pname);
     d->m_parameters[pname] = ret;
+    if (!d->m_output_parameter_names.contains(pname))
+        d->m_output_parameter_names << pname;
     return ret;
 }
 
@@ -76,6 +83,11 @@ void MountainProcessRunner::setDetach(bool val)
     d->m_detach = val;
 }
 
+void MountainProcessRunner::setResultStore(ProcessResultStore* store)
+{
+    d->m_result_store = store;
+}
+
 void MountainProcessRunner::setInputParameters(const QMap<QString, QVariant>& parameters)
 {
     d->m_parameters = parameters;
@@ -178,31 +190,57 @@ void MountainProcessRunner::runProcess()
 
     TaskProgress task(TaskProgress::Calculate, "MS: " + d->m_processor_name);
 
-    //if (d->m_mscmdserver_url.isEmpty()) {
-    if (d->m_mlproxy_url.isEmpty()) {
+    if (d->m_result_store) {
+        d->m_result_store->run(d->m_processor_name, d->m_parameters, d->m_output_parameter_names, [this, &task]() {
+            return d->run_process(task);
+        });
+    }
+    else {
+        d->run_process(task);
+    }
+}
+
+bool MountainProcessRunnerPrivate::run_process(TaskProgress& task)
+{
+    //if (m_mscmdserver_url.isEmpty()) {
+    if (m_mlproxy_url.isEmpty()) {
         //QString mountainsort_exe = mountainlabBasePath() + "/mountainsort/bin/mountainsort";
         //QString mountainprocess_exe = MLUtil::mountainlabBasePath() + "/cpp/mountainprocess/bin/mountainprocess";
         //QString mountainprocess_exe = "mountainprocess"; // jfm changed on 9/7/17
         QStringList args;
         //args << "run-process";
-        args << d->m_processor_name;
+        args << m_processor_name;
         args << "--iops";
-        QStringList keys = d->m_parameters.keys();
+        QStringList keys = m_parameters.keys();
         foreach (QString key, keys) {
-            args << QString("%1:%2").arg(key).arg(d->m_parameters.value(key).toString());
+            args << QString("%1:%2").arg(key).arg(m_parameters.value(key).toString());
         }
         //right now we can't detach while running locally
-        //if (d->m_detach) {
+        //if (m_detach) {
         //    args << QString("--_detach=1");
         //}
         //task.log(QString("Executing locally: %1").arg(mountainprocess_exe));
         foreach (QString key, keys) {
-            QString val = d->m_parameters[key].toString();
+            QString val = m_parameters[key].toString();
             task.log(QString("%1 = %2").arg(key).arg(val));
             if (val.startsWith("http")) {
                 task.error("Executing locally, but parameter starts with http. Probably mlproxy url has not been set.");
-                return;
+                return false;
+            }
+        }
+
+        //processors registered by the application run right here, without spawning ml-run-process
+        LocalProcessorRegistry::ProcessorFunction local_processor = LocalProcessorRegistry::globalInstance()->processor(m_processor_name);
+        if (local_processor) {
+            task.log("Executing in process: " + m_processor_name);
+            if (!local_processor(m_parameters)) {
+                if (MLUtil::threadInterruptRequested())
+                    task.error("Terminating due to interrupt request");
+                else
+                    task.error("Problem running processor in process: " + m_processor_name);
+                return false;
             }
+            return true;
         }
 
         QString exe = "ml-run-process";
@@ -225,7 +263,7 @@ void MountainProcessRunner::runProcess()
 
         if (!process0->waitForStarted()) {
             task.error("Error starting process.");
-            return;
+            return false;
         }
 
         QString stdout;
@@ -241,9 +279,13 @@ void MountainProcessRunner::runProcess()
             if (MLUtil::threadInterruptRequested()) {
                 task.error("Terminating due to interrupt request");
                 process0->terminate();
-                return;
+                return false;
             }
         }
+        if ((process0->exitStatus() != QProcess::NormalExit) || (process0->exitCode() != 0)) {
+            task.error(QString("Process exited with code %1").arg(process0->exitCode()));
+            return false;
+        }
 
         /*
         if (QProcess::execute(mountainprocess_exe, args) != 0) {
@@ -254,22 +296,22 @@ void MountainProcessRunner::runProcess()
     }
     else {
         /*
-        QString url = d->m_mscmdserver_url + "/?";
-        url += "processor=" + d->m_processor_name + "&";
-        QStringList keys = d->m_parameters.keys();
+        QString url = m_mscmdserver_url + "/?";
+        url += "processor=" + m_processor_name + "&";
+        QStringList keys = m_parameters.keys();
         foreach(QString key, keys)
         {
-            url += QString("%1=%2&").arg(key).arg(d->m_parameters.value(key).toString());
+            url += QString("%1=%2&").arg(key).arg(m_parameters.value(key).toString());
         }
-        this->setStatus("Remote " + d->m_processor_name, "MLNetwork::httpGetText: " + url, 0.5);
+        this->setStatus("Remote " + m_processor_name, "MLNetwork::httpGetText: " + url, 0.5);
         MLNetwork::httpGetText(url);
         this->setStatus("", "", 1);
         */
 
         task.log("Setting up pp_process");
         QJsonObject pp_process;
-        pp_process["processor_name"] = d->m_processor_name;
-        pp_process["parameters"] = variantmap_to_json_obj(d->m_parameters);
+        pp_process["processor_name"] = m_processor_name;
+        pp_process["parameters"] = variantmap_to_json_obj(m_parameters);
         QJsonArray pp_processes;
         pp_processes.append(pp_process);
         QJsonObject pp;
@@ -286,15 +328,15 @@ void MountainProcessRunner::runProcess()
         QJsonObject req;
         req["action"] = "queueScript";
         req["script"] = script;
-        if (d->m_detach) {
+        if (m_detach) {
             req["detach"] = 1;
         }
-        QString url = d->m_mlproxy_url + "/mpserver";
+        QString url = m_mlproxy_url + "/mpserver";
         task.log("POSTING: " + url);
         task.log(QJsonDocument(req).toJson());
         if (MLUtil::threadInterruptRequested()) {
             task.error("Halted before post.");
-            return;
+            return false;
         }
         QTime post_timer;
         post_timer.start();
@@ -306,14 +348,16 @@ void MountainProcessRunner::runProcess()
         }
         if (MLUtil::threadInterruptRequested()) {
             task.error("Halted during post: " + url);
-            return;
+            return false;
         }
         task.log("GOT RESPONSE: ");
         task.log(QJsonDocument(resp).toJson());
         if (!resp["error"].toString().isEmpty()) {
             task.error(resp["error"].toString());
+            return false;
         }
     }
+    return true;
 }
 
 QString MountainProcessRunnerPrivate::create_temporary_output_file_name(const QString& mlproxy_url, const QString& processor_name, const QMap<QString, QVariant>& params, const QString& parameter_name)
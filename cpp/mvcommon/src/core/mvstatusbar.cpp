@@ -131,8 +131,22 @@ void MVStatusBar::slot_update_quantities()
             d->m_bytes_allocated_label.setText(txt);
             IIntCounter* allocatedCounter = static_cast<IIntCounter*>(manager->counter("allocated_bytes"));
             IIntCounter* freedCounter = static_cast<IIntCounter*>(manager->counter("freed_bytes"));
+            IIntCounter* cacheHitsCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_hits"));
+            IIntCounter* cacheMissesCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_misses"));
+            IIntCounter* cacheEvictionsCounter = static_cast<IIntCounter*>(manager->counter("mda_cache_evictions"));
+            IIntCounter* prefetchHitsCounter = static_cast<IIntCounter*>(manager->counter("timeseries_prefetch_hits"));
+            IIntCounter* prefetchMissesCounter = static_cast<IIntCounter*>(manager->counter("timeseries_prefetch_misses"));
+            QString tooltip;
             if (allocatedCounter && freedCounter)
-                d->m_bytes_allocated_label.setToolTip(QString("Allocated: <b>%1</b><br>Freed: <b>%2</b>").arg(format_num_bytes(allocatedCounter->value())).arg(format_num_bytes(freedCounter->value())));
+                tooltip = QString("Allocated: <b>%1</b><br>Freed: <b>%2</b>").arg(format_num_bytes(allocatedCounter->value())).arg(format_num_bytes(freedCounter->value()));
+            if (cacheHitsCounter && cacheMissesCounter && cacheEvictionsCounter)
+                tooltip += QString("<br>Block cache: <b>%1</b> hits, <b>%2</b> misses, <b>%3</b> evictions").arg(cacheHitsCounter->value()).arg(cacheMissesCounter->value()).arg(cacheEvictionsCounter->value());
+            if (prefetchHitsCounter && prefetchMissesCounter) {
+                double hits = prefetchHitsCounter->value(), misses = prefetchMissesCounter->value();
+                double pct = (hits + misses) ? hits * 100 / (hits + misses) : 0;
+                tooltip += QString("<br>Timeseries prefetch: <b>%1</b> hits, <b>%2</b> misses (%3% hit rate)").arg(hits).arg(misses).arg(pct, 0, 'f', 1);
+            }
+            d->m_bytes_allocated_label.setToolTip(tooltip);
         }
     }
 }
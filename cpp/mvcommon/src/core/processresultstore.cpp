@@ -0,0 +1,177 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "processresultstore.h"
+#include "mlcommon.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
+#include <icounter.h>
+#include <objectregistry.h>
+
+#define PROCESS_RESULT_WAIT_INTERVAL_MSEC 100
+
+struct ProcessResultEntry {
+    bool in_progress = true;
+    QMap<QString, QString> input_signatures; //path -> signature
+    QMap<QString, QString> output_signatures;
+};
+
+class ProcessResultStorePrivate {
+public:
+    ProcessResultStore* q;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_finished;
+    QMap<QString, ProcessResultEntry> m_entries; //by request key
+
+    IIntCounter* hitsCounter = nullptr;
+
+    static QString file_signature(const QString& path);
+    static bool signatures_unchanged(const QMap<QString, QString>& signatures);
+};
+
+ProcessResultStore::ProcessResultStore()
+{
+    d = new ProcessResultStorePrivate;
+    d->q = this;
+    ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
+    if (manager) {
+        d->hitsCounter = static_cast<IIntCounter*>(manager->counter("process_result_hits"));
+    }
+}
+
+ProcessResultStore::~ProcessResultStore()
+{
+    delete d;
+}
+
+bool ProcessResultStore::run(const QString& processor_name, const QMap<QString, QVariant>& parameters, const QStringList& output_parameter_names, ComputeFunction compute)
+{
+    ProcessResultEntry entry;
+    QStringList output_paths;
+    QString str = processor_name + ":";
+    QStringList keys = parameters.keys();
+    qSort(keys);
+    foreach (QString key, keys) {
+        QString val = parameters.value(key).toString();
+        str += key + "=" + val + "&";
+        if (output_parameter_names.contains(key)) {
+            output_paths << val;
+        }
+        else {
+            //the same input path with different content is a different request
+            QString sig = ProcessResultStorePrivate::file_signature(val);
+            if (!sig.isEmpty()) {
+                entry.input_signatures[val] = sig;
+                str += "(" + sig + ")&";
+            }
+        }
+    }
+    QString request_key = MLUtil::computeSha1SumOfString(str);
+
+    {
+        QMutexLocker locker(&d->m_mutex);
+        while (d->m_entries.contains(request_key)) {
+            const ProcessResultEntry& E = d->m_entries[request_key];
+            if (E.in_progress) {
+                //if the other run fails or is interrupted, its entry is removed and we run it ourselves
+                if (MLUtil::threadInterruptRequested())
+                    return false;
+                d->m_finished.wait(&d->m_mutex, PROCESS_RESULT_WAIT_INTERVAL_MSEC);
+                continue;
+            }
+            if (ProcessResultStorePrivate::signatures_unchanged(E.output_signatures)) {
+                if (d->hitsCounter)
+                    d->hitsCounter->add(1);
+                return true;
+            }
+            d->m_entries.remove(request_key);
+        }
+        d->m_entries[request_key] = entry;
+    }
+
+    bool ok = compute();
+
+    QMutexLocker locker(&d->m_mutex);
+    if ((ok) && (!MLUtil::threadInterruptRequested())) {
+        ProcessResultEntry& E = d->m_entries[request_key];
+        E.in_progress = false;
+        foreach (QString path, output_paths) {
+            //remote outputs have no local file, and there is nothing to check for them
+            QString sig = ProcessResultStorePrivate::file_signature(path);
+            if (!sig.isEmpty())
+                E.output_signatures[path] = sig;
+        }
+    }
+    else {
+        d->m_entries.remove(request_key);
+    }
+    d->m_finished.wakeAll();
+    return ok;
+}
+
+void ProcessResultStore::removeStaleResults()
+{
+    QMutexLocker locker(&d->m_mutex);
+    QStringList keys = d->m_entries.keys();
+    foreach (QString key, keys) {
+        const ProcessResultEntry& E = d->m_entries[key];
+        if (E.in_progress)
+            continue;
+        if ((!ProcessResultStorePrivate::signatures_unchanged(E.input_signatures)) || (!ProcessResultStorePrivate::signatures_unchanged(E.output_signatures))) {
+            d->m_entries.remove(key);
+        }
+    }
+}
+
+void ProcessResultStore::clear()
+{
+    QMutexLocker locker(&d->m_mutex);
+    QStringList keys = d->m_entries.keys();
+    foreach (QString key, keys) {
+        if (!d->m_entries[key].in_progress)
+            d->m_entries.remove(key);
+    }
+}
+
+int ProcessResultStore::numResults() const
+{
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_entries.count();
+}
+
+QString ProcessResultStorePrivate::file_signature(const QString& path)
+{
+    if ((path.isEmpty()) || (!QFileInfo(path).isAbsolute()))
+        return "";
+    QFileInfo info(path);
+    if (!info.isFile())
+        return "";
+    return QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+bool ProcessResultStorePrivate::signatures_unchanged(const QMap<QString, QString>& signatures)
+{
+    QStringList paths = signatures.keys();
+    foreach (QString path, paths) {
+        if (file_signature(path) != signatures[path])
+            return false;
+    }
+    return true;
+}
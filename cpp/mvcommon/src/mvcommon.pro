@@ -35,7 +35,7 @@ INCLUDEPATH += ../include/core
 VPATH += core ../include/core
 HEADERS += \
 closemehandler.h flowlayout.h imagesavedialog.h \
-mountainprocessrunner.h mvabstractcontextmenuhandler.h \
+mountainprocessrunner.h localprocessorregistry.h processresultstore.h mvabstractcontextmenuhandler.h \
 mvabstractcontrol.h mvabstractview.h mvabstractviewfactory.h \
 mvcontrolpanel2.h mvstatusbar.h \
 tabber.h tabberframe.h taskprogressview.h actionfactory.h mvabstractplugin.h \
@@ -43,7 +43,7 @@ mvabstractcontext.h mvmainwindow.h
 
 SOURCES += \
 closemehandler.cpp flowlayout.cpp imagesavedialog.cpp \
-mountainprocessrunner.cpp mvabstractcontextmenuhandler.cpp \
+mountainprocessrunner.cpp localprocessorregistry.cpp processresultstore.cpp mvabstractcontextmenuhandler.cpp \
 mvabstractcontrol.cpp mvabstractview.cpp mvabstractviewfactory.cpp \
 mvcontrolpanel2.cpp mvstatusbar.cpp \
 tabber.cpp tabberframe.cpp taskprogressview.cpp actionfactory.cpp mvabstractplugin.cpp \
@@ -0,0 +1,223 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "chunkpipeline.h"
+
+#include <QDebug>
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+class ChunkPipelineThread : public QThread {
+public:
+    std::function<void()> body;
+    void run()
+    {
+        body();
+    }
+};
+
+struct ChunkPipelineItem {
+    bigint index = 0;
+    Mda32 chunk;
+};
+
+class ChunkPipelinePrivate {
+public:
+    ChunkPipeline* q;
+
+    bigint m_num_chunks = 0;
+    int m_num_workers = 0;
+    int m_queue_capacity = 0;
+    ChunkPipeline::ReadFunction m_read;
+    ChunkPipeline::ComputeFunction m_compute;
+    ChunkPipeline::WriteFunction m_write;
+
+    //all of the following are protected by m_mutex
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QQueue<ChunkPipelineItem> m_to_compute;
+    QMap<bigint, Mda32> m_computed;
+    bigint m_num_in_flight = 0;
+    bool m_reading_done = false;
+    bool m_failed = false;
+
+    void reader_loop();
+    void worker_loop(int worker_index);
+    void set_failed();
+};
+
+ChunkPipeline::ChunkPipeline()
+{
+    d = new ChunkPipelinePrivate;
+    d->q = this;
+    d->m_num_workers = qMax(1, QThread::idealThreadCount());
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+    delete d;
+}
+
+void ChunkPipeline::setNumChunks(bigint num_chunks)
+{
+    d->m_num_chunks = num_chunks;
+}
+
+void ChunkPipeline::setNumWorkers(int num_workers)
+{
+    d->m_num_workers = qMax(1, num_workers);
+}
+
+int ChunkPipeline::numWorkers() const
+{
+    return d->m_num_workers;
+}
+
+void ChunkPipeline::setQueueCapacity(int num_chunks)
+{
+    d->m_queue_capacity = num_chunks;
+}
+
+void ChunkPipeline::setReadFunction(ReadFunction func)
+{
+    d->m_read = func;
+}
+
+void ChunkPipeline::setComputeFunction(ComputeFunction func)
+{
+    d->m_compute = func;
+}
+
+void ChunkPipeline::setWriteFunction(WriteFunction func)
+{
+    d->m_write = func;
+}
+
+bool ChunkPipeline::run()
+{
+    if (!d->m_read) {
+        qWarning() << "No read function set in ChunkPipeline";
+        return false;
+    }
+    if (d->m_queue_capacity <= 0)
+        d->m_queue_capacity = 2 * d->m_num_workers;
+    d->m_to_compute.clear();
+    d->m_computed.clear();
+    d->m_num_in_flight = 0;
+    d->m_reading_done = false;
+    d->m_failed = false;
+
+    QList<ChunkPipelineThread*> threads;
+    {
+        ChunkPipelineThread* thread = new ChunkPipelineThread;
+        thread->body = [this]() { d->reader_loop(); };
+        threads << thread;
+    }
+    for (int w = 0; w < d->m_num_workers; w++) {
+        ChunkPipelineThread* thread = new ChunkPipelineThread;
+        thread->body = [this, w]() { d->worker_loop(w); };
+        threads << thread;
+    }
+    foreach (ChunkPipelineThread* thread, threads) {
+        thread->start();
+    }
+
+    //the ordered writer runs in the calling thread
+    for (bigint i = 0; i < d->m_num_chunks; i++) {
+        Mda32 chunk;
+        {
+            QMutexLocker locker(&d->m_mutex);
+            while ((!d->m_computed.contains(i)) && (!d->m_failed))
+                d->m_changed.wait(&d->m_mutex);
+            if (d->m_failed)
+                break;
+            chunk = d->m_computed.take(i);
+        }
+        bool ok = d->m_write ? d->m_write(i, chunk) : true;
+        QMutexLocker locker(&d->m_mutex);
+        d->m_num_in_flight--;
+        if (!ok)
+            d->m_failed = true;
+        d->m_changed.wakeAll();
+    }
+
+    foreach (ChunkPipelineThread* thread, threads) {
+        thread->wait();
+        delete thread;
+    }
+    d->m_to_compute.clear();
+    d->m_computed.clear();
+
+    return !d->m_failed;
+}
+
+void ChunkPipelinePrivate::reader_loop()
+{
+    for (bigint i = 0; i < m_num_chunks; i++) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while ((m_num_in_flight >= m_queue_capacity) && (!m_failed))
+                m_changed.wait(&m_mutex);
+            if (m_failed)
+                return;
+            m_num_in_flight++;
+        }
+        ChunkPipelineItem item;
+        item.index = i;
+        if (!m_read(i, item.chunk)) {
+            set_failed();
+            return;
+        }
+        QMutexLocker locker(&m_mutex);
+        m_to_compute.enqueue(item);
+        m_changed.wakeAll();
+    }
+    QMutexLocker locker(&m_mutex);
+    m_reading_done = true;
+    m_changed.wakeAll();
+}
+
+void ChunkPipelinePrivate::worker_loop(int worker_index)
+{
+    while (true) {
+        ChunkPipelineItem item;
+        {
+            QMutexLocker locker(&m_mutex);
+            while ((m_to_compute.isEmpty()) && (!m_reading_done) && (!m_failed))
+                m_changed.wait(&m_mutex);
+            if ((m_failed) || (m_to_compute.isEmpty()))
+                return;
+            item = m_to_compute.dequeue();
+        }
+        bool ok = m_compute ? m_compute(worker_index, item.index, item.chunk) : true;
+        if (!ok) {
+            set_failed();
+            return;
+        }
+        QMutexLocker locker(&m_mutex);
+        m_computed[item.index] = item.chunk;
+        m_changed.wakeAll();
+    }
+}
+
+void ChunkPipelinePrivate::set_failed()
+{
+    QMutexLocker locker(&m_mutex);
+    m_failed = true;
+    m_changed.wakeAll();
+}
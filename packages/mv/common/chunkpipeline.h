@@ -0,0 +1,56 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CHUNKPIPELINE_H
+#define CHUNKPIPELINE_H
+
+#include <functional>
+#include "mda32.h"
+
+/*
+ * Streams a sequence of chunks through three stages: a single reader thread, a number of
+ * compute workers, and an ordered writer (the calling thread). At most queueCapacity chunks
+ * are in flight (read but not yet written), so memory stays bounded while the disk and
+ * the cores are both kept busy. Chunk i is always written before chunk i+1.
+ *
+ * The compute function receives the index of the worker calling it (0..numWorkers-1), so
+ * callers can keep per-worker state such as FFT plans. If any stage returns false the
+ * pipeline stops and run() returns false.
+ */
+class ChunkPipelinePrivate;
+class ChunkPipeline {
+public:
+    typedef std::function<bool(bigint chunk_index, Mda32& chunk)> ReadFunction;
+    typedef std::function<bool(int worker_index, bigint chunk_index, Mda32& chunk)> ComputeFunction;
+    typedef std::function<bool(bigint chunk_index, Mda32& chunk)> WriteFunction;
+
+    ChunkPipeline();
+    virtual ~ChunkPipeline();
+
+    void setNumChunks(bigint num_chunks);
+    void setNumWorkers(int num_workers); //default: the ideal thread count
+    int numWorkers() const;
+    void setQueueCapacity(int num_chunks); //default: twice the number of workers
+    void setReadFunction(ReadFunction func);
+    void setComputeFunction(ComputeFunction func); //optional
+    void setWriteFunction(WriteFunction func); //optional
+
+    bool run();
+
+private:
+    ChunkPipelinePrivate* d;
+};
+
+#endif // CHUNKPIPELINE_H
@@ -223,3 +223,12 @@ QString MLUtil::makeRandomId(int numchars)
 {
     return make_random_id_22(numchars);
 }
+
+QString MLUtil::tempPath()
+{
+    QString tmp_path = qgetenv("ML_TEMPORARY_DIRECTORY");
+    if (tmp_path.isEmpty()) {
+        tmp_path = "/tmp/mountainlab-tmp";
+    }
+    return tmp_path;
+}
@@ -36,6 +36,7 @@ QString makeRandomId(int numchars);
 QList<int> stringListToIntList(const QStringList& list);
 QList<bigint> stringListToBigIntList(const QStringList& list);
 QStringList intListToStringList(const QList<int>& list);
+QString tempPath(); //same as in mlcommon: $ML_TEMPORARY_DIRECTORY, or /tmp/mountainlab-tmp
 };
 
 #endif // MLUTIL_H
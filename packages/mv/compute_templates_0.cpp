@@ -18,8 +18,15 @@
 #include "mlutil.h"
 #include <math.h>
 #include "get_sort_indices.h"
+#include "chunkpipeline.h"
+#include <algorithm>
+#include <QDebug>
 //#include "omp.h"
 
+#define TEMPLATES_CHUNK_SIZE 1e5
+#define MAX_TEMPLATE_ACCUMULATOR_BYTES 2e9 //for all of the per-worker accumulators together
+#define TEMPLATES_CLIPS_BATCH_SIZE 10000 //clips read together with DiskReadMda32::readChunks
+
 Mda compute_templates_0(const DiskReadMda& X, Mda& firings, int clip_size)
 {
     QVector<double> times;
@@ -85,74 +92,158 @@ Mda compute_templates_0(const DiskReadMda& X, const QVector<double>& times, cons
     return templates;
 }
 
-void get_sums_and_counts_for_templates(Mda& sums, Mda& counts, const Mda32& X, bigint t_offset, const QVector<double>& times, const QVector<int>& labels, int clip_size, int K)
+Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
 {
-    int M = X.N1();
-    bigint N = X.N2();
-    int T = clip_size;
-    int Tmid = (int)((T + 1) / 2) - 1;
-    sums.allocate(M, T, K);
-    counts.allocate(1, K);
-    for (bigint i = 0; i < times.count(); i++) {
-        bigint t = times[i] - t_offset;
-        if ((t >= clip_size) && (t < N - clip_size)) {
-            int k = labels[i];
-            if ((k >= 1) && (k <= K)) {
-                Mda32 clip;
-                X.getChunk(clip, 0, t - Tmid, M, T);
-                for (int t = 0; t < T; t++) {
-                    for (int m = 0; m < M; m++) {
-                        sums.setValue(sums.value(m, t, k - 1) + clip.value(m, t), m, t, k - 1);
-                    }
-                }
-                counts.set(counts.get(k - 1) + 1, k - 1);
-            }
-        }
+    Mda32 templates;
+    if (!compute_templates_in_parallel(templates, 0, X, times, labels, clip_size)) {
+        qWarning() << "Problem computing templates in parallel";
     }
+    return templates;
 }
 
-Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
+bool compute_templates_in_parallel(Mda32& templates, Mda32* stdevs, const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
 {
-    int M = X.N1();
+    bigint M = X.N1();
     bigint N = X.N2();
-    int T = clip_size;
+    bigint T = clip_size;
+    bigint Tmid = (bigint)((T + 1) / 2) - 1;
     int K = MLCompute::max<int>(labels);
+    bigint MT = M * T;
 
-    Mda sums(M, T, K);
-    Mda counts(1, K);
+    templates.allocate(M, T, K);
+    if (stdevs)
+        stdevs->allocate(M, T, K);
+    if ((!MT) || (K <= 0))
+        return true;
 
-    bigint chunk_size = 1e5;
-#pragma omp parallel for
-    for (bigint t = 0; t < N; t += chunk_size) {
-        Mda32 chunk;
-#pragma omp critical(compute_templates_in_parallel1)
-        {
-            X.readChunk(chunk, 0, t - clip_size, M, chunk_size + 2 * clip_size);
+    //sort the events by time once, so that each chunk is handed only its own range of events
+    QVector<bigint> event_times;
+    QVector<int> event_labels;
+    {
+        QVector<double> times0;
+        QVector<int> labels0;
+        for (bigint i = 0; i < times.count(); i++) {
+            int k = labels.value(i);
+            if (k >= 1) {
+                times0 << times[i];
+                labels0 << k;
+            }
+        }
+        QList<bigint> inds = get_sort_indices_bigint(times0);
+        event_times.resize(inds.count());
+        event_labels.resize(inds.count());
+        for (bigint j = 0; j < inds.count(); j++) {
+            event_times[j] = (bigint)(times0[inds[j]] + 0.5);
+            event_labels[j] = labels0[inds[j]];
         }
-        Mda sums0;
-        Mda counts0;
-        get_sums_and_counts_for_templates(sums0, counts0, chunk, t - clip_size, times, labels, clip_size, K);
-#pragma omp critical(compute_templates_in_parallel2)
-        {
-            for (bigint i = 0; i < M * T * K; i++) {
-                sums.set(sums.get(i) + sums0.get(i), i);
+    }
+    bigint L = event_times.count();
+
+    //chunk c gets the events with times in [c*chunk_size,(c+1)*chunk_size). Events outside of the
+    //timeseries go to the first and last chunks, and their clips are zero-padded by readChunk
+    bigint chunk_size = TEMPLATES_CHUNK_SIZE;
+    bigint num_chunks = qMax((bigint)1, (N + chunk_size - 1) / chunk_size);
+    QVector<bigint> chunk_event_starts(num_chunks + 1);
+    chunk_event_starts[0] = 0;
+    for (bigint c = 1; c < num_chunks; c++) {
+        chunk_event_starts[c] = std::lower_bound(event_times.begin(), event_times.end(), c * chunk_size) - event_times.begin();
+    }
+    chunk_event_starts[num_chunks] = L;
+
+    //each worker accumulates into its own contiguous block of sums (and sums of squares), so the
+    //inner loops run over M*T consecutive values without any locking
+    ChunkPipeline pipeline;
+    bigint accumulator_bytes = (stdevs ? 2 : 1) * K * MT * sizeof(double) + K * sizeof(bigint);
+    int num_workers = qMax(1, (int)qMin((bigint)pipeline.numWorkers(), (bigint)(MAX_TEMPLATE_ACCUMULATOR_BYTES / accumulator_bytes)));
+    pipeline.setNumWorkers(num_workers);
+    QVector<double> sums(num_workers * K * MT, 0);
+    QVector<double> sumsqrs(stdevs ? num_workers * K * MT : 0, 0);
+    QVector<bigint> counts(num_workers * K, 0);
+    double* sums_ptr = sums.data();
+    double* sumsqrs_ptr = stdevs ? sumsqrs.data() : 0;
+    bigint* counts_ptr = counts.data();
+
+    pipeline.setNumChunks(num_chunks);
+    pipeline.setReadFunction([&](bigint c, Mda32& chunk) {
+        bigint i1 = chunk_event_starts[c];
+        bigint i2 = chunk_event_starts[c + 1];
+        if (i1 >= i2)
+            return true; //no events, nothing to read
+        bigint t1 = event_times[i1] - Tmid;
+        bigint t2 = event_times[i2 - 1] - Tmid + T - 1;
+        if (!X.readChunk(chunk, 0, t1, M, t2 - t1 + 1)) {
+            qWarning() << "Problem reading chunk in compute_templates_in_parallel" << t1 << t2;
+            return false;
+        }
+        return true;
+    });
+    pipeline.setComputeFunction([&](int w, bigint c, Mda32& chunk) {
+        bigint i1 = chunk_event_starts[c];
+        bigint i2 = chunk_event_starts[c + 1];
+        if (i1 >= i2)
+            return true;
+        bigint t1 = event_times[i1] - Tmid;
+        const float* Xptr = chunk.constDataPtr();
+        double* wsums = &sums_ptr[w * K * MT];
+        double* wsumsqrs = sumsqrs_ptr ? &sumsqrs_ptr[w * K * MT] : 0;
+        bigint* wcounts = &counts_ptr[w * K];
+        for (bigint i = i1; i < i2; i++) {
+            int k = event_labels[i];
+            const float* clip = &Xptr[(event_times[i] - Tmid - t1) * M];
+            double* s = &wsums[(k - 1) * MT];
+            for (bigint aa = 0; aa < MT; aa++) {
+                s[aa] += clip[aa];
             }
-            for (int i = 0; i < K; i++) {
-                counts.set(counts.get(i) + counts0.get(i), i);
+            if (wsumsqrs) {
+                double* ss = &wsumsqrs[(k - 1) * MT];
+                for (bigint aa = 0; aa < MT; aa++) {
+                    ss[aa] += clip[aa] * (double)clip[aa];
+                }
+            }
+            wcounts[k - 1]++;
+        }
+        return true;
+    });
+    if (!pipeline.run())
+        return false;
+
+    //reduce the per-worker accumulators pairwise, in a tree
+    for (int stride = 1; stride < num_workers; stride *= 2) {
+#pragma omp parallel for
+        for (int w = 0; w < num_workers - stride; w += 2 * stride) {
+            double* s1 = &sums_ptr[w * K * MT];
+            const double* s2 = &sums_ptr[(w + stride) * K * MT];
+            for (bigint aa = 0; aa < K * MT; aa++) {
+                s1[aa] += s2[aa];
+            }
+            if (sumsqrs_ptr) {
+                double* ss1 = &sumsqrs_ptr[w * K * MT];
+                const double* ss2 = &sumsqrs_ptr[(w + stride) * K * MT];
+                for (bigint aa = 0; aa < K * MT; aa++) {
+                    ss1[aa] += ss2[aa];
+                }
+            }
+            for (int k = 0; k < K; k++) {
+                counts_ptr[w * K + k] += counts_ptr[(w + stride) * K + k];
             }
         }
     }
-    Mda32 ret(M, T, K);
+
+    float* templates_ptr = templates.dataPtr();
+    float* stdevs_ptr = stdevs ? stdevs->dataPtr() : 0;
     for (int k = 0; k < K; k++) {
-        if (counts.get(k)) {
-            for (int t = 0; t < T; t++) {
-                for (int m = 0; m < M; m++) {
-                    ret.setValue(sums.value(m, t, k) / counts.get(k), m, t, k);
+        bigint count = counts_ptr[k];
+        for (bigint aa = k * MT; aa < (k + 1) * MT; aa++) {
+            if (count) {
+                double mean0 = sums_ptr[aa] / count;
+                templates_ptr[aa] = mean0;
+                if ((stdevs_ptr) && (count >= 2)) {
+                    stdevs_ptr[aa] = sqrt(qMax(0.0, sumsqrs_ptr[aa] / count - mean0 * mean0));
                 }
             }
         }
     }
-    return ret;
+    return true;
 }
 
 Mda32 compute_templates_0(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size)
@@ -169,13 +260,22 @@ Mda32 compute_templates_0(const DiskReadMda32& X, const QVector<double>& times,
     QList<int> counts;
     for (int k = 0; k < K; k++)
         counts << 0;
+    QVector<int> inds;
     for (int i = 0; i < L; i++) {
-        int k = labels[i];
-        bigint t0 = (bigint)(times[i] + 0.5);
-        if (k >= 1) {
-            Mda32 X0;
-            X.readChunk(X0, 0, t0 - Tmid, M, T);
-            dtype32* Xptr = X0.dataPtr();
+        if (labels[i] >= 1)
+            inds << i;
+    }
+    Mda32 clips;
+    for (int i0 = 0; i0 < inds.count(); i0 += TEMPLATES_CLIPS_BATCH_SIZE) {
+        int num = qMin(TEMPLATES_CLIPS_BATCH_SIZE, inds.count() - i0);
+        QVector<bigint> t1s(num);
+        for (int j = 0; j < num; j++) {
+            t1s[j] = (bigint)(times[inds[i0 + j]] + 0.5) - Tmid;
+        }
+        X.readChunks(clips, t1s, T);
+        for (int j = 0; j < num; j++) {
+            int k = labels[inds[i0 + j]];
+            dtype32* Xptr = clips.dataPtr(0, 0, j);
             dtype32* Tptr = templates.dataPtr(0, 0, k - 1);
             for (int i = 0; i < M * T; i++) {
                 Tptr[i] += Xptr[i];
@@ -28,5 +28,10 @@ Mda32 compute_templates_0(const DiskReadMda32& X, Mda& firings, int clip_size);
 Mda32 compute_templates_0(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
 
 Mda32 compute_templates_in_parallel(const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
+//One pass over X: the templates are the means of the clips of each label (1..K), and the stdevs (if not null)
+//are computed along with them. Event times are rounded to the nearest timepoint, and clips that extend past
+//the ends of X are zero-padded rather than skipped. Every label with at least one event gets its mean
+//template; the stdevs are left zero for labels with fewer than two events. Returns false if X could not be read
+bool compute_templates_in_parallel(Mda32& templates, Mda32* stdevs, const DiskReadMda32& X, const QVector<double>& times, const QVector<int>& labels, int clip_size);
 
 #endif // COMPUTE_TEMPLATES_0_H
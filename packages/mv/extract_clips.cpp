@@ -21,6 +21,8 @@
 #endif
 #include "get_principal_components.h"
 
+#define EXTRACT_CLIPS_BATCH_SIZE 10000 //clips read together when only some of the channels are kept
+
 Mda extract_clips(const DiskReadMda& X, const QVector<double>& times, int clip_size)
 {
     bigint M = X.N1();
@@ -53,19 +55,14 @@ Mda32 extract_clips(const DiskReadMda32& X, const QVector<double>& times, int cl
     bigint L = times.count();
     bigint Tmid = (bigint)((T + 1) / 2) - 1;
     Mda32 clips(M, T, L);
+    //clips that do not fit entirely in the timeseries are left as zeros (a window of -T never overlaps it)
+    QVector<bigint> t1s(L);
     for (bigint i = 0; i < L; i++) {
         bigint t1 = (bigint)times[i] - Tmid;
         bigint t2 = t1 + T - 1;
-        if ((t1 >= 0) && (t2 < N)) {
-            Mda32 tmp;
-            X.readChunk(tmp, 0, t1, M, T);
-            for (bigint t = 0; t < T; t++) {
-                for (bigint m = 0; m < M; m++) {
-                    clips.set(tmp.get(m, t), m, t, i);
-                }
-            }
-        }
+        t1s[i] = ((t1 >= 0) && (t2 < N)) ? t1 : -T;
     }
+    X.readChunks(clips, t1s, T);
     return clips;
 }
 
@@ -103,15 +100,20 @@ Mda32 extract_clips(const DiskReadMda32& X, const QVector<double>& times, const
     bigint L = times.count();
     bigint Tmid = (bigint)((T + 1) / 2) - 1;
     Mda32 clips(M0, T, L);
-    for (bigint i = 0; i < L; i++) {
-        bigint t1 = (bigint)times[i] - Tmid;
-        bigint t2 = t1 + T - 1;
-        if ((t1 >= 0) && (t2 < N)) {
-            Mda32 tmp;
-            X.readChunk(tmp, 0, t1, M, T);
+    Mda32 batch;
+    for (bigint i0 = 0; i0 < L; i0 += EXTRACT_CLIPS_BATCH_SIZE) {
+        bigint num = qMin((bigint)EXTRACT_CLIPS_BATCH_SIZE, L - i0);
+        QVector<bigint> t1s(num);
+        for (bigint i = 0; i < num; i++) {
+            bigint t1 = (bigint)times[i0 + i] - Tmid;
+            bigint t2 = t1 + T - 1;
+            t1s[i] = ((t1 >= 0) && (t2 < N)) ? t1 : -T;
+        }
+        X.readChunks(batch, t1s, T);
+        for (bigint i = 0; i < num; i++) {
             for (bigint t = 0; t < T; t++) {
                 for (bigint m0 = 0; m0 < M0; m0++) {
-                    clips.set(tmp.get(channels[m0], t), m0, t, i);
+                    clips.set(batch.get(channels[m0], t, i), m0, t, i0 + i);
                 }
             }
         }
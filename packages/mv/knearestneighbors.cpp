@@ -0,0 +1,107 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "knearestneighbors.h"
+
+#include <float.h>
+
+#define KNN_QUERY_BLOCK_SIZE 32
+#define KNN_REFERENCE_BLOCK_SIZE 256
+
+namespace KNearestNeighbors {
+
+/*
+ * Insert a candidate into the sorted list of the K best so far, which is known to
+ * have the candidate better than its last entry
+ */
+void insert_candidate(float* best_distsqrs, int* best_inds, int K, float distsqr, int ind)
+{
+    int j = K - 1;
+    while ((j > 0) && ((best_distsqrs[j - 1] > distsqr) || ((best_distsqrs[j - 1] == distsqr) && (best_inds[j - 1] > ind)))) {
+        best_distsqrs[j] = best_distsqrs[j - 1];
+        best_inds[j] = best_inds[j - 1];
+        j--;
+    }
+    best_distsqrs[j] = distsqr;
+    best_inds[j] = ind;
+}
+
+/*
+ * Accumulate the squared distances from the query point q to the reference block, which is stored
+ * transposed (one row of num_refs values per feature) so that the inner loop vectorizes
+ */
+void compute_distsqrs(int M, const float* q, const float* refs_transposed, int num_refs, float* distsqrs)
+{
+    for (int r = 0; r < num_refs; r++)
+        distsqrs[r] = 0;
+    for (int m = 0; m < M; m++) {
+        float qm = q[m];
+        const float* row = &refs_transposed[m * num_refs];
+        for (int r = 0; r < num_refs; r++) {
+            float diff = qm - row[r];
+            distsqrs[r] += diff * diff;
+        }
+    }
+}
+}
+
+QVector<int> find_k_nearest_neighbors(const Mda32& X, int K)
+{
+    int M = X.N1();
+    int N = X.N2();
+    K = qMin(K, N);
+    QVector<int> ret(N * K);
+    if (K <= 0)
+        return ret;
+    const float* ptr = X.constDataPtr();
+
+    int num_query_blocks = (N + KNN_QUERY_BLOCK_SIZE - 1) / KNN_QUERY_BLOCK_SIZE;
+#pragma omp parallel for
+    for (int bb = 0; bb < num_query_blocks; bb++) {
+        int q1 = bb * KNN_QUERY_BLOCK_SIZE;
+        int q2 = qMin(N, q1 + KNN_QUERY_BLOCK_SIZE);
+        QVector<float> best_distsqrs((q2 - q1) * K, FLT_MAX);
+        QVector<int> best_inds((q2 - q1) * K, -1);
+        QVector<float> refs_transposed(M * KNN_REFERENCE_BLOCK_SIZE);
+        QVector<float> distsqrs(KNN_REFERENCE_BLOCK_SIZE);
+        for (int r1 = 0; r1 < N; r1 += KNN_REFERENCE_BLOCK_SIZE) {
+            int r2 = qMin(N, r1 + KNN_REFERENCE_BLOCK_SIZE);
+            int num_refs = r2 - r1;
+            for (int r = 0; r < num_refs; r++) {
+                for (int m = 0; m < M; m++) {
+                    refs_transposed[m * num_refs + r] = ptr[m + M * (r1 + r)];
+                }
+            }
+            for (int i = q1; i < q2; i++) {
+                KNearestNeighbors::compute_distsqrs(M, &ptr[M * i], refs_transposed.data(), num_refs, distsqrs.data());
+                if ((i >= r1) && (i < r2))
+                    distsqrs[i - r1] = -1; //the point itself comes first, even among duplicates
+                float* best_distsqrs_i = &best_distsqrs[(i - q1) * K];
+                int* best_inds_i = &best_inds[(i - q1) * K];
+                for (int r = 0; r < num_refs; r++) {
+                    //reference indices increase, so a tie with the last entry never displaces it
+                    if (distsqrs[r] < best_distsqrs_i[K - 1])
+                        KNearestNeighbors::insert_candidate(best_distsqrs_i, best_inds_i, K, distsqrs[r], r1 + r);
+                }
+            }
+        }
+        for (int i = q1; i < q2; i++) {
+            for (int k = 0; k < K; k++) {
+                ret[i * K + k] = best_inds[(i - q1) * K + k];
+            }
+        }
+    }
+    return ret;
+}
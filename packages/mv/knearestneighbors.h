@@ -0,0 +1,29 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef KNEARESTNEIGHBORS_H
+#define KNEARESTNEIGHBORS_H
+
+#include "mda32.h"
+#include <QVector>
+
+/*
+ * Exact K nearest neighbors of every column of X among all the columns of X, by brute force over blocks
+ * of points. The result has min(K, N) entries per point (point i at [i * min(K, N) ...]), ordered by
+ * distance, and the point itself always comes first.
+ */
+QVector<int> find_k_nearest_neighbors(const Mda32& X, int K);
+
+#endif // KNEARESTNEIGHBORS_H
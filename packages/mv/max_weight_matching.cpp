@@ -0,0 +1,144 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "max_weight_matching.h"
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace MaxWeightMatching {
+
+struct ResidualEdge {
+    int to;
+    int rev; //index of the reverse edge in the adjacency list of to
+    int cap;
+    bigint cost;
+};
+
+class ResidualGraph {
+public:
+    ResidualGraph(int num_nodes)
+        : adj(num_nodes)
+    {
+    }
+    void addEdge(int from, int to, bigint cost)
+    {
+        adj[from].push_back(ResidualEdge{ to, (int)adj[to].size(), 1, cost });
+        adj[to].push_back(ResidualEdge{ from, (int)adj[from].size() - 1, 0, -cost });
+    }
+    std::vector<std::vector<ResidualEdge> > adj;
+};
+}
+
+QVector<int> max_weight_matching(int M, int N, const QVector<MatchingEdge>& edges)
+{
+    using namespace MaxWeightMatching;
+
+    QVector<int> assignment(M, -1);
+    if (edges.isEmpty())
+        return assignment;
+
+    //source -> rows -> columns -> sink, each unit capacity, and the cost of a row->column edge is minus its weight
+    const bigint inf = std::numeric_limits<bigint>::max() / 4;
+    int source = M + N;
+    int sink = M + N + 1;
+    int num_nodes = M + N + 2;
+    ResidualGraph G(num_nodes);
+
+    //the initial potentials are the shortest distances from the source (the graph has no cycles yet)
+    std::vector<bigint> potential(num_nodes, 0);
+    std::vector<bool> col_used(N, false);
+    for (int i = 0; i < M; i++)
+        G.addEdge(source, i, 0);
+    for (int e = 0; e < edges.count(); e++) {
+        const MatchingEdge& E = edges[e];
+        if (E.weight <= 0)
+            continue;
+        G.addEdge(E.row, M + E.col, -E.weight);
+        if ((!col_used[E.col]) || (-E.weight < potential[M + E.col]))
+            potential[M + E.col] = -E.weight;
+        col_used[E.col] = true;
+    }
+    bool any_cols = false;
+    for (int j = 0; j < N; j++) {
+        if (col_used[j]) {
+            G.addEdge(M + j, sink, 0);
+            potential[sink] = qMin(potential[sink], potential[M + j]);
+            any_cols = true;
+        }
+    }
+    if (!any_cols)
+        return assignment;
+
+    typedef std::pair<bigint, int> DistNode;
+    std::vector<bigint> dist(num_nodes);
+    std::vector<int> prev_node(num_nodes), prev_edge(num_nodes);
+    while (true) {
+        //shortest path from the source to the sink in reduced costs, which are never negative
+        std::fill(dist.begin(), dist.end(), inf);
+        dist[source] = 0;
+        std::priority_queue<DistNode, std::vector<DistNode>, std::greater<DistNode> > queue;
+        queue.push(DistNode(0, source));
+        while (!queue.empty()) {
+            DistNode top = queue.top();
+            queue.pop();
+            int u = top.second;
+            if (top.first > dist[u])
+                continue;
+            if (u == sink)
+                break; //nothing further can improve the path to the sink
+            for (int a = 0; a < (int)G.adj[u].size(); a++) {
+                const ResidualEdge& E = G.adj[u][a];
+                if (E.cap <= 0)
+                    continue;
+                bigint d = dist[u] + E.cost + potential[u] - potential[E.to];
+                if (d < dist[E.to]) {
+                    dist[E.to] = d;
+                    prev_node[E.to] = u;
+                    prev_edge[E.to] = a;
+                    queue.push(DistNode(d, E.to));
+                }
+            }
+        }
+        if (dist[sink] >= inf)
+            break;
+        //the true cost of the path is minus the gain in total weight; costs only grow from here, so stop at the first one that gains nothing
+        bigint path_cost = dist[sink] + potential[sink] - potential[source];
+        if (path_cost >= 0)
+            break;
+        //capping at the sink distance keeps the reduced costs nonnegative for the nodes the search did not settle
+        for (int v = 0; v < num_nodes; v++) {
+            potential[v] += qMin(dist[v], dist[sink]);
+        }
+        for (int v = sink; v != source; v = prev_node[v]) {
+            ResidualEdge& E = G.adj[prev_node[v]][prev_edge[v]];
+            E.cap--;
+            G.adj[v][E.rev].cap++;
+        }
+    }
+
+    for (int i = 0; i < M; i++) {
+        for (int a = 0; a < (int)G.adj[i].size(); a++) {
+            const ResidualEdge& E = G.adj[i][a];
+            if ((E.to >= M) && (E.to < M + N) && (E.cap == 0) && (E.cost < 0)) {
+                assignment[i] = E.to - M;
+            }
+        }
+    }
+    return assignment;
+}
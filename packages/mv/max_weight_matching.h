@@ -0,0 +1,38 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MAX_WEIGHT_MATCHING_H
+#define MAX_WEIGHT_MATCHING_H
+
+#include <QVector>
+#include <stdint.h>
+typedef int64_t bigint;
+
+struct MatchingEdge {
+    int row = 0;
+    int col = 0;
+    bigint weight = 0;
+};
+
+/*
+ * Exact maximum-weight matching of a sparse bipartite graph with M rows and N columns, given only its
+ * edges of positive weight (a row and column with no edge between them are never matched). Solved by
+ * successive shortest augmenting paths (Dijkstra with potentials), O(min(M, N) * E * log(M + N)) for E
+ * edges, so it scales with the nonzeros rather than with M * N. Returns, for each row, the column it is
+ * matched to, or -1.
+ */
+QVector<int> max_weight_matching(int M, int N, const QVector<MatchingEdge>& edges);
+
+#endif // MAX_WEIGHT_MATCHING_H
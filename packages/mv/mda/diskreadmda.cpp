@@ -26,8 +26,13 @@
 #include <QJsonArray>
 //#include <icounter.h>
 //#include <objectregistry.h>
+#include <QMutex>
+#include <vector>
+#include <unistd.h>
+#include <errno.h>
 
 #define MAX_PATH_LEN 10000
+#define READ_BLOCK_SIZE 1e6
 #define DEFAULT_CHUNK_SIZE 1e5
 
 /// TODO (LOW) make tmp directory with different name on server, so we can really test if it is doing the computation in the right place
@@ -36,6 +41,7 @@ class DiskReadMdaPrivate {
 public:
     DiskReadMda* q;
     FILE* m_file;
+    QMutex m_file_mutex { QMutex::Recursive }; //guards opening the file; reads use pread and need no lock
     bool m_file_open_failed;
     bool m_header_read;
     MDAIO_HEADER m_header;
@@ -62,6 +68,7 @@ public:
     void construct_and_clear();
     bool read_header_if_needed();
     bool open_file_if_needed();
+    bigint read_entries(double* data, bigint i, bigint n);
     void copy_from(const DiskReadMda& other);
     bigint total_size();
     static QStringList find_all_mda_files_in_directory(QString dir_path, bool recursive);
@@ -598,8 +605,7 @@ bool DiskReadMda::readChunk(Mda& X, bigint i, bigint size) const
     bigint jB = qMin(i + size - 1, d->total_size() - 1);
     bigint size_to_read = jB - jA + 1;
     if (size_to_read > 0) {
-        fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (jA), SEEK_SET);
-        bigint bytes_read = mda_read_float64(&X.dataPtr()[jA - i], &d->m_header, size_to_read, d->m_file);
+        bigint bytes_read = d->read_entries(&X.dataPtr()[jA - i], jA, size_to_read);
         /*
         if (d->bytesReadCounter)
             d->bytesReadCounter->add(bytes_read);
@@ -635,8 +641,7 @@ bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint size1, bigint s
         bigint jB = qMin(i2 + size2 - 1, N2() - 1);
         bigint size2_to_read = jB - jA + 1;
         if (size2_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i2) * size1], &d->m_header, size1 * size2_to_read, d->m_file);
+            bigint bytes_read = d->read_entries(&X.dataPtr()[(jA - i2) * size1], i1 + N1() * jA, size1 * size2_to_read);
             /*
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
@@ -682,8 +687,7 @@ bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint i3, bigint size
         bigint jB = qMin(i3 + size3 - 1, N3() - 1);
         bigint size3_to_read = jB - jA + 1;
         if (size3_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * i2 + N1() * N2() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i3) * size1 * size2], &d->m_header, size1 * size2 * size3_to_read, d->m_file);
+            bigint bytes_read = d->read_entries(&X.dataPtr()[(jA - i3) * size1 * size2], i1 + N1() * i2 + N1() * N2() * jA, size1 * size2 * size3_to_read);
             /*
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
@@ -764,6 +768,7 @@ bool DiskReadMdaPrivate::read_header_if_needed()
 {
     if (m_header_read)
         return true;
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda) {
         m_header_read = true;
         return true;
@@ -811,6 +816,7 @@ bool DiskReadMdaPrivate::read_header_if_needed()
 
 bool DiskReadMdaPrivate::open_file_if_needed()
 {
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda)
         return true;
     if (m_use_concat) {
@@ -848,6 +854,43 @@ bool DiskReadMdaPrivate::open_file_if_needed()
     return true;
 }
 
+static bigint pread_fully(int fd, unsigned char* buf, bigint nbytes, bigint offset)
+{
+    bigint num_read = 0;
+    while (num_read < nbytes) {
+        ssize_t ret = pread(fd, buf + num_read, nbytes - num_read, offset + num_read);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (ret == 0)
+            break;
+        num_read += ret;
+    }
+    return num_read;
+}
+
+bigint DiskReadMdaPrivate::read_entries(double* data, bigint i, bigint n)
+{
+    //positional reads leave the FILE position alone, so concurrent readChunk() calls don't have to be serialized
+    int fd = fileno(m_file);
+    bigint entry_size = m_header.num_bytes_per_entry;
+    bigint block_size = qMin(n, (bigint)READ_BLOCK_SIZE);
+    std::vector<unsigned char> buf(block_size * entry_size);
+    bigint num_read = 0;
+    while (num_read < n) {
+        bigint n0 = qMin(block_size, n - num_read);
+        bigint nbytes = pread_fully(fd, buf.data(), n0 * entry_size, m_header.header_size + entry_size * (i + num_read));
+        bigint n1 = nbytes / entry_size;
+        mda_convert_float64(data + num_read, &m_header, n1, buf.data());
+        num_read += n1;
+        if (n1 < n0)
+            break;
+    }
+    return num_read;
+}
+
 void DiskReadMdaPrivate::copy_from(const DiskReadMda& other)
 {
     /// TODO (LOW) think about copying over additional information such as internal chunks
@@ -26,9 +26,21 @@
 #include <QJsonArray>
 //#include <icounter.h>
 //#include <objectregistry.h>
+#include <QMutex>
+#include <QThread>
+#include <QAtomicInt>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unistd.h>
+#include <errno.h>
 
 #define MAX_PATH_LEN 10000
+#define READ_BLOCK_SIZE 1e6
 #define DEFAULT_CHUNK_SIZE 1e6
+#define READ_CHUNKS_MAX_GAP_BYTES (64 * 1024) //windows closer than this are read together
+#define READ_CHUNKS_MAX_SPAN_BYTES (4 * 1024 * 1024) //but no single read is longer than this
+#define READ_CHUNKS_MAX_THREADS 8
 
 /// TODO (LOW) make tmp directory with different name on server, so we can really test if it is doing the computation in the right place
 
@@ -36,6 +48,7 @@ class DiskReadMda32Private {
 public:
     DiskReadMda32* q;
     FILE* m_file;
+    QMutex m_file_mutex { QMutex::Recursive }; //guards opening the file; reads use pread and need no lock
     bool m_file_open_failed;
     bool m_header_read;
     MDAIO_HEADER m_header;
@@ -62,6 +75,7 @@ public:
     void construct_and_clear();
     bool read_header_if_needed();
     bool open_file_if_needed();
+    bigint read_entries(dtype32* data, bigint i, bigint n);
     void copy_from(const DiskReadMda32& other);
     bigint total_size();
     static QStringList find_all_mda_files_in_directory(QString dir_path, bool recursive);
@@ -598,8 +612,7 @@ bool DiskReadMda32::readChunk(Mda32& X, bigint i, bigint size) const
     bigint jB = qMin(i + size - 1, d->total_size() - 1);
     bigint size_to_read = jB - jA + 1;
     if (size_to_read > 0) {
-        fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (jA), SEEK_SET);
-        bigint bytes_read = mda_read_float32(&X.dataPtr()[jA - i], &d->m_header, size_to_read, d->m_file);
+        bigint bytes_read = d->read_entries(&X.dataPtr()[jA - i], jA, size_to_read);
         /*
         if (d->bytesReadCounter)
             d->bytesReadCounter->add(bytes_read);
@@ -635,8 +648,7 @@ bool DiskReadMda32::readChunk(Mda32& X, bigint i1, bigint i2, bigint size1, bigi
         bigint jB = qMin(i2 + size2 - 1, N2() - 1);
         bigint size2_to_read = jB - jA + 1;
         if (size2_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float32(&X.dataPtr()[(jA - i2) * size1], &d->m_header, size1 * size2_to_read, d->m_file);
+            bigint bytes_read = d->read_entries(&X.dataPtr()[(jA - i2) * size1], i1 + N1() * jA, size1 * size2_to_read);
             /*
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
@@ -688,8 +700,7 @@ bool DiskReadMda32::readChunk(Mda32& X, bigint i1, bigint i2, bigint i3, bigint
         bigint jB = qMin(i3 + size3 - 1, N3() - 1);
         bigint size3_to_read = jB - jA + 1;
         if (size3_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * i2 + N1() * N2() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float32(&X.dataPtr()[(jA - i3) * size1 * size2], &d->m_header, size1 * size2 * size3_to_read, d->m_file);
+            bigint bytes_read = d->read_entries(&X.dataPtr()[(jA - i3) * size1 * size2], i1 + N1() * i2 + N1() * N2() * jA, size1 * size2 * size3_to_read);
             /*
             if (d->bytesReadCounter)
                 d->bytesReadCounter->add(bytes_read);
@@ -707,6 +718,128 @@ bool DiskReadMda32::readChunk(Mda32& X, bigint i1, bigint i2, bigint i3, bigint
     }
 }
 
+class ReadChunksThread : public QThread {
+public:
+    std::function<void()> body;
+    void run()
+    {
+        body();
+    }
+};
+
+struct ReadChunksGroup {
+    bigint first = 0, last = 0; //range in the sorted window order
+    bigint t1 = 0, t2 = 0; //columns to read, inside the array
+};
+
+bool DiskReadMda32::readChunks(Mda32& X, const QVector<bigint>& i2, bigint size2) const
+{
+    bigint M = N1();
+    bigint L = i2.count();
+    if ((X.N1() != M) || (X.N2() != size2) || (X.N3() != L) || (X.N4() != 1) || (X.N5() != 1) || (X.N6() != 1))
+        X.allocate(M, size2, L);
+    if ((M == 0) || (size2 <= 0) || (L == 0))
+        return true;
+    if ((d->m_use_memory_mda) || (d->m_use_concat)) {
+        for (bigint j = 0; j < L; j++) {
+            Mda32 tmp;
+            if (!readChunk(tmp, 0, i2[j], M, size2))
+                return false;
+            X.setChunk(tmp, 0, 0, j);
+        }
+        return true;
+    }
+    if (!d->open_file_if_needed())
+        return false;
+    bigint N2 = this->N2();
+    if (M * N2 != d->total_size()) {
+        qWarning() << "Cannot read chunks, dimensions don't agree:" << M << N2 << d->total_size();
+        return false;
+    }
+
+    //sort the windows by start column, and group those that are close together into one read
+    std::vector<bigint> order(L);
+    for (bigint j = 0; j < L; j++)
+        order[j] = j;
+    std::stable_sort(order.begin(), order.end(), [&i2](bigint a, bigint b) { return i2[a] < i2[b]; });
+    bigint column_bytes = M * d->m_header.num_bytes_per_entry;
+    bigint max_gap = READ_CHUNKS_MAX_GAP_BYTES / column_bytes;
+    bigint max_span = qMax(size2, (bigint)(READ_CHUNKS_MAX_SPAN_BYTES / column_bytes));
+    QList<ReadChunksGroup> groups;
+    for (bigint jj = 0; jj < L; jj++) {
+        bigint j = order[jj];
+        bigint w1 = qMax(i2[j], (bigint)0);
+        bigint w2 = qMin(i2[j] + size2 - 1, N2 - 1);
+        if (w1 > w2)
+            continue; //entirely outside the array
+        if ((!groups.isEmpty()) && (w1 <= groups.last().t2 + 1 + max_gap) && (qMax(w2, groups.last().t2) - groups.last().t1 + 1 <= max_span)) {
+            groups.last().last = jj;
+            groups.last().t2 = qMax(w2, groups.last().t2);
+        }
+        else {
+            ReadChunksGroup G;
+            G.first = G.last = jj;
+            G.t1 = w1;
+            G.t2 = w2;
+            groups << G;
+        }
+    }
+
+    //the reads are positional, so the threads share the file. Each takes the next group until there are none left
+    dtype32* Xptr = X.dataPtr();
+    QAtomicInt next_group_index(0);
+    QAtomicInt failed(0);
+    auto read_groups = [&]() {
+        std::vector<dtype32> buf;
+        while (!failed.load()) {
+            int gg = next_group_index.fetchAndAddOrdered(1);
+            if (gg >= groups.count())
+                break;
+            const ReadChunksGroup& G = groups[gg];
+            bigint num_columns = G.t2 - G.t1 + 1;
+            buf.resize(M * num_columns);
+            if (d->read_entries(buf.data(), M * G.t1, M * num_columns) != M * num_columns) {
+                printf("Warning problem reading chunks in DiskReadMda32: %ld-%ld\n", (long)G.t1, (long)G.t2);
+                failed.store(1);
+                break;
+            }
+            for (bigint jj = G.first; jj <= G.last; jj++) {
+                bigint j = order[jj];
+                dtype32* ptr = &Xptr[M * size2 * j];
+                for (bigint t = 0; t < size2; t++) {
+                    bigint t0 = i2[j] + t;
+                    if ((G.t1 <= t0) && (t0 <= G.t2))
+                        std::copy(&buf[M * (t0 - G.t1)], &buf[M * (t0 - G.t1)] + M, &ptr[M * t]);
+                    else
+                        std::fill(&ptr[M * t], &ptr[M * t] + M, 0);
+                }
+            }
+        }
+    };
+    int num_threads = qMin(groups.count(), qMin(READ_CHUNKS_MAX_THREADS, qMax(1, QThread::idealThreadCount())));
+    QList<ReadChunksThread*> threads;
+    for (int i = 1; i < num_threads; i++) {
+        ReadChunksThread* thread = new ReadChunksThread;
+        thread->body = read_groups;
+        thread->start();
+        threads << thread;
+    }
+    read_groups();
+    foreach (ReadChunksThread* thread, threads) {
+        thread->wait();
+        delete thread;
+    }
+    if (failed.load())
+        return false;
+
+    //the windows that were entirely outside the array
+    for (bigint j = 0; j < L; j++) {
+        if ((i2[j] + size2 - 1 < 0) || (i2[j] > N2 - 1))
+            std::fill(&Xptr[M * size2 * j], &Xptr[M * size2 * j] + M * size2, 0);
+    }
+    return true;
+}
+
 dtype32 DiskReadMda32::value(bigint i) const
 {
     if (d->m_use_memory_mda)
@@ -770,6 +903,7 @@ bool DiskReadMda32Private::read_header_if_needed()
 {
     if (m_header_read)
         return true;
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda) {
         m_header_read = true;
         return true;
@@ -817,6 +951,7 @@ bool DiskReadMda32Private::read_header_if_needed()
 
 bool DiskReadMda32Private::open_file_if_needed()
 {
+    QMutexLocker locker(&m_file_mutex);
     if (m_use_memory_mda)
         return true;
     if (m_use_concat) {
@@ -854,6 +989,43 @@ bool DiskReadMda32Private::open_file_if_needed()
     return true;
 }
 
+static bigint pread_fully(int fd, unsigned char* buf, bigint nbytes, bigint offset)
+{
+    bigint num_read = 0;
+    while (num_read < nbytes) {
+        ssize_t ret = pread(fd, buf + num_read, nbytes - num_read, offset + num_read);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (ret == 0)
+            break;
+        num_read += ret;
+    }
+    return num_read;
+}
+
+bigint DiskReadMda32Private::read_entries(dtype32* data, bigint i, bigint n)
+{
+    //positional reads leave the FILE position alone, so concurrent readChunk() calls don't have to be serialized
+    int fd = fileno(m_file);
+    bigint entry_size = m_header.num_bytes_per_entry;
+    bigint block_size = qMin(n, (bigint)READ_BLOCK_SIZE);
+    std::vector<unsigned char> buf(block_size * entry_size);
+    bigint num_read = 0;
+    while (num_read < n) {
+        bigint n0 = qMin(block_size, n - num_read);
+        bigint nbytes = pread_fully(fd, buf.data(), n0 * entry_size, m_header.header_size + entry_size * (i + num_read));
+        bigint n1 = nbytes / entry_size;
+        mda_convert_float32(data + num_read, &m_header, n1, buf.data());
+        num_read += n1;
+        if (n1 < n0)
+            break;
+    }
+    return num_read;
+}
+
 void DiskReadMda32Private::copy_from(const DiskReadMda32& other)
 {
     /// TODO (LOW) think about copying over additional information such as internal chunks
@@ -19,6 +19,7 @@
 
 #include "mda32.h"
 #include "mdaio.h"
+#include <QVector>
 
 class DiskReadMda32Private;
 /**
@@ -69,6 +70,10 @@ public:
     bool readChunk(Mda32& X, bigint i1, bigint i2, bigint size1, bigint size2) const;
     ///Retrieve a chunk of the vectorized data of size N1xN2xN3 starting at position (i1,i2,i3)
     bool readChunk(Mda32& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const;
+    ///Retrieve many N1 x size2 windows at once (e.g. spike clips): window j starts at column i2[j] and goes to X(:,:,j). X is allocated
+    ///(N1 x size2 x i2.count()) only if it does not have those dimensions already. Nearby windows are coalesced into single reads,
+    ///which are issued from several threads. Columns outside the array are zero. Like readChunk(), this may be called from multiple threads
+    bool readChunks(Mda32& X, const QVector<bigint>& i2, bigint size2) const;
 
     ///A slow method to retrieve the value at location i of the vectorized array for example value(3+4*N1())==value(3,4). Consider using readChunk() instead
     dtype32 value(bigint i) const;
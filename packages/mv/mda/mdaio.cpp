@@ -18,8 +18,11 @@
 #include <vector>
 #include <cstring>
 #include <inttypes.h>
+#include <algorithm>
 #include <QDebug>
 
+#define MDAIO_CONVERSION_BLOCK_SIZE 1e6
+
 //can be replaced by std::is_same when C++11 is enabled
 template <class T, class U>
 struct is_same {
@@ -209,13 +212,69 @@ bigint mdaReadData_impl(TargetType* data, const bigint size, FILE* inputFile)
         return jfread(data, sizeof(SourceType), size, inputFile);
     }
     else {
-        std::vector<SourceType> tmp(size);
-        const bigint ret = jfread(&tmp[0], sizeof(SourceType), size, inputFile);
-        std::copy(tmp.begin(), tmp.end(), data);
+        //convert in bounded blocks so that large reads do not need a full-size temporary
+        const bigint block_size = std::min(size, (bigint)MDAIO_CONVERSION_BLOCK_SIZE);
+        std::vector<SourceType> tmp(block_size);
+        bigint ret = 0;
+        for (bigint i = 0; i < size; i += block_size) {
+            const bigint n = std::min(block_size, size - i);
+            const bigint num_read = jfread(&tmp[0], sizeof(SourceType), n, inputFile);
+            if (num_read > 0)
+                std::copy(tmp.begin(), tmp.begin() + num_read, data + i);
+            ret += num_read;
+            if (num_read < n)
+                break;
+        }
         return ret;
     }
 }
 
+template <typename SourceType, typename TargetType>
+bigint mdaConvertData_impl(TargetType* data, const bigint size, const unsigned char* src)
+{
+    if ((uintptr_t)src % sizeof(SourceType) == 0) {
+        const SourceType* ptr = (const SourceType*)src;
+        std::copy(ptr, ptr + size, data);
+    }
+    else {
+        //the header size is not always a multiple of the entry size (e.g. float64 with 32-bit dims)
+        for (bigint i = 0; i < size; i++) {
+            SourceType val;
+            std::memcpy(&val, src + i * sizeof(SourceType), sizeof(SourceType));
+            data[i] = val;
+        }
+    }
+    return size;
+}
+
+template <typename Type>
+bigint mdaConvertData(Type* data, const struct MDAIO_HEADER* header, const bigint size, const unsigned char* src)
+{
+    if (header->data_type == MDAIO_TYPE_BYTE) {
+        return mdaConvertData_impl<unsigned char>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT32) {
+        return mdaConvertData_impl<float>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT16) {
+        return mdaConvertData_impl<int16_t>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT32) {
+        return mdaConvertData_impl<int32_t>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT16) {
+        return mdaConvertData_impl<uint16_t>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT64) {
+        return mdaConvertData_impl<double>(data, size, src);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT32) {
+        return mdaConvertData_impl<uint32_t>(data, size, src);
+    }
+    else
+        return 0;
+}
+
 template <typename Type>
 bigint mdaReadData(Type* data, const struct MDAIO_HEADER* header, const bigint size, FILE* inputFile)
 {
@@ -320,6 +379,16 @@ bigint mda_read_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, FILE* i
     return mdaReadData(data, H, n, input_file);
 }
 
+bigint mda_convert_float32(float* data, const struct MDAIO_HEADER* H, bigint n, const void* src)
+{
+    return mdaConvertData(data, H, n, (const unsigned char*)src);
+}
+
+bigint mda_convert_float64(double* data, const struct MDAIO_HEADER* H, bigint n, const void* src)
+{
+    return mdaConvertData(data, H, n, (const unsigned char*)src);
+}
+
 bigint mda_write_byte(unsigned char* data, struct MDAIO_HEADER* H, bigint n, FILE* output_file)
 {
     return mdaWriteData(data, n, H, output_file);
@@ -23,15 +23,16 @@ macx:CONFIG -= app_bundle
 #QMAKE_LFLAGS += -fopenmp
 
 #FFTW
-#USE_FFTW3=$$(USE_FFTW3)
-#CONFIG("no_fftw3") {
-#    warning(Not using FFTW3)
-#}
-#else {
-#    LIBS += -lfftw3f -lfftw3f_threads
-#    SOURCES += p_spikeview_templates.cpp
-#    HEADERS += p_spikeview_templates.h
-#}
+USE_FFTW3=$$(USE_FFTW3)
+CONFIG("no_fftw3") {
+    warning(Not using FFTW3)
+    DEFINES += NO_FFTW3
+}
+else {
+    LIBS += -lfftw3f -lfftw3f_threads
+    SOURCES += p_bandpass_filter.cpp p_spikeview_templates.cpp
+    HEADERS += p_bandpass_filter.h p_spikeview_templates.h
+}
 
 #-std=c++11   # AHB removed since not in GNU gcc 4.6.3
 
@@ -47,7 +48,8 @@ SOURCES += \
     #p_extract_firings.cpp \
     #p_concat_timeseries.cpp \
     #p_banjoview_cross_correlograms.cpp \
-    #kdtree.cpp \
+    kdtree.cpp \
+    knearestneighbors.cpp \
     get_sort_indices.cpp \
     p_create_multiscale_timeseries.cpp \
     p_mv_discrimhist.cpp
@@ -60,7 +62,8 @@ HEADERS += \
     #p_synthesize_timeseries.h \
     #p_combine_firing_segments.h \
     #p_extract_firings.h \
-    #kdtree.h \
+    kdtree.h \
+    knearestneighbors.h \
     get_sort_indices.h \
     p_create_multiscale_timeseries.h \
     p_mv_discrimhist.h
@@ -69,7 +72,7 @@ HEADERS += \
     p_extract_clips.h \
     #p_create_firings.h \
     #p_combine_firings.h \
-    #p_whiten.h \
+    p_whiten.h \
     #p_apply_timestamp_offset.h \
     #p_link_segments.h \
     #p_cluster_metrics.h \
@@ -78,22 +81,21 @@ HEADERS += \
     p_compute_templates.h \
     #p_load_test.h \
     #p_compute_amplitudes.h \
-    #p_isolation_metrics.h \
-    #p_confusion_matrix.h \
+    p_isolation_metrics.h \
+    p_confusion_matrix.h \
     #p_reorder_labels.h \
-    #p_bandpass_filter.h \
     p_mask_out_artifacts.h \
     p_mv_compute_templates.h \
     p_mv_compute_amplitudes.h \
     extract_clips.h \
     get_principal_components.h \
-    hungarian.h
+    max_weight_matching.h
 
 SOURCES += \
     p_extract_clips.cpp \
     #p_create_firings.cpp \
     #p_combine_firings.cpp \
-    #p_whiten.cpp \
+    p_whiten.cpp \
     #p_apply_timestamp_offset.cpp \
     #p_link_segments.cpp \
     #p_cluster_metrics.cpp \
@@ -102,16 +104,15 @@ SOURCES += \
     p_compute_templates.cpp \
     #p_load_test.cpp \
     #p_compute_amplitudes.cpp \
-    #p_isolation_metrics.cpp \
-    #p_confusion_matrix.cpp \
+    p_isolation_metrics.cpp \
+    p_confusion_matrix.cpp \
     #p_reorder_labels.cpp \
-    #p_bandpass_filter.cpp \
-    #p_mask_out_artifacts.cpp \
+    p_mask_out_artifacts.cpp \
     p_mv_compute_templates.cpp \
     p_mv_compute_amplitudes.cpp \
     extract_clips.cpp \
     get_principal_components.cpp \
-    hungarian.cpp
+    max_weight_matching.cpp
 
 HEADERS += pca.h compute_templates_0.h
 SOURCES += pca.cpp compute_templates_0.cpp
@@ -138,11 +139,13 @@ INCLUDEPATH += common
 HEADERS += common/mlcompute.h \
     common/clparams.h \
     common/textfile.h \
-    common/mlutil.h
+    common/mlutil.h \
+    common/chunkpipeline.h
 
 SOURCES += common/mlcompute.cpp \
     common/clparams.cpp \
     common/textfile.cpp \
-    common/mlutil.cpp
+    common/mlutil.cpp \
+    common/chunkpipeline.cpp
 
 
@@ -24,13 +24,15 @@
 #include "mv_main.h"
 //#include "p_multineighborhood_sort.h"
 //#include "p_preprocess.h"
-//#include "p_spikeview_templates.h"
 //#include "omp.h"
 //#include "p_synthesize_timeseries.h"
 
 #include "p_create_multiscale_timeseries.h"
-//#include "p_bandpass_filter.h"
-//#include "p_whiten.h"
+#ifndef NO_FFTW3
+#include "p_bandpass_filter.h"
+#include "p_spikeview_templates.h"
+#endif
+#include "p_whiten.h"
 #include "p_extract_clips.h"
 #include "p_compute_templates.h"
 
@@ -38,13 +40,13 @@
 #include "p_mv_discrimhist.h"
 
 #include "p_mv_compute_amplitudes.h"
+#include "p_mask_out_artifacts.h"
+#include "p_confusion_matrix.h"
+#include "p_isolation_metrics.h"
 
 #if 0
-#include "p_confusion_matrix.h"
 #include "p_reorder_labels.h"
-#include "p_mask_out_artifacts.h"
 #include "p_compute_amplitudes.h"
-#include "p_isolation_metrics.h"
 #include "p_concat_firings.h"
 #include "p_concat_timeseries.h"
 #include "p_split_firings.h"
@@ -82,7 +84,7 @@ QJsonObject get_spec()
     }
 #endif
 #ifndef NO_FFTW3
-    /*{
+    {
         ProcessorSpec X("spikeview.templates", "0.16");
         X.addInputs("timeseries", "firings");
         X.addOutputs("templates_out");
@@ -91,7 +93,7 @@ QJsonObject get_spec()
         X.addOptionalParameters("samplerate", "freq_min", "freq_max");
         X.addOptionalParameter("subtract_temporal_mean", "", "false");
         processors.push_back(X.get_spec());
-    }*/
+    }
 #endif
 #if 0
     {
@@ -152,7 +154,7 @@ QJsonObject get_spec()
 
 
 #ifndef NO_FFTW3
-    /*{
+    {
         ProcessorSpec X("mv.bandpass_filter", "0.20");
         X.addInputs("timeseries");
         X.addOutputs("timeseries_out");
@@ -162,9 +164,9 @@ QJsonObject get_spec()
         X.addOptionalParameter("subsample_factor", "", 1);
         X.can_return_requirements = true;
         processors.push_back(X.get_spec());
-    }*/
+    }
 #endif
-    /*{
+    {
         ProcessorSpec X("mv.whiten", "0.1");
         X.addInputs("timeseries");
         X.addOutputs("timeseries_out");
@@ -197,7 +199,6 @@ QJsonObject get_spec()
         X.addOptionalParameter("quantization_unit", "", 0);
         processors.push_back(X.get_spec());
     }
-    */
     {
         ProcessorSpec X("mv.extract_clips", "0.11");
         X.addInput("timeseries");
@@ -224,7 +225,7 @@ QJsonObject get_spec()
         processors.push_back(X.get_spec());
     }
     {
-        ProcessorSpec X("mv.compute_templates", "0.11");
+        ProcessorSpec X("mv.compute_templates", "0.12");
         X.addInputs("timeseries", "firings");
         X.addOutputs("templates_out");
         X.addRequiredParameters("clip_size");
@@ -277,14 +278,6 @@ QJsonObject get_spec()
         X.addRequiredParameters("samplerate");
         processors.push_back(X.get_spec());
     }
-    {
-        ProcessorSpec X("mv.isolation_metrics", "0.15j");
-        X.addInputs("timeseries", "firings");
-        X.addOutputs("metrics_out");
-        X.addOptionalOutputs("pair_metrics_out");
-        X.addOptionalParameter("compute_bursting_parents", "", "false");
-        processors.push_back(X.get_spec());
-    }
     /*
     {
         ProcessorSpec X("mv.extract_firings", "0.11");
@@ -308,6 +301,15 @@ QJsonObject get_spec()
         processors.push_back(X.get_spec());
     }
 #endif
+    {
+        ProcessorSpec X("mv.isolation_metrics", "0.16");
+        X.addInputs("timeseries", "firings");
+        X.addOutputs("metrics_out");
+        X.addOptionalOutputs("pair_metrics_out");
+        X.addOptionalParameter("compute_bursting_parents", "", "false");
+        X.addOptionalParameter("exact_nearest_neighbors", "", "true");
+        processors.push_back(X.get_spec());
+    }
     {
         ProcessorSpec X("mv.mv_discrimhist", "0.1");
         X.addInputs("timeseries", "firings");
@@ -345,8 +347,9 @@ QJsonObject get_spec()
         X.addRequiredParameters("central_channel");
         processors.push_back(X.get_spec());
     }
+#endif
     {
-        ProcessorSpec X("mv.confusion_matrix", "0.17");
+        ProcessorSpec X("mv.confusion_matrix", "0.18");
         X.addInputs("firings1", "firings2");
         X.addOutputs("confusion_matrix_out");
         X.addOptionalOutputs("matched_firings_out", "label_map_out", "firings2_relabeled_out", "firings2_relabel_map_out");
@@ -355,16 +358,15 @@ QJsonObject get_spec()
         processors.push_back(X.get_spec());
     }
     {
-        ProcessorSpec X("mv.mask_out_artifacts", "0.1");
+        ProcessorSpec X("mv.mask_out_artifacts", "0.2");
         X.addInputs("timeseries");
-        X.addOutputs("timeseries_out");
-        X.addOptionalParameter("threshold","",6);
-        X.addOptionalParameter("interval_size","",2000);
+        X.addOptionalOutputs("timeseries_out", "masked_intervals_out");
+        X.addOptionalParameter("threshold", "", 6);
+        X.addOptionalParameter("interval_size", "", 2000);
         processors.push_back(X.get_spec());
     }
-#endif
     {
-        ProcessorSpec X("mv.mv_compute_templates", "0.1");
+        ProcessorSpec X("mv.mv_compute_templates", "0.11");
         X.addInputs("timeseries","firings");
         X.addOutputs("templates_out","stdevs_out");
         X.addOptionalParameter("clip_size","",200);
@@ -402,7 +404,6 @@ int main(int argc, char* argv[])
 
     QString pname;
     bool requirements_only = false;
-    (void)requirements_only;
     if (arg1 == "spec") {
         QJsonObject spec = get_spec();
         if (arg2.isEmpty()) {
@@ -468,7 +469,7 @@ int main(int argc, char* argv[])
     }
 #endif
 #ifndef NO_FFTW3
-    /*else if (pname == "spikeview.templates") {
+    else if (pname == "spikeview.templates") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString firings = CLP.named_parameters["firings"].toString();
         QString templates_out = CLP.named_parameters["templates_out"].toString();
@@ -482,7 +483,7 @@ int main(int argc, char* argv[])
             opts.filt_padding = 50;
         opts.subtract_temporal_mean = (CLP.named_parameters.value("subtract_temporal_mean") == "true");
         ret = p_spikeview_templates(timeseries, firings, templates_out, opts);
-    }*/
+    }
 #endif
 #if 0
     else if (pname == "banjoview.cross_correlograms") {
@@ -559,15 +560,11 @@ int main(int argc, char* argv[])
     else if (pname == "mv.create_multiscale_timeseries") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString timeseries_out = CLP.named_parameters["timeseries_out"].toString();
-        QString tempdir = CLP.named_parameters["_tempdir"].toString();
-        if (tempdir.isEmpty()) {
-            qWarning() << "Required _tempdir parameter not provided";
-            return -1;
-        }
-        ret = p_create_multiscale_timeseries(timeseries,timeseries_out,tempdir);
+        QString tempdir = CLP.named_parameters["_tempdir"].toString(); //no longer used
+        ret = p_create_multiscale_timeseries(timeseries, timeseries_out, tempdir);
     }
 #ifndef NO_FFTW3
-    /*else if (pname == "mv.bandpass_filter") {
+    else if (pname == "mv.bandpass_filter") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString timeseries_out = CLP.named_parameters["timeseries_out"].toString();
         Bandpass_filter_opts opts;
@@ -590,9 +587,9 @@ int main(int argc, char* argv[])
                 printf("Error in processor while trying to retrieve requirements.\n");
             }
         }
-    }*/
+    }
 #endif
-    /*else if (pname == "mv.whiten") {
+    else if (pname == "mv.whiten") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString timeseries_out = CLP.named_parameters["timeseries_out"].toString();
         Whiten_opts opts;
@@ -636,7 +633,6 @@ int main(int argc, char* argv[])
         opts.quantization_unit = CLP.named_parameters["quantization_unit"].toDouble();
         ret = p_apply_whitening_matrix(timeseries, whitening_matrix, timeseries_out, opts);
     }
-    */
     else if (pname == "mv.extract_clips") {
         QStringList timeseries_list = MLUtil::toStringList(CLP.named_parameters["timeseries"]);
         QString event_times = CLP.named_parameters["event_times"].toString();
@@ -721,15 +717,6 @@ int main(int argc, char* argv[])
         opts.samplerate = CLP.named_parameters["samplerate"].toDouble();
         ret = p_cluster_metrics(timeseries, firings, cluster_metrics_out, opts);
     }
-    else if (pname == "mv.isolation_metrics") {
-        QStringList timeseries_list = MLUtil::toStringList(CLP.named_parameters["timeseries"]);
-        QString firings = CLP.named_parameters["firings"].toString();
-        QString metrics_out = CLP.named_parameters["metrics_out"].toString();
-        QString pair_metrics_out = CLP.named_parameters["pair_metrics_out"].toString();
-        P_isolation_metrics_opts opts;
-        opts.compute_bursting_parents = (CLP.named_parameters["compute_bursting_parents"].toString() == "true");
-        ret = p_isolation_metrics(timeseries_list, firings, metrics_out, pair_metrics_out, opts);
-    }
     else if (pname == "mv.combine_cluster_metrics") {
         QStringList metrics_list = MLUtil::toStringList(CLP.named_parameters["metrics_list"]);
         QString metrics_out = CLP.named_parameters["metrics_out"].toString();
@@ -742,6 +729,16 @@ int main(int argc, char* argv[])
         ret = p_split_firings(timeseries_list, firings, firings_out_list);
     }
 #endif
+    else if (pname == "mv.isolation_metrics") {
+        QStringList timeseries_list = MLUtil::toStringList(CLP.named_parameters["timeseries"]);
+        QString firings = CLP.named_parameters["firings"].toString();
+        QString metrics_out = CLP.named_parameters["metrics_out"].toString();
+        QString pair_metrics_out = CLP.named_parameters["pair_metrics_out"].toString();
+        P_isolation_metrics_opts opts;
+        opts.compute_bursting_parents = (CLP.named_parameters["compute_bursting_parents"].toString() == "true");
+        opts.exact_nearest_neighbors = (CLP.named_parameters.value("exact_nearest_neighbors", "true").toString() != "false");
+        ret = p_isolation_metrics(timeseries_list, firings, metrics_out, pair_metrics_out, opts);
+    }
     else if (pname == "mv.mv_discrimhist") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString firings = CLP.named_parameters["firings"].toString();
@@ -791,6 +788,7 @@ int main(int argc, char* argv[])
         QString amplitudes_out = CLP.named_parameters["amplitudes_out"].toString();
         ret = p_compute_amplitudes(timeseries, event_times, amplitudes_out, opts);
     }
+#endif
     else if (pname == "mv.confusion_matrix") {
         P_confusion_matrix_opts opts;
         QString firings1 = CLP.named_parameters["firings1"].toString();
@@ -808,12 +806,12 @@ int main(int argc, char* argv[])
     }
     else if (pname == "mv.mask_out_artifacts") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
-        QString timeseries_out = CLP.named_parameters["timeseries_out"].toString();
-        double threshold = CLP.named_parameters["threshold"].toDouble();
-        bigint interval_size = CLP.named_parameters["interval_size"].toDouble();
-        ret = p_mask_out_artifacts(timeseries,timeseries_out,threshold,interval_size);
+        QString timeseries_out = CLP.named_parameters.value("timeseries_out").toString();
+        QString masked_intervals_out = CLP.named_parameters.value("masked_intervals_out").toString();
+        double threshold = CLP.named_parameters.value("threshold", 6).toDouble();
+        int interval_size = CLP.named_parameters.value("interval_size", 2000).toInt();
+        ret = p_mask_out_artifacts(timeseries, timeseries_out, masked_intervals_out, threshold, interval_size);
     }
-#endif
     else if (pname == "mv.mv_compute_templates") {
         QString timeseries = CLP.named_parameters["timeseries"].toString();
         QString firings = CLP.named_parameters["firings"].toString();
@@ -20,17 +20,28 @@
 #include <diskwritemda.h>
 //#include "omp.h"
 #include "fftw3.h"
+#include "chunkpipeline.h"
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QCoreApplication>
 #include <cmath>
+#include <string.h>
+#include "mlutil.h"
 using std::fabs;
 using std::erf;
 using std::sqrt;
 
+#define MAX_OVERLAP_SIZE 60000
+#define OVERLAP_NUM_TRANSITION_WIDTHS 50 //the impulse response of the kernel is negligible beyond this many samplerate/width
+#define FFTW_PLANNING_TIME_LIMIT_SEC 20
+
 namespace P_bandpass_filter {
 void define_kernel(bigint N, double* kernel, double samplefreq, double freq_min, double freq_max, double freq_wid);
 void multiply_by_factor(bigint N, float* X, double factor);
+bigint fft_friendly_size(bigint n);
+void load_fftw_wisdom();
+void save_fftw_wisdom();
 struct Kernel_runner {
     Kernel_runner()
     {
@@ -38,77 +49,71 @@ struct Kernel_runner {
 
     ~Kernel_runner()
     {
+        fftwf_destroy_plan(p_fft);
+        fftwf_destroy_plan(p_ifft);
         fftwf_free(data_in);
         fftwf_free(data_out);
-        free(kernel0);
-        //delete p_fft;
-        //delete p_ifft;
+        fftwf_free(kernel0);
     }
     void init(bigint M_in, bigint N_in, double samplerate, double freq_min, double freq_max, double freq_wid)
     {
         M = M_in;
         N = N_in;
         MN = M * N;
+        Nc = N / 2 + 1; //the data is real, so only the non-negative frequencies are kept
 
-        /*
-        p_fft=new fftwf_plan; //this nonsense is necessary because we cannot instantiate fftw plans in multiple threads simultaneously
-        p_ifft=new fftwf_plan;
-        */
-
-        data_in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-        data_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-        kernel0 = (double*)malloc(sizeof(double) * N);
+        data_in = (float*)fftwf_malloc(sizeof(float) * MN);
+        data_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * M * Nc);
+        kernel0 = (float*)fftwf_malloc(sizeof(float) * Nc);
 
-        define_kernel(N, kernel0, samplerate, freq_min, freq_max, freq_wid);
+        //the kernel is real and symmetric, so we keep its first Nc entries, with the 1/N of the inverse transform folded in
+        double* kernel_full = (double*)malloc(sizeof(double) * N);
+        define_kernel(N, kernel_full, samplerate, freq_min, freq_max, freq_wid);
+        for (bigint i = 0; i < Nc; i++) {
+            kernel0[i] = kernel_full[i] / N;
+        }
+        free(kernel_full);
 
-        bigint rank = 1;
+        //the channels are interleaved (stride M), one transform per channel
         int n[] = { (int)N };
+        int nc[] = { (int)Nc };
         bigint howmany = M;
-        int* inembed = n;
-        bigint istride = M;
-        bigint idist = 1;
-        int* onembed = n;
-        bigint ostride = M;
-        bigint odist = 1;
-        unsigned flags = FFTW_ESTIMATE;
-        p_fft = fftwf_plan_many_dft(rank, n, howmany, data_in, inembed, istride, idist, data_out, onembed, ostride, odist, FFTW_FORWARD, flags);
-        p_ifft = fftwf_plan_many_dft(rank, n, howmany, data_out, inembed, istride, idist, data_in, onembed, ostride, odist, FFTW_BACKWARD, flags);
+        bigint stride = M;
+        bigint dist = 1;
+        unsigned flags = FFTW_MEASURE; //quick when the wisdom already covers this size
+        fftwf_set_timelimit(FFTW_PLANNING_TIME_LIMIT_SEC);
+        p_fft = fftwf_plan_many_dft_r2c(1, n, howmany, data_in, n, stride, dist, data_out, nc, stride, dist, flags);
+        p_ifft = fftwf_plan_many_dft_c2r(1, n, howmany, data_out, nc, stride, dist, data_in, n, stride, dist, flags);
     }
     void apply(Mda32& chunk)
     {
         //set input data
-        for (bigint i = 0; i < MN; i++) {
-            data_in[i][0] = chunk.get(i);
-            data_in[i][1] = 0;
-        }
+        memcpy(data_in, chunk.constDataPtr(), sizeof(float) * MN);
         //fft
         fftwf_execute(p_fft);
         //multiply by kernel
-        double factor = 1.0 / N;
         bigint aa = 0;
-        for (bigint i = 0; i < N; i++) {
+        for (bigint i = 0; i < Nc; i++) {
+            float k0 = kernel0[i];
             for (bigint m = 0; m < M; m++) {
-                data_out[aa][0] *= kernel0[i] * factor;
-                data_out[aa][1] *= kernel0[i] * factor;
+                data_out[aa][0] *= k0;
+                data_out[aa][1] *= k0;
                 aa++;
             }
         }
         fftwf_execute(p_ifft);
         //set the output data
-        for (bigint i = 0; i < MN; i++) {
-            chunk.set(data_in[i][0], i);
-        }
+        memcpy(chunk.dataPtr(), data_in, sizeof(float) * MN);
     }
 
     bigint M;
-    bigint N, MN;
-    fftwf_complex* data_in;
-    fftwf_complex* data_out;
-    double* kernel0;
+    bigint N, MN, Nc;
+    float* data_in = 0;
+    fftwf_complex* data_out = 0;
+    float* kernel0 = 0;
     fftwf_plan p_fft;
     fftwf_plan p_ifft;
 };
-Mda32 bandpass_filter_kernel(Mda32& X, double samplerate, double freq_min, double freq_max, double freq_wid);
 Mda32 subsample(const Mda32& timeseries, int subsample_factor);
 }
 
@@ -144,15 +149,26 @@ bool p_bandpass_filter(QString timeseries, QString timeseries_out, Bandpass_filt
     QTime timer_status;
     timer_status.start();
 
-    bigint num_threads = omp_get_max_threads();
+    ChunkPipeline pipeline;
+    bigint num_threads = pipeline.numWorkers();
+
+    int overhead = 4; // real in, half-spectrum out, chunk, chunk2
+
+    //the overlap only needs to cover the impulse response of the kernel, which is set by its narrowest transition
+    bigint overlap_size = MAX_OVERLAP_SIZE;
+    double narrowest_transition = opts.freq_wid;
+    if (opts.freq_min)
+        narrowest_transition = qMin(narrowest_transition, opts.freq_min / 3); //relwid in define_kernel
+    if ((narrowest_transition > 0) && (opts.samplerate > 0))
+        overlap_size = qMin(overlap_size, (bigint)ceil(OVERLAP_NUM_TRANSITION_WIDTHS * opts.samplerate / narrowest_transition));
 
-    int overhead = 6; // complex in, complex out, chunk, chunk2, extra
-    bigint overlap_size = 60000;
     bigint min_chunk_size = overlap_size*2;
     double target_ram_bytes = 1.0 * (1024*1024*1024);
     double target_chunk_size = target_ram_bytes / (overhead * sizeof(float) * M * num_threads) - 2 * overlap_size;
     bigint chunk_size = (bigint)(target_chunk_size);
     if (chunk_size < min_chunk_size) chunk_size = min_chunk_size;
+    //grow the chunk so that the transform size has only small prime factors
+    chunk_size = P_bandpass_filter::fft_friendly_size(chunk_size + 2 * overlap_size) - 2 * overlap_size;
 
     double expected_ram_bytes = overhead * sizeof(float)*M*num_threads*(chunk_size+2*overlap_size);
     opts.expected_peak_ram_mb = expected_ram_bytes / (1024 * 1024);
@@ -165,257 +181,133 @@ bool p_bandpass_filter(QString timeseries, QString timeseries_out, Bandpass_filt
     qDebug().noquote() << "Expected peak RAM usage (MB):" << opts.expected_peak_ram_mb;
     qDebug().noquote() << "samplerate/freq_min/freq_max/freq_wid:" << opts.samplerate << opts.freq_min << opts.freq_max << opts.freq_wid;
 
-    bool ret = true;
+    //one kernel runner for each worker so they don't intersect. The plans are created here
+    //because we cannot instantiate fftw plans in multiple threads simultaneously. Only the first
+    //one is actually measured; the rest reuse the wisdom, which is saved for the next run
+    P_bandpass_filter::load_fftw_wisdom();
+    QList<P_bandpass_filter::Kernel_runner*> kernel_runners;
+    for (bigint w = 0; w < num_threads; w++) {
+        P_bandpass_filter::Kernel_runner* KR = new P_bandpass_filter::Kernel_runner;
+        KR->init(M, chunk_size + 2 * overlap_size, opts.samplerate, opts.freq_min, opts.freq_max, opts.freq_wid);
+        kernel_runners << KR;
+    }
+    P_bandpass_filter::save_fftw_wisdom();
+
+    //reading, filtering and writing are overlapped: one reader thread, the workers, and the ordered writer
+    pipeline.setQueueCapacity(num_threads + 2); //keeps the peak RAM close to the estimate above
     bigint num_timepoints_handled = 0;
-#pragma omp parallel
-    {
-        // one kernel runner for each parallel thread so they don't intersect
-        P_bandpass_filter::Kernel_runner KR;
-#pragma omp critical(lock1)
-        {
-            KR.init(M, chunk_size + 2 * overlap_size, opts.samplerate, opts.freq_min, opts.freq_max, opts.freq_wid);
+    pipeline.setNumChunks((Naa + chunk_size - 1) / chunk_size);
+    pipeline.setReadFunction([&](bigint i, Mda32& chunk) {
+        bigint timepoint = i * chunk_size;
+        if (!X.readChunk(chunk, 0, timepoint - overlap_size, M, chunk_size + 2 * overlap_size)) {
+            qWarning() << "Error reading chunk";
+            return false;
         }
-#pragma omp for
-        for (bigint timepoint = 0; timepoint < Naa; timepoint += chunk_size) {
-            Mda32 chunk;
-#pragma omp critical(lock1)
-            {
-                if (!X.readChunk(chunk, 0, timepoint - overlap_size, M, chunk_size + 2 * overlap_size)) {
-                    qWarning() << "Error reading chunk";
-                    ret = false;
-                }
-            }
-            //if (!opts.testcode.split(",").contains("nokernel")) {
-            QTime kernel_timer;
-            kernel_timer.start();
-            KR.apply(chunk);
-            //chunk = P_bandpass_filter::bandpass_filter_kernel(chunk, opts.samplerate, opts.freq_min, opts.freq_max, opts.freq_wid);
-            //qDebug().noquote() << "Kernel timer elapsed: " << kernel_timer.elapsed() << " for chunk at " << timepoint << " of " << N;
-            //}
-
-            Mda32 chunk2;
-            {
-                chunk.getChunk(chunk2, 0, overlap_size, M, chunk_size);
-            }
-#pragma omp critical(lock1)
-            {
-                {
-                    if (do_write) {
-                        if (opts.subsample_factor > 1) {
-                            chunk2 = P_bandpass_filter::subsample(chunk2, opts.subsample_factor);
-                        }
-                        if (opts.quantization_unit) {
-                            P_bandpass_filter::multiply_by_factor(chunk2.totalSize(), chunk2.dataPtr(), 1.0 / opts.quantization_unit);
-                        }
-                        if (!Ybb.writeChunk(chunk2, 0, timepoint / opts.subsample_factor)) {
-                            qWarning() << "Error writing chunk";
-                            ret = false;
-                        }
-                    }
-                }
-                num_timepoints_handled += qMin((bigint)chunk_size, Naa - timepoint);
-                if ((timer_status.elapsed() > 5000) || (num_timepoints_handled == Naa) || (timepoint == 0)) {
-                    printf("%ld/%ld (%d%%) -- using %d threads.\n",
-                        num_timepoints_handled, Naa,
-                        (int)(num_timepoints_handled * 1.0 / Naa * 100),
-                        omp_get_num_threads());
-                    timer_status.restart();
-                }
+        return true;
+    });
+    pipeline.setComputeFunction([&](int worker_index, bigint, Mda32& chunk) {
+        kernel_runners[worker_index]->apply(chunk);
+        Mda32 chunk2;
+        chunk.getChunk(chunk2, 0, overlap_size, M, chunk_size);
+        if (opts.subsample_factor > 1) {
+            chunk2 = P_bandpass_filter::subsample(chunk2, opts.subsample_factor);
+        }
+        if (opts.quantization_unit) {
+            P_bandpass_filter::multiply_by_factor(chunk2.totalSize(), chunk2.dataPtr(), 1.0 / opts.quantization_unit);
+        }
+        chunk = chunk2;
+        return true;
+    });
+    pipeline.setWriteFunction([&](bigint i, Mda32& chunk) {
+        bigint timepoint = i * chunk_size;
+        if (do_write) {
+            if (!Ybb.writeChunk(chunk, 0, timepoint / opts.subsample_factor)) {
+                qWarning() << "Error writing chunk";
+                return false;
             }
         }
-    }
+        num_timepoints_handled += qMin((bigint)chunk_size, Naa - timepoint);
+        if ((timer_status.elapsed() > 5000) || (num_timepoints_handled == Naa) || (timepoint == 0)) {
+            printf("%ld/%ld (%d%%) -- using %ld threads.\n",
+                num_timepoints_handled, Naa,
+                (int)(num_timepoints_handled * 1.0 / Naa * 100),
+                num_threads);
+            timer_status.restart();
+        }
+        return true;
+    });
+    bool ret = pipeline.run();
+    qDeleteAll(kernel_runners);
 
     return ret;
 }
 
 namespace P_bandpass_filter {
 
-void multiply_by_factor(bigint N, float* X, double factor)
+bigint fft_friendly_size(bigint n)
 {
-    /*bigint start = 0;
-#ifdef USE_SSE2
-    __m128d factor_m128 = _mm_load_pd1(&factor);
-    for (; start < (N / 2) * 2; start += 2) {
-        double* chunk = X + start;
-        __m128d x = _mm_load_pd(chunk);
-        __m128d result = _mm_mul_pd(x, factor_m128);
-        _mm_store_pd(chunk, result);
+    //the smallest m>=n of the form 2^a*3^b*5^c*7^d, for which fftw is fastest
+    for (bigint m = qMax((bigint)1, n);; m++) {
+        bigint r = m;
+        while (r % 2 == 0)
+            r /= 2;
+        while (r % 3 == 0)
+            r /= 3;
+        while (r % 5 == 0)
+            r /= 5;
+        while (r % 7 == 0)
+            r /= 7;
+        if (r == 1)
+            return m;
     }
-#endif
-*/
-    for (bigint i = 0; i < N; i++)
-        X[i] *= factor;
 }
 
-bool do_fft_1d_r2c(bigint M, bigint N, float* out, float* in)
+QString fftw_wisdom_path()
 {
-    /*
-    if (num_threads>1) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(num_threads);
-    }
-    */
-
-    bigint MN = M * N;
-
-    fftwf_complex* in2 = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-    fftwf_complex* out2 = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-    for (bigint ii = 0; ii < MN; ii++) {
-        //in2[ii][0]=in[ii*2];
-        //in2[ii][1]=in[ii*2+1];
-        in2[ii][0] = in[ii];
-        in2[ii][1] = 0;
-    }
-
-    /*
-     * From FFTW docs:
-     * howmany is the number of transforms to compute.
-     * The resulting plan computes howmany transforms,
-     * where the input of the k-th transform is at
-     * location in+k*idist (in C pointer arithmetic),
-     * and its output is at location out+k*odist.
-     * Plans obtained in this way can often be faster
-     * than calling FFTW multiple times for the individual
-     * transforms. The basic fftwf_plan_dft interface corresponds
-     * to howmany=1 (in which case the dist parameters are ignored).
-     *
-     * Each of the howmany transforms has rank rank
-     * and size n, as in the basic interface.
-     * In addition, the advanced interface allows the
-     * input and output arrays of each transform to be
-     * row-major subarrays of larger rank-rank arrays,
-     * described by inembed and onembed parameters,
-     * respectively. {i,o}nembed must be arrays of length
-     * rank, and n should be elementwise less than or equal
-     * to {i,o}nembed. Passing NULL for an nembed parameter
-     * is equivalent to passing n (i.e. same physical and
-     * logical dimensions, as in the basic interface.)
-     *
-     * The stride parameters indicate that the j-th element
-     * of the input or output arrays is located at j*istride
-     * or j*ostride, respectively. (For a multi-dimensional array,
-     * j is the ordinary row-major index.) When combined with
-     * the k-th transform in a howmany loop, from above, this
-     * means that the (j,k)-th element is at j*stride+k*dist.
-     * (The basic fftwf_plan_dft interface corresponds to a stride
-     * of 1.)
-     */
-    fftwf_plan p;
-    bigint rank = 1;
-    int n[] = { (int)N };
-    bigint howmany = M;
-    int* inembed = n;
-    bigint istride = M;
-    bigint idist = 1;
-    int* onembed = n;
-    bigint ostride = M;
-    bigint odist = 1;
-    bigint sign = FFTW_FORWARD;
-    unsigned flags = FFTW_ESTIMATE;
-#pragma omp critical
-    p = fftwf_plan_many_dft(rank, n, howmany, in2, inembed, istride, idist, out2, onembed, ostride, odist, sign, flags);
-    //p=fftwf_plan_dft_1d(N,in2,out2,fftwf_FORWARD,fftwf_ESTIMATE);
-
-    fftwf_execute(p);
-    for (bigint ii = 0; ii < MN; ii++) {
-        out[ii * 2] = out2[ii][0];
-        out[ii * 2 + 1] = out2[ii][1];
-    }
-    fftwf_free(in2);
-    fftwf_free(out2);
-
-/*
-    if (num_threads>1) {
-        fftwf_cleanup_threads();
-    }
-    */
-
-#pragma omp critical
-    fftwf_destroy_plan(p);
-
-    return true;
+    return MLUtil::tempPath() + "/fftwf_wisdom";
 }
 
-bool do_ifft_1d_c2r(bigint M, bigint N, float* out, float* in)
+void load_fftw_wisdom()
 {
-    /*
-    if (num_threads>1) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(num_threads);
-    }
-    */
-
-    bigint MN = M * N;
-
-    fftwf_complex* in2 = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-    fftwf_complex* out2 = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * MN);
-    for (bigint ii = 0; ii < MN; ii++) {
-        in2[ii][0] = in[ii * 2];
-        in2[ii][1] = in[ii * 2 + 1];
-    }
-
-    fftwf_plan p;
-    bigint rank = 1;
-    int n[] = { (int)N };
-    bigint howmany = M;
-    int* inembed = n;
-    bigint istride = M;
-    bigint idist = 1;
-    int* onembed = n;
-    bigint ostride = M;
-    bigint odist = 1;
-    bigint sign = FFTW_BACKWARD;
-    unsigned flags = FFTW_ESTIMATE;
-#pragma omp critical
-    p = fftwf_plan_many_dft(rank, n, howmany, in2, inembed, istride, idist, out2, onembed, ostride, odist, sign, flags);
-    //p=fftwf_plan_dft_1d(N,in2,out2,fftwf_BACKWARD,fftwf_ESTIMATE);
-
-    fftwf_execute(p);
-    for (bigint ii = 0; ii < MN; ii++) {
-        out[ii] = out2[ii][0];
+    QString path = fftw_wisdom_path();
+    if (!QFile::exists(path))
+        return;
+    if (!fftwf_import_wisdom_from_filename(path.toUtf8().data())) {
+        qWarning() << "Unable to import fftw wisdom from" << path;
     }
-    fftwf_free(in2);
-    fftwf_free(out2);
+}
 
-/*
-    if (num_threads>1) {
-        fftwf_cleanup_threads();
+void save_fftw_wisdom()
+{
+    //write to a temporary file and rename, since other processes may be doing the same
+    QString path = fftw_wisdom_path();
+    QDir().mkpath(QFileInfo(path).path());
+    QString tmp_path = path + ".tmp." + MLUtil::makeRandomId(6);
+    if (!fftwf_export_wisdom_to_filename(tmp_path.toUtf8().data())) {
+        qWarning() << "Unable to export fftw wisdom to" << tmp_path;
+        QFile::remove(tmp_path);
+        return;
     }
-    */
-
-#pragma omp critical
-    fftwf_destroy_plan(p);
-
-    return true;
+    QFile::remove(path);
+    if (!QFile::rename(tmp_path, path))
+        QFile::remove(tmp_path);
 }
 
-void multiply_complex_by_real_kernel(bigint M, bigint N, float* Y, double* kernel)
+void multiply_by_factor(bigint N, float* X, double factor)
 {
-    bigint bb = 0;
-    bigint aa = 0;
-    /*
+    /*bigint start = 0;
 #ifdef USE_SSE2
-    for (bigint i = 0; i < N; i++) {
-        __m128d kernel_m128 = _mm_load_pd1(kernel + aa);
-        for (bigint j = 0; j < M; j++) {
-            __m128d Y_m128 = _mm_load_pd(Y + bb * 2);
-            __m128d result = _mm_mul_pd(Y_m128, kernel_m128);
-            _mm_store_pd(Y + bb * 2, result);
-            bb++;
-        }
-        aa++;
+    __m128d factor_m128 = _mm_load_pd1(&factor);
+    for (; start < (N / 2) * 2; start += 2) {
+        double* chunk = X + start;
+        __m128d x = _mm_load_pd(chunk);
+        __m128d result = _mm_mul_pd(x, factor_m128);
+        _mm_store_pd(chunk, result);
     }
-#else
+#endif
 */
-    for (bigint i = 0; i < N; i++) {
-        for (bigint j = 0; j < M; j++) {
-            Y[bb * 2] *= kernel[aa];
-            Y[bb * 2 + 1] *= kernel[aa];
-            bb++;
-        }
-        aa++;
-    }
-    //#endif
+    for (bigint i = 0; i < N; i++)
+        X[i] *= factor;
 }
 
 void define_kernel(bigint N, double* kernel, double samplefreq, double freq_min, double freq_max, double freq_wid)
@@ -446,37 +338,6 @@ void define_kernel(bigint N, double* kernel, double samplefreq, double freq_min,
     }
 }
 
-Mda32 bandpass_filter_kernel(Mda32& X, double samplerate, double freq_min, double freq_max, double freq_wid)
-{
-    QTime timer;
-    timer.start();
-    bigint M = X.N1();
-    bigint N = X.N2();
-    bigint MN = M * N;
-    Mda32 Y(M, N);
-    float* Xptr = X.dataPtr();
-    float* Yptr = Y.dataPtr();
-
-    double* kernel0 = (double*)allocate(sizeof(double) * N);
-    float* Xhat = (float*)allocate(sizeof(float) * MN * 2);
-    define_kernel(N, kernel0, samplerate, freq_min, freq_max, freq_wid);
-
-    do_fft_1d_r2c(M, N, Xhat, Xptr);
-    multiply_complex_by_real_kernel(M, N, Xhat, kernel0);
-    do_ifft_1d_c2r(M, N, Yptr, Xhat);
-
-    multiply_by_factor(MN, Yptr, 1.0 / N);
-
-    free(kernel0);
-    free(Xhat);
-
-    double sec = timer.elapsed() * 1.0 / 1000;
-    double rate = X.totalSize() / sec;
-    printf("bandpass filter rate: %g numbers/sec\n", rate);
-
-    return Y;
-}
-
 Mda32 subsample(const Mda32& timeseries, int subsample_factor)
 {
     int M = timeseries.N1();
@@ -19,6 +19,7 @@
 #include <diskreadmda.h>
 #include <diskreadmda32.h>
 #include "mlutil.h"
+#include "compute_templates_0.h"
 
 bool p_compute_templates(QStringList timeseries_list, QString firings_path, QString templates_out, int clip_size, const QList<int>& clusters_in)
 {
@@ -72,46 +73,25 @@ bool p_compute_templates(QStringList timeseries_list, QString firings_path, QStr
 
     bigint K0 = clusters.count();
 
-    Mda templates(M, T, K0);
-    QVector<double> counts(K0);
-    counts.fill(0);
-
-    double* templates_ptr = templates.dataPtr();
+    //the labels are renumbered 1..K0 in the order of clusters
+    QVector<int> labels0(labels.count());
+    for (bigint i = 0; i < labels.count(); i++) {
+        labels0[i] = label_map[labels[i]] + 1;
+    }
 
-    bigint Tmid = (bigint)((T + 1) / 2) - 1;
     printf("computing templates (M=%ld,T=%ld,K=%ld,L=%d)...\n", M, T, K0, times.count());
-    QTime timer;
-    timer.start();
-    for (bigint i = 0; i < times.count(); i++) {
-        bigint t1 = times[i] - Tmid;
-        //bigint t2 = t1 + T - 1;
-        int k = label_map[labels[i]];
-        if (timer.elapsed() > 3000) {
-            qDebug().noquote() << QString("Compute templates: processing event %1 of %2").arg(i).arg(times.count());
-            timer.restart();
-        }
-        {
-            Mda32 tmp;
-            tmp.allocate(M, T);
-            if (!X.readChunk(tmp, 0, t1, M, T)) {
-                qWarning() << "Problem reading chunk of timeseries list:" << t1;
-                return false;
-            }
-            float* tmp_ptr = tmp.dataPtr();
-            bigint offset = M * T * k;
-            for (bigint aa = 0; aa < M * T; aa++) {
-                templates_ptr[offset + aa] += tmp_ptr[aa];
-            }
-            counts[k]++;
-        }
+    Mda32 templates;
+    if (!compute_templates_in_parallel(templates, 0, X, times, labels0, T)) {
+        qWarning() << "Problem computing templates";
+        return false;
     }
-    bigint bb = 0;
-    for (bigint k = 0; k < K0; k++) {
-        for (bigint aa = 0; aa < M * T; aa++) {
-            if (counts[k])
-                templates_ptr[bb] /= counts[k];
-            bb++;
+    if (templates.N3() < K0) {
+        //the last clusters have no events
+        Mda32 padded(M, T, K0);
+        for (bigint aa = 0; aa < templates.totalSize(); aa++) {
+            padded.set(templates.get(aa), aa);
         }
+        templates = padded;
     }
 
     return templates.write32(templates_out);
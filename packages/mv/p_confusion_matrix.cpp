@@ -16,13 +16,21 @@
 
 #include "p_confusion_matrix.h"
 #include "mlutil.h"
-#include "hungarian.h"
-#include "get_sort_indices.h"
+#include "max_weight_matching.h"
 
+#include <QAtomicInt>
+#include <QHash>
+#include <QThread>
 #include <diskreadmda.h>
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <vector>
 using std::fabs;
 
+#define CONFUSION_MATRIX_READ_BLOCK_SIZE 1000000 //events read from a firings file at a time
+#define CONFUSION_MATRIX_SEGMENT_SIZE 100000 //events per time segment in the parallel counting and matching
+
 namespace P_confusion_matrix {
 struct MFEvent {
     int chan = -1;
@@ -36,9 +44,28 @@ struct MFMergeEvent {
     int label2 = -1;
 };
 
-void sort_events_by_time(QList<MFEvent>& events);
-void sort_events_by_time(QList<MFMergeEvent>& events);
-int compute_max_label(const QList<MFEvent>& events);
+//only the pairs of labels that actually occur together are stored, keyed by labelA * (KB + 1) + labelB
+typedef QHash<bigint, bigint> SparsePairCounts;
+typedef QHash<bigint, double> SparsePairScores;
+
+class SegmentThread : public QThread {
+public:
+    std::function<void()> body;
+    void run()
+    {
+        body();
+    }
+};
+
+bool load_events(QVector<MFEvent>& events, const QString& firings_path);
+void run_segments_in_parallel(bigint num_segments, const std::function<void(bigint segment)>& func);
+void sort_events_by_time(QVector<MFEvent>& events);
+void sort_events_by_time(QVector<MFMergeEvent>& events);
+int compute_max_label(const QVector<MFEvent>& events);
+QVector<bigint> compute_event_counts(const QVector<MFEvent>& events, int K);
+bigint first_event_at_or_after(const QVector<MFEvent>& events, double t);
+SparsePairCounts count_pairs(const QVector<MFEvent>& eventsA, const QVector<MFEvent>& eventsB, int KB, double max_matching_offset);
+void find_best_matches(std::vector<bigint>& best_matches, const QVector<MFEvent>& eventsA, const std::vector<bigint>& assignmentsA, const QVector<MFEvent>& eventsB, const std::vector<bigint>& assignmentsB, const SparsePairScores& match_scores, bool A_is_firings1, int K2, double max_matching_offset);
 }
 
 bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_matrix_out, QString matched_firings_out, QString label_map_out, QString firings2_relabeled_out, QString firings2_relabel_map_out, P_confusion_matrix_opts opts)
@@ -60,32 +87,13 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
         }
     }
 
-    // Collect the list of events from firings1
-    printf("Collecting events...\n");
-    QList<MFEvent> events1;
-    {
-        DiskReadMda F1(firings1);
-        for (bigint i = 0; i < F1.N2(); i++) {
-            MFEvent evt;
-            evt.chan = F1.value(0, i);
-            evt.time = F1.value(1, i);
-            evt.label = F1.value(2, i);
-            events1 << evt;
-        }
-    }
-    // Collect the list of events from firings2
+    // Collect the lists of events from firings1 and firings2
     printf("Collecting events...\n");
-    QList<MFEvent> events2;
-    {
-        DiskReadMda F2(firings2);
-        for (bigint i = 0; i < F2.N2(); i++) {
-            MFEvent evt;
-            evt.chan = F2.value(0, i);
-            evt.time = F2.value(1, i);
-            evt.label = F2.value(2, i);
-            events2 << evt;
-        }
-    }
+    QVector<MFEvent> events1, events2;
+    if (!load_events(events1, firings1))
+        return false;
+    if (!load_events(events2, firings2))
+        return false;
 
     // Sort the events by time
     printf("Sorting events...\n");
@@ -98,87 +106,26 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
 
     // Count up every pair that satisfies opts.max_matching_offset -- but don't count redundantly
     printf("Counting all pairs...\n");
-    bigint total_counts_12[K1 + 1][K2 + 1];
-    {
-        for (int k2 = 0; k2 < K2 + 1; k2++) {
-            for (int k1 = 0; k1 < K1 + 1; k1++) {
-                total_counts_12[k1][k2] = 0;
-            }
-        }
-
-        bigint i2 = 0;
-        for (bigint i1 = 0; i1 < events1.count(); i1++) {
-            if (events1[i1].label > 0) {
-                int present[K2 + 1];
-                for (int k2 = 0; k2 < K2 + 1; k2++) {
-                    present[k2] = 0;
-                }
-                double t1 = events1[i1].time;
-                while ((i2 < events2.count()) && (events2[i2].time < t1 - opts.max_matching_offset))
-                    i2++;
-                bigint old_i2 = i2;
-                while ((i2 < events2.count()) && (events2[i2].time <= t1 + opts.max_matching_offset)) {
-                    if (events2[i2].label > 0) {
-                        present[events2[i2].label] = 1;
-                    }
-                    i2++;
-                }
-                i2 = old_i2;
-                for (int kk = 1; kk <= K2; kk++) {
-                    if (present[kk])
-                        total_counts_12[events1[i1].label][kk]++;
-                }
-            }
-        }
-    }
-
-    // Count up every pair that satisfies opts.max_matching_offset -- but don't count redundantly
-    printf("Counting all pairs...\n");
-    bigint total_counts_21[K2 + 1][K1 + 1];
-    {
-        for (int k1 = 0; k1 < K1 + 1; k1++) {
-            for (int k2 = 0; k2 < K2 + 1; k2++) {
-                total_counts_21[k2][k1] = 0;
-            }
-        }
-
-        bigint i1 = 0;
-        for (bigint i2 = 0; i2 < events2.count(); i2++) {
-            if (events2[i2].label > 0) {
-                int present[K1 + 1];
-                for (int k1 = 0; k1 < K1 + 1; k1++) {
-                    present[k1] = 0;
-                }
-                double t2 = events2[i2].time;
-                while ((i1 < events1.count()) && (events1[i1].time < t2 - opts.max_matching_offset))
-                    i1++;
-                bigint old_i1 = i1;
-                while ((i1 < events1.count()) && (events1[i1].time <= t2 + opts.max_matching_offset)) {
-                    if (events1[i1].label > 0) {
-                        present[events1[i1].label] = 1;
-                    }
-                    i1++;
-                }
-                i1 = old_i1;
-                for (int kk = 1; kk <= K1; kk++) {
-                    if (present[kk])
-                        total_counts_21[events2[i2].label][kk]++;
-                }
-            }
-        }
-    }
-
-    bigint event_counts1[K1 + 1];
-    for (bigint i = 0; i <= K1; i++)
-        event_counts1[i] = 0;
-    for (bigint i = 0; i < events1.count(); i++) {
-        event_counts1[events1[i].label]++;
-    }
-    bigint event_counts2[K2 + 1];
-    for (bigint i = 0; i <= K2; i++)
-        event_counts2[i] = 0;
-    for (bigint i = 0; i < events2.count(); i++) {
-        event_counts2[events2[i].label]++;
+    SparsePairCounts total_counts_12 = count_pairs(events1, events2, K2, opts.max_matching_offset);
+    SparsePairCounts total_counts_21 = count_pairs(events2, events1, K1, opts.max_matching_offset);
+
+    QVector<bigint> event_counts1 = compute_event_counts(events1, K1);
+    QVector<bigint> event_counts2 = compute_event_counts(events2, K2);
+
+    // The match score of every pair of labels that occur together (any two events within the offset do)
+    SparsePairScores match_scores;
+    for (SparsePairCounts::const_iterator it = total_counts_12.constBegin(); it != total_counts_12.constEnd(); it++) {
+        int k1 = it.key() / (K2 + 1);
+        int k2 = it.key() % (K2 + 1);
+        bigint numer12 = it.value();
+        bigint numer21 = total_counts_21.value((bigint)k2 * (K1 + 1) + k1, 0);
+        bigint denom12 = event_counts1[k1];
+        bigint denom21 = event_counts2[k2];
+        if (denom12 == 0)
+            denom12 = 1; //don't divide by zero
+        if (denom21 == 0)
+            denom21 = 1;
+        match_scores[it.key()] = qMin(numer12 * 1.0 / denom12, numer21 * 1.0 / denom21);
     }
 
     std::vector<bigint> assignments1(events1.count(), -1);
@@ -188,100 +135,8 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
         printf("pass %d...\n", pass);
         std::vector<bigint> assignments1_thispass(events1.count(), -1);
         std::vector<bigint> assignments2_thispass(events2.count(), -1);
-        { //first fill in the assignments1_thispass
-            bigint i2 = 0;
-            for (bigint i1 = 0; i1 < events1.count(); i1++) {
-                if ((events1[i1].label > 0) && (assignments1[i1] < 0)) { // only consider it if it has a label and hasn't been assigned
-                    double t1 = events1[i1].time; // this is the timepoint for event 1
-
-                    //increase i2 until it reaches the lefthand constraint (we assume we are coming from the left)
-                    while ((i2 < events2.count()) && (events2[i2].time < t1 - opts.max_matching_offset))
-                        i2++;
-                    bigint old_i2 = i2; //save this index for later so we can return to this spot for the next event
-
-                    double best_match_score = 0;
-                    double abs_offset_of_best_match_score = opts.max_matching_offset + 1;
-                    bigint best_i2 = -1;
-                    //move through the events in firings2 until we pass the righthand constraint
-                    while ((i2 < events2.count()) && (events2[i2].time <= t1 + opts.max_matching_offset)) {
-                        if ((events2[i2].label > 0) && (assignments2[i2] < 0)) { //only consider it if it has a label and unassigned
-                            double time0 = events2[i2].time;
-                            bigint numer12 = total_counts_12[events1[i1].label][events2[i2].label];
-                            bigint numer21 = total_counts_21[events2[i2].label][events1[i1].label];
-                            bigint denom12 = event_counts1[events1[i1].label];
-                            bigint denom21 = event_counts2[events2[i2].label];
-                            if (denom12 == 0)
-                                denom12 = 1; //don't divide by zero
-                            if (denom21 == 0)
-                                denom21 = 1;
-                            double match_score = qMin(numer12 * 1.0 / denom12, numer21 * 1.0 / denom21);
-
-                            if (match_score >= best_match_score) {
-                                double abs_offset = fabs(time0 - t1);
-                                //in the case of a tie, use the one that is closer in offset.
-                                if ((match_score > best_match_score) || ((match_score == best_match_score) && (abs_offset < abs_offset_of_best_match_score))) {
-                                    best_match_score = match_score;
-                                    best_i2 = i2;
-                                    abs_offset_of_best_match_score = abs_offset;
-                                }
-                            }
-                        }
-                        i2++; // go to the next one
-                    }
-                    if (best_i2 >= 0) {
-                        assignments1_thispass[i1] = best_i2;
-                    }
-                    i2 = old_i2; // go back so we are ready to handle the next event
-                }
-            }
-        }
-        { //next fill in the assignments2_thispass
-            bigint i1 = 0;
-            for (bigint i2 = 0; i2 < events2.count(); i2++) {
-                if ((events2[i2].label > 0) && (assignments2[i2] < 0)) { // only consider it if it has a label and hasn't been assigned
-                    double t2 = events2[i2].time; // this is the timepoint for event 2
-
-                    //increase i1 until it reaches the lefthand constraint (we assume we are coming from the left)
-                    while ((i1 < events1.count()) && (events1[i1].time < t2 - opts.max_matching_offset))
-                        i1++;
-                    bigint old_i1 = i1; //save this index for later so we can return to this spot for the next event
-
-                    double best_match_score = 0;
-                    double abs_offset_of_best_match_score = opts.max_matching_offset + 1;
-                    bigint best_i1 = -1;
-                    //move through the events in firings2 until we pass the righthand constraint
-                    while ((i1 < events1.count()) && (events1[i1].time <= t2 + opts.max_matching_offset)) {
-                        if ((events1[i1].label > 0) && (assignments1[i1] < 0)) { //only consider it if it has a label and unassigned
-                            double time0 = events1[i1].time;
-                            bigint numer12 = total_counts_12[events1[i1].label][events2[i2].label];
-                            bigint numer21 = total_counts_21[events2[i2].label][events1[i1].label];
-                            bigint denom12 = event_counts1[events1[i1].label];
-                            bigint denom21 = event_counts2[events2[i2].label];
-                            if (denom12 == 0)
-                                denom12 = 1; //don't divide by zero
-                            if (denom21 == 0)
-                                denom21 = 1;
-                            double match_score = qMin(numer12 * 1.0 / denom12, numer21 * 1.0 / denom21);
-
-                            if (match_score >= best_match_score) {
-                                double abs_offset = fabs(time0 - t2);
-                                //in the case of a tie, use the one that is closer in offset.
-                                if ((match_score > best_match_score) || ((match_score == best_match_score) && (abs_offset < abs_offset_of_best_match_score))) {
-                                    best_match_score = match_score;
-                                    best_i1 = i1;
-                                    abs_offset_of_best_match_score = abs_offset;
-                                }
-                            }
-                        }
-                        i1++; // go to the next one
-                    }
-                    if (best_i1 >= 0) {
-                        assignments2_thispass[i2] = best_i1;
-                    }
-                    i1 = old_i1; // go back so we are ready to handle the next event
-                }
-            }
-        }
+        find_best_matches(assignments1_thispass, events1, assignments1, events2, assignments2, match_scores, true, K2, opts.max_matching_offset);
+        find_best_matches(assignments2_thispass, events2, assignments2, events1, assignments1, match_scores, false, K2, opts.max_matching_offset);
         //use only those where assignments1_thispass agrees with assignments2_thispass
         bool something_changed = false;
         for (bigint i1 = 0; i1 < events1.count(); i1++) {
@@ -299,7 +154,7 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
 
     printf("Creating list of merged events...\n");
     // Create the list of matched events
-    QList<MFMergeEvent> events3;
+    QVector<MFMergeEvent> events3;
     for (bigint i1 = 0; i1 < events1.count(); i1++) {
         if (assignments1[i1] >= 0) {
             bigint i2 = assignments1[i1];
@@ -368,15 +223,38 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
     if ((!label_map_out.isEmpty()) || (opts.relabel_firings2)) {
         printf("Writing label_map_out...\n");
         if (K1 > 0) {
-            int assignment[K1];
-            Mda matrix(K1, K2);
+            //the confusion matrix is mostly zeros, so match on its nonzero entries only
+            QVector<MatchingEdge> edges;
+            for (int j = 0; j < K2; j++) {
+                for (int i = 0; i < K1; i++) {
+                    bigint count = confusion_matrix.value(i, j);
+                    if (count > 0) {
+                        MatchingEdge E;
+                        E.row = i;
+                        E.col = j;
+                        E.weight = count;
+                        edges << E;
+                    }
+                }
+            }
+            QVector<int> assignment = max_weight_matching(K1, K2, edges);
+            //as before, the labels that share no events are still paired up (in order) while there are labels left on both sides
+            std::vector<bool> col_used(K2, false);
             for (int i = 0; i < K1; i++) {
-                for (int j = 0; j < K2; j++) {
-                    matrix.setValue((-1) * confusion_matrix.value(i, j), i, j);
+                if (assignment[i] >= 0)
+                    col_used[assignment[i]] = true;
+            }
+            int j0 = 0;
+            for (int i = 0; i < K1; i++) {
+                if (assignment[i] < 0) {
+                    while ((j0 < K2) && (col_used[j0]))
+                        j0++;
+                    if (j0 < K2) {
+                        assignment[i] = j0;
+                        col_used[j0] = true;
+                    }
                 }
             }
-            double cost;
-            hungarian(assignment, &cost, matrix.dataPtr(), K1, K2);
             for (int i = 0; i < K1; i++) {
                 label_map.setValue(assignment[i] + 1, i);
             }
@@ -473,35 +351,42 @@ bool p_confusion_matrix(QString firings1, QString firings2, QString confusion_ma
 
 namespace P_confusion_matrix {
 
-void sort_events_by_time(QList<MFEvent>& events)
+bool load_events(QVector<MFEvent>& events, const QString& firings_path)
 {
-    QVector<double> times(events.count());
-    for (bigint i = 0; i < events.count(); i++) {
-        times[i] = events[i].time;
+    DiskReadMda F(firings_path);
+    if (F.N1() < 3) {
+        qWarning() << "Unexpected dimensions of firings file: " + firings_path;
+        return false;
     }
-    QList<bigint> inds = get_sort_indices_bigint(times);
-    QList<MFEvent> ret;
-    for (bigint i = 0; i < inds.count(); i++) {
-        ret << events[inds[i]];
+    events.resize(F.N2());
+    for (bigint i0 = 0; i0 < F.N2(); i0 += CONFUSION_MATRIX_READ_BLOCK_SIZE) {
+        bigint size0 = qMin((bigint)CONFUSION_MATRIX_READ_BLOCK_SIZE, F.N2() - i0);
+        Mda chunk;
+        if (!F.readChunk(chunk, 0, i0, 3, size0)) {
+            qWarning() << "Unable to read firings file: " + firings_path;
+            return false;
+        }
+        for (bigint i = 0; i < size0; i++) {
+            MFEvent& evt = events[i0 + i];
+            evt.chan = chunk.value(0, i);
+            evt.time = chunk.value(1, i);
+            evt.label = chunk.value(2, i);
+        }
     }
-    events = ret;
+    return true;
 }
 
-void sort_events_by_time(QList<MFMergeEvent>& events)
+void sort_events_by_time(QVector<MFEvent>& events)
 {
-    QVector<double> times(events.count());
-    for (bigint i = 0; i < events.count(); i++) {
-        times[i] = events[i].time;
-    }
-    QList<bigint> inds = get_sort_indices_bigint(times);
-    QList<MFMergeEvent> ret;
-    for (bigint i = 0; i < inds.count(); i++) {
-        ret << events[inds[i]];
-    }
-    events = ret;
+    std::stable_sort(events.begin(), events.end(), [](const MFEvent& E1, const MFEvent& E2) { return E1.time < E2.time; });
+}
+
+void sort_events_by_time(QVector<MFMergeEvent>& events)
+{
+    std::stable_sort(events.begin(), events.end(), [](const MFMergeEvent& E1, const MFMergeEvent& E2) { return E1.time < E2.time; });
 }
 
-int compute_max_label(const QList<MFEvent>& events)
+int compute_max_label(const QVector<MFEvent>& events)
 {
     int ret = 0;
     for (bigint i = 0; i < events.count(); i++) {
@@ -510,4 +395,134 @@ int compute_max_label(const QList<MFEvent>& events)
     }
     return ret;
 }
+
+QVector<bigint> compute_event_counts(const QVector<MFEvent>& events, int K)
+{
+    QVector<bigint> ret(K + 1, 0);
+    for (bigint i = 0; i < events.count(); i++) {
+        if (events[i].label >= 0)
+            ret[events[i].label]++;
+    }
+    return ret;
+}
+
+bigint first_event_at_or_after(const QVector<MFEvent>& events, double t)
+{
+    return std::lower_bound(events.begin(), events.end(), t, [](const MFEvent& E, double t0) { return E.time < t0; }) - events.begin();
+}
+
+void run_segments_in_parallel(bigint num_segments, const std::function<void(bigint segment)>& func)
+{
+    //the calling thread works too, and each thread takes the next segment that nobody has started
+    QAtomicInt next_segment(0);
+    auto run_segments = [&]() {
+        while (true) {
+            bigint ss = next_segment.fetchAndAddOrdered(1);
+            if (ss >= num_segments)
+                break;
+            func(ss);
+        }
+    };
+    int num_threads = qMax(1, (int)qMin((bigint)QThread::idealThreadCount(), num_segments));
+    QList<SegmentThread*> threads;
+    for (int i = 1; i < num_threads; i++) {
+        SegmentThread* thread = new SegmentThread;
+        thread->body = run_segments;
+        thread->start();
+        threads << thread;
+    }
+    run_segments();
+    foreach (SegmentThread* thread, threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+SparsePairCounts count_pairs(const QVector<MFEvent>& eventsA, const QVector<MFEvent>& eventsB, int KB, double max_matching_offset)
+{
+    //the events are split into time segments that are counted independently and then added together, in order
+    bigint num_segments = (eventsA.count() + CONFUSION_MATRIX_SEGMENT_SIZE - 1) / CONFUSION_MATRIX_SEGMENT_SIZE;
+    QVector<SparsePairCounts> segment_counts(num_segments);
+    SparsePairCounts* segment_counts_ptr = segment_counts.data();
+    run_segments_in_parallel(num_segments, [&](bigint ss) {
+        bigint iA1 = ss * CONFUSION_MATRIX_SEGMENT_SIZE;
+        bigint iA2 = qMin(iA1 + CONFUSION_MATRIX_SEGMENT_SIZE, (bigint)eventsA.count());
+        SparsePairCounts& counts = segment_counts_ptr[ss];
+        std::vector<int> present; //the distinct labels near the current event
+        bigint iB = first_event_at_or_after(eventsB, eventsA[iA1].time - max_matching_offset);
+        for (bigint iA = iA1; iA < iA2; iA++) {
+            if (eventsA[iA].label > 0) {
+                double tA = eventsA[iA].time;
+                while ((iB < eventsB.count()) && (eventsB[iB].time < tA - max_matching_offset))
+                    iB++;
+                present.clear();
+                for (bigint jB = iB; (jB < eventsB.count()) && (eventsB[jB].time <= tA + max_matching_offset); jB++) {
+                    if (eventsB[jB].label > 0)
+                        present.push_back(eventsB[jB].label);
+                }
+                std::sort(present.begin(), present.end());
+                present.erase(std::unique(present.begin(), present.end()), present.end());
+                for (int kB : present) {
+                    counts[(bigint)eventsA[iA].label * (KB + 1) + kB]++;
+                }
+            }
+        }
+    });
+    SparsePairCounts ret;
+    for (bigint ss = 0; ss < num_segments; ss++) {
+        const SparsePairCounts& counts = segment_counts[ss];
+        for (SparsePairCounts::const_iterator it = counts.constBegin(); it != counts.constEnd(); it++) {
+            ret[it.key()] += it.value();
+        }
+    }
+    return ret;
+}
+
+void find_best_matches(std::vector<bigint>& best_matches, const QVector<MFEvent>& eventsA, const std::vector<bigint>& assignmentsA, const QVector<MFEvent>& eventsB, const std::vector<bigint>& assignmentsB, const SparsePairScores& match_scores, bool A_is_firings1, int K2, double max_matching_offset)
+{
+    //each event only depends on the assignments of the previous passes, so the time segments are independent
+    bigint num_segments = (eventsA.count() + CONFUSION_MATRIX_SEGMENT_SIZE - 1) / CONFUSION_MATRIX_SEGMENT_SIZE;
+    run_segments_in_parallel(num_segments, [&](bigint ss) {
+        bigint iA1 = ss * CONFUSION_MATRIX_SEGMENT_SIZE;
+        bigint iA2 = qMin(iA1 + CONFUSION_MATRIX_SEGMENT_SIZE, (bigint)eventsA.count());
+        bigint iB = first_event_at_or_after(eventsB, eventsA[iA1].time - max_matching_offset);
+        for (bigint iA = iA1; iA < iA2; iA++) {
+            if ((eventsA[iA].label > 0) && (assignmentsA[iA] < 0)) { // only consider it if it has a label and hasn't been assigned
+                double tA = eventsA[iA].time;
+
+                //increase iB until it reaches the lefthand constraint (we are coming from the left)
+                while ((iB < eventsB.count()) && (eventsB[iB].time < tA - max_matching_offset))
+                    iB++;
+
+                double best_match_score = 0;
+                double abs_offset_of_best_match_score = max_matching_offset + 1;
+                bigint best_iB = -1;
+                //move through the events in the other firings until we pass the righthand constraint
+                for (bigint jB = iB; (jB < eventsB.count()) && (eventsB[jB].time <= tA + max_matching_offset); jB++) {
+                    if ((eventsB[jB].label > 0) && (assignmentsB[jB] < 0)) { //only consider it if it has a label and unassigned
+                        bigint key;
+                        if (A_is_firings1)
+                            key = (bigint)eventsA[iA].label * (K2 + 1) + eventsB[jB].label;
+                        else
+                            key = (bigint)eventsB[jB].label * (K2 + 1) + eventsA[iA].label;
+                        double match_score = match_scores.value(key, 0);
+
+                        if (match_score >= best_match_score) {
+                            double abs_offset = fabs(eventsB[jB].time - tA);
+                            //in the case of a tie, use the one that is closer in offset.
+                            if ((match_score > best_match_score) || ((match_score == best_match_score) && (abs_offset < abs_offset_of_best_match_score))) {
+                                best_match_score = match_score;
+                                best_iB = jB;
+                                abs_offset_of_best_match_score = abs_offset;
+                            }
+                        }
+                    }
+                }
+                if (best_iB >= 0) {
+                    best_matches[iA] = best_iB;
+                }
+            }
+        }
+    });
+}
 }
@@ -14,89 +14,169 @@
  * limitations under the License.
  */
 #include "p_create_multiscale_timeseries.h"
-#include <QStringList>
+#include <QAtomicInt>
 #include <QFile>
+#include <QMutex>
+#include <QThread>
 #include <QTime>
-#include "diskreadmda.h"
+#include <QVector>
+#include <functional>
+#include "diskreadmda32.h"
 #include "diskwritemda.h"
 #include "mlutil.h"
 
+#define MULTISCALE_CHUNK_ENTRIES 3e6 //approximate number of entries (channels x timepoints) per input chunk
+#define MULTISCALE_NUM_CHUNKS_PER_BATCH 16
+
+/*
+ * Output layout (M x (N-1), float32, N the smallest power of 3 >= number of timepoints):
+ *   min(ds=3), max(ds=3), min(ds=9), max(ds=9), ..., min(ds=N), max(ds=N)
+ * where the level with downsampling factor ds has N/ds columns. The input is zero-padded to N timepoints.
+ *
+ * The input is read once, in chunks of chunk_size (a power of 3) timepoints. Each chunk is reduced
+ * in memory through all levels with ds <= chunk_size and those are written straight to their place
+ * in the output. The coarser levels are accumulated sequentially from the per-chunk reductions.
+ */
+
+class MultiscaleThread : public QThread {
+public:
+    std::function<void()> body;
+    void run()
+    {
+        body();
+    }
+};
+
+struct MultiscaleCarry {
+    Mda32 mins, maxs;
+    int count = 0;
+    bigint num_written = 0;
+};
+
 bigint smallest_power_of_3_larger_than(bigint N);
-bool downsample_min(const DiskReadMda& X, QString out_fname, bigint N);
-bool downsample_max(const DiskReadMda& X, QString out_fname, bigint N);
-bool write_concatenation(QStringList input_fnames, QString output_fname);
+static bigint level_offset(bigint N, int level);
+static void downsample_min_max(Mda32& mins_out, Mda32& maxs_out, const Mda32& mins_in, const Mda32& maxs_in);
+static bool write_level(DiskWriteMda& Y, bigint N, int level, bigint index, Mda32& mins, Mda32& maxs);
+static bool push_to_carry(DiskWriteMda& Y, bigint N, QVector<MultiscaleCarry>& carries, int level, const Mda32& mins, const Mda32& maxs);
 
 bool p_create_multiscale_timeseries(QString path_in, QString path_out, QString tempdir)
 {
-    DiskReadMda X(path_in);
+    Q_UNUSED(tempdir) //the levels are now written directly to the output
+
+    DiskReadMda32 X(path_in);
     X.reshape(X.N1(), X.N2() * X.N3()); //to handle the case of clips (3D array)
 
+    bigint M = X.N1();
     bigint N = smallest_power_of_3_larger_than(X.N2());
+    int num_levels = 0;
+    for (bigint ds_factor = 3; ds_factor <= N; ds_factor *= 3)
+        num_levels++;
 
-    QStringList tmp_file_names;
-    QString prev_min_fname;
-    QString prev_max_fname;
-    for (bigint ds_factor = 3; ds_factor <= N; ds_factor *= 3) {
-        printf("ds_factor = %ld / %ld\n", ds_factor, N);
-        QString rnd=MLUtil::makeRandomId(10);
-        QString min_fname = tempdir+"/"+"min."+rnd;
-        QString max_fname = tempdir+"/"+"max."+rnd;
-        if (ds_factor == 3) {
-            if (!downsample_min(X, min_fname, N)) {
-                printf("Problem in downsample_min\n");
-                printf("Removing temporary files\n");
-                foreach (QString fname, tmp_file_names) {
-                    QFile::remove(fname);
+    DiskWriteMda Y;
+    if (!Y.open(MDAIO_TYPE_FLOAT32, path_out, M, qMax(N - 1, (bigint)0))) {
+        qWarning() << "Unable to open output file: " + path_out;
+        return false;
+    }
+    if (!num_levels) {
+        Y.close();
+        return true;
+    }
+
+    bigint chunk_size = 3;
+    int chunk_levels = 1;
+    while ((chunk_size * 3 <= N) && (M * chunk_size * 3 <= MULTISCALE_CHUNK_ENTRIES)) {
+        chunk_size *= 3;
+        chunk_levels++;
+    }
+    bigint num_chunks = N / chunk_size;
+    printf("Creating %d levels using %ld chunks of size %ld\n", num_levels, num_chunks, chunk_size);
+
+    QVector<MultiscaleCarry> carries(num_levels + 1);
+    QVector<Mda32> chunk_mins(MULTISCALE_NUM_CHUNKS_PER_BATCH);
+    QVector<Mda32> chunk_maxs(MULTISCALE_NUM_CHUNKS_PER_BATCH);
+    Mda32* chunk_mins_ptr = chunk_mins.data();
+    Mda32* chunk_maxs_ptr = chunk_maxs.data();
+    int num_threads = qMax(1, qMin(QThread::idealThreadCount(), (int)MULTISCALE_NUM_CHUNKS_PER_BATCH));
+    QMutex write_mutex; //the output file is shared by the workers
+    bool ok = true;
+    QTime timer;
+    timer.start();
+    for (bigint c0 = 0; (c0 < num_chunks) && (ok); c0 += MULTISCALE_NUM_CHUNKS_PER_BATCH) {
+        bigint c1 = qMin(c0 + MULTISCALE_NUM_CHUNKS_PER_BATCH, num_chunks);
+        //the chunks of the batch are reduced by the workers (the calling thread is one of them), each taking the next
+        //chunk that nobody has started
+        QAtomicInt next_chunk(c0);
+        QAtomicInt failed(0);
+        auto reduce_chunks = [&]() {
+            DiskReadMda32 X0 = X;
+            while (!failed.load()) {
+                bigint c = next_chunk.fetchAndAddOrdered(1);
+                if (c >= c1)
+                    break;
+                bigint t0 = c * chunk_size;
+                Mda32 mins, maxs;
+                if (t0 < X0.N2()) {
+                    Mda32 chunk;
+                    if (!X0.readChunk(chunk, 0, t0, M, chunk_size)) {
+                        failed.store(1);
+                        break;
+                    }
+                    mins = chunk;
+                    maxs = chunk;
+                    for (int level = 1; level <= chunk_levels; level++) {
+                        Mda32 mins2, maxs2;
+                        downsample_min_max(mins2, maxs2, mins, maxs);
+                        mins = mins2;
+                        maxs = maxs2;
+                        QMutexLocker locker(&write_mutex);
+                        if (!write_level(Y, N, level, c * mins.N2(), mins, maxs)) {
+                            failed.store(1);
+                            break;
+                        }
+                    }
                 }
-                return false;
-            }
-            if (!downsample_max(X, max_fname, N)) {
-                printf("Problem in downsample_max\n");
-                printf("Removing temporary files\n");
-                foreach (QString fname, tmp_file_names) {
-                    QFile::remove(fname);
+                else {
+                    //entirely in the zero padding; the output file is already zero-filled
+                    mins.allocate(M, 1);
+                    maxs.allocate(M, 1);
                 }
-                return false;
+                chunk_mins_ptr[c - c0] = mins;
+                chunk_maxs_ptr[c - c0] = maxs;
             }
+        };
+        QList<MultiscaleThread*> threads;
+        for (int i = 1; i < qMin((bigint)num_threads, c1 - c0); i++) {
+            MultiscaleThread* thread = new MultiscaleThread;
+            thread->body = reduce_chunks;
+            thread->start();
+            threads << thread;
         }
-        else {
-            if (!downsample_min(DiskReadMda(prev_min_fname), min_fname, (N * 3) / ds_factor)) {
-                printf("Problem in downsample_min *\n");
-                printf("Removing temporary files\n");
-                foreach (QString fname, tmp_file_names) {
-                    QFile::remove(fname);
-                }
-                return false;
-            }
-            if (!downsample_max(DiskReadMda(prev_max_fname), max_fname, (N * 3) / ds_factor)) {
-                printf("Problem in downsample_max *\n");
-                printf("Removing temporary files\n");
-                foreach (QString fname, tmp_file_names) {
-                    QFile::remove(fname);
-                }
-                return false;
+        reduce_chunks();
+        foreach (MultiscaleThread* thread, threads) {
+            thread->wait();
+            delete thread;
+        }
+        if (failed.load())
+            ok = false;
+        //the coarser levels depend on the order of the chunks
+        for (bigint c = c0; (c < c1) && (ok); c++) {
+            if (chunk_levels < num_levels) {
+                if (!push_to_carry(Y, N, carries, chunk_levels + 1, chunk_mins[c - c0], chunk_maxs[c - c0]))
+                    ok = false;
             }
         }
-        tmp_file_names << min_fname;
-        tmp_file_names << max_fname;
-        prev_min_fname = min_fname;
-        prev_max_fname = max_fname;
-        printf("...................\n");
+        if ((timer.elapsed() > 5000) || (c1 == num_chunks)) {
+            printf("create_multiscale_timeseries %ld/%ld (%d%%)\n", c1 * chunk_size, N, (int)(c1 * 1.0 / num_chunks * 100));
+            timer.restart();
+        }
     }
+    Y.close();
 
-    printf("Writing concatenation...\n");
-    if (!write_concatenation(tmp_file_names, path_out)) {
-        printf("Problem in write_concatenation\n");
-        printf("Removing temporary files\n");
-        foreach (QString fname, tmp_file_names) {
-            QFile::remove(fname);
-        }
+    if (!ok) {
+        printf("Problem creating multiscale timeseries\n");
+        QFile::remove(path_out);
         return false;
     }
-    printf("Removing temporary files\n");
-    foreach (QString fname, tmp_file_names) {
-        QFile::remove(fname);
-    }
 
     return true;
 }
@@ -110,106 +190,85 @@ bigint smallest_power_of_3_larger_than(bigint N)
     return ret;
 }
 
-bool downsample_min(const DiskReadMda& X, QString out_fname, bigint N)
+bigint level_offset(bigint N, int level)
 {
-    DiskWriteMda Y;
-    if (!Y.open(MDAIO_TYPE_FLOAT32, out_fname, X.N1(), N / 3)) {
-        qWarning() << "Unable to open output file in downsample_min: " + out_fname;
-        return false;
+    //the min block of the level starts after the min and max blocks of all finer levels
+    bigint ret = 0;
+    bigint size = N / 3;
+    for (int l = 1; l < level; l++) {
+        ret += 2 * size;
+        size /= 3;
     }
+    return ret;
+}
 
-    /// TODO choose chunk_size sensibly
-    bigint chunk_size = 3 * 5000;
-    QTime timer;
-    timer.start();
-    for (bigint ii = 0; ii < N; ii += chunk_size) {
-        if (timer.elapsed() > 5000) {
-            printf("downsample_min %ld/%ld (%ld%%)\n", ii, N, (bigint)(ii * 1.0 / N * 100));
-            timer.restart();
-        }
-        bigint size0 = qMin(chunk_size, N - ii);
-        Mda A;
-        X.readChunk(A, 0, ii, X.N1(), size0);
-        Mda B(X.N1(), size0 / 3);
-        for (bigint jj = 0; jj < size0 / 3; jj++) {
-            for (bigint m = 0; m < X.N1(); m++) {
-                double val1 = A.value(m, jj * 3);
-                double val2 = A.value(m, jj * 3 + 1);
-                double val3 = A.value(m, jj * 3 + 2);
-                double val = qMin(qMin(val1, val2), val3);
-                B.setValue(val, m, jj);
-            }
+void downsample_min_max(Mda32& mins_out, Mda32& maxs_out, const Mda32& mins_in, const Mda32& maxs_in)
+{
+    bigint M = mins_in.N1();
+    bigint N2 = mins_in.N2() / 3;
+    mins_out.allocate(M, N2);
+    maxs_out.allocate(M, N2);
+    const float* Amin = mins_in.constDataPtr();
+    const float* Amax = maxs_in.constDataPtr();
+    float* Bmin = mins_out.dataPtr();
+    float* Bmax = maxs_out.dataPtr();
+    for (bigint j = 0; j < N2; j++) {
+        const float* a1 = &Amin[M * (3 * j)];
+        const float* a2 = &Amin[M * (3 * j + 1)];
+        const float* a3 = &Amin[M * (3 * j + 2)];
+        const float* b1 = &Amax[M * (3 * j)];
+        const float* b2 = &Amax[M * (3 * j + 1)];
+        const float* b3 = &Amax[M * (3 * j + 2)];
+        float* bmin = &Bmin[M * j];
+        float* bmax = &Bmax[M * j];
+        for (bigint m = 0; m < M; m++) {
+            bmin[m] = qMin(qMin(a1[m], a2[m]), a3[m]);
+            bmax[m] = qMax(qMax(b1[m], b2[m]), b3[m]);
         }
-        Y.writeChunk(B, 0, ii / 3);
     }
-
-    return true;
 }
 
-bool downsample_max(const DiskReadMda& X, QString out_fname, bigint N)
+bool write_level(DiskWriteMda& Y, bigint N, int level, bigint index, Mda32& mins, Mda32& maxs)
 {
-    DiskWriteMda Y;
-    if (!Y.open(MDAIO_TYPE_FLOAT32, out_fname, X.N1(), N / 3)) {
-        qWarning() << "Unable to open output file in downsample_min: " + out_fname;
+    bigint size = N;
+    for (int l = 0; l < level; l++)
+        size /= 3;
+    bigint offset = level_offset(N, level);
+    if (!Y.writeChunk(mins, 0, offset + index))
+        return false;
+    if (!Y.writeChunk(maxs, 0, offset + size + index))
         return false;
-    }
-
-    /// TODO choose chunk_size sensibly
-    bigint chunk_size = 3 * 5000;
-    QTime timer;
-    timer.start();
-    for (bigint ii = 0; ii < N; ii += chunk_size) {
-        if (timer.elapsed() > 5000) {
-            printf("downsample_max %ld/%ld (%ld%%)\n", ii, N, (bigint)(ii * 1.0 / N * 100));
-            timer.restart();
-        }
-        bigint size0 = qMin(chunk_size, N - ii);
-        Mda A;
-        X.readChunk(A, 0, ii, X.N1(), size0);
-        Mda B(X.N1(), size0 / 3);
-        for (bigint jj = 0; jj < size0 / 3; jj++) {
-            for (bigint m = 0; m < X.N1(); m++) {
-                double val1 = A.value(m, jj * 3);
-                double val2 = A.value(m, jj * 3 + 1);
-                double val3 = A.value(m, jj * 3 + 2);
-                double val = qMax(qMax(val1, val2), val3);
-                B.setValue(val, m, jj);
-            }
-        }
-        Y.writeChunk(B, 0, ii / 3);
-    }
-
     return true;
 }
 
-bool write_concatenation(QStringList input_fnames, QString output_fname)
+bool push_to_carry(DiskWriteMda& Y, bigint N, QVector<MultiscaleCarry>& carries, int level, const Mda32& mins, const Mda32& maxs)
 {
-    bigint M = 1, N = 0;
-    foreach (QString fname, input_fnames) {
-        DiskReadMda X(fname);
-        M = X.N1();
-        N += X.N2();
-    }
-    DiskWriteMda Y;
-    if (!Y.open(MDAIO_TYPE_FLOAT32, output_fname, M, N)) {
-        qWarning() << "Unable to open output file: " + output_fname;
-        return false;
+    MultiscaleCarry& CC = carries[level];
+    if (CC.count == 0) {
+        CC.mins = mins;
+        CC.maxs = maxs;
     }
-    bigint offset = 0;
-    foreach (QString fname, input_fnames) {
-        DiskReadMda X(fname);
-
-        /// TODO choose chunk_size sensibly
-        bigint chunk_size = 10000;
-        for (bigint ii = 0; ii < X.N2(); ii += chunk_size) {
-            bigint size0 = qMin((bigint)chunk_size, (bigint)(X.N2() - ii));
-            Mda tmp;
-            X.readChunk(tmp, 0, ii, M, size0);
-            Y.writeChunk(tmp, 0, offset);
-            offset += size0;
+    else {
+        float* Cmin = CC.mins.dataPtr();
+        float* Cmax = CC.maxs.dataPtr();
+        const float* Amin = mins.constDataPtr();
+        const float* Amax = maxs.constDataPtr();
+        for (bigint m = 0; m < mins.N1(); m++) {
+            Cmin[m] = qMin(Cmin[m], Amin[m]);
+            Cmax[m] = qMax(Cmax[m], Amax[m]);
         }
     }
-    Y.close();
+    CC.count++;
+    if (CC.count < 3)
+        return true;
 
+    //the reduction for this level is complete
+    if (!write_level(Y, N, level, CC.num_written, CC.mins, CC.maxs))
+        return false;
+    CC.num_written++;
+    CC.count = 0;
+    if (level + 1 < carries.count()) {
+        return push_to_carry(Y, N, carries, level + 1, CC.mins, CC.maxs);
+    }
     return true;
 }
@@ -19,6 +19,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
 #include <QTime>
 #include <QVector>
 #include <diskreadmda.h>
@@ -27,8 +28,10 @@
 #include <mda32.h>
 #include "pca.h"
 #include "kdtree.h"
+#include "knearestneighbors.h"
 #include "compute_templates_0.h"
 #include "textfile.h"
+#include <algorithm>
 #include <cmath>
 using std::sqrt;
 
@@ -36,9 +39,10 @@ namespace P_isolation_metrics {
 Mda32 extract_clips(const DiskReadMda32& X, const QVector<double>& times, int clip_size);
 Mda32 compute_mean_clip(const Mda32& clips);
 QJsonObject get_cluster_metrics(const DiskReadMda32& X, const QVector<double>& times, P_isolation_metrics_opts opts);
-QJsonObject get_pair_metrics(const DiskReadMda32& X, const QVector<double>& times_k1, const QVector<double>& times_k2, P_isolation_metrics_opts opts);
+QJsonObject get_pair_metrics(const Mda32& sample_clips_k1, const Mda32& sample_clips_k2, P_isolation_metrics_opts opts);
 QSet<QString> get_pairs_to_compare(const Mda32& templates0, bigint num_comparisons_per_cluster, const QList<int>& cluster_numbers, P_isolation_metrics_opts opts);
-double compute_overlap(const DiskReadMda32& X, const QVector<double>& times1, const QVector<double>& times2, P_isolation_metrics_opts opts);
+QVector<double> sample(const QVector<double>& times, bigint num);
+double compute_overlap(const Mda32& sample_clips1, const Mda32& sample_clips2, P_isolation_metrics_opts opts);
 bool is_bursting_parent_candidate(const Mda32& template0, const Mda32& template0_parent, P_isolation_metrics_opts opts);
 bool test_bursting_timing(const QVector<double>& times, const QVector<double>& times_parent, P_isolation_metrics_opts opts, bool verbose);
 struct ClusterData {
@@ -48,6 +52,16 @@ struct ClusterData {
     int overlap_cluster = 0;
     int bursting_parent = 0;
 };
+//the clips at sample(times, max_num_to_use), shared by all the pairs of a cluster. They are extracted on the
+//cluster's first pair and freed after its last, so only the clusters with pairs in progress hold clips
+struct ClusterSampleClips {
+    QMutex mutex;
+    bool extracted = false;
+    Mda32 clips;
+    int num_pairs_remaining = 0;
+};
+Mda32 acquire_sample_clips(ClusterSampleClips* C, const DiskReadMda32& X, const QVector<double>& times, const P_isolation_metrics_opts& opts);
+void release_sample_clips(ClusterSampleClips* C);
 }
 
 bool p_isolation_metrics(QStringList timeseries_list, QString firings_path, QString metrics_out_path, QString pair_metrics_out_path, P_isolation_metrics_opts opts)
@@ -134,26 +148,44 @@ bool p_isolation_metrics(QStringList timeseries_list, QString firings_path, QStr
     QSet<QString> pairs_to_compare = P_isolation_metrics::get_pairs_to_compare(templates0, num_comparisons_per_cluster, cluster_numbers, opts);
     QList<QString> pairs_to_compare_list = pairs_to_compare.toList();
     qSort(pairs_to_compare_list);
+    QMap<int, P_isolation_metrics::ClusterSampleClips*> sample_clips;
+    foreach (int k, cluster_numbers) {
+        sample_clips[k] = new P_isolation_metrics::ClusterSampleClips;
+    }
+    foreach (QString pairstr, pairs_to_compare_list) {
+        QStringList vals = pairstr.split("-");
+        sample_clips[vals[0].toInt()]->num_pairs_remaining++;
+        sample_clips[vals[1].toInt()]->num_pairs_remaining++;
+    }
 #pragma omp parallel for
     for (int jj = 0; jj < pairs_to_compare_list.count(); jj++) {
         QString pairstr;
         int k1, k2;
+        DiskReadMda32 X0;
         QVector<double> times_k1, times_k2;
+        P_isolation_metrics::ClusterSampleClips *C1, *C2;
         P_isolation_metrics_opts opts0;
-        DiskReadMda32 X0;
 #pragma omp critical
         {
+            X0 = X;
             pairstr = pairs_to_compare_list[jj];
             QStringList vals = pairstr.split("-");
             k1 = vals[0].toInt();
             k2 = vals[1].toInt();
             times_k1 = cluster_data.value(k1).times;
             times_k2 = cluster_data.value(k2).times;
+            C1 = sample_clips.value(k1);
+            C2 = sample_clips.value(k2);
             opts0 = opts;
-            X0 = X;
         }
 
-        QJsonObject pair_metrics = P_isolation_metrics::get_pair_metrics(X0, times_k1, times_k2, opts0);
+        Mda32 sample_clips_k1 = P_isolation_metrics::acquire_sample_clips(C1, X0, times_k1, opts0);
+        Mda32 sample_clips_k2 = P_isolation_metrics::acquire_sample_clips(C2, X0, times_k2, opts0);
+        QJsonObject pair_metrics = P_isolation_metrics::get_pair_metrics(sample_clips_k1, sample_clips_k2, opts0);
+        sample_clips_k1 = Mda32();
+        sample_clips_k2 = Mda32();
+        P_isolation_metrics::release_sample_clips(C1);
+        P_isolation_metrics::release_sample_clips(C2);
 
 #pragma omp critical
         {
@@ -172,6 +204,7 @@ bool p_isolation_metrics(QStringList timeseries_list, QString firings_path, QStr
             cluster_pairs.push_back(tmp);
         }
     }
+    qDeleteAll(sample_clips);
 
     if (opts.compute_bursting_parents) {
         qDebug().noquote() << "Computing bursting parents...";
@@ -309,6 +342,52 @@ void regress_out_noise_shape(Mda32& clips, const Mda32& shape)
     }
 }
 
+/*
+ * The fraction of the nearest neighbors (in feature space) that have a different label than
+ * the point itself. Exact neighbors unless opts.exact_nearest_neighbors is false, in which case
+ * the approximate kd-tree search is used.
+ */
+double compute_neighbor_label_disagreement(const Mda32& FF, const QVector<bigint>& labels, P_isolation_metrics_opts opts)
+{
+    double num_correct = 0;
+    double num_total = 0;
+    if (opts.exact_nearest_neighbors) {
+        QVector<int> neighbors = find_k_nearest_neighbors(FF, opts.K_nearest);
+        bigint K = (FF.N2() ? neighbors.count() / FF.N2() : 0);
+        for (bigint i = 0; i < FF.N2(); i++) {
+            for (bigint a = 0; a < K; a++) {
+                int ind = neighbors[i * K + a];
+                if (ind != i) {
+                    if (labels[ind] == labels[i])
+                        num_correct++;
+                    num_total++;
+                }
+            }
+        }
+    }
+    else {
+        KdTree tree;
+        tree.create(FF);
+        for (bigint i = 0; i < FF.N2(); i++) {
+            QVector<float> p;
+            for (bigint j = 0; j < FF.N1(); j++) {
+                p << FF.value(j, i);
+            }
+            QList<int> indices = tree.findApproxKNearestNeighbors(FF, p, opts.K_nearest, opts.exhaustive_search_num);
+            for (bigint a = 0; a < indices.count(); a++) {
+                if (indices[a] != i) {
+                    if (labels[indices[a]] == labels[i])
+                        num_correct++;
+                    num_total++;
+                }
+            }
+        }
+    }
+    if (!num_total)
+        return 0;
+    return 1 - (num_correct * 1.0 / num_total);
+}
+
 double compute_noise_overlap(const DiskReadMda32& X, const QVector<double>& times, P_isolation_metrics_opts opts, bool debug)
 {
     QTime timer;
@@ -375,89 +454,43 @@ double compute_noise_overlap(const DiskReadMda32& X, const QVector<double>& time
 
     elapsed_times << timer.restart();
 
-    KdTree tree;
-    tree.create(FF);
-    double num_correct = 0;
-    double num_total = 0;
-    for (bigint i = 0; i < FF.N2(); i++) {
-        QVector<float> p;
-        for (bigint j = 0; j < FF.N1(); j++) {
-            p << FF.value(j, i);
-        }
-        QList<int> indices = tree.findApproxKNearestNeighbors(FF, p, opts.K_nearest, opts.exhaustive_search_num);
-        for (bigint a = 0; a < indices.count(); a++) {
-            if (indices[a] != i) {
-                if (all_labels[indices[a]] == all_labels[i])
-                    num_correct++;
-                num_total++;
-            }
-        }
-    }
+    double ret = compute_neighbor_label_disagreement(FF, all_labels, opts);
 
     elapsed_times << timer.restart();
 
     if (false)
         qDebug().noquote() << "Elapsed times:" << elapsed_times;
 
-    if (!num_total)
-        return 0;
-    return 1 - (num_correct * 1.0 / num_total);
+    return ret;
 }
 
-double compute_overlap(const DiskReadMda32& X, const QVector<double>& times1, const QVector<double>& times2, P_isolation_metrics_opts opts)
+double compute_overlap(const Mda32& sample_clips1, const Mda32& sample_clips2, P_isolation_metrics_opts opts)
 {
-    bigint num_to_use = qMin(qMin(opts.max_num_to_use, times1.count()), times2.count());
+    //sample() takes a prefix of a fixed ordering, so the first clips of each cluster are the sample we need
+    bigint num_to_use = qMin(qMin((bigint)opts.max_num_to_use, sample_clips1.N3()), sample_clips2.N3());
     if (num_to_use < opts.min_num_to_use)
         return 0;
-    QVector<double> times1_subset = sample(times1, num_to_use);
-    QVector<double> times2_subset = sample(times2, num_to_use);
 
-    QVector<double> all_times;
     QVector<bigint> all_labels; //1 and 2
-
-    for (bigint i = 0; i < times1_subset.count(); i++) {
-        all_times << times1_subset[i];
+    for (bigint i = 0; i < num_to_use; i++) {
         all_labels << 1;
     }
-    for (bigint i = 0; i < times2_subset.count(); i++) {
-        all_times << times2_subset[i];
+    for (bigint i = 0; i < num_to_use; i++) {
         all_labels << 2;
     }
 
-    Mda32 all_clips = extract_clips(X, all_times, opts.clip_size);
-
-    Mda32 all_clips_reshaped(all_clips.N1() * all_clips.N2(), all_clips.N3());
-    bigint NNN = all_clips.totalSize();
-    for (bigint iii = 0; iii < NNN; iii++) {
-        all_clips_reshaped.set(all_clips.get(iii), iii);
-    }
+    bigint MT = sample_clips1.N1() * sample_clips1.N2();
+    Mda32 all_clips_reshaped(MT, num_to_use * 2);
+    float* ptr = all_clips_reshaped.dataPtr();
+    std::copy(sample_clips1.constDataPtr(), sample_clips1.constDataPtr() + MT * num_to_use, ptr);
+    std::copy(sample_clips2.constDataPtr(), sample_clips2.constDataPtr() + MT * num_to_use, ptr + MT * num_to_use);
 
     bool subtract_mean = false;
     Mda32 FF;
     Mda32 CC, sigma;
     pca(CC, FF, sigma, all_clips_reshaped, opts.num_features, subtract_mean);
 
-    KdTree tree;
-    tree.create(FF);
-    double num_correct = 0;
-    double num_total = 0;
-    for (bigint i = 0; i < all_times.count(); i++) {
-        QVector<float> p;
-        for (bigint j = 0; j < FF.N1(); j++) {
-            p << FF.value(j, i);
-        }
-        QList<int> indices = tree.findApproxKNearestNeighbors(FF, p, opts.K_nearest, opts.exhaustive_search_num);
-        for (bigint a = 0; a < indices.count(); a++) {
-            if (indices[a] != i) {
-                if (all_labels[indices[a]] == all_labels[i])
-                    num_correct++;
-                num_total++;
-            }
-        }
-    }
-    if (!num_total)
-        return 0;
-    return 1 - (num_correct * 1.0 / num_total);
+    return compute_neighbor_label_disagreement(FF, all_labels, opts);
 }
 
 QVector<bigint> find_label_inds(const QVector<bigint>& labels, bigint k)
@@ -539,6 +572,25 @@ Mda32 extract_clips(const DiskReadMda32& X, const QVector<double>& times, int cl
     }
     return clips;
 }
+Mda32 acquire_sample_clips(ClusterSampleClips* C, const DiskReadMda32& X, const QVector<double>& times, const P_isolation_metrics_opts& opts)
+{
+    //the other pairs of this cluster wait here while its clips are read, other clusters are read in parallel
+    QMutexLocker locker(&C->mutex);
+    if (!C->extracted) {
+        C->clips = extract_clips(X, sample(times, opts.max_num_to_use), opts.clip_size);
+        C->extracted = true;
+    }
+    return C->clips;
+}
+
+void release_sample_clips(ClusterSampleClips* C)
+{
+    QMutexLocker locker(&C->mutex);
+    C->num_pairs_remaining--;
+    if (C->num_pairs_remaining == 0)
+        C->clips = Mda32();
+}
+
 Mda32 compute_mean_clip(const Mda32& clips)
 {
     bigint M = clips.N1();
@@ -629,10 +681,10 @@ QJsonObject get_cluster_metrics(const DiskReadMda32& X, const QVector<double>& t
     }
     return ret;
 }
-QJsonObject get_pair_metrics(const DiskReadMda32& X, const QVector<double>& times_k1, const QVector<double>& times_k2, P_isolation_metrics_opts opts)
+QJsonObject get_pair_metrics(const Mda32& sample_clips_k1, const Mda32& sample_clips_k2, P_isolation_metrics_opts opts)
 {
     QJsonObject pair_metrics;
-    double overlap = P_isolation_metrics::compute_overlap(X, times_k1, times_k2, opts);
+    double overlap = P_isolation_metrics::compute_overlap(sample_clips_k1, sample_clips_k2, opts);
     pair_metrics["overlap"] = overlap;
     return pair_metrics;
 }
@@ -23,7 +23,8 @@ struct P_isolation_metrics_opts {
     int clip_size = 50;
     int num_features = 10;
     int K_nearest = 6;
-    int exhaustive_search_num = 100;
+    int exhaustive_search_num = 100; //only for the approximate nearest neighbor search
+    bool exact_nearest_neighbors = true;
     int max_num_to_use = 500;
     int min_num_to_use = 100;
     bool do_not_compute_pair_metrics = false;
@@ -14,50 +14,92 @@
  * limitations under the License.
  */
 #include "p_mask_out_artifacts.h"
-#include "diskreadmda.h"
+#include "diskreadmda32.h"
 #include "diskwritemda.h"
+#include <QBitArray>
 #include <QTime>
+#include <QDebug>
 #include <math.h>
 #include "mlutil.h"
 #include "mda.h"
+#include "chunkpipeline.h"
 
-bool p_mask_out_artifacts(const QString& timeseries_path, const QString& timeseries_out_path, double threshold, int interval_size)
+#define MASK_OUT_ARTIFACTS_CHUNK_SIZE 1e5 //approximate number of timepoints per pipeline chunk
+
+bool p_mask_out_artifacts(const QString& timeseries_path, const QString& timeseries_out_path, const QString& masked_intervals_out_path, double threshold, int interval_size)
 {
     if ((!threshold) || (!interval_size)) {
         printf("Problem with input parameters. Either threshold or interval_size is zero.\n");
         return false;
     }
+    if ((timeseries_out_path.isEmpty()) && (masked_intervals_out_path.isEmpty())) {
+        printf("Problem with input parameters. Neither timeseries_out nor masked_intervals_out was specified.\n");
+        return false;
+    }
 
     QTime status_timer;
     status_timer.start();
 
-    DiskReadMda X(timeseries_path);
+    DiskReadMda32 X(timeseries_path);
     bigint M = X.N1();
     bigint N = X.N2();
 
-    //compute norms of chunks
-    Mda norms(M, N / interval_size);
-    for (bigint i = 0; i < N / interval_size; i++) {
-        bigint timepoint = i * interval_size;
-        if (status_timer.elapsed() > 5000) {
-            printf("mask_out_artifacts compute_norms: %ld/%ld (%d%%)\n", timepoint, N, (int)(timepoint * 100.0 / N));
-            status_timer.restart();
+    //the intervals are processed in groups, so that each pipeline chunk is reasonably large
+    bigint num_intervals = N / interval_size;
+    bigint intervals_per_chunk = qMax((bigint)1, (bigint)(MASK_OUT_ARTIFACTS_CHUNK_SIZE / interval_size));
+    bigint num_chunks = (num_intervals + intervals_per_chunk - 1) / intervals_per_chunk;
+    auto read_intervals = [&](bigint i, Mda32& chunk) {
+        bigint i1 = i * intervals_per_chunk;
+        bigint i2 = qMin(num_intervals, i1 + intervals_per_chunk);
+        if (!X.readChunk(chunk, 0, i1 * interval_size, M, (i2 - i1) * interval_size)) {
+            qWarning() << "Problem reading chunk in mask_out_artifacts" << i1 * interval_size;
+            return false;
         }
-        Mda chunk;
-        X.readChunk(chunk, 0, timepoint, M, interval_size);
-        for (bigint m = 0; m < M; m++) {
-            double sumsqr = 0;
-            for (bigint aa = 0; aa < interval_size; aa++) {
-                sumsqr += chunk.value(m, aa) * chunk.value(m, aa);
+        return true;
+    };
+
+    //compute norms of chunks
+    Mda norms(M, num_intervals);
+    {
+        ChunkPipeline pipeline;
+        pipeline.setNumChunks(num_chunks);
+        pipeline.setReadFunction(read_intervals);
+        pipeline.setComputeFunction([&](int, bigint i, Mda32& chunk) {
+            //each chunk sets its own columns of norms
+            bigint i1 = i * intervals_per_chunk;
+            const float* ptr = chunk.constDataPtr();
+            double* norms_ptr = norms.dataPtr();
+            QVector<double> sumsqrs(M);
+            for (bigint j = 0; j < chunk.N2() / interval_size; j++) {
+                //accumulate all the channels of a timepoint together, in the order the data is stored
+                sumsqrs.fill(0);
+                const float* ptr0 = &ptr[M * j * interval_size];
+                for (bigint aa = 0; aa < interval_size; aa++) {
+                    for (bigint m = 0; m < M; m++) {
+                        double val = ptr0[m + M * aa];
+                        sumsqrs[m] += val * val;
+                    }
+                }
+                for (bigint m = 0; m < M; m++) {
+                    norms_ptr[m + M * (i1 + j)] = sqrt(sumsqrs[m]);
+                }
             }
-            norms.set(sqrt(sumsqr), m, i);
-        }
+            return true;
+        });
+        pipeline.setWriteFunction([&](bigint i, Mda32&) {
+            if (status_timer.elapsed() > 5000) {
+                bigint timepoint = i * intervals_per_chunk * interval_size;
+                printf("mask_out_artifacts compute_norms: %ld/%ld (%d%%)\n", timepoint, N, (int)(timepoint * 100.0 / N));
+                status_timer.restart();
+            }
+            return true;
+        });
+        if (!pipeline.run())
+            return false;
     }
 
-    //determine which chunks to use
-    QVector<int> use_it(N / interval_size + 1);
-    for (bigint i = 0; i < use_it.count(); i++)
-        use_it[i] = 1;
+    //determine which intervals to mask out
+    QBitArray masked(num_intervals);
     for (bigint m = 0; m < M; m++) {
         QVector<double> vals;
         for (bigint i = 0; i < norms.N2(); i++) {
@@ -68,37 +110,90 @@ bool p_mask_out_artifacts(const QString& timeseries_path, const QString& timeser
         printf("For channel %ld: mean=%g, stdev=%g, interval size = %d\n", m, mean0, sigma0, interval_size);
         for (bigint i = 0; i < norms.N2(); i++) {
             if (norms.value(m, i) > mean0 + sigma0 * threshold) {
-                use_it[i - 1] = 0; //don't use the neighbor chunks either
-                use_it[i] = 0; //don't use the neighbor chunks either
-                use_it[i + 1] = 0; //don't use the neighbor chunks either
+                //don't use the neighbor intervals either
+                if (i - 1 >= 0)
+                    masked.setBit(i - 1);
+                masked.setBit(i);
+                if (i + 1 < num_intervals)
+                    masked.setBit(i + 1);
             }
         }
     }
+    bigint num_timepoints_not_used = masked.count(true) * interval_size;
+    bigint num_timepoints_used = num_intervals * interval_size - num_timepoints_not_used;
 
-    //write the data
-    bigint num_timepoints_used = 0;
-    bigint num_timepoints_not_used = 0;
-    DiskWriteMda Y;
-    Y.open(MDAIO_TYPE_FLOAT32, timeseries_out_path, M, N);
-    for (bigint i = 0; i < N / interval_size; i++) {
-        bigint timepoint = i * interval_size;
-        if (status_timer.elapsed() > 5000) {
-            printf("mask_out_artifacts write data: %ld/%ld (%d%%)\n", timepoint, N, (int)(timepoint * 100.0 / N));
-            status_timer.restart();
+    if (!masked_intervals_out_path.isEmpty()) {
+        //each column is a run of consecutive masked intervals: first timepoint, and one past the last timepoint
+        QList<bigint> starts, ends;
+        for (bigint i = 0; i < num_intervals; i++) {
+            if ((masked.testBit(i)) && ((i == 0) || (!masked.testBit(i - 1))))
+                starts << i * interval_size;
+            if ((masked.testBit(i)) && ((i + 1 == num_intervals) || (!masked.testBit(i + 1))))
+                ends << (i + 1) * interval_size;
         }
-        Mda chunk;
-        X.readChunk(chunk, 0, timepoint, M, interval_size);
-        if (use_it[i]) {
-            num_timepoints_used += interval_size;
-            Y.writeChunk(chunk, 0, timepoint);
+        Mda intervals(2, starts.count());
+        for (bigint j = 0; j < starts.count(); j++) {
+            intervals.setValue(starts[j], 0, j);
+            intervals.setValue(ends[j], 1, j);
         }
-        else {
-            num_timepoints_not_used += interval_size;
+        if (!intervals.write64(masked_intervals_out_path)) {
+            qWarning() << "Problem writing masked intervals in mask_out_artifacts" << masked_intervals_out_path;
+            return false;
+        }
+    }
+
+    //write the data, unless the caller only wants the masked intervals
+    if (!timeseries_out_path.isEmpty()) {
+        DiskWriteMda Y;
+        Y.open(MDAIO_TYPE_FLOAT32, timeseries_out_path, M, N);
+        ChunkPipeline pipeline;
+        pipeline.setNumChunks(num_chunks);
+        pipeline.setReadFunction([&](bigint i, Mda32& chunk) {
+            //a chunk that is masked out entirely need not be read
+            bigint i1 = i * intervals_per_chunk;
+            bigint i2 = qMin(num_intervals, i1 + intervals_per_chunk);
+            for (bigint j = i1; j < i2; j++) {
+                if (!masked.testBit(j))
+                    return read_intervals(i, chunk);
+            }
+            chunk.allocate(M, (i2 - i1) * interval_size);
+            return true;
+        });
+        pipeline.setComputeFunction([&](int, bigint i, Mda32& chunk) {
+            bigint i1 = i * intervals_per_chunk;
+            float* ptr = chunk.dataPtr();
+            for (bigint j = 0; j < chunk.N2() / interval_size; j++) {
+                if (masked.testBit(i1 + j)) {
+                    for (bigint k = M * j * interval_size; k < M * (j + 1) * interval_size; k++)
+                        ptr[k] = 0;
+                }
+            }
+            return true;
+        });
+        pipeline.setWriteFunction([&](bigint i, Mda32& chunk) {
+            bigint i1 = i * intervals_per_chunk;
+            bigint timepoint = i1 * interval_size;
+            if (status_timer.elapsed() > 5000) {
+                printf("mask_out_artifacts write data: %ld/%ld (%d%%)\n", timepoint, N, (int)(timepoint * 100.0 / N));
+                status_timer.restart();
+            }
+            if (!Y.writeChunk(chunk, 0, timepoint)) {
+                qWarning() << "Problem writing chunk in mask_out_artifacts" << timepoint;
+                return false;
+            }
+            return true;
+        });
+        if (!pipeline.run()) {
+            Y.close();
+            return false;
         }
+        Y.close();
     }
-    Y.close();
 
-    printf("Using %.2f%% of all timepoints\n", num_timepoints_used * 100.0 / (num_timepoints_used + num_timepoints_not_used));
+    if (num_intervals)
+        printf("Using %.2f%% of all timepoints\n", num_timepoints_used * 100.0 / (num_timepoints_used + num_timepoints_not_used));
+    else
+        printf("The timeseries is shorter than one interval, nothing was masked\n");
 
     return true;
 }
@@ -19,6 +19,11 @@
 
 #include <QString>
 
-bool p_mask_out_artifacts(const QString& timeseries_path, const QString& timeseries_out_path, double threshold, int interval_size);
+/*
+ * Zeroes out the intervals whose norm (on any channel) is more than threshold stdevs above the mean, together
+ * with their neighbors. Either output may be empty: masked_intervals_out is a 2xK array of the masked runs
+ * (first timepoint, one past the last timepoint), for steps that would rather skip them than read a masked copy.
+ */
+bool p_mask_out_artifacts(const QString& timeseries_path, const QString& timeseries_out_path, const QString& masked_intervals_out_path, double threshold, int interval_size);
 
 #endif // MASK_OUT_ARTIFACTS_H
@@ -16,13 +16,14 @@
 #include "p_mv_compute_templates.h"
 
 #include <diskreadmda.h>
+#include <diskreadmda32.h>
 #include "compute_templates_0.h"
 
 /// TODO 0.9.1 #define USE_TASK_PROGRESS, and don't use this outside of the mountainview gui -- unnecessary dependence AND risk
 
 bool mv_compute_templates(const QString& timeseries_path, const QString& firings_path, const QString& templates_out_path, const QString& stdevs_out_path, int clip_size)
 {
-    DiskReadMda X(timeseries_path);
+    DiskReadMda32 X(timeseries_path);
     if (X.N2() <= 1) {
         return false;
     }
@@ -33,8 +34,9 @@ bool mv_compute_templates(const QString& timeseries_path, const QString& firings
         times << firings.value(1, i);
         labels << (int)firings.value(2, i);
     }
-    Mda templates, stdevs;
-    compute_templates_stdevs(templates, stdevs, X, times, labels, clip_size);
+    Mda32 templates, stdevs;
+    if (!compute_templates_in_parallel(templates, &stdevs, X, times, labels, clip_size))
+        return false;
     templates.write32(templates_out_path);
     stdevs.write32(stdevs_out_path);
     return true;
@@ -24,6 +24,7 @@ using std::erf;
 using std::sqrt;
 #include "fftw3.h"
 
+#define SPIKEVIEW_TEMPLATES_CLIPS_BATCH_SIZE 10000 //clips read together with DiskReadMda32::readChunks
 
 namespace P_spikeview_templates {
 struct ClusterData {
@@ -107,9 +108,8 @@ bool p_spikeview_templates(QString timeseries, QString firings, QString template
                 }
                 CD = &cluster_data[key];
             }
-            /// Witold -- this is a bad pitfall. I needed to use a new instance of DiskReadMda32 here because accessing the same instance across multiple threads was causing WRONG results --very bad -- please help make DiskReadMda32 thread safe
-            DiskReadMda32 X0(timeseries);
-            compute_template(CD->template0, X0, CD->times, opts, BP);
+            //the reads of DiskReadMda32 are positional, so all the threads can share X
+            compute_template(CD->template0, X, CD->times, opts, BP);
         }
     }
 
@@ -168,14 +168,20 @@ void compute_template(Mda32& template0, const DiskReadMda32& X, const QVector<do
     Mda sum(M, T + 2 * opts.filt_padding);
 
     int Tmid = (int)((T + 1) / 2) - 1;
-    for (bigint i = 0; i < times.count(); i++) {
-        bigint t1 = times[i] - Tmid - opts.filt_padding;
-        Mda32 tmp;
-        X.readChunk(tmp, 0, t1, M, T + opts.filt_padding * 2);
-        for (int t = 0; t < T + 2 * opts.filt_padding; t++) {
-            for (int m = 0; m < M; m++) {
-                double val = tmp.get(m, t);
-                sum.set(sum.get(m, t) + val, m, t);
+    int T2 = T + 2 * opts.filt_padding;
+    Mda32 clips;
+    for (bigint i0 = 0; i0 < times.count(); i0 += SPIKEVIEW_TEMPLATES_CLIPS_BATCH_SIZE) {
+        bigint num = qMin((bigint)SPIKEVIEW_TEMPLATES_CLIPS_BATCH_SIZE, (bigint)times.count() - i0);
+        QVector<bigint> t1s(num);
+        for (bigint i = 0; i < num; i++) {
+            t1s[i] = times[i0 + i] - Tmid - opts.filt_padding;
+        }
+        X.readChunks(clips, t1s, T2);
+        double* sum_ptr = sum.dataPtr();
+        for (bigint i = 0; i < num; i++) {
+            const dtype32* ptr = clips.dataPtr(0, 0, i);
+            for (bigint j = 0; j < M * T2; j++) {
+                sum_ptr[j] += ptr[j];
             }
         }
     }
@@ -16,10 +16,12 @@
 #include "p_whiten.h"
 
 #include <QTime>
+#include <QThread>
 #include <diskreadmda32.h>
 #include <diskwritemda.h>
 #include <mda.h>
 #include "pca.h"
+#include "chunkpipeline.h"
 //#include "omp.h"
 #include <cmath>
 using std::floor;
@@ -40,6 +42,7 @@ void quantize(bigint N, float* X, double unit)
     }
 }
 Mda32 extract_channels_from_chunk(const Mda32& X, const QList<int>& channels);
+bool apply_whitening_matrix(DiskReadMda32& X, const Mda& WW, DiskWriteMda& Y, bigint chunk_size, double quantization_unit);
 }
 
 bool p_whiten(QString timeseries, QString timeseries_out, Whiten_opts &opts)
@@ -75,11 +78,9 @@ bool p_whiten(QString timeseries, QString timeseries_out, Whiten_opts &opts)
 #pragma omp parallel for
         for (bigint timepoint = 0; timepoint < N; timepoint += chunk_size) {
             Mda32 chunk;
-#pragma omp critical(lock1)
-            {
-                if (!X.readChunk(chunk, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
-                    qWarning() << "Problem reading chunk in whiten (1)";
-                }
+            //readChunk is reentrant, no need to serialize the reads
+            if (!X.readChunk(chunk, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
+                qWarning() << "Problem reading chunk in whiten (1)";
             }
             float* chunkptr = chunk.dataPtr();
             Mda XXt0(M, M);
@@ -134,7 +135,6 @@ bool p_whiten(QString timeseries, QString timeseries_out, Whiten_opts &opts)
     //Mda AA = get_whitening_matrix(COV);
     Mda WW;
     whitening_matrix_from_XXt(WW, XXt); // the result is symmetric (assumed below)
-    double* WWptr = WW.dataPtr();
 
     /*
     qDebug().noquote() << "Debug WW";
@@ -155,54 +155,10 @@ bool p_whiten(QString timeseries, QString timeseries_out, Whiten_opts &opts)
     if (opts.quantization_unit > 0)
         dtype = MDAIO_TYPE_INT16;
     Y.open(dtype, timeseries_out, M, N);
-    {
-        QTime timer;
-        timer.start();
-        bigint num_timepoints_handled = 0;
-#pragma omp parallel for
-        for (bigint timepoint = 0; timepoint < N; timepoint += chunk_size) {
-            Mda32 chunk_in;
-#pragma omp critical(lock1)
-            {
-                if (!X.readChunk(chunk_in, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
-                    qWarning() << "Problem reading chunk in whiten (2)";
-                }
-            }
-            float* chunk_in_ptr = chunk_in.dataPtr();
-            Mda32 chunk_out(M, chunk_in.N2());
-            float* chunk_out_ptr = chunk_out.dataPtr();
-            for (bigint i = 0; i < chunk_in.N2(); i++) { // explicitly do mat-mat mult ... TODO replace w/ BLAS3
-                bigint aa = M * i;
-                bigint bb = 0;
-                for (bigint m1 = 0; m1 < M; m1++) {
-                    for (bigint m2 = 0; m2 < M; m2++) {
-                        chunk_out_ptr[aa + m1] += chunk_in_ptr[aa + m2] * WWptr[bb]; // actually this does dgemm w/ WW^T
-                        bb++; // but since symmetric, doesn't matter.
-                    }
-                }
-            }
-#pragma omp critical(lock2)
-            {
-                // The following is needed to make the output deterministic, due to a very tricky floating-point problem that I honestly could not track down
-                // It has something to do with multiplying by very small values of WWptr[bb]. But I truly could not pinpoint the exact problem.
-                P_whiten::quantize(chunk_out.totalSize(), chunk_out.dataPtr(), 0.0001);
-                if (opts.quantization_unit > 0) {
-                    P_whiten::scale_for_quantization(chunk_out, opts.quantization_unit);
-                }
-                if (!Y.writeChunk(chunk_out, 0, timepoint)) {
-                    qWarning() << "Problem writing chunk in whiten";
-                }
-                num_timepoints_handled += qMin(chunk_size, N - timepoint);
-                if ((timer.elapsed() > 5000) || (num_timepoints_handled == N)) {
-                    printf("%ld/%ld (%d%%)\n", num_timepoints_handled, N, (int)(num_timepoints_handled * 1.0 / N * 100));
-                    timer.restart();
-                }
-            }
-        }
-    }
+    bool ok = P_whiten::apply_whitening_matrix(X, WW, Y, chunk_size, opts.quantization_unit);
     Y.close();
 
-    return true;
+    return ok;
 }
 
 bool p_compute_whitening_matrix(QStringList timeseries_list, const QList<int>& channels, QString whitening_matrix_out, Whiten_opts opts)
@@ -230,7 +186,7 @@ bool p_compute_whitening_matrix(QStringList timeseries_list, const QList<int>& c
     bigint timepoint = 0;
     while (timepoint < N) {
         QList<Mda32> chunks;
-        while ((timepoint < N) && (chunks.count() < omp_get_max_threads())) {
+        while ((timepoint < N) && (chunks.count() < QThread::idealThreadCount())) {
             Mda32 chunk0;
             if (!X0.readChunk(chunk0, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
                 qWarning() << "Problem reading chunk in compute whiten matrix";
@@ -362,7 +318,7 @@ bool p_apply_whitening_matrix(QString timeseries, QString whitening_matrix, QStr
     bigint M = X.N1();
     bigint N = X.N2();
 
-    bigint processing_chunk_size = 1e7;
+    bigint processing_chunk_size = 1e5; //small enough that all the pipeline workers have chunks to work on
     bigint chunk_size = processing_chunk_size;
     if (N < processing_chunk_size) {
         chunk_size = N;
@@ -370,61 +326,15 @@ bool p_apply_whitening_matrix(QString timeseries, QString whitening_matrix, QStr
 
     Mda WW(whitening_matrix);
 
-    double* WWptr = WW.dataPtr();
-
     DiskWriteMda Y;
     int dtype = MDAIO_TYPE_FLOAT32;
     if (opts.quantization_unit > 0)
         dtype = MDAIO_TYPE_INT16;
     Y.open(dtype, timeseries_out, M, N);
-    {
-        QTime timer;
-        timer.start();
-        bigint num_timepoints_handled = 0;
-#pragma omp parallel for
-        for (bigint timepoint = 0; timepoint < N; timepoint += chunk_size) {
-            Mda32 chunk_in;
-#pragma omp critical(lock1)
-            {
-                if (!X.readChunk(chunk_in, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
-                    qWarning() << "Problem reading chunk in whiten (3)";
-                }
-            }
-            float* chunk_in_ptr = chunk_in.dataPtr();
-            Mda32 chunk_out(M, chunk_in.N2());
-            float* chunk_out_ptr = chunk_out.dataPtr();
-            for (bigint i = 0; i < chunk_in.N2(); i++) { // explicitly do mat-mat mult ... TODO replace w/ BLAS3
-                bigint aa = M * i;
-                bigint bb = 0;
-                for (bigint m1 = 0; m1 < M; m1++) {
-                    for (bigint m2 = 0; m2 < M; m2++) {
-                        chunk_out_ptr[aa + m1] += chunk_in_ptr[aa + m2] * WWptr[bb]; // actually this does dgemm w/ WW^T
-                        bb++; // but since symmetric, doesn't matter.
-                    }
-                }
-            }
-#pragma omp critical(lock2)
-            {
-                // The following is needed to make the output deterministic, due to a very tricky floating-point problem that I honestly could not track down
-                // It has something to do with multiplying by very small values of WWptr[bb]. But I truly could not pinpoint the exact problem.
-                P_whiten::quantize(chunk_out.totalSize(), chunk_out.dataPtr(), 0.0001);
-                if (opts.quantization_unit > 0) {
-                    P_whiten::scale_for_quantization(chunk_out, opts.quantization_unit);
-                }
-                if (!Y.writeChunk(chunk_out, 0, timepoint)) {
-                    qWarning() << "Problem writing chunk in apply whitening matrix";
-                }
-                num_timepoints_handled += qMin(chunk_size, N - timepoint);
-                if ((timer.elapsed() > 5000) || (num_timepoints_handled == N)) {
-                    printf("%ld/%ld (%d%%)\n", num_timepoints_handled, N, (int)(num_timepoints_handled * 1.0 / N * 100));
-                    timer.restart();
-                }
-            }
-        }
-    }
+    bool ok = P_whiten::apply_whitening_matrix(X, WW, Y, chunk_size, opts.quantization_unit);
     Y.close();
 
-    return true;
+    return ok;
 }
 
 namespace P_whiten {
@@ -442,6 +352,67 @@ Mda32 extract_channels_from_chunk(const Mda32& X, const QList<int>& channels)
     return ret;
 }
 
+bool apply_whitening_matrix(DiskReadMda32& X, const Mda& WW, DiskWriteMda& Y, bigint chunk_size, double quantization_unit)
+{
+    //read, multiply and write are overlapped: one reader thread, a worker per core, and the ordered writer
+    bigint M = X.N1();
+    bigint N = X.N2();
+    const double* WWptr = WW.constDataPtr();
+    if (!chunk_size)
+        return true;
+
+    QTime timer;
+    timer.start();
+    bigint num_timepoints_handled = 0;
+
+    ChunkPipeline pipeline;
+    pipeline.setNumChunks((N + chunk_size - 1) / chunk_size);
+    pipeline.setReadFunction([&](bigint i, Mda32& chunk) {
+        bigint timepoint = i * chunk_size;
+        if (!X.readChunk(chunk, 0, timepoint, M, qMin(chunk_size, N - timepoint))) {
+            qWarning() << "Problem reading chunk in whiten" << timepoint;
+            return false;
+        }
+        return true;
+    });
+    pipeline.setComputeFunction([&](int, bigint, Mda32& chunk) {
+        float* chunk_in_ptr = chunk.dataPtr();
+        Mda32 chunk_out(M, chunk.N2());
+        float* chunk_out_ptr = chunk_out.dataPtr();
+        for (bigint i = 0; i < chunk.N2(); i++) { // explicitly do mat-mat mult ... TODO replace w/ BLAS3
+            bigint aa = M * i;
+            bigint bb = 0;
+            for (bigint m1 = 0; m1 < M; m1++) {
+                for (bigint m2 = 0; m2 < M; m2++) {
+                    chunk_out_ptr[aa + m1] += chunk_in_ptr[aa + m2] * WWptr[bb]; // actually this does dgemm w/ WW^T
+                    bb++; // but since symmetric, doesn't matter.
+                }
+            }
+        }
+        // The following is needed to make the output deterministic, due to a very tricky floating-point problem that I honestly could not track down
+        // It has something to do with multiplying by very small values of WWptr[bb]. But I truly could not pinpoint the exact problem.
+        P_whiten::quantize(chunk_out.totalSize(), chunk_out.dataPtr(), 0.0001);
+        if (quantization_unit > 0) {
+            P_whiten::scale_for_quantization(chunk_out, quantization_unit);
+        }
+        chunk = chunk_out;
+        return true;
+    });
+    pipeline.setWriteFunction([&](bigint i, Mda32& chunk) {
+        if (!Y.writeChunk(chunk, 0, i * chunk_size)) {
+            qWarning() << "Problem writing chunk in whiten" << i * chunk_size;
+            return false;
+        }
+        num_timepoints_handled += chunk.N2();
+        if ((timer.elapsed() > 5000) || (num_timepoints_handled == N)) {
+            printf("%ld/%ld (%d%%)\n", num_timepoints_handled, N, (int)(num_timepoints_handled * 1.0 / N * 100));
+            timer.restart();
+        }
+        return true;
+    });
+    return pipeline.run();
+}
+
 void scale_for_quantization(Mda32& X, double quantization_unit)
 {
     bigint N = X.totalSize();
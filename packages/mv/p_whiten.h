@@ -17,6 +17,7 @@
 #define P_WHITEN_H
 
 #include <QString>
+#include <QStringList>
 
 struct Whiten_opts {
     double quantization_unit = 0;